@@ -0,0 +1,264 @@
+#include "base64.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+constexpr std::uint8_t INVALID = 0xff;
+constexpr std::uint8_t WHITESPACE = 0xfe;
+constexpr std::uint8_t PADDING = 0xfd;
+
+/// The vector kernels store 16 or 32 bytes for every 12 or 24 decoded bytes, so the output buffer
+/// has this many bytes after the decoded data
+constexpr std::size_t STORE_SLACK = 8;
+
+constexpr std::array<std::uint8_t, 256> make_decoding_table() {
+    std::array<std::uint8_t, 256> table{};
+    table.fill(INVALID);
+    constexpr std::string_view alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    for (std::size_t i = 0; i < alphabet.size(); ++i) {
+        table[static_cast<unsigned char>(alphabet[i])] = static_cast<std::uint8_t>(i);
+    }
+    for (const char ch : {' ', '\t', '\n', '\r'}) {
+        table[static_cast<unsigned char>(ch)] = WHITESPACE;
+    }
+    table['='] = PADDING;
+    return table;
+}
+
+constexpr auto DECODING_TABLE = make_decoding_table();
+
+/// Decode whole blocks of base64 characters from the beginning of input, up to output_size bytes.
+/// Stops at the first block containing anything else than the base64 alphabet (whitespace, padding,
+/// invalid characters), which is left to the scalar code. Returns the number of consumed characters;
+/// 3/4 of them are written to output.
+using DecodeBlocks = std::size_t (*)(const char * input, std::size_t input_size, unsigned char * output,
+                                     std::size_t output_size);
+
+#if defined(__x86_64__)
+
+// The characters are translated to sextets and validated with nibble lookup tables, and the sextets
+// are packed with multiply-add instructions (W. Muła, D. Lemire: Faster Base64 Encoding and Decoding
+// Using AVX2 Instructions, ACM TWEB 12(3), 2018). A character is valid when the bits looked up by its low
+// and high nibble do not intersect.
+
+__attribute__((target("sse4.2"))) std::size_t decode_blocks_sse42(
+    const char * input, const std::size_t input_size, unsigned char * output, const std::size_t output_size) {
+    const __m128i lut_lo = _mm_setr_epi8(
+        0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+    const __m128i lut_hi = _mm_setr_epi8(
+        0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m128i lut_roll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i nibble_mask = _mm_set1_epi8(0x0f);
+    const __m128i slash = _mm_set1_epi8('/');
+    const __m128i pack_pairs = _mm_set1_epi32(0x01400140);
+    const __m128i pack_quads = _mm_set1_epi32(0x00011000);
+    const __m128i pack_bytes = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+
+    std::size_t consumed = 0;
+    std::size_t produced = 0;
+    while (input_size - consumed >= 16 && output_size - produced >= 12) {
+        const __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i *>(input + consumed));
+        const __m128i hi_nibbles = _mm_and_si128(_mm_srli_epi32(chars, 4), nibble_mask);
+        const __m128i lo_nibbles = _mm_and_si128(chars, nibble_mask);
+        const __m128i lo = _mm_shuffle_epi8(lut_lo, lo_nibbles);
+        const __m128i hi = _mm_shuffle_epi8(lut_hi, hi_nibbles);
+        if (!_mm_testz_si128(lo, hi)) {
+            break;
+        }
+        // '/' shares the high nibble with '+', it is told apart by adding -1 to its index
+        const __m128i roll = _mm_shuffle_epi8(lut_roll, _mm_add_epi8(_mm_cmpeq_epi8(chars, slash), hi_nibbles));
+        const __m128i sextets = _mm_add_epi8(chars, roll);
+        const __m128i pairs = _mm_maddubs_epi16(sextets, pack_pairs);
+        const __m128i quads = _mm_madd_epi16(pairs, pack_quads);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(output + produced), _mm_shuffle_epi8(quads, pack_bytes));
+        consumed += 16;
+        produced += 12;
+    }
+    return consumed;
+}
+
+__attribute__((target("avx2"))) std::size_t decode_blocks_avx2(
+    const char * input, const std::size_t input_size, unsigned char * output, const std::size_t output_size) {
+    // The shuffles work within 128-bit lanes, so the tables are repeated in both lanes
+    const __m256i lut_lo = _mm256_setr_epi8(
+        0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a,
+        0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+    const __m256i lut_hi = _mm256_setr_epi8(
+        0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+        0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m256i lut_roll = _mm256_setr_epi8(
+        0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i nibble_mask = _mm256_set1_epi8(0x0f);
+    const __m256i slash = _mm256_set1_epi8('/');
+    const __m256i pack_pairs = _mm256_set1_epi32(0x01400140);
+    const __m256i pack_quads = _mm256_set1_epi32(0x00011000);
+    const __m256i pack_bytes = _mm256_setr_epi8(
+        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    // The 12 bytes of each lane are moved next to each other
+    const __m256i pack_lanes = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+
+    std::size_t consumed = 0;
+    std::size_t produced = 0;
+    while (input_size - consumed >= 32 && output_size - produced >= 24) {
+        const __m256i chars = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(input + consumed));
+        const __m256i hi_nibbles = _mm256_and_si256(_mm256_srli_epi32(chars, 4), nibble_mask);
+        const __m256i lo_nibbles = _mm256_and_si256(chars, nibble_mask);
+        const __m256i lo = _mm256_shuffle_epi8(lut_lo, lo_nibbles);
+        const __m256i hi = _mm256_shuffle_epi8(lut_hi, hi_nibbles);
+        if (!_mm256_testz_si256(lo, hi)) {
+            break;
+        }
+        const __m256i roll =
+            _mm256_shuffle_epi8(lut_roll, _mm256_add_epi8(_mm256_cmpeq_epi8(chars, slash), hi_nibbles));
+        const __m256i sextets = _mm256_add_epi8(chars, roll);
+        const __m256i pairs = _mm256_maddubs_epi16(sextets, pack_pairs);
+        const __m256i quads = _mm256_madd_epi16(pairs, pack_quads);
+        const __m256i bytes = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(quads, pack_bytes), pack_lanes);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(output + produced), bytes);
+        consumed += 32;
+        produced += 24;
+    }
+    return consumed;
+}
+
+#endif
+
+DecodeBlocks get_decode_blocks(const Base64Kernel kernel) {
+    switch (kernel) {
+#if defined(__x86_64__)
+        case Base64Kernel::SSE42:
+            return decode_blocks_sse42;
+        case Base64Kernel::AVX2:
+            return decode_blocks_avx2;
+#endif
+        default:
+            return nullptr;
+    }
+}
+
+std::optional<std::vector<unsigned char>> decode(
+    const DecodeBlocks decode_blocks, const std::string_view input, const std::size_t max_size) {
+    const auto capacity = std::min(input.size() / 4 * 3, max_size);
+    std::vector<unsigned char> output(capacity + STORE_SLACK);
+    // Stores through unsigned char may alias the members of the vector, so the buffer is kept in a local
+    unsigned char * const buffer = output.data();
+    std::size_t size = 0;
+
+    std::uint32_t quantum = 0;
+    int sextets = 0;
+    int padding = 0;
+    // The vector kernel decodes the beginning of the input and of every line, where a quantum starts.
+    // The rest (the padding, invalid characters and the tail shorter than a block) is decoded here. The
+    // state is passed by value, so that the stores to the buffer cannot alias it.
+    const auto decode_line = [decode_blocks, input, buffer, capacity](const std::size_t pos, const std::size_t size) {
+        return decode_blocks(input.data() + pos, input.size() - pos, buffer + size, capacity - size);
+    };
+    std::size_t pos = 0;
+    if (decode_blocks != nullptr) {
+        pos = decode_line(0, 0);
+        size = pos / 4 * 3;
+    }
+    for (; pos < input.size(); ++pos) {
+        const auto value = DECODING_TABLE[static_cast<unsigned char>(input[pos])];
+        if (value == WHITESPACE) {
+            if (decode_blocks != nullptr && sextets == 0 && padding == 0) {
+                // The loop continues with the first character the kernel did not decode
+                const auto consumed = decode_line(pos + 1, size);
+                pos += consumed;
+                size += consumed / 4 * 3;
+            }
+            continue;
+        }
+        if (value == INVALID) {
+            return std::nullopt;
+        }
+        if (value == PADDING) {
+            // Padding is allowed only in the last two positions of the last quantum
+            if (sextets < 2) {
+                return std::nullopt;
+            }
+            ++padding;
+            ++sextets;
+        } else {
+            if (padding > 0) {
+                return std::nullopt;
+            }
+            quantum = (quantum << 6) | value;
+            ++sextets;
+        }
+        if (sextets < 4) {
+            continue;
+        }
+
+        quantum <<= 6 * padding;
+        const std::array<unsigned char, 3> bytes{
+            static_cast<unsigned char>(quantum >> 16),
+            static_cast<unsigned char>(quantum >> 8),
+            static_cast<unsigned char>(quantum)};
+        for (int i = 0; i < 3 - padding; ++i) {
+            if (size == max_size) {
+                output.resize(size);
+                return output;
+            }
+            buffer[size++] = bytes[static_cast<std::size_t>(i)];
+        }
+        if (padding > 0) {
+            // Only whitespace can follow the padding
+            padding = 3;
+        }
+        quantum = 0;
+        sextets = 0;
+    }
+
+    if (sextets != 0 || padding == 1 || padding == 2) {
+        return std::nullopt;
+    }
+    output.resize(size);
+    return output;
+}
+
+}  // namespace
+
+bool base64_kernel_supported(const Base64Kernel kernel) {
+    switch (kernel) {
+        case Base64Kernel::SCALAR:
+            return true;
+#if defined(__x86_64__)
+        case Base64Kernel::SSE42:
+            return __builtin_cpu_supports("sse4.2");
+        case Base64Kernel::AVX2:
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+    }
+}
+
+Base64Kernel base64_best_kernel() {
+    for (const auto kernel : {Base64Kernel::AVX2, Base64Kernel::SSE42}) {
+        if (base64_kernel_supported(kernel)) {
+            return kernel;
+        }
+    }
+    return Base64Kernel::SCALAR;
+}
+
+std::optional<std::vector<unsigned char>> base64_decode(const std::string_view input, const std::size_t max_size) {
+    // The CPU is checked once per process
+    static const auto decode_blocks = get_decode_blocks(base64_best_kernel());
+    return decode(decode_blocks, input, max_size);
+}
+
+std::optional<std::vector<unsigned char>> base64_decode(
+    const Base64Kernel kernel, const std::string_view input, const std::size_t max_size) {
+    return decode(get_decode_blocks(kernel), input, max_size);
+}
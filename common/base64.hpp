@@ -0,0 +1,36 @@
+#ifndef RHSM_DNF5_PLUGINS_BASE64_HPP
+#define RHSM_DNF5_PLUGINS_BASE64_HPP
+
+#include <cstddef>
+#include <limits>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+/// Implementations of base64_decode(). The vector kernels decode blocks of 16 (SSE4.2) or 32 (AVX2)
+/// base64 characters at once; everything else (line breaks, padding, invalid characters and the tail)
+/// is decoded by the scalar code, so all kernels give the same results.
+enum class Base64Kernel { SCALAR, SSE42, AVX2 };
+
+/// Is the kernel supported by the CPU? The scalar kernel is supported everywhere, the vector
+/// kernels only on x86-64 CPUs with the instruction set.
+bool base64_kernel_supported(Base64Kernel kernel);
+
+/// The fastest kernel supported by the CPU; it is used by base64_decode()
+Base64Kernel base64_best_kernel();
+
+/// Decode base64 (RFC 4648) data, e.g. the body of a PEM block. Whitespace (including line
+/// breaks) is skipped. Decoding stops when max_size bytes have been produced, which allows
+/// reading only the beginning of large documents. Returns std::nullopt on invalid input.
+std::optional<std::vector<unsigned char>> base64_decode(
+    std::string_view input,
+    std::size_t max_size = std::numeric_limits<std::size_t>::max());
+
+/// Like base64_decode(), but use the given kernel (used by tests and benchmarks). The kernel
+/// must be supported by the CPU, see base64_kernel_supported().
+std::optional<std::vector<unsigned char>> base64_decode(
+    Base64Kernel kernel,
+    std::string_view input,
+    std::size_t max_size = std::numeric_limits<std::size_t>::max());
+
+#endif // RHSM_DNF5_PLUGINS_BASE64_HPP
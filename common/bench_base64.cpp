@@ -0,0 +1,124 @@
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <openssl/evp.h>
+
+#include "base64.hpp"
+
+/// Throughput of base64_decode() with every kernel, and of the PEM decoder of OpenSSL (EVP_DecodeUpdate(),
+/// used by PEM_read_X509()) for comparison. The inputs are the bodies of the test certificates (1-2 KiB)
+/// and generated PEM bodies of the sizes of v3 entitlement certificates with a large content extension
+/// (32 KiB) and of the entitlement data of Simple Content Access certificates (2 MiB), wrapped in lines
+/// of 64 characters like PEM.
+///
+/// The results can be compared across commits with compare.py of Google Benchmark, see TESTING.md.
+
+namespace {
+
+constexpr std::string_view BASE64_ALPHABET = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+constexpr std::size_t PEM_LINE_LENGTH = 64;
+
+/// The body of the first PEM block of the test certificate
+std::string read_pem_body(const std::string & name) {
+    std::ifstream file(std::filesystem::path(TEST_DATA_DIR) / name, std::ios::binary);
+    std::ostringstream content;
+    content << file.rdbuf();
+    const auto pem = std::move(content).str();
+    const auto begin = pem.find('\n') + 1;
+    return pem.substr(begin, pem.find("-----END") - begin);
+}
+
+/// A PEM body of the given number of random encoded bytes
+std::string generate_pem_body(const std::size_t size) {
+    std::mt19937 random(42);
+    std::string body;
+    for (std::size_t i = 0; i < size / 3 * 4; ++i) {
+        body += BASE64_ALPHABET[random() % BASE64_ALPHABET.size()];
+        if ((i + 1) % PEM_LINE_LENGTH == 0) {
+            body += '\n';
+        }
+    }
+    return body + "\n";
+}
+
+/// The inputs indexed by the second argument of the benchmarks
+const std::string & get_input(const std::int64_t index) {
+    static const std::vector<std::string> inputs{
+        read_pem_body("product-479.pem"),
+        read_pem_body("entitlement-v3.pem"),
+        generate_pem_body(32 * 1024),
+        generate_pem_body(2 * 1024 * 1024)};
+    return inputs[static_cast<std::size_t>(index)];
+}
+
+void input_args(benchmark::internal::Benchmark * benchmark) {
+    for (std::int64_t input = 0; input < 4; ++input) {
+        benchmark->Arg(input);
+    }
+}
+
+void kernel_args(benchmark::internal::Benchmark * benchmark) {
+    for (const auto kernel : {Base64Kernel::SCALAR, Base64Kernel::SSE42, Base64Kernel::AVX2}) {
+        for (std::int64_t input = 0; input < 4; ++input) {
+            benchmark->Args({static_cast<std::int64_t>(kernel), input});
+        }
+    }
+}
+
+void BM_Base64Decode(benchmark::State & state) {
+    const auto kernel = static_cast<Base64Kernel>(state.range(0));
+    if (!base64_kernel_supported(kernel)) {
+        state.SkipWithError("the kernel is not supported by the CPU");
+        return;
+    }
+    const auto & input = get_input(state.range(1));
+    for (auto _ : state) {
+        auto decoded = base64_decode(kernel, input);
+        benchmark::DoNotOptimize(decoded);
+    }
+    state.SetBytesProcessed(state.iterations() * static_cast<std::int64_t>(input.size()));
+}
+BENCHMARK(BM_Base64Decode)->Apply(kernel_args);
+
+void BM_Base64DecodeBest(benchmark::State & state) {
+    const auto & input = get_input(state.range(0));
+    for (auto _ : state) {
+        auto decoded = base64_decode(input);
+        benchmark::DoNotOptimize(decoded);
+    }
+    state.SetBytesProcessed(state.iterations() * static_cast<std::int64_t>(input.size()));
+}
+BENCHMARK(BM_Base64DecodeBest)->Apply(input_args);
+
+void BM_OpenSslDecode(benchmark::State & state) {
+    const auto & input = get_input(state.range(0));
+    const auto context = std::unique_ptr<EVP_ENCODE_CTX, decltype(&EVP_ENCODE_CTX_free)>(
+        EVP_ENCODE_CTX_new(), EVP_ENCODE_CTX_free);
+    for (auto _ : state) {
+        std::vector<unsigned char> decoded(input.size() / 4 * 3 + 3);
+        int size = 0;
+        int final_size = 0;
+        EVP_DecodeInit(context.get());
+        const auto * data = reinterpret_cast<const unsigned char *>(input.data());
+        if (EVP_DecodeUpdate(context.get(), decoded.data(), &size, data, static_cast<int>(input.size())) < 0 ||
+            EVP_DecodeFinal(context.get(), decoded.data() + size, &final_size) < 0) {
+            state.SkipWithError("EVP_DecodeUpdate() failed");
+            return;
+        }
+        decoded.resize(static_cast<std::size_t>(size + final_size));
+        benchmark::DoNotOptimize(decoded);
+    }
+    state.SetBytesProcessed(state.iterations() * static_cast<std::int64_t>(input.size()));
+}
+BENCHMARK(BM_OpenSslDecode)->Apply(input_args);
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,148 @@
+#ifndef RHSM_DNF5_PLUGINS_BENCH_FIXTURES_HPP
+#define RHSM_DNF5_PLUGINS_BENCH_FIXTURES_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+#include <openssl/x509v3.h>
+#include <zlib.h>
+
+/// Fixtures of the microbenchmarks generated on the fly with OpenSSL. Generating and signing
+/// 100k certificates would take longer than the benchmarks, so at most UNIQUE_CERTIFICATES
+/// distinct certificates are generated and the larger fixtures repeat them; parsing a repeated
+/// certificate costs the same as parsing a distinct one.
+
+namespace bench_fixtures {
+
+constexpr std::int64_t UNIQUE_CERTIFICATES = 1000;
+
+/// The sizes of the parameterized fixtures: 1, 10, 100, ..., 100k products or certificates
+constexpr std::int64_t MIN_FIXTURE_SIZE = 1;
+constexpr std::int64_t MAX_FIXTURE_SIZE = 100000;
+
+/// The first product ID of generated product certificates
+constexpr std::int64_t FIRST_PRODUCT_ID = 100000;
+
+/// Generate a self-signed certificate in the PEM format. When product_id is not empty,
+/// the certificate contains the Red Hat product extensions like a product certificate.
+/// Expired certificates were valid for one day a year ago.
+inline std::string generate_certificate(const std::int64_t serial, const std::string &product_id = "",
+                                        const bool expired = false) {
+    static const auto key = std::unique_ptr<EVP_PKEY, decltype(&EVP_PKEY_free)>(EVP_EC_gen("P-256"), EVP_PKEY_free);
+    constexpr long YEAR = 365L * 24 * 3600;
+
+    const auto cert = std::unique_ptr<X509, decltype(&X509_free)>(X509_new(), X509_free);
+    X509_set_version(cert.get(), X509_VERSION_3);
+    ASN1_INTEGER_set_int64(X509_get_serialNumber(cert.get()), serial);
+    X509_gmtime_adj(X509_getm_notBefore(cert.get()), expired ? -YEAR : 0);
+    X509_gmtime_adj(X509_getm_notAfter(cert.get()), expired ? -YEAR + 24 * 3600 : YEAR);
+    X509_set_pubkey(cert.get(), key.get());
+    auto *name = X509_get_subject_name(cert.get());
+    const auto common_name = std::to_string(serial);
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+                               reinterpret_cast<const unsigned char *>(common_name.c_str()), -1, -1, 0);
+    X509_set_issuer_name(cert.get(), name);
+
+    // 1.3.6.1.4.1.2312.9.1.<product ID>.1 (name), .2 (version) and .3 (architecture)
+    if (!product_id.empty()) {
+        const std::string values[] = {"Product " + product_id, "10.0", "x86_64"};
+        for (int i = 0; i < 3; ++i) {
+            const auto oid = "1.3.6.1.4.1.2312.9.1." + product_id + "." + std::to_string(i + 1);
+            auto *data = ASN1_OCTET_STRING_new();
+            ASN1_OCTET_STRING_set(data, reinterpret_cast<const unsigned char *>(values[i].data()),
+                                  static_cast<int>(values[i].size()));
+            auto *object = OBJ_txt2obj(oid.c_str(), 1);
+            auto *extension = X509_EXTENSION_create_by_OBJ(nullptr, object, 0, data);
+            X509_add_ext(cert.get(), extension, -1);
+            X509_EXTENSION_free(extension);
+            ASN1_OBJECT_free(object);
+            ASN1_OCTET_STRING_free(data);
+        }
+    }
+
+    if (X509_sign(cert.get(), key.get(), EVP_sha256()) == 0) {
+        throw std::runtime_error("could not sign certificate");
+    }
+    const auto bio = std::unique_ptr<BIO, decltype(&BIO_free)>(BIO_new(BIO_s_mem()), BIO_free);
+    if (PEM_write_bio_X509(bio.get(), cert.get()) != 1) {
+        throw std::runtime_error("could not write certificate");
+    }
+    char *pem = nullptr;
+    const auto size = BIO_get_mem_data(bio.get(), &pem);
+    return {pem, static_cast<std::size_t>(size)};
+}
+
+/// Return count product certificates; the product IDs are FIRST_PRODUCT_ID, FIRST_PRODUCT_ID + 1, ...
+/// modulo UNIQUE_CERTIFICATES
+inline std::vector<std::string> generate_product_certificates(const std::int64_t count) {
+    static std::vector<std::string> unique;
+    while (static_cast<std::int64_t>(unique.size()) < std::min(count, UNIQUE_CERTIFICATES)) {
+        const auto serial = static_cast<std::int64_t>(unique.size());
+        unique.push_back(generate_certificate(serial, std::to_string(FIRST_PRODUCT_ID + serial)));
+    }
+    std::vector<std::string> certificates;
+    certificates.reserve(static_cast<std::size_t>(count));
+    for (std::int64_t i = 0; i < count; ++i) {
+        certificates.push_back(unique[static_cast<std::size_t>(i % UNIQUE_CERTIFICATES)]);
+    }
+    return certificates;
+}
+
+inline void write_file(const std::filesystem::path &path, const std::string &content) {
+    std::ofstream file(path, std::ios::binary);
+    if (!(file << content)) {
+        throw std::runtime_error("could not write file: " + path.string());
+    }
+}
+
+/// Write the content gzip compressed, like productid metadata of repositories
+inline void write_compressed_file(const std::filesystem::path &path, const std::string &content) {
+    const auto file = std::unique_ptr<gzFile_s, decltype(&gzclose)>(gzopen(path.c_str(), "wb"), gzclose);
+    if (!file || gzwrite(file.get(), content.data(), static_cast<unsigned>(content.size())) == 0) {
+        throw std::runtime_error("could not write file: " + path.string());
+    }
+}
+
+/// A temporary directory removed with all its content when the fixture is destroyed
+class TemporaryDirectory {
+public:
+    explicit TemporaryDirectory(const std::string &name)
+        : path(std::filesystem::temp_directory_path() / name) {
+        std::filesystem::remove_all(path);
+        std::filesystem::create_directories(path);
+    }
+
+    ~TemporaryDirectory() {
+        std::error_code ec;
+        std::filesystem::remove_all(path, ec);
+    }
+
+    TemporaryDirectory(const TemporaryDirectory &) = delete;
+    TemporaryDirectory &operator=(const TemporaryDirectory &) = delete;
+
+    std::filesystem::path path;
+};
+
+/// Return the fixture of the given size (e.g. state.range(0)). Only the last used fixture is kept,
+/// so a directory with 100k files exists only while the benchmarks of that size run.
+template <typename Fixture>
+Fixture &current_fixture(const std::int64_t count) {
+    static std::unique_ptr<Fixture> current;
+    if (!current || current->count != count) {
+        current.reset();
+        current = std::make_unique<Fixture>(count);
+    }
+    return *current;
+}
+
+}  // namespace bench_fixtures
+
+#endif // RHSM_DNF5_PLUGINS_BENCH_FIXTURES_HPP
@@ -0,0 +1,129 @@
+#include <benchmark/benchmark.h>
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <dlfcn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <libdnf5/base/base.hpp>
+
+/// Cold start of the plugins in a dnf process. Every measurement runs in a freshly forked child,
+/// in which the plugin has never been loaded:
+///
+/// - BM_Dlopen: dlopen() of the plugin library, including its dependencies and relocations
+/// - BM_BaseSetup: Base::setup() loading only the given plugin; it includes dlopen(), the construction
+///   of the plugin and its init, pre_base_setup and post_base_setup hooks. BM_BaseSetup/none is
+///   the baseline without plugins.
+///
+/// Run it as root to measure the status checks of the rhsm plugin, as another user to measure
+/// its early return.
+
+namespace {
+
+struct Plugin {
+    const char *name;
+    std::filesystem::path library;
+};
+
+const Plugin PLUGINS[]{
+    {"rhsm", RHSM_PLUGIN_PATH},
+    {"productid", PRODUCTID_PLUGIN_PATH},
+};
+
+struct ChildResult {
+    std::int64_t nanoseconds = -1;
+};
+
+/// Run the function in a forked child and return the time it took
+template <typename Function>
+ChildResult run_in_child(Function &&function) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        throw std::runtime_error("pipe() failed");
+    }
+    const pid_t pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        ChildResult result;
+        try {
+            const auto start = std::chrono::steady_clock::now();
+            function();
+            result.nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count();
+        } catch (...) {
+        }
+        [[maybe_unused]] const auto written = write(fds[1], &result, sizeof(result));
+        _exit(0);
+    }
+    close(fds[1]);
+    ChildResult result;
+    const auto size = read(fds[0], &result, sizeof(result));
+    close(fds[0]);
+    int status = 0;
+    waitpid(pid, &status, 0);
+    if (size != sizeof(result) || result.nanoseconds < 0) {
+        throw std::runtime_error("The measurement failed in the child process");
+    }
+    return result;
+}
+
+/// Create the configuration directory of one plugin; no plugin is enabled for an empty name
+std::filesystem::path create_plugin_conf_dir(const std::string &name) {
+    const auto dir = std::filesystem::temp_directory_path() / ("bench_plugin_cold_start_" + name);
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+    if (!name.empty()) {
+        std::ofstream(dir / (name + ".conf")) << "[main]\nname = " << name << "\nenabled = yes\n";
+    }
+    return dir;
+}
+
+void report(benchmark::State &state, const ChildResult &result) {
+    state.SetIterationTime(static_cast<double>(result.nanoseconds) / 1e9);
+}
+
+void BM_Dlopen(benchmark::State &state) {
+    const auto &plugin = PLUGINS[state.range(0)];
+    state.SetLabel(plugin.name);
+    for (auto _ : state) {
+        report(state, run_in_child([&plugin]() {
+            if (!dlopen(plugin.library.c_str(), RTLD_NOW | RTLD_LOCAL)) {
+                throw std::runtime_error(dlerror());
+            }
+        }));
+    }
+}
+BENCHMARK(BM_Dlopen)->DenseRange(0, static_cast<int>(std::size(PLUGINS)) - 1)->UseManualTime()->Unit(benchmark::kMicrosecond);
+
+void BM_BaseSetup(benchmark::State &state) {
+    const bool baseline = state.range(0) < 0;
+    const std::string name = baseline ? "" : PLUGINS[state.range(0)].name;
+    const auto plugin_dir = baseline ? std::filesystem::path() : PLUGINS[state.range(0)].library.parent_path();
+    const auto conf_dir = create_plugin_conf_dir(name);
+    state.SetLabel(baseline ? "none" : name);
+    for (auto _ : state) {
+        report(state, run_in_child([&]() {
+            libdnf5::Base base;
+            auto &config = base.get_config();
+            config.get_plugins_option().set(!baseline);
+            config.get_pluginconfpath_option().set(conf_dir.string());
+            if (!baseline) {
+                config.get_pluginpath_option().set(plugin_dir.string());
+            }
+            // Do not detect the release version from the rpmdb
+            base.get_vars()->set("releasever", "10");
+            base.setup();
+        }));
+    }
+    std::filesystem::remove_all(conf_dir);
+}
+BENCHMARK(BM_BaseSetup)->DenseRange(-1, static_cast<int>(std::size(PLUGINS)) - 1)->UseManualTime()->Unit(benchmark::kMicrosecond);
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,197 @@
+#include "cert_cache.hpp"
+
+#include "base64.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr std::string_view REDHAT_PRODUCT_OID_PREFIX = "1.3.6.1.4.1.2312.9.1.";
+
+constexpr std::string_view PEM_BEGIN_ENTITLEMENT_DATA = "-----BEGIN ENTITLEMENT DATA-----";
+constexpr std::string_view PEM_END = "-----END ";
+
+std::int64_t to_ns(const timespec &time) {
+    return static_cast<std::int64_t>(time.tv_sec) * 1000000000 + time.tv_nsec;
+}
+
+/// Read the whole file; size is the size reported by stat(), so that the file is usually read by one
+/// read() call (and a second one finding the end of the file)
+std::string read_file(const std::filesystem::path &path, const std::size_t size) {
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error("could not open file: " + path.string());
+    }
+    std::string content(size + 1, '\0');
+    std::size_t length = 0;
+    while (true) {
+        if (length == content.size()) {
+            content.resize(content.size() * 2);
+        }
+        const auto count = read(fd, content.data() + length, content.size() - length);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count < 0) {
+            const std::string error = std::strerror(errno);
+            close(fd);
+            throw std::runtime_error("read error on " + path.string() + ": " + error);
+        }
+        if (count == 0) {
+            break;
+        }
+        length += static_cast<std::size_t>(count);
+    }
+    close(fd);
+    content.resize(length);
+    return content;
+}
+
+CertFacts decode(const std::string_view content) {
+    CertFacts facts;
+    facts.content_hash = fnv1a_hash(content);
+    facts.validity = read_cert_validity(content);
+    if (auto extensions = read_pem_extensions(content)) {
+        std::vector<CertExtension> redhat_extensions;
+        for (auto &extension : *extensions) {
+            if (extension.oid.starts_with(REDHAT_OID_PREFIX)) {
+                redhat_extensions.push_back(std::move(extension));
+            }
+        }
+        facts.redhat_extensions = std::move(redhat_extensions);
+    }
+    try {
+        facts.entitlement_data = read_pem_entitlement_data(content);
+    } catch (const std::runtime_error &e) {
+        facts.entitlement_data_error = e.what();
+    }
+    return facts;
+}
+
+}  // namespace
+
+std::uint64_t fnv1a_hash(const std::string_view data) {
+    std::uint64_t hash = 0xcbf29ce484222325ULL;
+    for (const char c : data) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+std::optional<std::vector<unsigned char>> read_pem_entitlement_data(const std::string_view pem) {
+    const auto begin = pem.find(PEM_BEGIN_ENTITLEMENT_DATA);
+    if (begin == std::string_view::npos) {
+        return std::nullopt;
+    }
+    const auto body = pem.substr(begin + PEM_BEGIN_ENTITLEMENT_DATA.size());
+    const auto end = body.find(PEM_END);
+    if (end == std::string_view::npos) {
+        throw std::runtime_error("truncated entitlement data");
+    }
+    auto data = base64_decode(body.substr(0, end));
+    if (!data) {
+        throw std::runtime_error("invalid base64 encoding of entitlement data");
+    }
+    return data;
+}
+
+std::string CertFacts::product_id() const {
+    if (redhat_extensions) {
+        for (const auto &extension : *redhat_extensions) {
+            if (!extension.oid.starts_with(REDHAT_PRODUCT_OID_PREFIX)) {
+                continue;
+            }
+            const auto rest = std::string_view(extension.oid).substr(REDHAT_PRODUCT_OID_PREFIX.size());
+            if (const auto end = rest.find('.'); end != std::string_view::npos && end > 0) {
+                return std::string(rest.substr(0, end));
+            }
+        }
+    }
+    return {};
+}
+
+std::size_t CertCache::ContentHash::operator()(const std::string_view content) const {
+    return static_cast<std::size_t>(fnv1a_hash(content));
+}
+
+CertCache & CertCache::get() {
+    static CertCache cache;
+    return cache;
+}
+
+std::shared_ptr<const CertFacts> CertCache::lookup_or_decode(std::unique_lock<std::mutex> &lock, const std::string_view content) {
+    if (const auto it = by_content.find(content); it != by_content.end()) {
+        ++hits;
+        return it->second;
+    }
+    // The certificate is decoded without holding the lock, so that the threads parsing the entitlement
+    // certificates (see get_certs_not_after()) decode them in parallel. Two threads asking for the same
+    // content at once may both decode it; the first facts are kept.
+    lock.unlock();
+    auto facts = std::make_shared<const CertFacts>(decode(content));
+    lock.lock();
+    const auto [it, inserted] = by_content.try_emplace(std::string(content), std::move(facts));
+    ++(inserted ? misses : hits);
+    return it->second;
+}
+
+std::shared_ptr<const CertFacts> CertCache::get_facts(const std::string_view content) {
+    std::unique_lock lock(mutex);
+    return lookup_or_decode(lock, content);
+}
+
+std::shared_ptr<const CertFacts> CertCache::get_file_facts(const std::filesystem::path &cert_path) {
+    struct stat file_stat{};
+    if (stat(cert_path.c_str(), &file_stat) != 0) {
+        throw std::runtime_error("could not open file: " + cert_path.string());
+    }
+    PathRecord record{
+        .inode = static_cast<std::uint64_t>(file_stat.st_ino),
+        .size = static_cast<std::int64_t>(file_stat.st_size),
+        .mtime_ns = to_ns(file_stat.st_mtim),
+        .ctime_ns = to_ns(file_stat.st_ctim),
+        .facts = nullptr,
+    };
+    {
+        const std::lock_guard lock(mutex);
+        if (const auto it = by_path.find(cert_path.native()); it != by_path.end()) {
+            const auto &cached = it->second;
+            if (cached.inode == record.inode && cached.size == record.size && cached.mtime_ns == record.mtime_ns &&
+                cached.ctime_ns == record.ctime_ns) {
+                ++hits;
+                return cached.facts;
+            }
+        }
+    }
+
+    // The file is read without holding the lock
+    const auto content = read_file(cert_path, static_cast<std::size_t>(file_stat.st_size));
+    std::unique_lock lock(mutex);
+    record.facts = lookup_or_decode(lock, content);
+    by_path.insert_or_assign(cert_path.native(), record);
+    return record.facts;
+}
+
+std::size_t CertCache::get_misses() const {
+    const std::lock_guard lock(mutex);
+    return misses;
+}
+
+std::size_t CertCache::get_hits() const {
+    const std::lock_guard lock(mutex);
+    return hits;
+}
+
+void CertCache::clear() {
+    const std::lock_guard lock(mutex);
+    by_content.clear();
+    by_path.clear();
+    hits = 0;
+    misses = 0;
+}
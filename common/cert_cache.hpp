@@ -0,0 +1,107 @@
+#ifndef RHSM_DNF5_PLUGINS_CERT_CACHE_HPP
+#define RHSM_DNF5_PLUGINS_CERT_CACHE_HPP
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "der_validity.hpp"
+
+/// Prefix of the OIDs of the extensions of Red Hat certificates
+constexpr std::string_view REDHAT_OID_PREFIX = "1.3.6.1.4.1.2312.";
+
+/// Facts read from one certificate. The certificate is decoded without OpenSSL (see der_validity.hpp);
+/// when the fast decoder fails, then validity or redhat_extensions is std::nullopt and the caller
+/// falls back to OpenSSL.
+struct CertFacts {
+    /// FNV-1a hash of the content of the certificate file. It is not a cryptographic hash; the cache
+    /// compares the whole content, too.
+    std::uint64_t content_hash = 0;
+
+    std::optional<CertValidity> validity;
+
+    /// Extensions with Red Hat OIDs (REDHAT_OID_PREFIX) in the order they are stored in the certificate,
+    /// with their whole values (e.g. the content sets of v1 entitlement certificates)
+    std::optional<std::vector<CertExtension>> redhat_extensions;
+
+    /// The "ENTITLEMENT DATA" block following v3 entitlement certificates, base64 decoded (zlib compressed
+    /// JSON); std::nullopt when there is no such block, see read_pem_entitlement_data()
+    std::optional<std::vector<unsigned char>> entitlement_data;
+
+    /// Why the "ENTITLEMENT DATA" block could not be decoded; empty when it was decoded or there is none
+    std::string entitlement_data_error;
+
+    /// Return the product ID of a product certificate: the arc following "1.3.6.1.4.1.2312.9.1." in the OID
+    /// of the first Red Hat product extension. Returns an empty string when there is no such extension.
+    [[nodiscard]] std::string product_id() const;
+};
+
+/// Certificate facts shared by both plugins for the lifetime of the dnf process. The plugins are loaded
+/// into the same process and they read the same certificates: the productid plugin parses product
+/// certificates from productid metadata and installs them, the rhsm plugin reads the installed product
+/// certificates. The cache lives in a small shared library linked by both plugins, so each certificate
+/// is decoded at most once per dnf run, whichever plugin asks first.
+///
+/// Facts are indexed by the content of the certificate and by the path of the certificate file.
+/// A cached path is valid only while the inode, the size, the modification time and the status change
+/// time of the file are the same; otherwise the file is read again and looked up by its content.
+/// All methods are thread-safe.
+class CertCache {
+public:
+    /// The cache of the process
+    static CertCache & get();
+
+    /// Return the facts of the certificate in PEM or DER format
+    std::shared_ptr<const CertFacts> get_facts(std::string_view content);
+
+    /// Return the facts of the certificate file.
+    /// Throws std::runtime_error if the file cannot be read.
+    std::shared_ptr<const CertFacts> get_file_facts(const std::filesystem::path & cert_path);
+
+    /// Certificates decoded by the cache, and requests answered without decoding
+    [[nodiscard]] std::size_t get_misses() const;
+    [[nodiscard]] std::size_t get_hits() const;
+
+    /// Forget all facts (used by tests)
+    void clear();
+
+private:
+    struct ContentHash {
+        using is_transparent = void;
+        std::size_t operator()(std::string_view content) const;
+    };
+
+    struct PathRecord {
+        std::uint64_t inode = 0;
+        std::int64_t size = 0;
+        std::int64_t mtime_ns = 0;
+        std::int64_t ctime_ns = 0;
+        std::shared_ptr<const CertFacts> facts;
+    };
+
+    /// Look up the facts of the content, or decode it; the lock of the mutex is released while decoding
+    std::shared_ptr<const CertFacts> lookup_or_decode(std::unique_lock<std::mutex> & lock, std::string_view content);
+
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, std::shared_ptr<const CertFacts>, ContentHash, std::equal_to<>> by_content;
+    std::map<std::string, PathRecord, std::less<>> by_path;
+    std::size_t hits = 0;
+    std::size_t misses = 0;
+};
+
+/// FNV-1a 64-bit hash of the data
+std::uint64_t fnv1a_hash(std::string_view data);
+
+/// Read the base64 decoded body of the "ENTITLEMENT DATA" PEM block that follows the certificate
+/// in v3 entitlement certificates. Returns std::nullopt when there is no such block.
+/// Throws std::runtime_error when the block is truncated or not valid base64.
+std::optional<std::vector<unsigned char>> read_pem_entitlement_data(std::string_view pem);
+
+#endif // RHSM_DNF5_PLUGINS_CERT_CACHE_HPP
@@ -0,0 +1,357 @@
+#include "der_validity.hpp"
+
+#include "base64.hpp"
+
+#include <chrono>
+#include <limits>
+
+namespace {
+
+constexpr unsigned char TAG_BOOLEAN = 0x01;
+constexpr unsigned char TAG_INTEGER = 0x02;
+constexpr unsigned char TAG_OCTET_STRING = 0x04;
+constexpr unsigned char TAG_OID = 0x06;
+constexpr unsigned char TAG_UTF8_STRING = 0x0c;
+constexpr unsigned char TAG_PRINTABLE_STRING = 0x13;
+constexpr unsigned char TAG_IA5_STRING = 0x16;
+constexpr unsigned char TAG_UTC_TIME = 0x17;
+constexpr unsigned char TAG_GENERALIZED_TIME = 0x18;
+constexpr unsigned char TAG_SEQUENCE = 0x30;
+constexpr unsigned char TAG_VERSION = 0xa0;  // [0] EXPLICIT, constructed
+constexpr unsigned char TAG_ISSUER_UNIQUE_ID = 0x81;  // [1] IMPLICIT
+constexpr unsigned char TAG_SUBJECT_UNIQUE_ID = 0x82;  // [2] IMPLICIT
+constexpr unsigned char TAG_EXTENSIONS = 0xa3;  // [3] EXPLICIT, constructed
+
+constexpr std::string_view PEM_BEGIN_LABEL = "-----BEGIN ";
+constexpr std::string_view PEM_BEGIN_CERTIFICATE = "-----BEGIN CERTIFICATE-----";
+constexpr std::string_view PEM_END = "-----END ";
+
+/// One DER element. The end of the content can be beyond the available data when the data
+/// is only a prefix of the certificate.
+struct DerElement {
+    unsigned char tag;
+    std::size_t begin;
+    std::size_t end;
+};
+
+/// Read the header of the element at pos. The element has to end before the limit (the end
+/// of the enclosing element). Only the definite length form with minimal length encoding is
+/// accepted, as required by DER.
+std::optional<DerElement> read_header(
+    const std::span<const unsigned char> der, std::size_t pos, const std::size_t limit) {
+    if (pos + 2 > der.size() || pos + 2 > limit) {
+        return std::nullopt;
+    }
+    const unsigned char tag = der[pos++];
+    if ((tag & 0x1f) == 0x1f) {
+        // high tag numbers are not used by the fields before the validity
+        return std::nullopt;
+    }
+
+    std::size_t length = der[pos++];
+    if (length & 0x80) {
+        const std::size_t length_bytes = length & 0x7f;
+        if (length_bytes == 0 || length_bytes > 4 || pos + length_bytes > der.size()) {
+            return std::nullopt;
+        }
+        if (der[pos] == 0) {
+            return std::nullopt;
+        }
+        length = 0;
+        for (std::size_t i = 0; i < length_bytes; ++i) {
+            length = (length << 8) | der[pos++];
+        }
+        if (length < 0x80) {
+            return std::nullopt;
+        }
+    }
+
+    if (pos > limit || length > limit - pos) {
+        return std::nullopt;
+    }
+    return DerElement{tag, pos, pos + length};
+}
+
+/// Parse a fixed number of decimal digits
+std::optional<int> parse_digits(const std::span<const unsigned char> digits) {
+    int value = 0;
+    for (const unsigned char ch : digits) {
+        if (ch < '0' || ch > '9') {
+            return std::nullopt;
+        }
+        value = value * 10 + (ch - '0');
+    }
+    return value;
+}
+
+/// Parse UTCTime (YYMMDDHHMMSSZ) or GeneralizedTime (YYYYMMDDHHMMSSZ) to seconds since the epoch
+std::optional<std::int64_t> parse_time(const std::span<const unsigned char> der, const DerElement &element) {
+    std::size_t year_digits;
+    if (element.tag == TAG_UTC_TIME) {
+        year_digits = 2;
+    } else if (element.tag == TAG_GENERALIZED_TIME) {
+        year_digits = 4;
+    } else {
+        return std::nullopt;
+    }
+    const auto value = der.subspan(element.begin, element.end - element.begin);
+    if (value.size() != year_digits + 11 || value.back() != 'Z') {
+        return std::nullopt;
+    }
+
+    auto year = parse_digits(value.first(year_digits));
+    const auto month = parse_digits(value.subspan(year_digits, 2));
+    const auto day = parse_digits(value.subspan(year_digits + 2, 2));
+    const auto hour = parse_digits(value.subspan(year_digits + 4, 2));
+    const auto minute = parse_digits(value.subspan(year_digits + 6, 2));
+    const auto second = parse_digits(value.subspan(year_digits + 8, 2));
+    if (!year || !month || !day || !hour || !minute || !second) {
+        return std::nullopt;
+    }
+    if (year_digits == 2) {
+        // RFC 5280: years 50-99 are 19xx, years 00-49 are 20xx
+        *year += *year >= 50 ? 1900 : 2000;
+    }
+    if (*hour > 23 || *minute > 59 || *second > 59) {
+        return std::nullopt;
+    }
+
+    const std::chrono::year_month_day date{
+        std::chrono::year(*year),
+        std::chrono::month(static_cast<unsigned>(*month)),
+        std::chrono::day(static_cast<unsigned>(*day))};
+    if (!date.ok()) {
+        return std::nullopt;
+    }
+    const auto days = std::chrono::sys_days(date).time_since_epoch().count();
+    return static_cast<std::int64_t>(days) * 86400 + *hour * 3600 + *minute * 60 + *second;
+}
+
+/// The TBSCertificate and its validity element
+struct ValidityLocation {
+    DerElement tbs;
+    DerElement validity;
+};
+
+/// Walk the certificate to its validity; the content of the validity is not checked
+std::optional<ValidityLocation> find_validity(const std::span<const unsigned char> der) {
+    // Certificate ::= SEQUENCE { tbsCertificate, signatureAlgorithm, signatureValue }
+    const auto certificate = read_header(der, 0, std::numeric_limits<std::size_t>::max());
+    if (!certificate || certificate->tag != TAG_SEQUENCE) {
+        return std::nullopt;
+    }
+    // TBSCertificate ::= SEQUENCE { [0] version OPTIONAL, serialNumber, signature, issuer, validity, ... }
+    const auto tbs = read_header(der, certificate->begin, certificate->end);
+    if (!tbs || tbs->tag != TAG_SEQUENCE) {
+        return std::nullopt;
+    }
+
+    auto element = read_header(der, tbs->begin, tbs->end);
+    if (element && element->tag == TAG_VERSION) {
+        // version INTEGER { v1(0), v2(1), v3(2) }
+        const auto version = read_header(der, element->begin, element->end);
+        if (!version || version->tag != TAG_INTEGER || version->end != element->end ||
+            version->end - version->begin != 1 || version->end > der.size() || der[version->begin] > 2) {
+            return std::nullopt;
+        }
+        element = read_header(der, element->end, tbs->end);
+    }
+    // serialNumber, signature and issuer are skipped without looking at their content
+    for (const unsigned char expected_tag : {TAG_INTEGER, TAG_SEQUENCE, TAG_SEQUENCE}) {
+        if (!element || element->tag != expected_tag) {
+            return std::nullopt;
+        }
+        element = read_header(der, element->end, tbs->end);
+    }
+
+    if (!element || element->tag != TAG_SEQUENCE || element->end > der.size()) {
+        return std::nullopt;
+    }
+    return ValidityLocation{*tbs, *element};
+}
+
+/// Decode the content of an OBJECT IDENTIFIER to the dotted form
+std::optional<std::string> decode_oid(const std::span<const unsigned char> content) {
+    if (content.empty()) {
+        return std::nullopt;
+    }
+    std::string oid;
+    std::uint64_t arc = 0;
+    std::size_t arc_bytes = 0;
+    for (const unsigned char byte : content) {
+        if ((arc_bytes == 0 && byte == 0x80) || arc > (std::numeric_limits<std::uint64_t>::max() >> 7)) {
+            // not the minimal encoding, or an arc too large
+            return std::nullopt;
+        }
+        arc = (arc << 7) | (byte & 0x7f);
+        ++arc_bytes;
+        if (byte & 0x80) {
+            continue;
+        }
+        if (oid.empty()) {
+            // The first subidentifier encodes the first two arcs
+            const std::uint64_t first = arc < 80 ? arc / 40 : 2;
+            oid = std::to_string(first) + "." + std::to_string(arc - first * 40);
+        } else {
+            oid += "." + std::to_string(arc);
+        }
+        arc = 0;
+        arc_bytes = 0;
+    }
+    if (arc_bytes != 0) {
+        return std::nullopt;
+    }
+    return oid;
+}
+
+/// The body of the first PEM block when it is a plain certificate
+std::optional<std::string_view> find_pem_certificate(const std::string_view pem) {
+    // Like PEM_read_X509(), use the first PEM block; anything else than a plain certificate
+    // (e.g. a key or encapsulated headers) is left to OpenSSL
+    const auto begin = pem.find(PEM_BEGIN_LABEL);
+    if (begin == std::string_view::npos || !pem.substr(begin).starts_with(PEM_BEGIN_CERTIFICATE)) {
+        return std::nullopt;
+    }
+    auto body = pem.substr(begin + PEM_BEGIN_CERTIFICATE.size());
+    if (const auto end = body.find(PEM_END); end != std::string_view::npos) {
+        body = body.substr(0, end);
+    }
+    return body;
+}
+
+}  // namespace
+
+std::optional<CertValidity> read_der_validity(const std::span<const unsigned char> der) {
+    const auto fields = find_validity(der);
+    if (!fields) {
+        return std::nullopt;
+    }
+
+    // Validity ::= SEQUENCE { notBefore Time, notAfter Time }
+    const auto *validity = &fields->validity;
+    const auto not_before_element = read_header(der, validity->begin, validity->end);
+    if (!not_before_element) {
+        return std::nullopt;
+    }
+    const auto not_after_element = read_header(der, not_before_element->end, validity->end);
+    if (!not_after_element || not_after_element->end != validity->end) {
+        return std::nullopt;
+    }
+
+    const auto not_before = parse_time(der, *not_before_element);
+    const auto not_after = parse_time(der, *not_after_element);
+    if (!not_before || !not_after) {
+        return std::nullopt;
+    }
+    return CertValidity{*not_before, *not_after};
+}
+
+std::optional<CertValidity> read_pem_validity(const std::string_view pem) {
+    const auto body = find_pem_certificate(pem);
+    if (!body) {
+        return std::nullopt;
+    }
+    const auto der = base64_decode(*body, MAX_DER_VALIDITY_PREFIX);
+    if (!der) {
+        return std::nullopt;
+    }
+    return read_der_validity(*der);
+}
+
+std::optional<CertValidity> read_cert_validity(const std::string_view data) {
+    if (!data.empty() && static_cast<unsigned char>(data.front()) == TAG_SEQUENCE) {
+        return read_der_validity(std::span(reinterpret_cast<const unsigned char *>(data.data()), data.size()));
+    }
+    return read_pem_validity(data);
+}
+
+std::optional<std::vector<CertExtension>> read_der_extensions(const std::span<const unsigned char> der) {
+    const auto fields = find_validity(der);
+    if (!fields || fields->tbs.end > der.size()) {
+        return std::nullopt;
+    }
+    const auto &tbs = fields->tbs;
+
+    // TBSCertificate ::= SEQUENCE { ..., validity, subject, subjectPublicKeyInfo,
+    //     [1] issuerUniqueID OPTIONAL, [2] subjectUniqueID OPTIONAL, [3] extensions OPTIONAL }
+    std::size_t pos = fields->validity.end;
+    for (int i = 0; i < 2; ++i) {
+        const auto element = read_header(der, pos, tbs.end);
+        if (!element || element->tag != TAG_SEQUENCE) {
+            return std::nullopt;
+        }
+        pos = element->end;
+    }
+
+    std::vector<CertExtension> extensions;
+    while (pos < tbs.end) {
+        const auto element = read_header(der, pos, tbs.end);
+        if (!element) {
+            return std::nullopt;
+        }
+        pos = element->end;
+        if (element->tag == TAG_ISSUER_UNIQUE_ID || element->tag == TAG_SUBJECT_UNIQUE_ID) {
+            continue;
+        }
+        if (element->tag != TAG_EXTENSIONS) {
+            return std::nullopt;
+        }
+
+        // Extensions ::= SEQUENCE OF Extension
+        // Extension ::= SEQUENCE { extnID OBJECT IDENTIFIER, critical BOOLEAN DEFAULT FALSE, extnValue OCTET STRING }
+        const auto list = read_header(der, element->begin, element->end);
+        if (!list || list->tag != TAG_SEQUENCE || list->end != element->end) {
+            return std::nullopt;
+        }
+        for (std::size_t extension_pos = list->begin; extension_pos < list->end;) {
+            const auto extension = read_header(der, extension_pos, list->end);
+            if (!extension || extension->tag != TAG_SEQUENCE) {
+                return std::nullopt;
+            }
+            extension_pos = extension->end;
+
+            const auto id = read_header(der, extension->begin, extension->end);
+            if (!id || id->tag != TAG_OID) {
+                return std::nullopt;
+            }
+            auto value = read_header(der, id->end, extension->end);
+            if (value && value->tag == TAG_BOOLEAN) {
+                value = read_header(der, value->end, extension->end);
+            }
+            if (!value || value->tag != TAG_OCTET_STRING || value->end != extension->end) {
+                return std::nullopt;
+            }
+            auto oid = decode_oid(der.subspan(id->begin, id->end - id->begin));
+            if (!oid) {
+                return std::nullopt;
+            }
+            extensions.push_back(CertExtension{
+                std::move(*oid), std::vector<unsigned char>(der.begin() + static_cast<std::ptrdiff_t>(value->begin),
+                                                            der.begin() + static_cast<std::ptrdiff_t>(value->end))});
+        }
+    }
+    return extensions;
+}
+
+std::optional<std::vector<CertExtension>> read_pem_extensions(const std::string_view pem) {
+    const auto body = find_pem_certificate(pem);
+    if (!body) {
+        return std::nullopt;
+    }
+    const auto der = base64_decode(*body);
+    if (!der) {
+        return std::nullopt;
+    }
+    return read_der_extensions(*der);
+}
+
+std::optional<std::string> read_der_string(const std::span<const unsigned char> der) {
+    const auto element = read_header(der, 0, der.size());
+    if (!element || element->end != der.size()) {
+        return std::nullopt;
+    }
+    if (element->tag != TAG_UTF8_STRING && element->tag != TAG_PRINTABLE_STRING && element->tag != TAG_IA5_STRING) {
+        return std::nullopt;
+    }
+    return std::string(der.begin() + static_cast<std::ptrdiff_t>(element->begin), der.end());
+}
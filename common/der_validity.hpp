@@ -0,0 +1,67 @@
+#ifndef RHSM_DNF5_PLUGINS_DER_VALIDITY_HPP
+#define RHSM_DNF5_PLUGINS_DER_VALIDITY_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// Maximum number of DER bytes decoded from a PEM certificate by read_cert_validity(). The validity
+/// is stored near the beginning of the certificate, after the serial number, the signature
+/// algorithm and the issuer name.
+constexpr std::size_t MAX_DER_VALIDITY_PREFIX = 4 * 1024;
+
+/// The validity period of a certificate in seconds since the epoch
+struct CertValidity {
+    std::int64_t not_before = 0;
+    std::int64_t not_after = 0;
+
+    bool operator==(const CertValidity &) const = default;
+};
+
+/// Read the validity of an X.509 certificate from its DER encoding without parsing the rest
+/// of the certificate. Only the headers of the certificate and of the TBSCertificate, and the fields
+/// preceding the validity are walked, so the data can be just a prefix of the certificate.
+/// Times must use the DER forms required by RFC 5280 (YYMMDDHHMMSSZ or YYYYMMDDHHMMSSZ).
+/// Returns std::nullopt on any unexpected or truncated encoding; callers then fall back
+/// to a full parser (OpenSSL).
+std::optional<CertValidity> read_der_validity(std::span<const unsigned char> der);
+
+/// Read the validity of the first certificate in PEM data. The first PEM block must be
+/// a "CERTIFICATE" without headers; at most MAX_DER_VALIDITY_PREFIX bytes of it are decoded.
+/// Returns std::nullopt when the validity cannot be read by read_der_validity().
+std::optional<CertValidity> read_pem_validity(std::string_view pem);
+
+/// Read the validity of a certificate in PEM or DER format, see read_pem_validity()
+/// and read_der_validity()
+std::optional<CertValidity> read_cert_validity(std::string_view data);
+
+/// One extension of an X.509 certificate
+struct CertExtension {
+    /// The extension ID in the dotted form, e.g. "1.3.6.1.4.1.2312.9.6"
+    std::string oid;
+
+    /// The content of extnValue, i.e. the DER encoding of the extension value
+    std::vector<unsigned char> value;
+
+    bool operator==(const CertExtension &) const = default;
+};
+
+/// Read the extensions of an X.509 certificate from its DER encoding, in the order they are stored.
+/// Unlike read_der_validity(), the whole TBSCertificate must be available. The extension values are
+/// not decoded. Returns std::nullopt on any unexpected or truncated encoding.
+std::optional<std::vector<CertExtension>> read_der_extensions(std::span<const unsigned char> der);
+
+/// Read the extensions of the first certificate in PEM data, see read_pem_validity()
+/// and read_der_extensions()
+std::optional<std::vector<CertExtension>> read_pem_extensions(std::string_view pem);
+
+/// Read an extension value that is a DER string (UTF8String, PrintableString or IA5String),
+/// as used by the Red Hat extensions of entitlement and product certificates. Returns std::nullopt
+/// for other values.
+std::optional<std::string> read_der_string(std::span<const unsigned char> der);
+
+#endif // RHSM_DNF5_PLUGINS_DER_VALIDITY_HPP
@@ -0,0 +1,12 @@
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include "der_validity.hpp"
+
+/// libFuzzer entry point for the certificate validity reader. The seed corpus is in
+/// fuzz/corpus/der_validity; test_der_validity checks the corpus against OpenSSL.
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t *data, std::size_t size) {
+    static_cast<void>(read_cert_validity(std::string_view(reinterpret_cast<const char *>(data), size)));
+    return 0;
+}
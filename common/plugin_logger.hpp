@@ -0,0 +1,148 @@
+#ifndef RHSM_DNF5_PLUGINS_PLUGIN_LOGGER_HPP
+#define RHSM_DNF5_PLUGINS_PLUGIN_LOGGER_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <concepts>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <libdnf5/logger/logger.hpp>
+
+/// A string literal used as a template argument, e.g. the prefix of PluginLogger
+template <std::size_t N>
+struct LogPrefix {
+    consteval LogPrefix(const char (&text)[N]) { std::copy_n(text, N, value); }
+
+    [[nodiscard]] constexpr std::string_view view() const { return {value, N - 1}; }
+
+    char value[N]{};
+};
+
+/// The level of a plugin logger for the value of its "log_level" option: critical, error, warning,
+/// notice, info, debug or trace. Returns std::nullopt for any other value.
+constexpr std::optional<libdnf5::Logger::Level> log_level_from_string(const std::string_view value) {
+    using Level = libdnf5::Logger::Level;
+    constexpr std::pair<std::string_view, Level> LEVELS[]{
+        {"critical", Level::CRITICAL},
+        {"error", Level::ERROR},
+        {"warning", Level::WARNING},
+        {"notice", Level::NOTICE},
+        {"info", Level::INFO},
+        {"debug", Level::DEBUG},
+        {"trace", Level::TRACE},
+    };
+    for (const auto & [name, level] : LEVELS) {
+        if (name == value) {
+            return level;
+        }
+    }
+    return std::nullopt;
+}
+
+/// The level of a plugin logger without the "log_level" option, taken from the dnf "logfilelevel"
+/// (0 - 10) the way dnf 4 did: 0 logs only critical messages, 1 and 2 informational messages, 3 and
+/// more (the default is 9) debug messages
+constexpr libdnf5::Logger::Level log_level_of_logfilelevel(const std::int32_t logfilelevel) {
+    if (logfilelevel <= 0) {
+        return libdnf5::Logger::Level::CRITICAL;
+    }
+    return logfilelevel <= 2 ? libdnf5::Logger::Level::INFO : libdnf5::Logger::Level::DEBUG;
+}
+
+/// The value formatted for an argument of PluginLogger, computed only when the message is formatted:
+/// a std::filesystem::path is formatted as its string and a callable without arguments as its result
+template <typename T>
+decltype(auto) log_argument_value(T && argument) {
+    if constexpr (std::is_same_v<std::remove_cvref_t<T>, std::filesystem::path>) {
+        return argument.string();
+    } else if constexpr (std::invocable<T &>) {
+        return std::invoke(argument);
+    } else {
+        return std::forward<T>(argument);
+    }
+}
+
+/// The argument type of the format string of PluginLogger for an argument of type T, deduced the
+/// way std::format_to deduces the type of log_argument_value(T)
+template <typename T>
+using LogArgument = std::conditional_t<
+    std::is_lvalue_reference_v<decltype(log_argument_value(std::declval<T>()))>,
+    decltype(log_argument_value(std::declval<T>())),
+    std::remove_reference_t<decltype(log_argument_value(std::declval<T>()))>>;
+
+/// Logging of a plugin to the libdnf5 logger; every message starts with Prefix. The format strings
+/// are checked at compile time, and messages above the level of the logger are neither formatted
+/// nor copied. The plugins take the level from their "log_level" option or from the dnf
+/// "logfilelevel", see log_level_from_string() and log_level_of_logfilelevel(). Paths are converted
+/// to strings only for formatted messages; any other argument that is expensive to compute can be
+/// passed as a callable, e.g. [&] { return describe(repo); }, which is called only when the message
+/// is formatted.
+template <LogPrefix Prefix>
+class PluginLogger {
+public:
+    using Level = libdnf5::Logger::Level;
+
+    explicit PluginLogger(libdnf5::Logger & logger, const Level level = Level::DEBUG)
+        : logger(&logger), level(level) {}
+
+    /// Are messages of the level written?
+    [[nodiscard]] bool is_enabled(const Level message_level) const { return message_level <= level; }
+
+    template <typename... Args>
+    void debug(std::format_string<LogArgument<Args>...> format, Args &&... args) const {
+        log(Level::DEBUG, format, std::forward<Args>(args)...);
+    }
+
+    template <typename... Args>
+    void info(std::format_string<LogArgument<Args>...> format, Args &&... args) const {
+        log(Level::INFO, format, std::forward<Args>(args)...);
+    }
+
+    template <typename... Args>
+    void warning(std::format_string<LogArgument<Args>...> format, Args &&... args) const {
+        log(Level::WARNING, format, std::forward<Args>(args)...);
+    }
+
+    template <typename... Args>
+    void error(std::format_string<LogArgument<Args>...> format, Args &&... args) const {
+        log(Level::ERROR, format, std::forward<Args>(args)...);
+    }
+
+    template <typename... Args>
+    void log(const Level message_level, std::format_string<LogArgument<Args>...> format, Args &&... args) const {
+        if (!is_enabled(message_level)) {
+            return;
+        }
+        std::string message(Prefix.view());
+        std::format_to(std::back_inserter(message), format, log_argument_value(std::forward<Args>(args))...);
+        logger->log_line(message_level, message);
+    }
+
+    /// Log the message and print it for the user on the standard output, formatted once.
+    /// The message is printed regardless of the level.
+    // FIXME: replace the standard output with appropriate DNF API call when available
+    template <typename... Args>
+    void notify(const Level message_level, std::format_string<LogArgument<Args>...> format, Args &&... args) const {
+        std::string message(Prefix.view());
+        std::format_to(std::back_inserter(message), format, log_argument_value(std::forward<Args>(args))...);
+        if (is_enabled(message_level)) {
+            logger->log_line(message_level, message);
+        }
+        std::cout << std::string_view(message).substr(Prefix.view().size()) << std::endl;
+    }
+
+private:
+    libdnf5::Logger * logger;
+    Level level;
+};
+
+#endif // RHSM_DNF5_PLUGINS_PLUGIN_LOGGER_HPP
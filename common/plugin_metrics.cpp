@@ -0,0 +1,270 @@
+#include "plugin_metrics.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <ctime>
+#include <format>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <unistd.h>
+
+namespace {
+
+constexpr std::string_view HOOK_DURATION_METRIC = "rhsm_dnf5_hook_duration_seconds";
+constexpr std::string_view LAST_RUN_METRIC = "rhsm_dnf5_last_run_timestamp_seconds";
+
+std::string escape_label_value(const std::string_view value) {
+    std::string escaped;
+    for (const char ch : value) {
+        if (ch == '\\' || ch == '"') {
+            escaped += '\\';
+            escaped += ch;
+        } else if (ch == '\n') {
+            escaped += "\\n";
+        } else {
+            escaped += ch;
+        }
+    }
+    return escaped;
+}
+
+std::string sample_key(const std::string_view name, const PluginMetrics::Labels &labels) {
+    std::string key(name);
+    if (!labels.empty()) {
+        key += '{';
+        for (std::size_t i = 0; i < labels.size(); ++i) {
+            key += std::format("{}{}=\"{}\"", i == 0 ? "" : ",", labels[i].first, escape_label_value(labels[i].second));
+        }
+        key += '}';
+    }
+    return key;
+}
+
+std::string format_value(const double value) {
+    return std::format("{}", value);
+}
+
+std::string_view trim(std::string_view text) {
+    while (!text.empty() && (text.front() == ' ' || text.front() == '\t')) {
+        text.remove_prefix(1);
+    }
+    while (!text.empty() && (text.back() == ' ' || text.back() == '\t' || text.back() == '\r')) {
+        text.remove_suffix(1);
+    }
+    return text;
+}
+
+/// Add the value to the sample, or append the sample
+void add_sample(std::vector<std::pair<std::string, double>> &samples, std::string key, const double value) {
+    const auto sample = std::find_if(samples.begin(), samples.end(), [&key](const auto &item) {
+        return item.first == key;
+    });
+    if (sample != samples.end()) {
+        sample->second += value;
+    } else {
+        samples.emplace_back(std::move(key), value);
+    }
+}
+
+}  // namespace
+
+PluginMetrics::PluginMetrics(std::string plugin_name, std::filesystem::path path)
+    : plugin_name(std::move(plugin_name)), path(std::move(path)) {}
+
+PluginMetrics::Family &PluginMetrics::get_family(
+    const std::string_view name, const std::string_view help, const std::string_view type) {
+    const auto family = std::find_if(families.begin(), families.end(), [name](const Family &item) {
+        return item.name == name;
+    });
+    if (family != families.end()) {
+        return *family;
+    }
+    return families.emplace_back(Family{std::string(name), std::string(help), std::string(type), {}});
+}
+
+void PluginMetrics::add_counter(
+    const std::string_view name, const std::string_view help, const double value, const Labels &labels) {
+    if (!is_enabled()) {
+        return;
+    }
+    add_sample(get_family(name, help, "counter").samples, sample_key(name, labels), value);
+}
+
+void PluginMetrics::set_gauge(
+    const std::string_view name, const std::string_view help, const double value, const Labels &labels) {
+    if (!is_enabled()) {
+        return;
+    }
+    auto &samples = get_family(name, help, "gauge").samples;
+    auto key = sample_key(name, labels);
+    const auto sample = std::find_if(samples.begin(), samples.end(), [&key](const auto &item) {
+        return item.first == key;
+    });
+    if (sample != samples.end()) {
+        sample->second = value;
+    } else {
+        samples.emplace_back(std::move(key), value);
+    }
+}
+
+void PluginMetrics::observe_hook_duration(const std::string_view hook, const std::chrono::duration<double> duration) {
+    if (!is_enabled()) {
+        return;
+    }
+    auto &family = get_family(HOOK_DURATION_METRIC, "Duration of the hooks of the dnf plugins", "histogram");
+    const Labels labels{{"plugin", plugin_name}, {"hook", std::string(hook)}};
+    const auto seconds = duration.count();
+    for (const auto bound : HOOK_DURATION_BUCKETS) {
+        auto bucket_labels = labels;
+        bucket_labels.emplace_back("le", format_value(bound));
+        add_sample(family.samples, sample_key(std::string(HOOK_DURATION_METRIC) + "_bucket", bucket_labels),
+                   seconds <= bound ? 1 : 0);
+    }
+    auto infinity_labels = labels;
+    infinity_labels.emplace_back("le", "+Inf");
+    add_sample(family.samples, sample_key(std::string(HOOK_DURATION_METRIC) + "_bucket", infinity_labels), 1);
+    add_sample(family.samples, sample_key(std::string(HOOK_DURATION_METRIC) + "_sum", labels), seconds);
+    add_sample(family.samples, sample_key(std::string(HOOK_DURATION_METRIC) + "_count", labels), 1);
+}
+
+std::vector<PluginMetrics::Family> PluginMetrics::parse(const std::string_view content) {
+    std::vector<Family> parsed;
+    std::istringstream lines{std::string(content)};
+    for (std::string line; std::getline(lines, line);) {
+        const auto text = trim(line);
+        if (text.empty()) {
+            continue;
+        }
+        if (text.starts_with("# HELP ") || text.starts_with("# TYPE ")) {
+            const auto rest = text.substr(7);
+            const auto space = rest.find(' ');
+            const auto name = rest.substr(0, space);
+            const auto value = space == std::string_view::npos ? std::string_view() : trim(rest.substr(space + 1));
+            if (parsed.empty() || parsed.back().name != name) {
+                parsed.push_back(Family{std::string(name), {}, "untyped", {}});
+            }
+            (text[2] == 'H' ? parsed.back().help : parsed.back().type) = std::string(value);
+            continue;
+        }
+        if (text.starts_with('#') || parsed.empty()) {
+            continue;
+        }
+        // The samples belong to the family of the preceding TYPE line: name{labels} value
+        const auto space = text.rfind(' ');
+        if (space == std::string_view::npos) {
+            continue;
+        }
+        const auto value_text = text.substr(space + 1);
+        double value = 0;
+        if (value_text == "+Inf" || value_text == "-Inf" || value_text == "NaN") {
+            continue;
+        }
+        const auto result = std::from_chars(value_text.data(), value_text.data() + value_text.size(), value);
+        if (result.ec != std::errc() || result.ptr != value_text.data() + value_text.size()) {
+            continue;
+        }
+        parsed.back().samples.emplace_back(std::string(trim(text.substr(0, space))), value);
+    }
+    return parsed;
+}
+
+std::string PluginMetrics::render(const std::string_view previous) const {
+    auto merged = parse(previous);
+    for (const auto &family : families) {
+        auto existing = std::find_if(merged.begin(), merged.end(), [&family](const Family &item) {
+            return item.name == family.name;
+        });
+        if (existing == merged.end() || existing->type != family.type) {
+            // New family, or the type changed: the previous values cannot be continued
+            if (existing != merged.end()) {
+                merged.erase(existing);
+            }
+            merged.push_back(family);
+            continue;
+        }
+        existing->help = family.help;
+        for (const auto &[key, value] : family.samples) {
+            if (family.type == "gauge") {
+                const auto sample = std::find_if(existing->samples.begin(), existing->samples.end(), [&key](const auto &item) {
+                    return item.first == key;
+                });
+                if (sample != existing->samples.end()) {
+                    sample->second = value;
+                    continue;
+                }
+                existing->samples.emplace_back(key, value);
+            } else {
+                add_sample(existing->samples, key, value);
+            }
+        }
+    }
+
+    std::string output;
+    for (const auto &family : merged) {
+        if (family.samples.empty()) {
+            continue;
+        }
+        output += std::format("# HELP {} {}\n# TYPE {} {}\n", family.name, family.help, family.name, family.type);
+        for (const auto &[key, value] : family.samples) {
+            output += std::format("{} {}\n", key, format_value(value));
+        }
+    }
+    return output;
+}
+
+void PluginMetrics::write() {
+    if (!is_enabled()) {
+        return;
+    }
+    set_gauge(
+        LAST_RUN_METRIC,
+        "Time of the last dnf run of the plugin, in seconds since the epoch",
+        static_cast<double>(std::time(nullptr)),
+        {{"plugin", plugin_name}});
+
+    std::string previous;
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (file.is_open()) {
+            std::ostringstream content;
+            content << file.rdbuf();
+            previous = std::move(content).str();
+        }
+    }
+
+    // The collector reads only *.prom files, so it never sees the temporary file
+    const auto temp_path = path.parent_path() / std::format(".{}.{}.tmp", path.filename().string(), getpid());
+    std::error_code ec;
+    std::filesystem::create_directories(path.parent_path(), ec);
+    {
+        std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            throw std::runtime_error("could not open file: " + temp_path.string());
+        }
+        file << render(previous);
+        file.close();
+        if (file.fail()) {
+            std::filesystem::remove(temp_path, ec);
+            throw std::runtime_error("write error on " + temp_path.string());
+        }
+    }
+    std::filesystem::permissions(temp_path, std::filesystem::perms(0644), ec);
+    std::filesystem::rename(temp_path, path, ec);
+    if (ec) {
+        std::error_code remove_ec;
+        std::filesystem::remove(temp_path, remove_ec);
+        throw std::runtime_error(std::format("could not rename file {} to {}: {}", temp_path.string(), path.string(), ec.message()));
+    }
+}
+
+HookTimer::HookTimer(PluginMetrics &metrics, const std::string_view hook)
+    : metrics(metrics), hook(metrics.is_enabled() ? hook : std::string_view()), start(std::chrono::steady_clock::now()) {}
+
+HookTimer::~HookTimer() {
+    try {
+        metrics.observe_hook_duration(hook, std::chrono::steady_clock::now() - start);
+    } catch (...) {
+        // A metric that cannot be recorded must not break the hook
+    }
+}
@@ -0,0 +1,86 @@
+#ifndef RHSM_DNF5_PLUGINS_PLUGIN_METRICS_HPP
+#define RHSM_DNF5_PLUGINS_PLUGIN_METRICS_HPP
+
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/// Upper bounds (in seconds) of the buckets of the hook duration histogram
+constexpr double HOOK_DURATION_BUCKETS[]{0.001, 0.005, 0.01, 0.05, 0.1, 0.5, 1, 5};
+
+/// Metrics of one plugin, written once per dnf run to a file read by the textfile collector of the Prometheus
+/// node_exporter. Each plugin owns its file. Counters and histograms are cumulative across dnf runs: the
+/// previous values are read from the file and this run is added to them, so that rates can be computed.
+/// Gauges describe the last run that set them. Samples that were not updated by this run are kept.
+/// The file is replaced atomically, so the collector never reads a partial file.
+class PluginMetrics {
+public:
+    using Labels = std::vector<std::pair<std::string, std::string>>;
+
+    /// Disabled metrics; nothing is collected or written
+    PluginMetrics() = default;
+
+    /// Collect metrics of the plugin, to be written to path; an empty path disables the metrics
+    PluginMetrics(std::string plugin_name, std::filesystem::path path);
+
+    [[nodiscard]] bool is_enabled() const { return !path.empty(); }
+
+    [[nodiscard]] const std::filesystem::path & get_path() const { return path; }
+
+    /// Increase a counter; the name should end with "_total"
+    void add_counter(std::string_view name, std::string_view help, double value, const Labels & labels = {});
+
+    /// Set a gauge
+    void set_gauge(std::string_view name, std::string_view help, double value, const Labels & labels = {});
+
+    /// Observe the duration of a hook of the plugin in the rhsm_dnf5_hook_duration_seconds histogram
+    void observe_hook_duration(std::string_view hook, std::chrono::duration<double> duration);
+
+    /// The content of the file: the metrics of this run merged with the previous content of the file
+    [[nodiscard]] std::string render(std::string_view previous) const;
+
+    /// Merge the metrics with the file, set the rhsm_dnf5_last_run_timestamp_seconds gauge, and replace the file.
+    /// Throws std::runtime_error when the file cannot be written.
+    void write();
+
+private:
+    struct Family {
+        std::string name;
+        std::string help;
+
+        /// "counter", "gauge" or "histogram"
+        std::string type;
+
+        /// Values indexed by the sample name with labels, e.g. rhsm_dnf5_hook_duration_seconds_count{hook="..."},
+        /// in the order of the exposition
+        std::vector<std::pair<std::string, double>> samples;
+    };
+
+    static std::vector<Family> parse(std::string_view content);
+
+    Family & get_family(std::string_view name, std::string_view help, std::string_view type);
+
+    std::string plugin_name;
+    std::filesystem::path path;
+    std::vector<Family> families;
+};
+
+/// Measure the duration of a hook from the construction to the destruction of the timer
+class HookTimer {
+public:
+    HookTimer(PluginMetrics & metrics, std::string_view hook);
+    ~HookTimer();
+
+    HookTimer(const HookTimer &) = delete;
+    HookTimer & operator=(const HookTimer &) = delete;
+
+private:
+    PluginMetrics & metrics;
+    std::string hook;
+    std::chrono::steady_clock::time_point start;
+};
+
+#endif // RHSM_DNF5_PLUGINS_PLUGIN_METRICS_HPP
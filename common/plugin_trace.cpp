@@ -0,0 +1,144 @@
+#include "plugin_trace.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <format>
+#include <fstream>
+#include <stdexcept>
+#include <tuple>
+#include <unistd.h>
+#include <json/json.h>
+
+Tracer::Tracer(std::filesystem::path path) : path(std::move(path)) {}
+
+std::filesystem::path Tracer::get_plugin_trace_path(
+    const std::string_view plugin_name, const std::string_view trace_dir_option) {
+    std::string_view dir = trace_dir_option;
+    if (const char *env = std::getenv(TRACE_DIR_ENV); env != nullptr && *env != '\0') {
+        dir = env;
+    }
+    if (dir.empty()) {
+        return {};
+    }
+    return std::filesystem::path(dir) / std::format("{}-{}.json", plugin_name, getpid());
+}
+
+void Tracer::record(
+    std::string name,
+    std::string category,
+    const std::chrono::microseconds start,
+    const std::chrono::microseconds duration,
+    std::vector<std::pair<std::string, std::string>> args) const {
+    if (!is_enabled()) {
+        return;
+    }
+    const std::lock_guard lock(mutex);
+    events.push_back(
+        {std::move(name), std::move(category), start.count(), duration.count(), static_cast<std::int64_t>(gettid()),
+         std::move(args)});
+}
+
+std::size_t Tracer::size() const {
+    const std::lock_guard lock(mutex);
+    return events.size();
+}
+
+std::string Tracer::to_json(const std::string_view process_name) const {
+    std::vector<const Event *> sorted;
+    const std::lock_guard lock(mutex);
+    sorted.reserve(events.size());
+    for (const auto &event : events) {
+        sorted.push_back(&event);
+    }
+    // Spans are recorded when they end, so inner spans are recorded first
+    std::sort(sorted.begin(), sorted.end(), [](const Event *a, const Event *b) {
+        return std::tuple(a->start, -a->duration) < std::tuple(b->start, -b->duration);
+    });
+
+    const auto pid = static_cast<Json::Int64>(getpid());
+    Json::Value trace_events(Json::arrayValue);
+    Json::Value process(Json::objectValue);
+    process["name"] = "process_name";
+    process["ph"] = "M";
+    process["pid"] = pid;
+    process["args"]["name"] = std::string(process_name);
+    trace_events.append(std::move(process));
+    for (const auto *event : sorted) {
+        Json::Value item(Json::objectValue);
+        item["name"] = event->name;
+        item["cat"] = event->category;
+        item["ph"] = "X";
+        item["ts"] = static_cast<Json::Int64>(event->start);
+        item["dur"] = static_cast<Json::Int64>(event->duration);
+        item["pid"] = pid;
+        item["tid"] = static_cast<Json::Int64>(event->thread_id);
+        if (!event->args.empty()) {
+            Json::Value args(Json::objectValue);
+            for (const auto &[key, value] : event->args) {
+                args[key] = value;
+            }
+            item["args"] = std::move(args);
+        }
+        trace_events.append(std::move(item));
+    }
+
+    Json::Value root(Json::objectValue);
+    root["traceEvents"] = std::move(trace_events);
+    root["displayTimeUnit"] = "ms";
+    Json::StreamWriterBuilder writer_builder;
+    writer_builder["indentation"] = "";
+    return Json::writeString(writer_builder, root) + "\n";
+}
+
+void Tracer::write(const std::string_view process_name) const {
+    if (!is_enabled()) {
+        return;
+    }
+    std::error_code ec;
+    std::filesystem::create_directories(path.parent_path(), ec);
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        throw std::runtime_error("could not open file: " + path.string());
+    }
+    file << to_json(process_name);
+    file.close();
+    if (file.fail()) {
+        throw std::runtime_error("write error on " + path.string());
+    }
+}
+
+TraceSpan::TraceSpan(const Tracer *tracer, const std::string_view name, const std::string_view category) {
+    if (tracer == nullptr || !tracer->is_enabled()) {
+        return;
+    }
+    this->tracer = tracer;
+    this->name = name;
+    this->category = category;
+    start = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch());
+    steady_start = std::chrono::steady_clock::now();
+}
+
+TraceSpan::~TraceSpan() {
+    end();
+}
+
+void TraceSpan::arg(const std::string_view key, std::string value) {
+    if (tracer != nullptr) {
+        args.emplace_back(key, std::move(value));
+    }
+}
+
+void TraceSpan::end() {
+    if (tracer == nullptr) {
+        return;
+    }
+    const auto duration =
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - steady_start);
+    try {
+        tracer->record(std::move(name), std::move(category), start, duration, std::move(args));
+    } catch (...) {
+        // A span that cannot be recorded must not break the hook
+    }
+    tracer = nullptr;
+}
@@ -0,0 +1,100 @@
+#ifndef RHSM_DNF5_PLUGINS_PLUGIN_TRACE_HPP
+#define RHSM_DNF5_PLUGINS_PLUGIN_TRACE_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/// Environment variable with the directory of the traces; it overrides the trace_dir option of the plugins
+constexpr const char * TRACE_DIR_ENV = "RHSM_DNF5_PLUGINS_TRACE_DIR";
+
+/// Spans of the hooks and of their phases recorded during one dnf run and written in the Chrome trace
+/// event format (JSON object with "traceEvents"), which is opened by Perfetto and chrome://tracing.
+/// Each span is a complete ("X") event with the start and the duration in microseconds; nested spans
+/// of the same thread are shown as children. A disabled tracer records nothing, so spans cost one
+/// branch when tracing is off. Spans may be recorded by several threads.
+class Tracer {
+public:
+    /// A disabled tracer
+    Tracer() = default;
+
+    /// Record spans, to be written to path by write()
+    explicit Tracer(std::filesystem::path path);
+
+    Tracer(const Tracer &) = delete;
+    Tracer & operator=(const Tracer &) = delete;
+
+    /// The tracer of a plugin: enabled when the environment variable TRACE_DIR_ENV or the trace_dir
+    /// option of the plugin (in this order) is not empty. The trace is written to
+    /// <dir>/<plugin name>-<pid>.json, so that plugins and dnf runs do not overwrite each other.
+    [[nodiscard]] static std::filesystem::path get_plugin_trace_path(
+        std::string_view plugin_name, std::string_view trace_dir_option);
+
+    [[nodiscard]] bool is_enabled() const { return !path.empty(); }
+
+    [[nodiscard]] const std::filesystem::path & get_path() const { return path; }
+
+    /// Record a span of the current thread; start is the time since the epoch. Recording does not
+    /// change the observable state of the traced objects, so it is allowed in const methods.
+    void record(
+        std::string name,
+        std::string category,
+        std::chrono::microseconds start,
+        std::chrono::microseconds duration,
+        std::vector<std::pair<std::string, std::string>> args) const;
+
+    /// Number of recorded spans
+    [[nodiscard]] std::size_t size() const;
+
+    /// The trace; events are sorted by their start and outer spans come before inner ones
+    [[nodiscard]] std::string to_json(std::string_view process_name) const;
+
+    /// Write the trace to the path, creating its directory.
+    /// Throws std::runtime_error when the file cannot be written.
+    void write(std::string_view process_name) const;
+
+private:
+    struct Event {
+        std::string name;
+        std::string category;
+        std::int64_t start;
+        std::int64_t duration;
+        std::int64_t thread_id;
+        std::vector<std::pair<std::string, std::string>> args;
+    };
+
+    std::filesystem::path path;
+    mutable std::mutex mutex;
+    mutable std::vector<Event> events;
+};
+
+/// A span recorded by the tracer when it ends (is destroyed). Nothing is done for a null or disabled tracer.
+class TraceSpan {
+public:
+    TraceSpan(const Tracer * tracer, std::string_view name, std::string_view category = "phase");
+    ~TraceSpan();
+
+    TraceSpan(const TraceSpan &) = delete;
+    TraceSpan & operator=(const TraceSpan &) = delete;
+
+    /// Add an argument shown with the span, e.g. the number of processed items
+    void arg(std::string_view key, std::string value);
+
+    /// End the span before it is destroyed
+    void end();
+
+private:
+    const Tracer * tracer = nullptr;
+    std::string name;
+    std::string category;
+    std::chrono::microseconds start{};
+    std::chrono::steady_clock::time_point steady_start;
+    std::vector<std::pair<std::string, std::string>> args;
+};
+
+#endif // RHSM_DNF5_PLUGINS_PLUGIN_TRACE_HPP
@@ -0,0 +1,186 @@
+#ifndef RHSM_DNF5_PLUGINS_SYSCALL_COUNTER_HPP
+#define RHSM_DNF5_PLUGINS_SYSCALL_COUNTER_HPP
+
+#include <csignal>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <optional>
+#include <string>
+#include <sys/ptrace.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/// Test helper counting system calls with ptrace. The function runs in a forked child process
+/// traced by the calling process; only the system calls made between two marker calls around
+/// the function are counted. The counts can be grouped by the kind of the system call, so that
+/// budgets do not depend on the system calls used by a particular version of glibc.
+
+namespace syscall_counter {
+
+/// Invalid file descriptors passed to close() to mark the start and the end of the function
+constexpr long BEGIN_MARKER = -0x5eca11;
+constexpr long END_MARKER = -0x5eca12;
+
+/// Number of calls by system call number (SYS_openat, SYS_getdents64, ...)
+using SyscallCounts = std::map<long, std::size_t>;
+
+inline std::size_t total(const SyscallCounts & counts) {
+    std::size_t sum = 0;
+    for (const auto & [nr, count] : counts) {
+        sum += count;
+    }
+    return sum;
+}
+
+inline std::size_t count_of(const SyscallCounts & counts, const long nr) {
+    const auto it = counts.find(nr);
+    return it == counts.end() ? 0 : it->second;
+}
+
+/// Group of system calls that do the same kind of work: "open", "stat" (including access() and
+/// readlink()), "getdents", "read", "write", "close", "modify" (renaming, removing and creating files
+/// and changing their modes), "memory" (allocation of memory) and "other"
+inline std::string group_of(const long nr) {
+    switch (nr) {
+#ifdef SYS_open
+        case SYS_open:
+#endif
+        case SYS_openat:
+        case SYS_openat2:
+            return "open";
+#ifdef SYS_stat
+        case SYS_stat:
+        case SYS_lstat:
+#endif
+#ifdef SYS_access
+        case SYS_access:
+#endif
+#ifdef SYS_readlink
+        case SYS_readlink:
+#endif
+        case SYS_fstat:
+        case SYS_newfstatat:
+        case SYS_statx:
+        case SYS_faccessat:
+        case SYS_faccessat2:
+        case SYS_readlinkat:
+            return "stat";
+        case SYS_getdents64:
+            return "getdents";
+        case SYS_read:
+        case SYS_pread64:
+            return "read";
+        case SYS_write:
+        case SYS_pwrite64:
+        case SYS_fsync:
+        case SYS_fdatasync:
+            return "write";
+        case SYS_close:
+            return "close";
+#ifdef SYS_rename
+        case SYS_rename:
+        case SYS_unlink:
+        case SYS_mkdir:
+        case SYS_chmod:
+#endif
+        case SYS_renameat:
+        case SYS_renameat2:
+        case SYS_unlinkat:
+        case SYS_mkdirat:
+        case SYS_fchmod:
+        case SYS_fchmodat:
+            return "modify";
+        case SYS_brk:
+        case SYS_mmap:
+        case SYS_munmap:
+        case SYS_mremap:
+        case SYS_madvise:
+            return "memory";
+        default:
+            return "other";
+    }
+}
+
+/// Number of calls by the group of the system calls, see group_of()
+using SyscallGroups = std::map<std::string, std::size_t>;
+
+inline SyscallGroups group_counts(const SyscallCounts & counts) {
+    SyscallGroups groups;
+    for (const auto & [nr, count] : counts) {
+        groups[group_of(nr)] += count;
+    }
+    return groups;
+}
+
+/// Run the function in a traced child process and return the system calls it made.
+/// Returns std::nullopt when the process cannot be traced (e.g. ptrace is denied by a seccomp
+/// policy or by the Yama LSM) or the function failed in the child.
+inline std::optional<SyscallCounts> count_syscalls(const std::function<void()> & function) {
+    const pid_t pid = fork();
+    if (pid < 0) {
+        return std::nullopt;
+    }
+    if (pid == 0) {
+        if (ptrace(PTRACE_TRACEME, 0, nullptr, nullptr) != 0) {
+            _exit(2);
+        }
+        raise(SIGSTOP);
+        syscall(SYS_close, BEGIN_MARKER);
+        try {
+            function();
+        } catch (...) {
+            _exit(1);
+        }
+        syscall(SYS_close, END_MARKER);
+        _exit(0);
+    }
+
+    int status = 0;
+    if (waitpid(pid, &status, 0) != pid || !WIFSTOPPED(status)) {
+        waitpid(pid, &status, 0);
+        return std::nullopt;
+    }
+    ptrace(PTRACE_SETOPTIONS, pid, nullptr, PTRACE_O_TRACESYSGOOD | PTRACE_O_EXITKILL);
+
+    SyscallCounts counts;
+    bool counting = false;
+    while (ptrace(PTRACE_SYSCALL, pid, nullptr, nullptr) == 0 && waitpid(pid, &status, 0) == pid) {
+        if (WIFEXITED(status) || WIFSIGNALED(status)) {
+            break;
+        }
+        if (!WIFSTOPPED(status) || WSTOPSIG(status) != (SIGTRAP | 0x80)) {
+            continue;
+        }
+        struct __ptrace_syscall_info info{};
+        if (ptrace(PTRACE_GET_SYSCALL_INFO, pid, sizeof(info), &info) <= 0 || info.op != PTRACE_SYSCALL_INFO_ENTRY) {
+            continue;
+        }
+        const auto nr = static_cast<long>(info.entry.nr);
+        const auto first_arg = static_cast<long>(info.entry.args[0]);
+        if (nr == SYS_close && first_arg == BEGIN_MARKER) {
+            counting = true;
+        } else if (nr == SYS_close && first_arg == END_MARKER) {
+            counting = false;
+        } else if (counting) {
+            ++counts[nr];
+        }
+    }
+
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        return std::nullopt;
+    }
+    return counts;
+}
+
+/// Can the system calls be counted? Tracing is denied e.g. by a seccomp policy of a container or by the
+/// Yama LSM; tests then skip the counting.
+inline bool is_available() {
+    static const bool available = count_syscalls([]() {}).has_value();
+    return available;
+}
+
+}  // namespace syscall_counter
+
+#endif // RHSM_DNF5_PLUGINS_SYSCALL_COUNTER_HPP
@@ -0,0 +1,336 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory_resource>
+#include <new>
+#include <sstream>
+#include <string>
+#include <json/json.h>
+#include <openssl/crypto.h>
+
+// rhsm_utils.hpp comes first, because productdb.hpp defines PRODUCT_CERT_DIR as a macro
+#include "rhsm_utils.hpp"
+#include "cert_cache.hpp"
+#include "filesystem.hpp"
+#include "productdb.hpp"
+#include "utils.hpp"
+
+/// Heap allocations of the hot paths of both plugins checked against the budgets in
+/// allocation_budgets.json. Every operation runs over a small, medium and large fixture
+/// (10, 100 and 1000 products, certificates or directory entries). The number of allocations and
+/// the peak of the bytes allocated by the operation and not freed yet must not exceed the budget.
+///
+/// The global operator new is replaced to count allocations, like in bench_productdb_arena, and
+/// libcrypto is given the same allocation functions by CRYPTO_set_mem_functions(). The measured values are
+/// recorded as test properties (see --gtest_output=json), so that the budgets can be updated
+/// when an intended change exceeds them; keep some headroom for other versions of the libraries.
+
+namespace fs = std::filesystem;
+
+namespace {
+
+std::atomic<bool> counting{false};
+std::atomic<std::size_t> allocations{0};
+std::atomic<std::size_t> live_bytes{0};
+std::atomic<std::size_t> peak_bytes{0};
+
+/// Stored in front of every allocation; counted_bytes is zero for allocations done while not counting
+struct AllocationHeader {
+    std::size_t offset;
+    std::size_t size;
+    std::size_t counted_bytes;
+};
+
+void *counted_allocate(const std::size_t size, std::size_t alignment) {
+    alignment = std::max(alignment, alignof(std::max_align_t));
+    const auto offset = (sizeof(AllocationHeader) + alignment - 1) / alignment * alignment;
+    void *raw = alignment <= alignof(std::max_align_t)
+        ? std::malloc(offset + size)
+        : std::aligned_alloc(alignment, (offset + size + alignment - 1) / alignment * alignment);
+    if (raw == nullptr) {
+        throw std::bad_alloc();
+    }
+    auto *ptr = static_cast<std::byte *>(raw) + offset;
+    auto *header = reinterpret_cast<AllocationHeader *>(ptr) - 1;
+    header->offset = offset;
+    header->size = size;
+    header->counted_bytes = 0;
+    if (counting.load(std::memory_order_relaxed)) {
+        header->counted_bytes = size;
+        ++allocations;
+        const auto live = live_bytes += size;
+        auto peak = peak_bytes.load(std::memory_order_relaxed);
+        while (live > peak && !peak_bytes.compare_exchange_weak(peak, live)) {
+        }
+    }
+    return ptr;
+}
+
+void counted_free(void *ptr) noexcept {
+    if (ptr == nullptr) {
+        return;
+    }
+    const auto *header = static_cast<AllocationHeader *>(ptr) - 1;
+    live_bytes -= header->counted_bytes;
+    std::free(static_cast<std::byte *>(ptr) - header->offset);
+}
+
+// Allocation functions of libcrypto; they must not throw
+void *crypto_malloc(const std::size_t size, [[maybe_unused]] const char *file, [[maybe_unused]] const int line) {
+    try {
+        return counted_allocate(size, alignof(std::max_align_t));
+    } catch (const std::bad_alloc &) {
+        return nullptr;
+    }
+}
+
+void crypto_free(void *ptr, [[maybe_unused]] const char *file, [[maybe_unused]] const int line) {
+    counted_free(ptr);
+}
+
+void *crypto_realloc(void *ptr, const std::size_t size, const char *file, const int line) {
+    void *new_ptr = crypto_malloc(size, file, line);
+    if (new_ptr != nullptr && ptr != nullptr) {
+        std::memcpy(new_ptr, ptr, std::min(size, (static_cast<AllocationHeader *>(ptr) - 1)->size));
+        counted_free(ptr);
+    }
+    return new_ptr;
+}
+
+/// Make libcrypto use the counted allocation functions. It has to be done before libcrypto
+/// allocates anything, so first in main().
+bool count_crypto_allocations() {
+    return CRYPTO_set_mem_functions(crypto_malloc, crypto_realloc, crypto_free) == 1;
+}
+
+struct AllocationStats {
+    std::size_t allocations = 0;
+    std::size_t peak_bytes = 0;
+};
+
+/// Count the allocations of the function
+template <typename Function>
+AllocationStats measure(Function &&function) {
+    allocations = 0;
+    live_bytes = 0;
+    peak_bytes = 0;
+    counting = true;
+    function();
+    counting = false;
+    return {allocations.load(), peak_bytes.load()};
+}
+
+constexpr std::pair<const char *, int> FIXTURES[]{{"small", 10}, {"medium", 100}, {"large", 1000}};
+
+const Json::Value &budgets() {
+    static const Json::Value root = []() {
+        Json::Value value;
+        std::ifstream file(ALLOCATION_BUDGETS_FILE);
+        Json::CharReaderBuilder reader_builder;
+        Json::String errors;
+        if (!Json::parseFromStream(reader_builder, file, &value, &errors)) {
+            ADD_FAILURE() << "could not read allocation budgets: " << errors;
+        }
+        return value;
+    }();
+    return root;
+}
+
+std::string read_file(const fs::path &path) {
+    std::ifstream file(path);
+    std::stringstream content;
+    content << file.rdbuf();
+    return content.str();
+}
+
+/// A productdb with the given number of products, each assigned to three repositories
+std::string generate_productdb(const int count) {
+    Json::Value root(Json::objectValue);
+    for (int i = 0; i < count; ++i) {
+        const auto product_id = std::to_string(100000 + i);
+        auto &repos = root[product_id] = Json::Value(Json::arrayValue);
+        repos.append("rhel-10-for-x86_64-baseos-rpms-" + product_id);
+        repos.append("rhel-10-for-x86_64-appstream-rpms-" + product_id);
+        repos.append("rhel-10-for-x86_64-supplementary-rpms-" + product_id);
+    }
+    return Json::writeString(Json::StreamWriterBuilder(), root);
+}
+
+}  // namespace
+
+// std::pmr::new_delete_resource() uses the aligned forms of the operators
+void *operator new(const std::size_t size) {
+    return counted_allocate(size, alignof(std::max_align_t));
+}
+
+void *operator new(const std::size_t size, const std::align_val_t alignment) {
+    return counted_allocate(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void *ptr) noexcept {
+    counted_free(ptr);
+}
+
+void operator delete(void *ptr, [[maybe_unused]] const std::size_t size) noexcept {
+    counted_free(ptr);
+}
+
+void operator delete(void *ptr, [[maybe_unused]] const std::align_val_t alignment) noexcept {
+    counted_free(ptr);
+}
+
+void operator delete(void *ptr, [[maybe_unused]] const std::size_t size,
+                     [[maybe_unused]] const std::align_val_t alignment) noexcept {
+    counted_free(ptr);
+}
+
+
+class AllocationBudgetTest : public ::testing::Test {
+protected:
+    fs::path temp_dir;
+    ProductIdPaths paths;
+
+    void SetUp() override {
+        temp_dir = fs::temp_directory_path() / "allocation_budget_test";
+        fs::remove_all(temp_dir);
+        fs::create_directories(temp_dir / "product");
+        fs::create_directories(temp_dir / "product-default");
+        paths.productdb_file = (temp_dir / "productid.json").string();
+        paths.product_cert_dir = (temp_dir / "product/").string();
+        paths.default_product_cert_dir = (temp_dir / "product-default/").string();
+    }
+
+    void TearDown() override {
+        fs::remove_all(temp_dir);
+    }
+
+    /// Compare the measured values with the budget of the operation and the fixture
+    void check_budget(const std::string &operation, const std::string &fixture, const AllocationStats &stats) {
+        RecordProperty(operation + "." + fixture + ".allocations", std::to_string(stats.allocations));
+        RecordProperty(operation + "." + fixture + ".peak_bytes", std::to_string(stats.peak_bytes));
+        const auto &budget = budgets()[operation][fixture];
+        ASSERT_TRUE(budget.isObject()) << "no budget of " << operation << " (" << fixture << ")";
+        EXPECT_LE(stats.allocations, budget["allocations"].asUInt64())
+            << operation << " (" << fixture << ") exceeds the budget of allocations";
+        EXPECT_LE(stats.peak_bytes, budget["peak_bytes"].asUInt64())
+            << operation << " (" << fixture << ") exceeds the budget of peak heap";
+    }
+
+    /// Write the productdb with count products and install their certificates; only products
+    /// with a certificate are written back
+    void write_productdb(const int count) const {
+        std::ofstream(paths.productdb_file) << generate_productdb(count);
+        write_certificates(paths.product_cert_dir, fs::path(TEST_DATA_DIR) / "product-479.pem", count);
+    }
+
+    /// Write count copies of the certificate to dir, named <first product ID + i>.pem
+    static void write_certificates(const fs::path &dir, const fs::path &cert, const int count) {
+        for (int i = 0; i < count; ++i) {
+            fs::copy_file(cert, dir / (std::to_string(100000 + i) + ".pem"), fs::copy_options::overwrite_existing);
+        }
+    }
+};
+
+
+TEST_F(AllocationBudgetTest, ReadProductDb) {
+    for (const auto &[fixture, count] : FIXTURES) {
+        write_productdb(count);
+        // The post_transaction hook reads the productdb into a monotonic arena
+        const auto stats = measure([this]() {
+            std::pmr::monotonic_buffer_resource arena(PRODUCTDB_ARENA_INITIAL_SIZE);
+            ProductDb product_db(paths, default_filesystem(), &arena);
+            ASSERT_TRUE(product_db.read_product_db());
+        });
+        check_budget("read_product_db", fixture, stats);
+    }
+}
+
+TEST_F(AllocationBudgetTest, WriteProductDb) {
+    for (const auto &[fixture, count] : FIXTURES) {
+        write_productdb(count);
+        std::pmr::monotonic_buffer_resource arena(PRODUCTDB_ARENA_INITIAL_SIZE);
+        ProductDb product_db(paths, default_filesystem(), &arena);
+        ASSERT_TRUE(product_db.read_product_db());
+        const auto stats = measure([&product_db]() {
+            ASSERT_TRUE(product_db.write_product_db());
+        });
+        check_budget("write_product_db", fixture, stats);
+    }
+}
+
+TEST_F(AllocationBudgetTest, GetProductIdFromCertContent) {
+    const auto cert_content = read_file(fs::path(TEST_DATA_DIR) / "product-479.pem");
+    ASSERT_FALSE(cert_content.empty());
+    // The one-time initialization of libcrypto is not a part of the budget
+    ASSERT_EQ(get_product_id_from_cert_content(cert_content), "479");
+    for (const auto &[fixture, count] : FIXTURES) {
+        const auto stats = measure([&cert_content, count]() {
+            for (int i = 0; i < count; ++i) {
+                ASSERT_EQ(get_product_id_from_cert_content(cert_content), "479");
+            }
+        });
+        check_budget("get_product_id_from_cert_content", fixture, stats);
+    }
+}
+
+TEST_F(AllocationBudgetTest, IsCertExpired) {
+    const auto cert_dir = temp_dir / "entitlement";
+    fs::create_directories(cert_dir);
+    for (const auto &[fixture, count] : FIXTURES) {
+        write_certificates(cert_dir, fs::path(TEST_DATA_DIR) / "expired.pem", count);
+        // The certificates are read, as by the first check in a dnf run
+        CertCache::get().clear();
+        const auto stats = measure([&cert_dir, count]() {
+            for (int i = 0; i < count; ++i) {
+                ASSERT_TRUE(is_cert_expired(cert_dir / (std::to_string(100000 + i) + ".pem")));
+            }
+        });
+        check_budget("is_cert_expired", fixture, stats);
+    }
+}
+
+TEST_F(AllocationBudgetTest, GetEntitlementCertPaths) {
+    const auto cert_dir = temp_dir / "entitlement";
+    fs::create_directories(cert_dir);
+    for (const auto &[fixture, count] : FIXTURES) {
+        // Every entitlement certificate has its key
+        for (int i = 0; i < count; ++i) {
+            std::ofstream(cert_dir / (std::to_string(100000 + i) + ".pem"));
+            std::ofstream(cert_dir / (std::to_string(100000 + i) + "-key.pem"));
+        }
+        const auto stats = measure([&cert_dir, count]() {
+            ASSERT_EQ(get_entitlement_cert_paths(cert_dir).size(), static_cast<std::size_t>(count));
+        });
+        check_budget("get_entitlement_cert_paths", fixture, stats);
+    }
+}
+
+TEST_F(AllocationBudgetTest, ListProductCertDirectory) {
+    for (const auto &[fixture, count] : FIXTURES) {
+        for (int i = 0; i < count; ++i) {
+            std::ofstream(paths.product_cert_dir + std::to_string(100000 + i) + ".pem");
+        }
+        const auto stats = measure([this, count]() {
+            ASSERT_EQ(default_filesystem().list_directory(paths.product_cert_dir).size(),
+                      static_cast<std::size_t>(count));
+        });
+        check_budget("list_product_cert_directory", fixture, stats);
+    }
+}
+
+
+int main(int argc, char ** argv) {
+    if (!count_crypto_allocations()) {
+        std::cerr << "could not set the allocation functions of libcrypto" << std::endl;
+        return 1;
+    }
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
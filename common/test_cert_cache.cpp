@@ -0,0 +1,128 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "cert_cache.hpp"
+
+namespace fs = std::filesystem;
+
+
+class CertCacheTest : public ::testing::Test {
+protected:
+    fs::path test_data_dir = fs::path(TEST_DATA_DIR);
+    fs::path temp_dir;
+
+    void SetUp() override {
+        temp_dir = fs::temp_directory_path() / "cert_cache_test";
+        fs::create_directories(temp_dir);
+        CertCache::get().clear();
+    }
+
+    void TearDown() override {
+        fs::remove_all(temp_dir);
+    }
+
+    static std::string read_file(const fs::path & path) {
+        std::ifstream file(path, std::ios::binary);
+        std::ostringstream content;
+        content << file.rdbuf();
+        return std::move(content).str();
+    }
+};
+
+
+TEST(Fnv1aHashTest, KnownValues) {
+    EXPECT_EQ(fnv1a_hash(""), 0xcbf29ce484222325ULL);
+    EXPECT_EQ(fnv1a_hash("a"), 0xaf63dc4c8601ec8cULL);
+    EXPECT_EQ(fnv1a_hash("foobar"), 0x85944171f73967e8ULL);
+}
+
+TEST_F(CertCacheTest, ProductCertificate) {
+    const auto content = read_file(test_data_dir / "product-479.pem");
+    const auto facts = CertCache::get().get_facts(content);
+    ASSERT_TRUE(facts->redhat_extensions.has_value());
+    EXPECT_EQ(facts->product_id(), "479");
+    EXPECT_EQ(facts->validity, read_cert_validity(content));
+    EXPECT_EQ(facts->content_hash, fnv1a_hash(content));
+    for (const auto & extension : *facts->redhat_extensions) {
+        EXPECT_TRUE(extension.oid.starts_with(REDHAT_OID_PREFIX)) << extension.oid;
+    }
+}
+
+TEST_F(CertCacheTest, NoProductExtension) {
+    // The consumer-like certificate has no Red Hat product extension
+    const auto facts = CertCache::get().get_facts(read_file(test_data_dir / "valid.pem"));
+    ASSERT_TRUE(facts->redhat_extensions.has_value());
+    EXPECT_EQ(facts->product_id(), "");
+}
+
+TEST_F(CertCacheTest, InvalidContent) {
+    const auto facts = CertCache::get().get_facts(std::string_view("not a certificate"));
+    EXPECT_FALSE(facts->validity.has_value());
+    EXPECT_FALSE(facts->redhat_extensions.has_value());
+    EXPECT_EQ(facts->product_id(), "");
+}
+
+TEST_F(CertCacheTest, SameContentDecodedOnce) {
+    auto & cache = CertCache::get();
+    const auto content = read_file(test_data_dir / "product-479.pem");
+    const auto first = cache.get_facts(content);
+    const auto second = cache.get_facts(content);
+    EXPECT_EQ(first, second);
+    EXPECT_EQ(cache.get_misses(), 1);
+    EXPECT_EQ(cache.get_hits(), 1);
+}
+
+TEST_F(CertCacheTest, PathSharesFactsWithContent) {
+    // The productid plugin asks by content, the rhsm plugin by path of the installed certificate
+    auto & cache = CertCache::get();
+    const auto cert_path = temp_dir / "479.pem";
+    fs::copy_file(test_data_dir / "product-479.pem", cert_path);
+    const auto by_content = cache.get_facts(read_file(cert_path));
+    const auto by_path = cache.get_file_facts(cert_path);
+    EXPECT_EQ(by_content, by_path);
+    EXPECT_EQ(cache.get_misses(), 1);
+
+    // The second lookup of the path does not read the file
+    EXPECT_EQ(cache.get_file_facts(cert_path), by_path);
+    EXPECT_EQ(cache.get_misses(), 1);
+    EXPECT_EQ(cache.get_hits(), 2);
+}
+
+TEST_F(CertCacheTest, ModifiedFileIsReadAgain) {
+    auto & cache = CertCache::get();
+    const auto cert_path = temp_dir / "479.pem";
+    fs::copy_file(test_data_dir / "product-479.pem", cert_path);
+    const auto before = cache.get_file_facts(cert_path);
+    EXPECT_EQ(before->product_id(), "479");
+
+    fs::remove(cert_path);
+    fs::copy_file(test_data_dir / "valid.pem", cert_path);
+    const auto after = cache.get_file_facts(cert_path);
+    EXPECT_NE(before, after);
+    EXPECT_EQ(after->product_id(), "");
+    EXPECT_EQ(cache.get_misses(), 2);
+}
+
+TEST_F(CertCacheTest, MissingFile) {
+    EXPECT_THROW(CertCache::get().get_file_facts(temp_dir / "nonexistent.pem"), std::runtime_error);
+}
+
+TEST_F(CertCacheTest, Clear) {
+    auto & cache = CertCache::get();
+    cache.get_file_facts(test_data_dir / "product-479.pem");
+    cache.clear();
+    EXPECT_EQ(cache.get_misses(), 0);
+    EXPECT_EQ(cache.get_hits(), 0);
+    cache.get_file_facts(test_data_dir / "product-479.pem");
+    EXPECT_EQ(cache.get_misses(), 1);
+}
+
+
+int main(int argc, char ** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,481 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+
+#include "base64.hpp"
+#include "der_validity.hpp"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+using X509Ptr = std::unique_ptr<X509, decltype(&X509_free)>;
+
+std::string read_file(const fs::path &path) {
+    std::ifstream file(path, std::ios::binary);
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    return buffer.str();
+}
+
+std::span<const unsigned char> as_bytes(const std::string &data) {
+    return {reinterpret_cast<const unsigned char *>(data.data()), data.size()};
+}
+
+std::optional<std::int64_t> asn1_time_to_epoch(const ASN1_TIME *time) {
+    struct tm time_tm{};
+    if (ASN1_TIME_to_tm(time, &time_tm) != 1) {
+        return std::nullopt;
+    }
+    return timegm(&time_tm);
+}
+
+/// The reference implementation: the validity of the certificate parsed completely by OpenSSL
+std::optional<CertValidity> openssl_der_validity(const std::string &der) {
+    const auto *data = reinterpret_cast<const unsigned char *>(der.data());
+    auto cert = X509Ptr(d2i_X509(nullptr, &data, static_cast<long>(der.size())), X509_free);
+    if (cert == nullptr) {
+        return std::nullopt;
+    }
+    const auto not_before = asn1_time_to_epoch(X509_get0_notBefore(cert.get()));
+    const auto not_after = asn1_time_to_epoch(X509_get0_notAfter(cert.get()));
+    if (!not_before || !not_after) {
+        return std::nullopt;
+    }
+    return CertValidity{*not_before, *not_after};
+}
+
+std::optional<CertValidity> openssl_pem_validity(const std::string &pem) {
+    auto bio = std::unique_ptr<BIO, decltype(&BIO_free)>(
+        BIO_new_mem_buf(pem.data(), static_cast<int>(pem.size())), BIO_free);
+    auto cert = X509Ptr(PEM_read_bio_X509(bio.get(), nullptr, nullptr, nullptr), X509_free);
+    if (cert == nullptr) {
+        return std::nullopt;
+    }
+    unsigned char *der = nullptr;
+    const int der_size = i2d_X509(cert.get(), &der);
+    std::string der_string(reinterpret_cast<const char *>(der), static_cast<std::size_t>(der_size));
+    OPENSSL_free(der);
+    return openssl_der_validity(der_string);
+}
+
+/// The reference implementation: the extensions of the certificate parsed by OpenSSL
+std::optional<std::vector<CertExtension>> openssl_pem_extensions(const std::string &pem) {
+    auto bio = std::unique_ptr<BIO, decltype(&BIO_free)>(
+        BIO_new_mem_buf(pem.data(), static_cast<int>(pem.size())), BIO_free);
+    auto cert = X509Ptr(PEM_read_bio_X509(bio.get(), nullptr, nullptr, nullptr), X509_free);
+    if (cert == nullptr) {
+        return std::nullopt;
+    }
+    std::vector<CertExtension> extensions;
+    for (int i = 0; i < X509_get_ext_count(cert.get()); ++i) {
+        auto *extension = X509_get_ext(cert.get(), i);
+        char oid[128];
+        OBJ_obj2txt(oid, sizeof(oid), X509_EXTENSION_get_object(extension), 1);
+        const auto *value = X509_EXTENSION_get_data(extension);
+        const auto *data = ASN1_STRING_get0_data(value);
+        extensions.push_back(CertExtension{
+            oid, std::vector<unsigned char>(data, data + ASN1_STRING_length(value))});
+    }
+    return extensions;
+}
+
+/// When the fast path returns a validity, it has to be the same as the validity read by OpenSSL.
+/// Data that OpenSSL cannot parse are allowed only when the damage is after the validity.
+void expect_consistent_with_openssl(const std::string &der) {
+    const auto validity = read_der_validity(as_bytes(der));
+    const auto expected = openssl_der_validity(der);
+    if (validity && expected) {
+        EXPECT_EQ(*validity, *expected);
+    }
+}
+
+}  // namespace
+
+
+class DerValidityTest : public ::testing::Test {
+protected:
+    static fs::path test_data_dir;
+    static fs::path corpus_dir;
+
+    static void SetUpTestSuite() {
+        test_data_dir = fs::path("test_data");
+        if (!fs::exists(test_data_dir)) {
+            test_data_dir = fs::path(TEST_DATA_DIR);
+        }
+        corpus_dir = fs::path("fuzz/corpus/der_validity");
+        if (!fs::exists(corpus_dir)) {
+            corpus_dir = fs::path(DER_VALIDITY_CORPUS_DIR);
+        }
+    }
+
+    static std::string read_der(const std::string &name) {
+        return read_file(corpus_dir / name);
+    }
+
+    /// Replace the first occurrence of the time string in the certificate
+    static std::string replace_time(std::string der, const std::string &time, const std::string &replacement) {
+        const auto pos = der.find(time);
+        EXPECT_NE(pos, std::string::npos);
+        der.replace(pos, time.size(), replacement);
+        return der;
+    }
+};
+
+fs::path DerValidityTest::test_data_dir;
+fs::path DerValidityTest::corpus_dir;
+
+
+// --- differential tests against OpenSSL ---
+
+TEST_F(DerValidityTest, ValidPem_MatchesOpenSsl) {
+    const auto pem = read_file(test_data_dir / "valid.pem");
+    const auto validity = read_cert_validity(pem);
+    ASSERT_TRUE(validity.has_value());
+    EXPECT_EQ(*validity, openssl_pem_validity(pem));
+}
+
+TEST_F(DerValidityTest, ExpiredPem_MatchesOpenSsl) {
+    const auto pem = read_file(test_data_dir / "expired.pem");
+    const auto validity = read_cert_validity(pem);
+    ASSERT_TRUE(validity.has_value());
+    EXPECT_EQ(*validity, openssl_pem_validity(pem));
+    EXPECT_EQ(validity->not_after, 1577836800);
+}
+
+TEST_F(DerValidityTest, GeneralizedTime_MatchesOpenSsl) {
+    // notBefore 2040-01-01 00:00:00 (UTCTime), notAfter 2060-02-29 12:00:00 (GeneralizedTime)
+    const auto pem = read_file(test_data_dir / "generalized-time.pem");
+    const auto validity = read_cert_validity(pem);
+    ASSERT_TRUE(validity.has_value());
+    EXPECT_EQ(*validity, openssl_pem_validity(pem));
+    EXPECT_EQ(validity->not_before, 2208988800);
+    EXPECT_EQ(validity->not_after, 2845281600);
+}
+
+TEST_F(DerValidityTest, Der_MatchesPem) {
+    EXPECT_EQ(read_cert_validity(read_der("valid.der")), read_cert_validity(read_file(test_data_dir / "valid.pem")));
+}
+
+TEST_F(DerValidityTest, Version1Certificate) {
+    const auto der = read_der("version1.der");
+    const auto validity = read_der_validity(as_bytes(der));
+    ASSERT_TRUE(validity.has_value());
+    EXPECT_EQ(*validity, openssl_der_validity(der));
+}
+
+TEST_F(DerValidityTest, Extensions_MatchOpenSsl) {
+    for (const auto *name : {"valid.pem", "entitlement-v1.pem", "entitlement-v3.pem", "product-479.pem"}) {
+        const auto pem = read_file(test_data_dir / name);
+        const auto extensions = read_pem_extensions(pem);
+        ASSERT_TRUE(extensions.has_value()) << name;
+        EXPECT_EQ(*extensions, openssl_pem_extensions(pem)) << name;
+    }
+}
+
+TEST_F(DerValidityTest, Extensions_RedHatStrings) {
+    const auto extensions = read_pem_extensions(read_file(test_data_dir / "product-479.pem"));
+    ASSERT_TRUE(extensions.has_value());
+    const auto tags = std::find_if(extensions->begin(), extensions->end(), [](const auto &extension) {
+        return extension.oid == "1.3.6.1.4.1.2312.9.1.479.4";
+    });
+    ASSERT_NE(tags, extensions->end());
+    EXPECT_EQ(read_der_string(tags->value), "rhel-9,rhel-9-x86_64");
+    // Not a string
+    EXPECT_FALSE(read_der_string(std::vector<unsigned char>{0x02, 0x01, 0x01}).has_value());
+}
+
+TEST_F(DerValidityTest, Extensions_Version1Certificate) {
+    const auto extensions = read_der_extensions(as_bytes(read_der("version1.der")));
+    ASSERT_TRUE(extensions.has_value());
+    EXPECT_TRUE(extensions->empty());
+}
+
+TEST_F(DerValidityTest, Extensions_TruncatedReturnsNullopt) {
+    const auto der = read_der("valid.der");
+    ASSERT_TRUE(read_der_extensions(as_bytes(der)).has_value());
+    for (std::size_t size = 0; size < der.size(); ++size) {
+        const auto prefix = der.substr(0, size);
+        // The signature after the TBSCertificate is not needed
+        const auto extensions = read_der_extensions(as_bytes(prefix));
+        if (extensions) {
+            EXPECT_EQ(*extensions, *read_der_extensions(as_bytes(der))) << size;
+        }
+    }
+}
+
+// --- truncated and malformed input ---
+
+TEST_F(DerValidityTest, Truncations_MatchOpenSslAfterValidity) {
+    // The validity of valid.der ends at offset 110
+    const auto der = read_der("valid.der");
+    const auto expected = openssl_der_validity(der);
+    for (std::size_t size = 0; size <= der.size(); ++size) {
+        const auto validity = read_der_validity(as_bytes(der).first(size));
+        if (size < 110) {
+            EXPECT_FALSE(validity.has_value()) << "size " << size;
+        } else {
+            EXPECT_EQ(validity, expected) << "size " << size;
+        }
+    }
+}
+
+TEST_F(DerValidityTest, TruncatedPem_UsesDecodedPrefix) {
+    // Only the beginning of the certificate is needed, like when reading a prefix of a large file
+    const auto pem = read_file(test_data_dir / "valid.pem");
+    EXPECT_EQ(read_pem_validity(pem.substr(0, 300)), openssl_pem_validity(pem));
+    EXPECT_FALSE(read_pem_validity(pem.substr(0, 100)).has_value());
+}
+
+TEST_F(DerValidityTest, PemWithOtherFirstBlock_ReturnsNullopt) {
+    const auto pem = read_file(test_data_dir / "valid-key.pem") + read_file(test_data_dir / "valid.pem");
+    EXPECT_FALSE(read_pem_validity(pem).has_value());
+}
+
+TEST_F(DerValidityTest, NotCertificate_ReturnsNullopt) {
+    EXPECT_FALSE(read_cert_validity("").has_value());
+    EXPECT_FALSE(read_cert_validity("this is not a valid certificate").has_value());
+    EXPECT_FALSE(read_cert_validity("-----BEGIN CERTIFICATE-----\n!!!!\n-----END CERTIFICATE-----\n").has_value());
+}
+
+TEST_F(DerValidityTest, InvalidTimes_ReturnNullopt) {
+    const auto der = read_der("valid.der");
+    for (const auto *invalid : {
+             "361310150340Z",  // month 13
+             "360230150340Z",  // February 30
+             "360410240340Z",  // hour 24
+             "360410150360Z",  // leap second
+             "3604101503 0Z",  // not a digit
+             "360410150340+"}) {  // not UTC
+        EXPECT_FALSE(read_der_validity(as_bytes(replace_time(der, "360410150340Z", invalid))).has_value()) << invalid;
+    }
+}
+
+TEST_F(DerValidityTest, UtcTimeCenturies) {
+    const auto der = read_der("valid.der");
+    // 1950 is the first year of UTCTime, 2049 is the last one
+    const auto from_1950 = replace_time(der, "360410150340Z", "500101000000Z");
+    EXPECT_EQ(read_der_validity(as_bytes(from_1950))->not_after, -631152000);
+    EXPECT_EQ(read_der_validity(as_bytes(from_1950)), openssl_der_validity(from_1950));
+    const auto until_2049 = replace_time(der, "360410150340Z", "491231235959Z");
+    EXPECT_EQ(read_der_validity(as_bytes(until_2049))->not_after, 2524607999);
+    EXPECT_EQ(read_der_validity(as_bytes(until_2049)), openssl_der_validity(until_2049));
+}
+
+TEST_F(DerValidityTest, NonMinimalLength_ReturnsNullopt) {
+    // Encode the length of the serial number (20 bytes) in the long form
+    auto der = read_der("valid.der");
+    ASSERT_EQ(der.substr(13, 2), std::string("\x02\x14", 2));
+    der.replace(14, 1, std::string("\x81\x14", 2));
+    EXPECT_FALSE(read_der_validity(as_bytes(der)).has_value());
+}
+
+TEST_F(DerValidityTest, IndefiniteLength_ReturnsNullopt) {
+    auto der = read_der("valid.der");
+    der[1] = '\x80';
+    EXPECT_FALSE(read_der_validity(as_bytes(der)).has_value());
+}
+
+// --- fuzz corpus regression ---
+
+TEST_F(DerValidityTest, Corpus_ConsistentWithOpenSsl) {
+    std::size_t files = 0;
+    for (const auto &entry : fs::directory_iterator(corpus_dir)) {
+        const auto data = read_file(entry.path());
+        const auto validity = read_cert_validity(data);
+        const auto expected = data.starts_with("-----") ? openssl_pem_validity(data) : openssl_der_validity(data);
+        if (validity && expected) {
+            EXPECT_EQ(*validity, *expected) << entry.path();
+        }
+        ++files;
+    }
+    EXPECT_GT(files, 0u);
+}
+
+TEST_F(DerValidityTest, BitFlips_ConsistentWithOpenSsl) {
+    for (const auto *name : {"valid.der", "generalized-time.der", "version1.der"}) {
+        const auto der = read_der(name);
+        // Damage every bit of the headers, the fields before the validity and the validity itself
+        for (std::size_t pos = 0; pos < std::min<std::size_t>(der.size(), 128); ++pos) {
+            for (int bit = 0; bit < 8; ++bit) {
+                auto damaged = der;
+                damaged[pos] = static_cast<char>(damaged[pos] ^ (1 << bit));
+                expect_consistent_with_openssl(damaged);
+            }
+        }
+    }
+}
+
+// --- base64 tests ---
+
+TEST(Base64Test, Decode) {
+    const auto decoded = base64_decode("aGVs\nbG8g d29y\r\nbGQ=");
+    ASSERT_TRUE(decoded.has_value());
+    EXPECT_EQ(std::string(decoded->begin(), decoded->end()), "hello world");
+}
+
+TEST(Base64Test, DecodePadding) {
+    EXPECT_EQ(base64_decode("YQ==").value(), std::vector<unsigned char>{'a'});
+    EXPECT_EQ(base64_decode("YWI=").value(), (std::vector<unsigned char>{'a', 'b'}));
+    EXPECT_EQ(base64_decode("").value(), std::vector<unsigned char>{});
+}
+
+TEST(Base64Test, DecodeInvalid) {
+    EXPECT_FALSE(base64_decode("YQ=").has_value());
+    EXPECT_FALSE(base64_decode("YWJj!").has_value());
+    EXPECT_FALSE(base64_decode("Y===").has_value());
+    EXPECT_FALSE(base64_decode("YQ==YWJj").has_value());
+    EXPECT_FALSE(base64_decode("YWJjZ").has_value());
+}
+
+TEST(Base64Test, DecodeMaxSize) {
+    // Decoding stops at the limit, the rest of the input is not checked
+    const auto decoded = base64_decode("aGVsbG8gd29ybGQ=!", 5);
+    ASSERT_TRUE(decoded.has_value());
+    EXPECT_EQ(std::string(decoded->begin(), decoded->end()), "hello");
+}
+
+
+// --- base64 kernel tests ---
+
+namespace {
+
+constexpr std::string_view BASE64_ALPHABET = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+std::vector<Base64Kernel> supported_kernels() {
+    std::vector<Base64Kernel> kernels;
+    for (const auto kernel : {Base64Kernel::SCALAR, Base64Kernel::SSE42, Base64Kernel::AVX2}) {
+        if (base64_kernel_supported(kernel)) {
+            kernels.push_back(kernel);
+        }
+    }
+    return kernels;
+}
+
+/// Encode data like PEM does, with lines of line_length characters
+std::string base64_encode(const std::vector<unsigned char> &data, const std::size_t line_length) {
+    std::string encoded;
+    for (std::size_t i = 0; i < data.size(); i += 3) {
+        const auto remaining = data.size() - i;
+        std::uint32_t quantum = static_cast<std::uint32_t>(data[i]) << 16;
+        if (remaining > 1) {
+            quantum |= static_cast<std::uint32_t>(data[i + 1]) << 8;
+        }
+        if (remaining > 2) {
+            quantum |= data[i + 2];
+        }
+        for (std::size_t j = 0; j < 4; ++j) {
+            encoded += j <= remaining ? BASE64_ALPHABET[(quantum >> (18 - 6 * j)) & 0x3f] : '=';
+        }
+    }
+    std::string wrapped;
+    for (std::size_t i = 0; i < encoded.size(); i += line_length) {
+        wrapped += encoded.substr(i, line_length) + "\n";
+    }
+    return wrapped;
+}
+
+}  // namespace
+
+TEST(Base64Test, BestKernelSupported) {
+    EXPECT_TRUE(base64_kernel_supported(Base64Kernel::SCALAR));
+    EXPECT_TRUE(base64_kernel_supported(base64_best_kernel()));
+}
+
+TEST(Base64Test, Kernels_WholeAlphabet) {
+    // Every character of the alphabet in every position of the vector blocks
+    std::string input;
+    for (int i = 0; i < 4; ++i) {
+        input += BASE64_ALPHABET.substr(static_cast<std::size_t>(i));
+        input += BASE64_ALPHABET.substr(0, static_cast<std::size_t>(i));
+    }
+    const auto expected = base64_decode(Base64Kernel::SCALAR, input);
+    ASSERT_TRUE(expected.has_value());
+    ASSERT_EQ(expected->size(), input.size() / 4 * 3);
+    for (const auto kernel : supported_kernels()) {
+        EXPECT_EQ(base64_decode(kernel, input), expected) << static_cast<int>(kernel);
+    }
+}
+
+TEST(Base64Test, Kernels_RoundTrip) {
+    std::mt19937 random(42);
+    for (std::size_t size = 0; size < 300; ++size) {
+        std::vector<unsigned char> data(size);
+        for (auto &byte : data) {
+            byte = static_cast<unsigned char>(random());
+        }
+        for (const std::size_t line_length : {64UL, 76UL, 1000UL}) {
+            const auto encoded = base64_encode(data, line_length);
+            for (const auto kernel : supported_kernels()) {
+                EXPECT_EQ(base64_decode(kernel, encoded), data) << static_cast<int>(kernel) << " " << size;
+            }
+        }
+    }
+}
+
+TEST(Base64Test, Kernels_InvalidCharacters) {
+    // Characters outside the alphabet in any position are found by all kernels
+    std::mt19937 random(42);
+    std::vector<unsigned char> data(200);
+    for (auto &byte : data) {
+        byte = static_cast<unsigned char>(random());
+    }
+    const auto encoded = base64_encode(data, 1000);
+    for (const char invalid : {'!', '-', '_', '.', ':', '@', '[', '`', '{', '\x7f', '\x80', '\xff', '\0'}) {
+        for (std::size_t pos = 0; pos < 96; ++pos) {
+            auto damaged = encoded;
+            damaged[pos] = invalid;
+            for (const auto kernel : supported_kernels()) {
+                EXPECT_FALSE(base64_decode(kernel, damaged).has_value()) << static_cast<int>(kernel) << " " << pos;
+            }
+        }
+    }
+}
+
+TEST(Base64Test, Kernels_Truncated) {
+    // Certificates are often decoded only up to MAX_DER_VALIDITY_PREFIX
+    std::mt19937 random(42);
+    std::vector<unsigned char> data(1000);
+    for (auto &byte : data) {
+        byte = static_cast<unsigned char>(random());
+    }
+    const auto encoded = base64_encode(data, 64);
+    for (std::size_t max_size = 0; max_size < 200; ++max_size) {
+        const std::vector<unsigned char> expected(data.begin(), data.begin() + static_cast<std::ptrdiff_t>(max_size));
+        for (const auto kernel : supported_kernels()) {
+            EXPECT_EQ(base64_decode(kernel, encoded, max_size), expected)
+                << static_cast<int>(kernel) << " " << max_size;
+        }
+    }
+}
+
+TEST(Base64Test, Kernels_Certificates) {
+    for (const auto *name :
+         {"valid.pem", "expired.pem", "entitlement-v1.pem", "entitlement-v3.pem", "product-479.pem"}) {
+        const auto pem = read_file(fs::path(TEST_DATA_DIR) / name);
+        const auto begin = pem.find('\n') + 1;
+        const auto end = pem.find("-----END");
+        const auto body = std::string_view(pem).substr(begin, end - begin);
+        const auto expected = base64_decode(Base64Kernel::SCALAR, body);
+        ASSERT_TRUE(expected.has_value()) << name;
+        for (const auto kernel : supported_kernels()) {
+            EXPECT_EQ(base64_decode(kernel, body), expected) << static_cast<int>(kernel) << " " << name;
+        }
+    }
+}
+
+
+int main(int argc, char ** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,122 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "plugin_logger.hpp"
+
+using Level = libdnf5::Logger::Level;
+using TestLogger = PluginLogger<"[test plugin] ">;
+
+
+/// Logger keeping the written messages
+class MemoryLogger : public libdnf5::Logger {
+public:
+    void write(const std::chrono::time_point<std::chrono::system_clock> &, pid_t, Level level,
+               const std::string & message) noexcept override {
+        messages.emplace_back(level, message);
+    }
+
+    std::vector<std::pair<Level, std::string>> messages;
+};
+
+class PluginLoggerTest : public ::testing::Test {
+protected:
+    void SetUp() override { previous_cout = std::cout.rdbuf(output.rdbuf()); }
+
+    void TearDown() override { std::cout.rdbuf(previous_cout); }
+
+    MemoryLogger memory;
+    std::ostringstream output;
+    std::streambuf *previous_cout = nullptr;
+};
+
+
+TEST_F(PluginLoggerTest, PrefixAndFormat) {
+    const TestLogger logger(memory);
+    logger.debug("Hook started");
+    logger.info("{} of {}", 1, std::string("2"));
+    logger.warning("Path {}", "/etc/pki/product/");
+    logger.error("Braces {{}} are kept: {}", 'x');
+
+    const std::vector<std::pair<Level, std::string>> expected{
+        {Level::DEBUG, "[test plugin] Hook started"},
+        {Level::INFO, "[test plugin] 1 of 2"},
+        {Level::WARNING, "[test plugin] Path /etc/pki/product/"},
+        {Level::ERROR, "[test plugin] Braces {} are kept: x"},
+    };
+    EXPECT_EQ(memory.messages, expected);
+    EXPECT_TRUE(output.str().empty());
+}
+
+TEST_F(PluginLoggerTest, LevelGating) {
+    const TestLogger logger(memory, Level::INFO);
+    EXPECT_FALSE(logger.is_enabled(Level::DEBUG));
+    EXPECT_TRUE(logger.is_enabled(Level::INFO));
+    EXPECT_TRUE(logger.is_enabled(Level::CRITICAL));
+
+    logger.debug("Not written {}", 1);
+    logger.info("Written {}", 2);
+    logger.error("Written {}", 3);
+    ASSERT_EQ(memory.messages.size(), 2);
+    EXPECT_EQ(memory.messages[0].second, "[test plugin] Written 2");
+    EXPECT_EQ(memory.messages[1].second, "[test plugin] Written 3");
+}
+
+TEST_F(PluginLoggerTest, LazyArguments) {
+    const TestLogger logger(memory, Level::INFO);
+    int calls = 0;
+    const auto describe = [&calls] {
+        ++calls;
+        return std::string("described");
+    };
+    const std::filesystem::path path("/etc/pki/product/69.pem");
+
+    logger.debug("Not written {} {}", describe, path);
+    EXPECT_EQ(calls, 0);
+    logger.info("Written {} {}", describe, path);
+    EXPECT_EQ(calls, 1);
+    ASSERT_EQ(memory.messages.size(), 1);
+    EXPECT_EQ(memory.messages[0].second, "[test plugin] Written described /etc/pki/product/69.pem");
+}
+
+TEST_F(PluginLoggerTest, NotifyPrintsOnce) {
+    const TestLogger logger(memory, Level::WARNING);
+    logger.notify(Level::WARNING, "No SCA entitlement certificate(s) found in {}", "/etc/pki/entitlement");
+    // The user sees the message even when it is not logged
+    logger.notify(Level::INFO, "Release set to {}", "9.4");
+
+    ASSERT_EQ(memory.messages.size(), 1);
+    EXPECT_EQ(memory.messages[0].first, Level::WARNING);
+    EXPECT_EQ(memory.messages[0].second, "[test plugin] No SCA entitlement certificate(s) found in /etc/pki/entitlement");
+    EXPECT_EQ(output.str(), "No SCA entitlement certificate(s) found in /etc/pki/entitlement\nRelease set to 9.4\n");
+}
+TEST_F(PluginLoggerTest, LogLevelFromString) {
+    EXPECT_EQ(log_level_from_string("critical"), Level::CRITICAL);
+    EXPECT_EQ(log_level_from_string("warning"), Level::WARNING);
+    EXPECT_EQ(log_level_from_string("info"), Level::INFO);
+    EXPECT_EQ(log_level_from_string("trace"), Level::TRACE);
+    EXPECT_EQ(log_level_from_string("Debug"), std::nullopt);
+    EXPECT_EQ(log_level_from_string(""), std::nullopt);
+}
+
+TEST_F(PluginLoggerTest, LogLevelOfLogfilelevel) {
+    EXPECT_EQ(log_level_of_logfilelevel(0), Level::CRITICAL);
+    EXPECT_EQ(log_level_of_logfilelevel(1), Level::INFO);
+    EXPECT_EQ(log_level_of_logfilelevel(2), Level::INFO);
+    EXPECT_EQ(log_level_of_logfilelevel(3), Level::DEBUG);
+    // The default of dnf
+    EXPECT_EQ(log_level_of_logfilelevel(9), Level::DEBUG);
+}
+
+
+int main(int argc, char ** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,160 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "plugin_metrics.hpp"
+
+namespace fs = std::filesystem;
+
+using namespace std::chrono_literals;
+
+
+class PluginMetricsTest : public ::testing::Test {
+protected:
+    fs::path temp_dir;
+
+    void SetUp() override {
+        temp_dir = fs::temp_directory_path() / "plugin_metrics_test";
+        fs::remove_all(temp_dir);
+    }
+
+    void TearDown() override {
+        fs::remove_all(temp_dir);
+    }
+
+    static std::string read_file(const fs::path &path) {
+        std::ifstream file(path);
+        std::stringstream content;
+        content << file.rdbuf();
+        return content.str();
+    }
+};
+
+
+TEST_F(PluginMetricsTest, DisabledMetricsCollectNothing) {
+    PluginMetrics metrics;
+    EXPECT_FALSE(metrics.is_enabled());
+    metrics.add_counter("rhsm_dnf5_productid_repositories_processed_total", "Repositories", 3);
+    {
+        const HookTimer timer(metrics, "post_transaction");
+    }
+    EXPECT_EQ(metrics.render(""), "");
+    EXPECT_NO_THROW(metrics.write());
+}
+
+TEST_F(PluginMetricsTest, Render) {
+    PluginMetrics metrics("productid", temp_dir / "rhsm_dnf5_productid.prom");
+    metrics.add_counter("rhsm_dnf5_productid_cache_lookups_total", "Lookups", 2, {{"result", "hit"}});
+    metrics.add_counter("rhsm_dnf5_productid_cache_lookups_total", "Lookups", 1, {{"result", "miss"}});
+    metrics.set_gauge("rhsm_dnf5_productid_products", "Products", 4);
+    metrics.observe_hook_duration("post_transaction", 20ms);
+
+    EXPECT_EQ(metrics.render(""),
+              "# HELP rhsm_dnf5_productid_cache_lookups_total Lookups\n"
+              "# TYPE rhsm_dnf5_productid_cache_lookups_total counter\n"
+              "rhsm_dnf5_productid_cache_lookups_total{result=\"hit\"} 2\n"
+              "rhsm_dnf5_productid_cache_lookups_total{result=\"miss\"} 1\n"
+              "# HELP rhsm_dnf5_productid_products Products\n"
+              "# TYPE rhsm_dnf5_productid_products gauge\n"
+              "rhsm_dnf5_productid_products 4\n"
+              "# HELP rhsm_dnf5_hook_duration_seconds Duration of the hooks of the dnf plugins\n"
+              "# TYPE rhsm_dnf5_hook_duration_seconds histogram\n"
+              "rhsm_dnf5_hook_duration_seconds_bucket{plugin=\"productid\",hook=\"post_transaction\",le=\"0.001\"} 0\n"
+              "rhsm_dnf5_hook_duration_seconds_bucket{plugin=\"productid\",hook=\"post_transaction\",le=\"0.005\"} 0\n"
+              "rhsm_dnf5_hook_duration_seconds_bucket{plugin=\"productid\",hook=\"post_transaction\",le=\"0.01\"} 0\n"
+              "rhsm_dnf5_hook_duration_seconds_bucket{plugin=\"productid\",hook=\"post_transaction\",le=\"0.05\"} 1\n"
+              "rhsm_dnf5_hook_duration_seconds_bucket{plugin=\"productid\",hook=\"post_transaction\",le=\"0.1\"} 1\n"
+              "rhsm_dnf5_hook_duration_seconds_bucket{plugin=\"productid\",hook=\"post_transaction\",le=\"0.5\"} 1\n"
+              "rhsm_dnf5_hook_duration_seconds_bucket{plugin=\"productid\",hook=\"post_transaction\",le=\"1\"} 1\n"
+              "rhsm_dnf5_hook_duration_seconds_bucket{plugin=\"productid\",hook=\"post_transaction\",le=\"5\"} 1\n"
+              "rhsm_dnf5_hook_duration_seconds_bucket{plugin=\"productid\",hook=\"post_transaction\",le=\"+Inf\"} 1\n"
+              "rhsm_dnf5_hook_duration_seconds_sum{plugin=\"productid\",hook=\"post_transaction\"} 0.02\n"
+              "rhsm_dnf5_hook_duration_seconds_count{plugin=\"productid\",hook=\"post_transaction\"} 1\n");
+}
+
+TEST_F(PluginMetricsTest, MergeWithPreviousContent) {
+    const std::string previous =
+        "# HELP rhsm_dnf5_rhsm_skipped_repositories_total Skipped\n"
+        "# TYPE rhsm_dnf5_rhsm_skipped_repositories_total counter\n"
+        "rhsm_dnf5_rhsm_skipped_repositories_total 5\n"
+        "# HELP rhsm_dnf5_rhsm_entitlement_certificates Certificates\n"
+        "# TYPE rhsm_dnf5_rhsm_entitlement_certificates gauge\n"
+        "rhsm_dnf5_rhsm_entitlement_certificates 7\n"
+        "# HELP rhsm_dnf5_rhsm_registered Registered\n"
+        "# TYPE rhsm_dnf5_rhsm_registered gauge\n"
+        "rhsm_dnf5_rhsm_registered 1\n";
+    PluginMetrics metrics("rhsm", temp_dir / "rhsm_dnf5_rhsm.prom");
+    metrics.add_counter("rhsm_dnf5_rhsm_skipped_repositories_total", "Skipped", 2);
+    metrics.set_gauge("rhsm_dnf5_rhsm_entitlement_certificates", "Certificates", 3);
+
+    // Counters are added, gauges are replaced and samples that were not updated are kept
+    EXPECT_EQ(metrics.render(previous),
+              "# HELP rhsm_dnf5_rhsm_skipped_repositories_total Skipped\n"
+              "# TYPE rhsm_dnf5_rhsm_skipped_repositories_total counter\n"
+              "rhsm_dnf5_rhsm_skipped_repositories_total 7\n"
+              "# HELP rhsm_dnf5_rhsm_entitlement_certificates Certificates\n"
+              "# TYPE rhsm_dnf5_rhsm_entitlement_certificates gauge\n"
+              "rhsm_dnf5_rhsm_entitlement_certificates 3\n"
+              "# HELP rhsm_dnf5_rhsm_registered Registered\n"
+              "# TYPE rhsm_dnf5_rhsm_registered gauge\n"
+              "rhsm_dnf5_rhsm_registered 1\n");
+}
+
+TEST_F(PluginMetricsTest, BrokenPreviousContentIsIgnored) {
+    PluginMetrics metrics("rhsm", temp_dir / "rhsm_dnf5_rhsm.prom");
+    metrics.add_counter("rhsm_dnf5_rhsm_status_checks_total", "Checks", 1);
+    EXPECT_EQ(metrics.render("garbage\nrhsm_dnf5_rhsm_status_checks_total x\n# TYPE\n"),
+              "# HELP rhsm_dnf5_rhsm_status_checks_total Checks\n"
+              "# TYPE rhsm_dnf5_rhsm_status_checks_total counter\n"
+              "rhsm_dnf5_rhsm_status_checks_total 1\n");
+}
+
+TEST_F(PluginMetricsTest, EscapeLabelValues) {
+    PluginMetrics metrics("rhsm", temp_dir / "rhsm_dnf5_rhsm.prom");
+    metrics.add_counter("rhsm_dnf5_test_total", "Test", 1, {{"repo", "a\"b\\c\nd"}});
+    const auto content = metrics.render("");
+    EXPECT_NE(content.find("rhsm_dnf5_test_total{repo=\"a\\\"b\\\\c\\nd\"} 1\n"), std::string::npos);
+
+    // Escaped label values are read back as the same sample
+    EXPECT_NE(metrics.render(content).find("rhsm_dnf5_test_total{repo=\"a\\\"b\\\\c\\nd\"} 2\n"), std::string::npos);
+}
+
+TEST_F(PluginMetricsTest, WriteIsCumulative) {
+    const auto path = temp_dir / "textfile" / "rhsm_dnf5_productid.prom";
+    for (int run = 0; run < 2; ++run) {
+        PluginMetrics metrics("productid", path);
+        metrics.add_counter("rhsm_dnf5_productid_certificates_installed_total", "Installed", 1);
+        metrics.observe_hook_duration("repos_loaded", 2s);
+        metrics.write();
+    }
+    const auto content = read_file(path);
+    EXPECT_NE(content.find("rhsm_dnf5_productid_certificates_installed_total 2\n"), std::string::npos);
+    EXPECT_NE(content.find("le=\"1\"} 0\n"), std::string::npos);
+    EXPECT_NE(content.find("le=\"5\"} 2\n"), std::string::npos);
+    EXPECT_NE(content.find("rhsm_dnf5_hook_duration_seconds_sum{plugin=\"productid\",hook=\"repos_loaded\"} 4\n"),
+              std::string::npos);
+    EXPECT_NE(content.find("# TYPE rhsm_dnf5_last_run_timestamp_seconds gauge\n"
+                           "rhsm_dnf5_last_run_timestamp_seconds{plugin=\"productid\"} "),
+              std::string::npos);
+
+    // Only the metrics file is left in the directory of the textfile collector
+    EXPECT_EQ(std::distance(fs::directory_iterator(path.parent_path()), fs::directory_iterator()), 1);
+    EXPECT_EQ(fs::status(path).permissions() & fs::perms::all, fs::perms(0644));
+}
+
+TEST_F(PluginMetricsTest, WriteError) {
+    fs::create_directories(temp_dir / "file.prom");
+    PluginMetrics metrics("rhsm", temp_dir / "file.prom");
+    metrics.add_counter("rhsm_dnf5_test_total", "Test", 1);
+    EXPECT_THROW(metrics.write(), std::runtime_error);
+    EXPECT_EQ(std::distance(fs::directory_iterator(temp_dir), fs::directory_iterator()), 1);
+}
+
+
+int main(int argc, char ** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
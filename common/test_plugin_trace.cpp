@@ -0,0 +1,152 @@
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <json/json.h>
+
+#include "plugin_trace.hpp"
+
+namespace fs = std::filesystem;
+
+
+class PluginTraceTest : public ::testing::Test {
+protected:
+    fs::path temp_dir;
+
+    void SetUp() override {
+        temp_dir = fs::temp_directory_path() / "plugin_trace_test";
+        fs::remove_all(temp_dir);
+        unsetenv(TRACE_DIR_ENV);
+    }
+
+    void TearDown() override {
+        fs::remove_all(temp_dir);
+        unsetenv(TRACE_DIR_ENV);
+    }
+
+    static Json::Value parse(const std::string &json) {
+        Json::Value root;
+        Json::CharReaderBuilder reader_builder;
+        Json::String errors;
+        std::istringstream stream(json);
+        EXPECT_TRUE(Json::parseFromStream(reader_builder, stream, &root, &errors)) << errors;
+        return root;
+    }
+};
+
+
+TEST_F(PluginTraceTest, DisabledTracerRecordsNothing) {
+    Tracer tracer;
+    EXPECT_FALSE(tracer.is_enabled());
+    {
+        TraceSpan span(&tracer, "post_transaction", "hook");
+        span.arg("repos", "3");
+        const TraceSpan child(nullptr, "read_product_db");
+    }
+    EXPECT_EQ(tracer.size(), 0);
+    EXPECT_NO_THROW(tracer.write("dnf"));
+}
+
+TEST_F(PluginTraceTest, NestedSpans) {
+    Tracer tracer(temp_dir / "trace.json");
+    {
+        TraceSpan hook(&tracer, "post_transaction", "hook");
+        {
+            TraceSpan repo(&tracer, "rhel-9-for-x86_64-baseos-rpms", "repo");
+            repo.arg("product_id", "479");
+            const TraceSpan decompress(&tracer, "decompress");
+        }
+        hook.arg("repos", "1");
+    }
+    ASSERT_EQ(tracer.size(), 3);
+
+    const auto root = parse(tracer.to_json("dnf (productid plugin)"));
+    EXPECT_EQ(root["displayTimeUnit"].asString(), "ms");
+    const auto &events = root["traceEvents"];
+    ASSERT_EQ(events.size(), 4);
+    EXPECT_EQ(events[0]["ph"].asString(), "M");
+    EXPECT_EQ(events[0]["args"]["name"].asString(), "dnf (productid plugin)");
+
+    // Outer spans first, and every span contains its children
+    EXPECT_EQ(events[1]["name"].asString(), "post_transaction");
+    EXPECT_EQ(events[1]["cat"].asString(), "hook");
+    EXPECT_EQ(events[1]["args"]["repos"].asString(), "1");
+    EXPECT_EQ(events[2]["name"].asString(), "rhel-9-for-x86_64-baseos-rpms");
+    EXPECT_EQ(events[2]["args"]["product_id"].asString(), "479");
+    EXPECT_EQ(events[3]["name"].asString(), "decompress");
+    EXPECT_EQ(events[3]["cat"].asString(), "phase");
+    EXPECT_FALSE(events[3].isMember("args"));
+    for (Json::ArrayIndex i = 1; i < events.size(); ++i) {
+        EXPECT_EQ(events[i]["ph"].asString(), "X");
+        EXPECT_EQ(events[i]["pid"].asInt64(), getpid());
+        EXPECT_EQ(events[i]["tid"].asInt64(), gettid());
+        EXPECT_GE(events[i]["dur"].asInt64(), 0);
+    }
+    for (Json::ArrayIndex i = 2; i < events.size(); ++i) {
+        const auto &parent = events[i - 1];
+        EXPECT_GE(events[i]["ts"].asInt64(), parent["ts"].asInt64());
+        EXPECT_LE(events[i]["ts"].asInt64() + events[i]["dur"].asInt64(),
+                  parent["ts"].asInt64() + parent["dur"].asInt64() + 1);
+    }
+}
+
+TEST_F(PluginTraceTest, SpansOfThreads) {
+    Tracer tracer(temp_dir / "trace.json");
+    std::thread background([&tracer]() { const TraceSpan span(&tracer, "status_check"); });
+    {
+        const TraceSpan span(&tracer, "pre_base_setup", "hook");
+    }
+    background.join();
+    const auto events = parse(tracer.to_json("dnf"))["traceEvents"];
+    ASSERT_EQ(events.size(), 3);
+    EXPECT_NE(events[1]["tid"].asInt64(), events[2]["tid"].asInt64());
+}
+
+TEST_F(PluginTraceTest, EndedSpanIsRecordedOnce) {
+    Tracer tracer(temp_dir / "trace.json");
+    TraceSpan span(&tracer, "get_status");
+    span.end();
+    span.end();
+    EXPECT_EQ(tracer.size(), 1);
+}
+
+TEST_F(PluginTraceTest, PluginTracePath) {
+    EXPECT_TRUE(Tracer::get_plugin_trace_path("rhsm", "").empty());
+    const auto pid = std::to_string(getpid());
+    EXPECT_EQ(Tracer::get_plugin_trace_path("rhsm", "/var/log/rhsm"), fs::path("/var/log/rhsm/rhsm-" + pid + ".json"));
+
+    // The environment variable overrides the option
+    setenv(TRACE_DIR_ENV, "/tmp/traces", 1);
+    EXPECT_EQ(Tracer::get_plugin_trace_path("productid", ""), fs::path("/tmp/traces/productid-" + pid + ".json"));
+    EXPECT_EQ(Tracer::get_plugin_trace_path("productid", "/var/log/rhsm"),
+              fs::path("/tmp/traces/productid-" + pid + ".json"));
+    setenv(TRACE_DIR_ENV, "", 1);
+    EXPECT_TRUE(Tracer::get_plugin_trace_path("productid", "").empty());
+}
+
+TEST_F(PluginTraceTest, WriteCreatesDirectory) {
+    Tracer tracer(temp_dir / "traces" / "rhsm.json");
+    {
+        const TraceSpan span(&tracer, "post_base_setup", "hook");
+    }
+    tracer.write("dnf (rhsm plugin)");
+    std::ifstream file(tracer.get_path());
+    std::stringstream content;
+    content << file.rdbuf();
+    EXPECT_EQ(parse(content.str())["traceEvents"].size(), 2);
+
+    fs::create_directories(temp_dir / "file");
+    const Tracer unwritable(temp_dir / "file");
+    EXPECT_THROW(unwritable.write("dnf"), std::runtime_error);
+}
+
+
+int main(int argc, char ** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,218 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <json/json.h>
+#include <libdnf5/logger/null_logger.hpp>
+
+// rhsm_utils.hpp comes first, because productdb.hpp defines PRODUCT_CERT_DIR as a macro
+#include "rhsm_utils.hpp"
+#include "cert_cache.hpp"
+#include "productdb.hpp"
+#include "productid_engine.hpp"
+#include "syscall_counter.hpp"
+
+/// System calls of the utilities and hook paths of both plugins checked against the budgets in
+/// syscall_budgets.json. The calls are counted by syscall_counter and grouped by their kind (open,
+/// stat, getdents, read, write, close, modify, other), so that the budgets do not depend on the
+/// system calls used by a particular version of glibc. Allocation of memory is not budgeted.
+///
+/// Every operation is run once before it is counted, so that static initialization and the caches
+/// filled by the first run are not part of the budget. The counts are recorded as test properties
+/// (see --gtest_output=json) for updating the budgets after an intended change.
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr int CERTIFICATES = 10;
+
+const Json::Value &budgets() {
+    static const Json::Value root = []() {
+        Json::Value value;
+        std::ifstream file(SYSCALL_BUDGETS_FILE);
+        Json::CharReaderBuilder reader_builder;
+        Json::String errors;
+        if (!Json::parseFromStream(reader_builder, file, &value, &errors)) {
+            ADD_FAILURE() << "could not read syscall budgets: " << errors;
+        }
+        return value;
+    }();
+    return root;
+}
+
+void expect(const bool condition, const char *what) {
+    if (!condition) {
+        throw std::runtime_error(what);
+    }
+}
+
+}  // namespace
+
+
+class SyscallBudgetTest : public ::testing::Test {
+protected:
+    fs::path temp_dir;
+    RhsmPaths rhsm_paths;
+    ProductIdPaths productid_paths;
+    libdnf5::NullLogger logger;
+
+    void SetUp() override {
+        if (!syscall_counter::is_available()) {
+            GTEST_SKIP() << "ptrace is not available";
+        }
+        temp_dir = fs::temp_directory_path() / "syscall_budget_test";
+        fs::remove_all(temp_dir);
+
+        // A registered system with valid entitlement certificates
+        rhsm_paths = RhsmPaths().with_installroot(temp_dir);
+        fs::create_directories(rhsm_paths.consumer_cert_dir);
+        std::ofstream(rhsm_paths.consumer_cert_dir / "cert.pem") << "consumer";
+        std::ofstream(rhsm_paths.consumer_cert_dir / "key.pem") << "key";
+        fs::create_directories(rhsm_paths.entitlement_cert_dir);
+        for (int i = 0; i < CERTIFICATES; ++i) {
+            fs::copy_file(fs::path(TEST_DATA_DIR) / "valid.pem", rhsm_paths.entitlement_cert_dir / (std::to_string(i) + ".pem"));
+            std::ofstream(rhsm_paths.entitlement_cert_dir / (std::to_string(i) + "-key.pem")) << "key";
+        }
+        fs::create_directories(rhsm_paths.releasever_file.parent_path());
+        std::ofstream(rhsm_paths.releasever_file) << "10.0\n";
+
+        // Products in the productdb; half of them have their certificate installed
+        productid_paths = ProductIdPaths().with_installroot(temp_dir.string());
+        fs::create_directories(productid_paths.product_cert_dir);
+        fs::create_directories(productid_paths.productdb_dir());
+        Json::Value productdb(Json::objectValue);
+        for (int i = 0; i < CERTIFICATES; ++i) {
+            const auto product_id = std::to_string(100000 + i);
+            productdb[product_id].append("repo-" + product_id);
+            if (i % 2 == 0) {
+                fs::copy_file(fs::path(TEST_DATA_DIR) / "product-479.pem",
+                              productid_paths.product_cert_dir + product_id + ".pem");
+            }
+        }
+        std::ofstream(productid_paths.productdb_file) << Json::writeString(Json::StreamWriterBuilder(), productdb);
+    }
+
+    void TearDown() override {
+        if (!temp_dir.empty()) {
+            fs::remove_all(temp_dir);
+        }
+    }
+
+    /// Count the system calls of the function and compare them with the budget of the operation
+    void check_budget(const std::string &operation, const std::function<void()> &function) {
+        SCOPED_TRACE(operation);
+        function();
+        const auto counts = syscall_counter::count_syscalls(function);
+        ASSERT_TRUE(counts.has_value()) << "the operation failed in the traced process";
+
+        auto groups = syscall_counter::group_counts(*counts);
+        groups.erase("memory");
+        std::size_t total = 0;
+        for (const auto &[group, count] : groups) {
+            total += count;
+            RecordProperty(operation + "." + group, std::to_string(count));
+        }
+        RecordProperty(operation + ".total", std::to_string(total));
+
+        const auto &budget = budgets()[operation];
+        ASSERT_TRUE(budget.isObject()) << "no budget of " << operation;
+        for (const auto &[group, count] : groups) {
+            EXPECT_LE(count, budget.get(group, 0).asUInt64()) << operation << " exceeds the budget of " << group;
+        }
+        EXPECT_LE(total, budget.get("total", 0).asUInt64()) << operation << " exceeds the total budget";
+    }
+
+    [[nodiscard]] ProductIdEngine make_engine() {
+        return {default_filesystem(), productid_paths, logger};
+    }
+};
+
+
+TEST_F(SyscallBudgetTest, InContainer) {
+    check_budget("in_container", [this]() {
+        expect(!in_container(rhsm_paths.rhsm_host_config_dir, rhsm_paths.entitlement_host_cert_dir), "in container");
+    });
+}
+
+TEST_F(SyscallBudgetTest, HasConsumerCertificate) {
+    check_budget("has_consumer_certificate", [this]() {
+        expect(has_consumer_certificate(rhsm_paths.consumer_cert_dir), "not registered");
+    });
+}
+
+TEST_F(SyscallBudgetTest, HasEntitlementCertificates) {
+    check_budget("has_entitlement_certificates", [this]() {
+        expect(has_entitlement_certificates(rhsm_paths.entitlement_cert_dir), "no entitlements");
+    });
+}
+
+TEST_F(SyscallBudgetTest, GetEntitlementCertPaths) {
+    check_budget("get_entitlement_cert_paths", [this]() {
+        expect(get_entitlement_cert_paths(rhsm_paths.entitlement_cert_dir).size() == CERTIFICATES,
+               "unexpected certificates");
+    });
+}
+
+TEST_F(SyscallBudgetTest, IsCertExpired) {
+    // The certificate is decoded, as by the first check in a dnf run
+    check_budget("is_cert_expired", [this]() {
+        CertCache::get().clear();
+        expect(!is_cert_expired(rhsm_paths.entitlement_cert_dir / "0.pem"), "expired");
+    });
+    // The certificate was decoded earlier in the dnf run, e.g. by the expiry check or for redhat.repo
+    check_budget("is_cert_expired_cached", [this]() {
+        expect(!is_cert_expired(rhsm_paths.entitlement_cert_dir / "0.pem"), "expired");
+    });
+}
+
+TEST_F(SyscallBudgetTest, GetReleasever) {
+    check_budget("get_releasever", [this]() {
+        expect(get_releasever(rhsm_paths.releasever_file) == "10.0", "unexpected releasever");
+    });
+}
+
+TEST_F(SyscallBudgetTest, ReadProductDb) {
+    // The constructor of every ProductRecord looks for the certificate of the product
+    check_budget("read_product_db", [this]() {
+        ProductDb product_db(productid_paths);
+        expect(product_db.read_product_db() && product_db.products.size() == CERTIFICATES, "unexpected productdb");
+    });
+}
+
+TEST_F(SyscallBudgetTest, SetupFilesystem) {
+    check_budget("setup_filesystem", [this]() {
+        expect(make_engine().setup_filesystem(), "setup failed");
+    });
+}
+
+TEST_F(SyscallBudgetTest, UpdateProductIdCache) {
+    // The repos_loaded hook; the metadata is cached by the first run
+    const auto metadata_path = temp_dir / "repodata" / "productid.gz";
+    fs::create_directories(metadata_path.parent_path());
+    fs::copy_file(PRODUCTID_METADATA_FILE, metadata_path);
+    check_budget("update_productid_cache", [this, &metadata_path]() {
+        expect(make_engine().update_productid_cache({{"rhel", metadata_path.string()}}).cache_hits <= 1, "no cache");
+    });
+}
+
+TEST_F(SyscallBudgetTest, ProcessTransaction) {
+    // The post_transaction hook after removing packages; no product certificate becomes inactive
+    std::set<std::string> installed_repos;
+    for (int i = 0; i < CERTIFICATES; ++i) {
+        installed_repos.insert("repo-" + std::to_string(100000 + i));
+    }
+    check_budget("process_transaction", [this, &installed_repos]() {
+        expect(make_engine().process_transaction({}, installed_repos).certificates_removed == 0, "removed");
+    });
+}
+
+
+int main(int argc, char ** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -8,8 +8,11 @@ Source0:        %{name}-%{version}.tar.gz
 
 %bcond_with     clang
 %bcond_with     tests
+%bcond_with     status_service
 
 Requires:       libdnf5
+# The plugins link libcrypto.so.3 of OpenSSL 3
+Requires:       openssl-libs%{?_isa} >= 1:3.0
 %if %{with clang}
 BuildRequires:  clang
 %else
@@ -17,23 +20,34 @@ BuildRequires:  gcc-c++ >= 10.1
 %endif
 BuildRequires:  cmake >= 3.21
 BuildRequires:  pkgconfig(libcrypto)
+BuildRequires:  pkgconfig(zlib)
+%if %{with status_service}
+BuildRequires:  systemd-rpm-macros
+%endif
 
 %description
 Libdnf5 plugin for management of product certificates
 
 %files
 
+%{_libdir}/libdnf5-plugins-rhsm/
+
 %{_libdir}/libdnf5/plugins/productid.*
 %config(noreplace) %{_sysconfdir}/dnf/libdnf5-plugins/productid.conf
 
 %{_libdir}/libdnf5/plugins/rhsm.*
 %config(noreplace) %{_sysconfdir}/dnf/libdnf5-plugins/rhsm.conf
+%if %{with status_service}
+%{_libexecdir}/rhsm-status-service
+%{_unitdir}/rhsm-status.service
+%{_unitdir}/rhsm-status.socket
+%endif
 
 %prep
 %autosetup -p1
 
 %build
-%cmake
+%cmake %{?with_status_service:-DWITH_STATUS_SERVICE=ON}
 %cmake_build
 
 %check
@@ -44,5 +58,16 @@ Libdnf5 plugin for management of product certificates
 %install
 %cmake_install
 
+%if %{with status_service}
+%post
+%systemd_post rhsm-status.socket
+
+%preun
+%systemd_preun rhsm-status.socket rhsm-status.service
+
+%postun
+%systemd_postun_with_restart rhsm-status.service
+%endif
+
 %changelog
 %autochangelog
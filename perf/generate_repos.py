@@ -0,0 +1,174 @@
+#!/usr/bin/python3
+"""
+Generator of local synthetic RPM repositories for measuring performance of the plugins offline.
+
+Every generated repository "perf-<N>" is a file:// repository with createrepo_c metadata and
+productid metadata containing a product certificate signed by a generated test CA, like the
+repositories of the Red Hat CDN. Several repositories can provide the same product. Each repository
+contains dummy noarch RPMs "perf-<N>-pkg-<M>" in versions 1.0 and 2.0, so that the same repositories
+can be used for install, upgrade and remove transactions.
+
+The repositories are described by "perf.repo" in the output directory, which is used as the reposdir
+of dnf (see hook_perf.py). Required tools: rpmbuild, createrepo_c, modifyrepo_c and openssl.
+"""
+
+import argparse
+import os
+import shutil
+import subprocess
+import tempfile
+
+# The Red Hat OID plus ".1" which is the product namespace
+REDHAT_PRODUCT_OID = "1.3.6.1.4.1.2312.9.1."
+
+FIRST_PRODUCT_ID = 900000
+PACKAGE_VERSIONS = ("1.0", "2.0")
+
+
+def repo_id(repo_index):
+    return f"perf-{repo_index}"
+
+
+def package_name(repo_index, package_index):
+    return f"perf-{repo_index}-pkg-{package_index}"
+
+
+def product_id(repo_index, products):
+    """
+    Return the product provided by the repository; the repositories are assigned
+    to the products round-robin.
+    """
+    return str(FIRST_PRODUCT_ID + repo_index % products)
+
+
+def run(cmd, cwd=None):
+    """
+    Run the command and raise an exception with its output when it fails.
+    """
+    proc = subprocess.run(cmd, cwd=cwd, stdout=subprocess.PIPE, stderr=subprocess.STDOUT,
+                          universal_newlines=True)
+    if proc.returncode != 0:
+        raise RuntimeError(f'Running command "{" ".join(cmd)}" failed: {proc.returncode}\n{proc.stdout}')
+
+
+def generate_ca(output_dir):
+    """
+    Generate the key and the self-signed certificate of the test CA signing product certificates.
+    :param output_dir: directory where ca.key and ca.pem are written
+    :return: tuple with paths of the certificate and the key
+    """
+    ca_cert = os.path.join(output_dir, "ca.pem")
+    ca_key = os.path.join(output_dir, "ca.key")
+    run(["openssl", "req", "-x509", "-newkey", "ec", "-pkeyopt", "ec_paramgen_curve:P-256", "-nodes",
+         "-keyout", ca_key, "-out", ca_cert, "-subj", "/CN=Performance Test Product CA", "-days", "3650"])
+    return ca_cert, ca_key
+
+
+def generate_product_cert(ca, work_dir, prod_id):
+    """
+    Generate a product certificate with the Red Hat product extensions, signed by the test CA.
+    :param ca: tuple with paths of the certificate and the key of the CA
+    :param work_dir: directory for temporary files
+    :param prod_id: the product ID
+    :return: path of the product certificate
+    """
+    ext_file = os.path.join(work_dir, f"{prod_id}.cnf")
+    with open(ext_file, "w") as f:
+        f.write(f"{REDHAT_PRODUCT_OID}{prod_id}.1 = ASN1:UTF8String:Performance Test Product {prod_id}\n")
+        f.write(f"{REDHAT_PRODUCT_OID}{prod_id}.2 = ASN1:UTF8String:1.0\n")
+        f.write(f"{REDHAT_PRODUCT_OID}{prod_id}.3 = ASN1:UTF8String:noarch\n")
+        f.write(f"{REDHAT_PRODUCT_OID}{prod_id}.4 = ASN1:UTF8String:perf-{prod_id}\n")
+    key = os.path.join(work_dir, f"{prod_id}.key")
+    csr = os.path.join(work_dir, f"{prod_id}.csr")
+    cert = os.path.join(work_dir, f"{prod_id}.pem")
+    run(["openssl", "req", "-new", "-newkey", "ec", "-pkeyopt", "ec_paramgen_curve:P-256", "-nodes",
+         "-keyout", key, "-out", csr, "-subj", f"/CN={prod_id}"])
+    run(["openssl", "x509", "-req", "-in", csr, "-CA", ca[0], "-CAkey", ca[1], "-set_serial", prod_id,
+         "-days", "3650", "-extfile", ext_file, "-out", cert])
+    return cert
+
+
+def write_spec(path, repo_index, packages):
+    """
+    Write the spec file of the dummy packages of one repository. The packages are subpackages
+    of one source package, so that one run of rpmbuild builds all of them.
+    """
+    with open(path, "w") as f:
+        f.write(f"Name: perf-{repo_index}\n"
+                "Version: %{perf_version}\n"
+                "Release: 1\n"
+                "Summary: Dummy packages for performance tests\n"
+                "License: MIT\n"
+                "BuildArch: noarch\n"
+                "AutoReqProv: no\n\n"
+                "%description\n"
+                "Dummy packages for performance tests of libdnf5 plugins.\n\n")
+        for package_index in range(packages):
+            name = package_name(repo_index, package_index)
+            f.write(f"%package -n {name}\n"
+                    f"Summary: Dummy package {name}\n\n"
+                    f"%description -n {name}\n"
+                    f"Dummy package {name}.\n\n"
+                    f"%files -n {name}\n\n")
+
+
+def generate_repo(output_dir, work_dir, repo_index, packages, product_cert):
+    """
+    Generate one repository with dummy RPMs in all PACKAGE_VERSIONS and productid metadata.
+    :return: path of the repository
+    """
+    repo_dir = os.path.join(output_dir, repo_id(repo_index))
+    spec = os.path.join(work_dir, f"{repo_id(repo_index)}.spec")
+    write_spec(spec, repo_index, packages)
+    for version in PACKAGE_VERSIONS:
+        run(["rpmbuild", "-bb", "--quiet", "--define", f"_topdir {work_dir}/rpmbuild",
+             "--define", f"_rpmdir {repo_dir}", "--define", "_build_name_fmt %%{NAME}-%%{VERSION}.rpm",
+             "--define", f"perf_version {version}", spec])
+    run(["createrepo_c", "--quiet", "--no-database", repo_dir])
+    # Like the CDN, the productid metadata is the product certificate (compressed by modifyrepo_c)
+    productid = os.path.join(work_dir, "productid")
+    shutil.copyfile(product_cert, productid)
+    run(["modifyrepo_c", "--quiet", "--mdtype=productid", productid, os.path.join(repo_dir, "repodata")])
+    return repo_dir
+
+
+def generate_repos(output_dir, repos, products, packages):
+    """
+    Generate repositories and the repo file describing them.
+    :param output_dir: directory for the repositories; it is replaced
+    :param repos: number of repositories
+    :param products: number of distinct products provided by the repositories
+    :param packages: number of packages in each repository
+    :return: None
+    """
+    shutil.rmtree(output_dir, ignore_errors=True)
+    os.makedirs(output_dir)
+    output_dir = os.path.abspath(output_dir)
+    with tempfile.TemporaryDirectory(prefix="perf-repos-") as work_dir:
+        ca = generate_ca(output_dir)
+        product_certs = {}
+        with open(os.path.join(output_dir, "perf.repo"), "w") as repo_file:
+            for repo_index in range(repos):
+                prod_id = product_id(repo_index, products)
+                if prod_id not in product_certs:
+                    product_certs[prod_id] = generate_product_cert(ca, work_dir, prod_id)
+                repo_dir = generate_repo(output_dir, work_dir, repo_index, packages, product_certs[prod_id])
+                repo_file.write(f"[{repo_id(repo_index)}]\n"
+                                f"name=Performance test repository {repo_index} (product {prod_id})\n"
+                                f"baseurl=file://{repo_dir}\n"
+                                "enabled=1\n"
+                                "gpgcheck=0\n\n")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Generate local repositories with productid metadata")
+    parser.add_argument("output_dir", help="directory for the repositories; it is replaced")
+    parser.add_argument("--repos", type=int, default=10, help="number of repositories")
+    parser.add_argument("--products", type=int, default=10, help="number of distinct products")
+    parser.add_argument("--packages", type=int, default=10, help="number of packages in each repository")
+    args = parser.parse_args()
+    generate_repos(args.output_dir, args.repos, args.products, args.packages)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,153 @@
+#!/usr/bin/python3
+"""
+End-to-end performance driver of the libdnf5 plugins. It generates local repositories for each
+scenario (see generate_repos.py) and runs real dnf5 install, upgrade and remove transactions against
+them in an empty installroot. The plugins record their hooks in Chrome traces (RHSM_DNF5_PLUGINS_TRACE_DIR),
+and the driver reports the duration of dnf and of every hook of every plugin per transaction, as the
+median of all runs.
+
+The plugins have to be installed on the host (e.g. from "make rpm"); they are loaded by dnf5 even
+with --installroot. The driver has to be run as root, because the productid plugin updates its cache
+and the product certificates only when it runs as root.
+"""
+
+import argparse
+import json
+import os
+import shutil
+import statistics
+import subprocess
+import sys
+import tempfile
+import time
+
+from generate_repos import PACKAGE_VERSIONS, generate_repos, package_name
+
+TRACE_DIR_ENV = "RHSM_DNF5_PLUGINS_TRACE_DIR"
+
+# Number of repositories, distinct products and packages in each repository
+SCENARIOS = {
+    "many-repos": {"repos": 200, "products": 10, "packages": 2},
+    "many-products": {"repos": 200, "products": 200, "packages": 2},
+    "large-transaction": {"repos": 4, "products": 4, "packages": 2000},
+}
+
+TRANSACTIONS = ("install", "upgrade", "remove")
+
+
+def dnf_command(repos_dir, installroot, transaction, scenario):
+    """
+    Return the dnf5 command of the transaction. Packages in the first version are installed,
+    upgraded to the second version and removed.
+    """
+    cmd = ["dnf5", "-y", "-q", f"--installroot={installroot}", "--releasever=10", "--use-host-config",
+           f"--setopt=reposdir={repos_dir}", f"--setopt=cachedir={installroot}/var/cache/libdnf5",
+           "--setopt=install_weak_deps=False"]
+    if transaction == "install":
+        return cmd + ["install"] + [
+            f"{package_name(repo_index, package_index)}-{PACKAGE_VERSIONS[0]}"
+            for repo_index in range(scenario["repos"])
+            for package_index in range(scenario["packages"])]
+    if transaction == "upgrade":
+        return cmd + ["upgrade"]
+    return cmd + ["remove", "perf-*"]
+
+
+def read_hook_durations(trace_dir):
+    """
+    Return durations of the hooks in milliseconds recorded in the traces of one dnf run,
+    indexed by "<plugin>.<hook>". The traces are named <plugin>-<pid>.json.
+    """
+    durations = {}
+    for name in os.listdir(trace_dir):
+        plugin = name.rsplit("-", 1)[0]
+        with open(os.path.join(trace_dir, name)) as f:
+            trace = json.load(f)
+        for event in trace["traceEvents"]:
+            if event.get("ph") == "X" and event.get("cat") == "hook":
+                key = f"{plugin}.{event['name']}"
+                durations[key] = durations.get(key, 0.0) + event["dur"] / 1000.0
+    return durations
+
+
+def run_transaction(repos_dir, installroot, transaction, scenario):
+    """
+    Run one transaction and return the durations in milliseconds: "dnf" is the wall time
+    of the whole dnf process, the rest are the hooks.
+    """
+    with tempfile.TemporaryDirectory(prefix="perf-trace-") as trace_dir:
+        env = dict(os.environ, **{TRACE_DIR_ENV: trace_dir})
+        cmd = dnf_command(repos_dir, installroot, transaction, scenario)
+        start = time.monotonic()
+        proc = subprocess.run(cmd, env=env, stdout=subprocess.PIPE, stderr=subprocess.STDOUT,
+                              universal_newlines=True)
+        elapsed = (time.monotonic() - start) * 1000.0
+        if proc.returncode != 0:
+            raise RuntimeError(f'dnf {transaction} failed: {proc.returncode}\n{proc.stdout}')
+        durations = read_hook_durations(trace_dir)
+    durations["dnf"] = elapsed
+    return durations
+
+
+def run_scenario(name, scenario, work_dir, runs, regenerate):
+    """
+    Run all transactions of the scenario in fresh installroots and return the median
+    durations indexed by transaction and by "dnf" or "<plugin>.<hook>".
+    """
+    repos_dir = os.path.join(work_dir, name)
+    if regenerate or not os.path.exists(os.path.join(repos_dir, "perf.repo")):
+        print(f"Generating repositories of {name}: {scenario}", file=sys.stderr)
+        generate_repos(repos_dir, scenario["repos"], scenario["products"], scenario["packages"])
+
+    samples = {transaction: {} for transaction in TRANSACTIONS}
+    for run in range(runs):
+        installroot = os.path.join(work_dir, f"installroot-{name}")
+        shutil.rmtree(installroot, ignore_errors=True)
+        os.makedirs(installroot)
+        for transaction in TRANSACTIONS:
+            print(f"{name}: run {run + 1}/{runs}: {transaction}", file=sys.stderr)
+            for key, value in run_transaction(repos_dir, installroot, transaction, scenario).items():
+                samples[transaction].setdefault(key, []).append(value)
+        shutil.rmtree(installroot, ignore_errors=True)
+
+    return {transaction: {key: statistics.median(values) for key, values in sorted(durations.items())}
+            for transaction, durations in samples.items()}
+
+
+def print_report(results):
+    """
+    Print the table of median durations of dnf and of the hooks of all scenarios.
+    """
+    print(f"{'scenario':<20} {'transaction':<12} {'duration':<40} {'ms':>10}")
+    for name, transactions in results.items():
+        for transaction, durations in transactions.items():
+            for key, value in durations.items():
+                print(f"{name:<20} {transaction:<12} {key:<40} {value:>10.1f}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Measure hooks of the plugins in dnf5 transactions")
+    parser.add_argument("--scenario", action="append", choices=sorted(SCENARIOS),
+                        help="scenario to run (can be repeated); all scenarios are run by default")
+    parser.add_argument("--work-dir", default="/var/tmp/rhsm-dnf5-perf",
+                        help="directory of generated repositories and installroots")
+    parser.add_argument("--runs", type=int, default=3, help="number of runs of each scenario")
+    parser.add_argument("--regenerate", action="store_true", help="regenerate existing repositories")
+    parser.add_argument("--json", help="write the results to this JSON file")
+    args = parser.parse_args()
+
+    if os.geteuid() != 0:
+        parser.error("the driver has to be run as root")
+
+    results = {}
+    for name in args.scenario or sorted(SCENARIOS):
+        results[name] = run_scenario(name, SCENARIOS[name], args.work_dir, args.runs, args.regenerate)
+
+    print_report(results)
+    if args.json:
+        with open(args.json, "w") as f:
+            json.dump({"scenarios": SCENARIOS, "runs": args.runs, "results": results}, f, indent=2)
+
+
+if __name__ == "__main__":
+    main()
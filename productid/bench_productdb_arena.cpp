@@ -0,0 +1,182 @@
+#include <benchmark/benchmark.h>
+
+#include <cstddef>
+#include <cstdlib>
+#include <fstream>
+#include <malloc.h>
+#include <memory_resource>
+#include <new>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "productdb.hpp"
+
+/// Compare the default heap allocation of productdb records with the monotonic arena used
+/// by the post_transaction hook. The productdb contains up to 50k products, each assigned
+/// to three repositories with realistic (long) repository IDs. Every iteration reads the file,
+/// removes one repository from every hundredth product and writes the file back.
+///
+/// The global operator new is replaced to count heap allocations, including allocations done
+/// inside jsoncpp. The peak RSS of one run of the workload is measured in a forked child process,
+/// which returns the freed memory to the system and resets its peak RSS (Linux only).
+
+namespace {
+
+std::size_t allocation_count = 0;
+
+std::string generate_productdb(const int64_t count) {
+    std::string content = "{";
+    for (int64_t i = 0; i < count; ++i) {
+        const auto product_id = std::to_string(100000 + i);
+        if (i > 0) {
+            content += ",";
+        }
+        content += "\"" + product_id + "\": [";
+        content += "\"rhel-10-for-x86_64-baseos-rpms-" + product_id + "\", ";
+        content += "\"rhel-10-for-x86_64-appstream-rpms-" + product_id + "\", ";
+        content += "\"rhel-10-for-x86_64-supplementary-rpms-" + product_id + "\"]";
+    }
+    content += "}";
+    return content;
+}
+
+void run_productdb_workload(MemoryFileSystem &fs, const ProductIdPaths &paths, const bool use_arena) {
+    const auto workload = [&fs, &paths](std::pmr::memory_resource *memory_resource) {
+        ProductDb product_db(paths, fs, memory_resource);
+        product_db.read_product_db();
+        // Like in a typical transaction, only a few repositories become inactive
+        int64_t index = 0;
+        for (auto &[product_id, product] : product_db.products) {
+            if (index++ % 100 == 0) {
+                product.remove_repo_id("rhel-10-for-x86_64-supplementary-rpms-" + std::string(product_id));
+            }
+        }
+        benchmark::DoNotOptimize(product_db.write_product_db());
+    };
+    if (use_arena) {
+        std::pmr::monotonic_buffer_resource arena(PRODUCTDB_ARENA_INITIAL_SIZE);
+        workload(&arena);
+    } else {
+        workload(std::pmr::get_default_resource());
+    }
+}
+
+/// Return the value of the given field (VmRSS, VmHWM) of /proc/self/status in KiB
+long proc_status_kib(const std::string &field) {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.starts_with(field + ":")) {
+            return std::stol(line.substr(field.size() + 1));
+        }
+    }
+    return -1;
+}
+
+/// Run the workload once in a child process and return the increase of its peak RSS in KiB
+double measure_peak_rss_kib(MemoryFileSystem &fs, const ProductIdPaths &paths, const bool use_arena) {
+    int pipe_fds[2];
+    if (pipe(pipe_fds) != 0) {
+        return -1;
+    }
+    const pid_t pid = fork();
+    if (pid == 0) {
+        close(pipe_fds[0]);
+        // Return the memory freed by the benchmark iterations to the system, so that it is not reused,
+        // and reset the peak RSS inherited from the parent process
+        malloc_trim(0);
+        std::ofstream("/proc/self/clear_refs") << "5";
+        const auto rss_before = proc_status_kib("VmRSS");
+        run_productdb_workload(fs, paths, use_arena);
+        const long rss_increase = proc_status_kib("VmHWM") - rss_before;
+        const auto written = write(pipe_fds[1], &rss_increase, sizeof(rss_increase));
+        _exit(written == sizeof(rss_increase) ? 0 : 1);
+    }
+    close(pipe_fds[1]);
+    long rss_increase = -1;
+    if (pid < 0 || read(pipe_fds[0], &rss_increase, sizeof(rss_increase)) != sizeof(rss_increase)) {
+        rss_increase = -1;
+    }
+    close(pipe_fds[0]);
+    if (pid > 0) {
+        waitpid(pid, nullptr, 0);
+    }
+    return static_cast<double>(rss_increase);
+}
+
+void run_benchmark(benchmark::State &state, const bool use_arena) {
+    MemoryFileSystem fs;
+    ProductIdPaths paths;
+    fs.create_directories(paths.productdb_dir(), true);
+    const auto productdb = generate_productdb(state.range(0));
+
+    std::size_t allocations = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        fs.write_file(paths.productdb_file, productdb);
+        const auto allocations_before = allocation_count;
+        state.ResumeTiming();
+
+        run_productdb_workload(fs, paths, use_arena);
+
+        state.PauseTiming();
+        allocations += allocation_count - allocations_before;
+        state.ResumeTiming();
+    }
+    fs.write_file(paths.productdb_file, productdb);
+    state.counters["allocations"] = static_cast<double>(allocations) / static_cast<double>(state.iterations());
+    state.counters["peak_rss_kib"] = measure_peak_rss_kib(fs, paths, use_arena);
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+void BM_ProductDbHeap(benchmark::State &state) {
+    run_benchmark(state, false);
+}
+BENCHMARK(BM_ProductDbHeap)->Arg(1000)->Arg(10000)->Arg(50000)->Unit(benchmark::kMillisecond);
+
+void BM_ProductDbArena(benchmark::State &state) {
+    run_benchmark(state, true);
+}
+BENCHMARK(BM_ProductDbArena)->Arg(1000)->Arg(10000)->Arg(50000)->Unit(benchmark::kMillisecond);
+
+void *counted_allocate(const std::size_t size, const std::size_t alignment) {
+    void *ptr = alignment <= alignof(std::max_align_t)
+        ? std::malloc(size == 0 ? 1 : size)
+        : std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+    if (ptr == nullptr) {
+        throw std::bad_alloc();
+    }
+    ++allocation_count;
+    return ptr;
+}
+
+}  // namespace
+
+// std::pmr::new_delete_resource() uses the aligned forms of the operators
+void *operator new(const std::size_t size) {
+    return counted_allocate(size, alignof(std::max_align_t));
+}
+
+void *operator new(const std::size_t size, const std::align_val_t alignment) {
+    return counted_allocate(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void *ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, [[maybe_unused]] const std::size_t size) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, [[maybe_unused]] const std::align_val_t alignment) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, [[maybe_unused]] const std::size_t size,
+                     [[maybe_unused]] const std::align_val_t alignment) noexcept {
+    std::free(ptr);
+}
+
+BENCHMARK_MAIN();
@@ -0,0 +1,96 @@
+#include <benchmark/benchmark.h>
+
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <sstream>
+#include <string>
+#include <libdnf5/logger/null_logger.hpp>
+
+#include "productid_engine.hpp"
+
+/// The complete post_transaction logic with 1k, 10k and 50k installed products. Every product
+/// is assigned to an active repository, so each iteration reads and writes the whole productdb and
+/// lists the directory of product certificates without changing anything. The in-memory filesystem
+/// shows the cost of the logic itself, the real filesystem (tmpfs when available) adds the I/O.
+/// Run it from the build directory of the plugin, where the test data are copied.
+
+namespace {
+
+constexpr const char * PRODUCTID_METADATA =
+    "./test_data/beea371342cde7daf5b1da602a14ef545b0962c58e75f541ed31177bab5d867a-productid.gz";
+
+std::string read_test_certificate() {
+    std::ifstream file("./test_data/38091.pem");
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    return buffer.str();
+}
+
+/// Install products to the filesystem and return the set of active repositories
+std::set<std::string> install_products(FileSystem &fs, const ProductIdPaths &paths, const int64_t count) {
+    const auto cert_content = read_test_certificate();
+    fs.create_directories(paths.productdb_dir(), true);
+    fs.create_directories(paths.product_cert_dir, false);
+
+    std::set<std::string> installed_repos{"rhel-baseos"};
+    ProductDb product_db(paths, fs);
+    for (int64_t i = 0; i < count; ++i) {
+        const auto product_id = std::to_string(100000 + i);
+        const auto repo_id = "repo-" + product_id;
+        const auto cert_path = paths.product_cert_dir + product_id + ".pem";
+        fs.write_file(cert_path, cert_content);
+        product_db.add_product_id(product_id, cert_path);
+        product_db.get_product(product_id).add_repo_id(repo_id);
+        installed_repos.insert(repo_id);
+    }
+    if (!product_db.write_product_db()) {
+        throw std::runtime_error("Unable to write productdb: " + product_db.path);
+    }
+    return installed_repos;
+}
+
+void BM_ProductIdEngineMemory(benchmark::State &state) {
+    MemoryFileSystem fs;
+    const ProductIdPaths paths;
+    const auto installed_repos = install_products(fs, paths, state.range(0));
+    const std::string productid_path = "/var/cache/libdnf5/rhel-baseos/repodata/productid";
+    fs.create_directories("/var/cache/libdnf5/rhel-baseos/repodata/", false);
+    fs.write_file(productid_path, read_test_certificate());
+
+    libdnf5::NullLogger logger;
+    const ProductIdEngine engine(fs, paths, logger);
+    const std::map<std::string, std::string> transaction_repos{{"rhel-baseos", productid_path}};
+    for (auto _ : state) {
+        engine.process_transaction(transaction_repos, installed_repos);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ProductIdEngineMemory)->Arg(1000)->Arg(10000)->Arg(50000)->Unit(benchmark::kMillisecond);
+
+void BM_ProductIdEnginePosix(benchmark::State &state) {
+    const auto shm = std::filesystem::path("/dev/shm");
+    const auto temp_dir = (std::filesystem::is_directory(shm) ? shm : std::filesystem::temp_directory_path())
+        / "bench_productid_engine";
+    std::filesystem::remove_all(temp_dir);
+
+    auto &fs = default_filesystem();
+    const auto paths = ProductIdPaths().with_installroot(temp_dir.string());
+    const auto installed_repos = install_products(fs, paths, state.range(0));
+
+    libdnf5::NullLogger logger;
+    const ProductIdEngine engine(fs, paths, logger);
+    const std::map<std::string, std::string> transaction_repos{{"rhel-baseos", PRODUCTID_METADATA}};
+    for (auto _ : state) {
+        engine.process_transaction(transaction_repos, installed_repos);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    std::filesystem::remove_all(temp_dir);
+}
+BENCHMARK(BM_ProductIdEnginePosix)->Arg(1000)->Arg(10000)->Arg(50000)->Unit(benchmark::kMillisecond);
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,196 @@
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "bench_fixtures.hpp"
+#include "filesystem.hpp"
+#include "productdb.hpp"
+#include "utils.hpp"
+
+/// Microbenchmarks of the utilities, of the scan of the product certificate directory and of all
+/// operations of the productdb, each with 1 to 100k product certificates or products. The certificates
+/// are generated with OpenSSL, see bench_fixtures.hpp. The productdb is stored in the in-memory filesystem, so the benchmarks show the cost of parsing
+/// and serializing the JSON document and of the records, not of the disk. Every product is assigned
+/// to two repositories and every second product has its certificate installed.
+///
+/// The results can be compared across commits with compare.py of Google Benchmark, see TESTING.md.
+
+namespace {
+
+using bench_fixtures::FIRST_PRODUCT_ID;
+using bench_fixtures::MAX_FIXTURE_SIZE;
+using bench_fixtures::MIN_FIXTURE_SIZE;
+
+/// Product certificates compressed like productid metadata of repositories
+struct CompressedCertificates {
+    explicit CompressedCertificates(const std::int64_t count) : count(count), dir("bench_productid_utils") {
+        const auto certificates = bench_fixtures::generate_product_certificates(count);
+        for (std::size_t i = 0; i < certificates.size(); ++i) {
+            paths.push_back(dir.path / (std::to_string(i) + "-productid.gz"));
+            bench_fixtures::write_compressed_file(paths.back(), certificates[i]);
+        }
+    }
+
+    std::int64_t count;
+    bench_fixtures::TemporaryDirectory dir;
+    std::vector<std::filesystem::path> paths;
+};
+
+/// Product certificates kept in memory, like decompressed productid metadata
+struct ProductCertificates {
+    explicit ProductCertificates(const std::int64_t count)
+        : count(count), certificates(bench_fixtures::generate_product_certificates(count)) {}
+
+    std::int64_t count;
+    std::vector<std::string> certificates;
+};
+
+/// The directory of installed product certificates
+struct ProductCertDirectory {
+    explicit ProductCertDirectory(const std::int64_t count) : count(count), dir("bench_productid_certs") {
+        const auto certificates = bench_fixtures::generate_product_certificates(count);
+        for (std::int64_t i = 0; i < count; ++i) {
+            bench_fixtures::write_file(dir.path / (std::to_string(FIRST_PRODUCT_ID + i) + ".pem"),
+                                       certificates[static_cast<std::size_t>(i)]);
+        }
+    }
+
+    std::int64_t count;
+    bench_fixtures::TemporaryDirectory dir;
+};
+
+/// The productdb file with count products and the productdb read from it
+struct ProductDbFixture {
+    explicit ProductDbFixture(const std::int64_t count) : count(count) {
+        fs.create_directories(paths.productdb_dir(), true);
+        fs.create_directories(paths.product_cert_dir, false);
+        ProductDb product_db(paths, fs);
+        for (std::int64_t i = 0; i < count; ++i) {
+            const auto product_id = std::to_string(FIRST_PRODUCT_ID + i);
+            const auto cert_path = paths.product_cert_dir + product_id + ".pem";
+            fs.write_file(cert_path, "");
+            product_db.add_product_id(product_id, cert_path);
+            auto &product = product_db.get_product(product_id);
+            product.add_repo_id("rhel-10-for-x86_64-baseos-rpms-" + product_id);
+            product.add_repo_id("rhel-10-for-x86_64-appstream-rpms-" + product_id);
+            product_ids.push_back(product_id);
+        }
+        if (!product_db.write_product_db()) {
+            throw std::runtime_error("could not write productdb: " + product_db.path);
+        }
+        // Every second product is not installed anymore; it is kept in the productdb read below
+        for (std::int64_t i = 1; i < count; i += 2) {
+            fs.remove(paths.product_cert_dir + product_ids[static_cast<std::size_t>(i)] + ".pem");
+        }
+        product_db_read.read_product_db();
+    }
+
+    std::int64_t count;
+    MemoryFileSystem fs;
+    ProductIdPaths paths;
+    std::vector<std::string> product_ids;
+    ProductDb product_db_read{paths, fs};
+};
+
+void set_items_processed(benchmark::State &state) {
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+void BM_DecompressProductIdCert(benchmark::State &state) {
+    const auto &fixture = bench_fixtures::current_fixture<CompressedCertificates>(state.range(0));
+    for (auto _ : state) {
+        for (const auto &path : fixture.paths) {
+            auto content = decompress_productid_cert(path);
+            benchmark::DoNotOptimize(content);
+        }
+    }
+    set_items_processed(state);
+}
+
+void BM_GetProductIdFromCertContent(benchmark::State &state) {
+    const auto &fixture = bench_fixtures::current_fixture<ProductCertificates>(state.range(0));
+    // OpenSSL is loaded by the first call
+    benchmark::DoNotOptimize(get_product_id_from_cert_content(fixture.certificates.front()));
+    for (auto _ : state) {
+        for (const auto &certificate : fixture.certificates) {
+            auto product_id = get_product_id_from_cert_content(certificate);
+            benchmark::DoNotOptimize(product_id);
+        }
+    }
+    set_items_processed(state);
+}
+
+/// The scan of the product certificate directory done by the post_transaction hook
+void BM_ListProductCertDirectory(benchmark::State &state) {
+    const auto &fixture = bench_fixtures::current_fixture<ProductCertDirectory>(state.range(0));
+    PosixFileSystem fs;
+    for (auto _ : state) {
+        auto names = fs.list_directory(fixture.dir.path.string());
+        benchmark::DoNotOptimize(names);
+    }
+    set_items_processed(state);
+}
+
+void BM_ReadProductDb(benchmark::State &state) {
+    auto &fixture = bench_fixtures::current_fixture<ProductDbFixture>(state.range(0));
+    for (auto _ : state) {
+        ProductDb product_db(fixture.paths, fixture.fs);
+        benchmark::DoNotOptimize(product_db.read_product_db());
+    }
+    set_items_processed(state);
+}
+
+void BM_WriteProductDb(benchmark::State &state) {
+    const auto &fixture = bench_fixtures::current_fixture<ProductDbFixture>(state.range(0));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(fixture.product_db_read.write_product_db());
+    }
+    set_items_processed(state);
+}
+
+void BM_ProductDbToJson(benchmark::State &state) {
+    const auto &fixture = bench_fixtures::current_fixture<ProductDbFixture>(state.range(0));
+    for (auto _ : state) {
+        auto root = fixture.product_db_read.to_json();
+        benchmark::DoNotOptimize(root);
+    }
+    set_items_processed(state);
+}
+
+/// Look up every product and one of its repositories, and a product that is not in the productdb
+void BM_ProductDbLookups(benchmark::State &state) {
+    auto &fixture = bench_fixtures::current_fixture<ProductDbFixture>(state.range(0));
+    auto &product_db = fixture.product_db_read;
+    for (auto _ : state) {
+        for (const auto &product_id : fixture.product_ids) {
+            benchmark::DoNotOptimize(product_db.has_product_id(product_id));
+            benchmark::DoNotOptimize(
+                product_db.get_product(product_id).has_repo_id("rhel-10-for-x86_64-appstream-rpms-" + product_id));
+        }
+        benchmark::DoNotOptimize(product_db.has_product_id("1"));
+    }
+    set_items_processed(state);
+}
+
+BENCHMARK(BM_DecompressProductIdCert)->RangeMultiplier(10)->Range(MIN_FIXTURE_SIZE, MAX_FIXTURE_SIZE)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_GetProductIdFromCertContent)->RangeMultiplier(10)->Range(MIN_FIXTURE_SIZE, MAX_FIXTURE_SIZE)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_ListProductCertDirectory)->RangeMultiplier(10)->Range(MIN_FIXTURE_SIZE, MAX_FIXTURE_SIZE)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_ReadProductDb)->RangeMultiplier(10)->Range(MIN_FIXTURE_SIZE, MAX_FIXTURE_SIZE)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_WriteProductDb)->RangeMultiplier(10)->Range(MIN_FIXTURE_SIZE, MAX_FIXTURE_SIZE)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_ProductDbToJson)->RangeMultiplier(10)->Range(MIN_FIXTURE_SIZE, MAX_FIXTURE_SIZE)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_ProductDbLookups)->RangeMultiplier(10)->Range(MIN_FIXTURE_SIZE, MAX_FIXTURE_SIZE)
+    ->Unit(benchmark::kMicrosecond);
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,122 @@
+#include <benchmark/benchmark.h>
+
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <ranges>
+#include <string>
+#include <vector>
+#include <libdnf5/base/base.hpp>
+#include <libdnf5/repo/repo.hpp>
+#include <libdnf5/rpm/package.hpp>
+#include <libdnf5/rpm/package_query.hpp>
+
+#include "utils.hpp"
+
+/// Transaction similar to a major-release upgrade: 20k packages spread over a few dozen repositories,
+/// with every fifth package being the outbound (removed) part of an upgrade. The packages are real
+/// libdnf5::rpm::Package objects from repositories loaded into a libdnf5::Base (from generated libsolv
+/// testcases), so the cost of get_repo() and get_repo_id() for every package is included. Only the
+/// construction of the libdnf5::base::TransactionPackage objects by goal resolution is left out, it
+/// is the same for both implementations.
+
+namespace {
+
+constexpr std::size_t TRANSACTION_PACKAGES = 20000;
+constexpr std::size_t TRANSACTION_REPOS = 32;
+
+struct BenchTransactionPackage {
+    bool outbound;
+    libdnf5::rpm::Package package;
+};
+
+class SyntheticTransaction {
+public:
+    SyntheticTransaction() {
+        std::filesystem::remove_all(temp_dir);
+        std::filesystem::create_directories(temp_dir);
+
+        base = std::make_unique<libdnf5::Base>();
+        base->get_config().get_installroot_option().set(temp_dir.string());
+        base->setup();
+        auto repo_sack = base->get_repo_sack();
+        const auto packages_per_repo = TRANSACTION_PACKAGES / TRANSACTION_REPOS + 1;
+        for (std::size_t i = 0; i < TRANSACTION_REPOS; ++i) {
+            const auto repo_id = "rhel-10-for-x86_64-synthetic-repository-" + std::to_string(i) + "-rpms";
+            const auto testcase_path = temp_dir / (repo_id + ".repo");
+            {
+                std::ofstream testcase(testcase_path);
+                testcase << "=Ver: 3.0\n";
+                for (std::size_t j = 0; j < packages_per_repo; ++j) {
+                    testcase << "=Pkg: synthetic-" << i << "-" << j << " 1.0 1 noarch\n";
+                }
+            }
+            repo_sack->create_repo_from_libsolv_testcase(repo_id, testcase_path.string());
+        }
+        // Packages of every repository, in the order of the repositories
+        std::map<std::string, std::vector<libdnf5::rpm::Package>> repo_packages;
+        for (const auto &package : libdnf5::rpm::PackageQuery(*base)) {
+            repo_packages[package.get_repo_id()].push_back(package);
+        }
+        std::vector<std::vector<libdnf5::rpm::Package> *> repos;
+        for (auto &packages_of_repo : repo_packages | std::views::values) {
+            repos.push_back(&packages_of_repo);
+        }
+
+        std::vector<std::size_t> next_package(repos.size(), 0);
+        packages.reserve(TRANSACTION_PACKAGES);
+        for (std::size_t i = 0; i < TRANSACTION_PACKAGES; ++i) {
+            // Packages are grouped by repository in runs of varying length, like in a real transaction
+            const auto repo = (i / 7 + i % 3) % repos.size();
+            packages.push_back({i % 5 == 0, repos[repo]->at(next_package[repo]++ % repos[repo]->size())});
+        }
+    }
+
+    ~SyntheticTransaction() { std::filesystem::remove_all(temp_dir); }
+
+    const std::filesystem::path temp_dir = std::filesystem::temp_directory_path() / "bench_transaction_repos";
+    std::unique_ptr<libdnf5::Base> base;
+    std::vector<BenchTransactionPackage> packages;
+};
+
+const SyntheticTransaction & synthetic_transaction() {
+    static const SyntheticTransaction transaction;
+    return transaction;
+}
+
+/// The original implementation: one string copy and one map lookup per package
+void BM_TransactionReposPerPackageString(benchmark::State &state) {
+    const auto &transaction = synthetic_transaction();
+    for (auto _ : state) {
+        std::map<std::string, libdnf5::repo::Repo *> active_repos;
+        for (const auto &pkg : transaction.packages) {
+            if (pkg.outbound) {
+                continue;
+            }
+            auto repo = pkg.package.get_repo();
+            auto repo_id = repo->get_id();
+            active_repos.try_emplace(repo_id, repo.get());
+        }
+        benchmark::DoNotOptimize(active_repos);
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(TRANSACTION_PACKAGES));
+}
+BENCHMARK(BM_TransactionReposPerPackageString);
+
+void BM_TransactionReposDeduplicated(benchmark::State &state) {
+    const auto &transaction = synthetic_transaction();
+    for (auto _ : state) {
+        auto active_repos = collect_transaction_repos(
+            transaction.packages,
+            [](const BenchTransactionPackage &pkg) { return !pkg.outbound; },
+            [](const BenchTransactionPackage &pkg) { return pkg.package.get_repo().get(); });
+        benchmark::DoNotOptimize(active_repos);
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(TRANSACTION_PACKAGES));
+}
+BENCHMARK(BM_TransactionReposDeduplicated);
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,185 @@
+#include "filesystem.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <libdnf5/utils/fs/file.hpp>
+#include <libdnf5/utils/fs/temp.hpp>
+
+#include "utils.hpp"
+
+namespace {
+
+/// Return the directory of the path without the trailing slash
+std::string parent_directory(const std::string &path) {
+    auto parent = std::filesystem::path(path).parent_path().string();
+    if (parent.size() > 1 && parent.ends_with('/')) {
+        parent.pop_back();
+    }
+    return parent.empty() ? "." : parent;
+}
+
+/// Return the directory path without the trailing slash
+std::string directory_key(std::string path) {
+    while (path.size() > 1 && path.ends_with('/')) {
+        path.pop_back();
+    }
+    return path;
+}
+
+}  // namespace
+
+bool PosixFileSystem::exists(const std::string &path) const {
+    return std::filesystem::exists(path);
+}
+
+std::optional<FileStatus> PosixFileSystem::stat(const std::string &path) const {
+    struct stat st{};
+    if (::stat(path.c_str(), &st) != 0) {
+        return std::nullopt;
+    }
+    return FileStatus{
+        .size = st.st_size,
+        .mtime_ns = static_cast<std::int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec,
+    };
+}
+
+std::vector<std::string> PosixFileSystem::list_directory(const std::string &path) const {
+    std::vector<std::string> names;
+    for (const auto &entry: std::filesystem::directory_iterator(path)) {
+        names.push_back(entry.path().filename().string());
+    }
+    return names;
+}
+
+std::optional<std::string> PosixFileSystem::read_file(const std::string &path) const {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        return std::nullopt;
+    }
+    return std::string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+}
+
+std::string PosixFileSystem::read_compressed_file(const std::string &path) const {
+    return decompress_productid_cert(path);
+}
+
+void PosixFileSystem::write_file(const std::string &path, const std::string_view content) {
+    auto file = libdnf5::utils::fs::File(path, "w", false);
+    file.write(content);
+}
+
+void PosixFileSystem::write_file_atomically(const std::string &path, const std::string_view content,
+                                            const std::string &temp_prefix) {
+    // Create the temporary file in the same directory as a target file to be able to atomically
+    // rename it to the target file. If the path contains only a filename, then the temporary
+    // file is created in the current working directory. The temporary file is automatically
+    // deleted when the TempFile object goes out of scope.
+    std::filesystem::path temp_dir = std::filesystem::path(path).parent_path();
+    if (temp_dir.empty()) {
+        temp_dir = std::filesystem::current_path();
+    }
+    libdnf5::utils::fs::TempFile temp_file(temp_dir, temp_prefix);
+    const std::string temp_path = temp_file.get_path();
+
+    std::ofstream file(temp_path);
+    if (!file.is_open()) {
+        throw std::runtime_error("Unable to open temporary file: " + temp_path);
+    }
+    file << content;
+    file.close();
+    if (file.fail()) {
+        throw std::runtime_error("Unable to write temporary file: " + temp_path);
+    }
+
+    std::filesystem::rename(temp_path, path);
+}
+
+void PosixFileSystem::remove(const std::string &path) {
+    std::filesystem::remove(path);
+}
+
+void PosixFileSystem::create_directories(const std::string &path, const bool private_dir) {
+    std::filesystem::create_directories(path);
+    if (private_dir) {
+        std::filesystem::permissions(
+            path,
+            std::filesystem::perms::others_all,
+            std::filesystem::perm_options::remove);
+    }
+}
+
+bool MemoryFileSystem::exists(const std::string &path) const {
+    return files.contains(path) || directories.contains(directory_key(path));
+}
+
+std::optional<FileStatus> MemoryFileSystem::stat(const std::string &path) const {
+    const auto it = files.find(path);
+    if (it == files.end()) {
+        return std::nullopt;
+    }
+    return FileStatus{.size = static_cast<std::int64_t>(it->second.content.size()), .mtime_ns = it->second.mtime_ns};
+}
+
+std::vector<std::string> MemoryFileSystem::list_directory(const std::string &path) const {
+    const auto dir = directory_key(path);
+    if (!directories.contains(dir)) {
+        throw std::runtime_error("Unable to open directory: " + path);
+    }
+    const auto prefix = dir == "/" ? dir : dir + "/";
+    std::vector<std::string> names;
+    for (auto it = files.lower_bound(prefix); it != files.end() && it->first.starts_with(prefix); ++it) {
+        const auto name = it->first.substr(prefix.size());
+        if (name.find('/') == std::string::npos) {
+            names.push_back(name);
+        }
+    }
+    return names;
+}
+
+std::optional<std::string> MemoryFileSystem::read_file(const std::string &path) const {
+    const auto it = files.find(path);
+    if (it == files.end()) {
+        return std::nullopt;
+    }
+    return it->second.content;
+}
+
+std::string MemoryFileSystem::read_compressed_file(const std::string &path) const {
+    auto content = read_file(path);
+    if (!content) {
+        throw std::runtime_error("cannot open file: " + path);
+    }
+    return std::move(*content);
+}
+
+void MemoryFileSystem::write_file(const std::string &path, const std::string_view content) {
+    if (!directories.contains(parent_directory(path))) {
+        throw std::runtime_error("Unable to create file: " + path);
+    }
+    files[path] = MemoryFile{.content = std::string(content), .mtime_ns = ++clock};
+}
+
+void MemoryFileSystem::write_file_atomically(const std::string &path, const std::string_view content,
+                                             [[maybe_unused]] const std::string &temp_prefix) {
+    write_file(path, content);
+}
+
+void MemoryFileSystem::remove(const std::string &path) {
+    files.erase(path);
+}
+
+void MemoryFileSystem::create_directories(const std::string &path, [[maybe_unused]] const bool private_dir) {
+    add_parent_directories(directory_key(path) + "/");
+}
+
+void MemoryFileSystem::add_parent_directories(const std::string &path) {
+    for (auto dir = parent_directory(path); directories.insert(dir).second; dir = parent_directory(dir)) {
+    }
+}
+
+FileSystem & default_filesystem() {
+    static PosixFileSystem filesystem;
+    return filesystem;
+}
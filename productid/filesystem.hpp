@@ -0,0 +1,103 @@
+#ifndef RHSM_DNF5_PLUGINS_FILESYSTEM_HPP
+#define RHSM_DNF5_PLUGINS_FILESYSTEM_HPP
+
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// Size and modification time of a file
+struct FileStatus {
+    std::int64_t size = 0;
+    std::int64_t mtime_ns = 0;
+};
+
+/// The narrow interface of all filesystem operations used by the business logic of the productid
+/// plugin. The real filesystem is accessed through PosixFileSystem. MemoryFileSystem keeps
+/// everything in memory, and it is used by unit tests, stress tests and benchmarks, which should
+/// not depend on disk performance. All methods that modify the filesystem throw std::runtime_error
+/// (or std::filesystem::filesystem_error) on failure.
+class FileSystem {
+public:
+    virtual ~FileSystem() = default;
+
+    [[nodiscard]] virtual bool exists(const std::string &path) const = 0;
+
+    /// Return the status of the file or std::nullopt when the file does not exist
+    [[nodiscard]] virtual std::optional<FileStatus> stat(const std::string &path) const = 0;
+
+    /// Return names of files (not full paths) in the directory
+    [[nodiscard]] virtual std::vector<std::string> list_directory(const std::string &path) const = 0;
+
+    /// Return the content of the file or std::nullopt when the file cannot be opened
+    [[nodiscard]] virtual std::optional<std::string> read_file(const std::string &path) const = 0;
+
+    /// Return the decompressed content of the file (productid metadata is compressed)
+    [[nodiscard]] virtual std::string read_compressed_file(const std::string &path) const = 0;
+
+    virtual void write_file(const std::string &path, std::string_view content) = 0;
+
+    /// Write the file to a temporary file named temp_prefix.XXXXXX in the same directory and
+    /// atomically rename it to the target path
+    virtual void write_file_atomically(const std::string &path, std::string_view content,
+                                       const std::string &temp_prefix) = 0;
+
+    virtual void remove(const std::string &path) = 0;
+
+    /// Create the directory including parent directories. When private_dir is true, then
+    /// the directory is not accessible by other users.
+    virtual void create_directories(const std::string &path, bool private_dir) = 0;
+};
+
+/// The filesystem of the system using std::filesystem, POSIX and libdnf5 utilities
+class PosixFileSystem final : public FileSystem {
+public:
+    [[nodiscard]] bool exists(const std::string &path) const override;
+    [[nodiscard]] std::optional<FileStatus> stat(const std::string &path) const override;
+    [[nodiscard]] std::vector<std::string> list_directory(const std::string &path) const override;
+    [[nodiscard]] std::optional<std::string> read_file(const std::string &path) const override;
+    [[nodiscard]] std::string read_compressed_file(const std::string &path) const override;
+    void write_file(const std::string &path, std::string_view content) override;
+    void write_file_atomically(const std::string &path, std::string_view content,
+                               const std::string &temp_prefix) override;
+    void remove(const std::string &path) override;
+    void create_directories(const std::string &path, bool private_dir) override;
+};
+
+/// The filesystem kept in memory. Paths are not normalized, and a file can be written only
+/// to an existing directory. Compressed files are stored already decompressed.
+/// The modification time is a counter increased by every write, so every change
+/// of a file is visible in its status.
+class MemoryFileSystem final : public FileSystem {
+public:
+    [[nodiscard]] bool exists(const std::string &path) const override;
+    [[nodiscard]] std::optional<FileStatus> stat(const std::string &path) const override;
+    [[nodiscard]] std::vector<std::string> list_directory(const std::string &path) const override;
+    [[nodiscard]] std::optional<std::string> read_file(const std::string &path) const override;
+    [[nodiscard]] std::string read_compressed_file(const std::string &path) const override;
+    void write_file(const std::string &path, std::string_view content) override;
+    void write_file_atomically(const std::string &path, std::string_view content,
+                               const std::string &temp_prefix) override;
+    void remove(const std::string &path) override;
+    void create_directories(const std::string &path, bool private_dir) override;
+
+private:
+    struct MemoryFile {
+        std::string content;
+        std::int64_t mtime_ns = 0;
+    };
+
+    void add_parent_directories(const std::string &path);
+
+    std::map<std::string, MemoryFile> files;
+    std::set<std::string> directories{"/", "."};
+    std::int64_t clock = 0;
+};
+
+/// Return the filesystem of the system shared by all users of this interface
+FileSystem & default_filesystem();
+
+#endif //RHSM_DNF5_PLUGINS_FILESYSTEM_HPP
@@ -6,23 +6,27 @@
 
 #include "productdb.hpp"
 
-#include <fstream>
 #include <filesystem>
-#include <iostream>
 #include <ranges>
-#include <libdnf5/utils/fs/temp.hpp>
+#include <stdexcept>
 
 /// We do not read the product db file in constructors. It is necessary
 /// to read the file explicitly using read_product_db() to be able to
 /// get an error when it is not possible to read the file.
 ProductDb::ProductDb() {
     path = DEFAULT_PRODUCTDB_FILE;
-    products = std::map<std::string, ProductRecord>();
 }
 
 ProductDb::ProductDb(const std::string &path) {
     this->path = path;
-    products = std::map<std::string, ProductRecord>();
+}
+
+ProductDb::ProductDb(const ProductIdPaths &paths, FileSystem &fs, std::pmr::memory_resource *memory_resource)
+    : products(memory_resource) {
+    this->fs = &fs;
+    this->path = paths.productdb_file;
+    this->product_cert_dir = paths.product_cert_dir;
+    this->default_product_cert_dir = paths.default_product_cert_dir;
 }
 
 ProductDb::~ProductDb() {
@@ -48,28 +52,24 @@ bool ProductDb::read_product_db() {
     }
 
     Json::Value root;
-    std::ifstream file(path);
+    auto file_content = fs->read_file(path);
 
-    if (!file.is_open()) {
+    if (!file_content) {
         throw std::runtime_error("Unable to open productdb file: " + path);
     }
-    
-    std::string file_content(
-        (std::istreambuf_iterator<char>(file)),
-        std::istreambuf_iterator<char>()
-        );
 
     Json::CharReaderBuilder reader_builder;
     std::unique_ptr<Json::CharReader> reader(reader_builder.newCharReader());
     Json::String errors;
-    if (!reader->parse(file_content.c_str(),
-                       file_content.c_str() + file_content.length(),
+    if (!reader->parse(file_content->c_str(),
+                       file_content->c_str() + file_content->length(),
                        &root,
                        &errors)) {
-        file.close();
         throw std::runtime_error("Unable to parse productdb file: '" +  path + "': " + errors);
     }
-    file.close();
+    // The content of the file and the parsed JSON document are released as soon as possible,
+    // so that they do not exist together with all records, when the productdb is large
+    file_content.reset();
     products.clear();
 
     if (!root.isObject()) {
@@ -77,7 +77,9 @@ bool ProductDb::read_product_db() {
     }
 
     for (const auto &product_id: root.getMemberNames()) {
-        products[product_id] = ProductRecord(product_id);
+        auto &product = products.try_emplace(
+            ProductMap::key_type(product_id, products.get_allocator()),
+            product_id, product_cert_dir, default_product_cert_dir, *fs).first->second;
 
         const Json::Value &repos = root[product_id];
         if (!repos.isArray()) {
@@ -90,9 +92,12 @@ bool ProductDb::read_product_db() {
                 products.clear();
                 throw std::runtime_error("The productdb file: '" + path + "' has invalid format (value of array is not string)");
             }
-            auto repo_id = repo.asString();
-            products[product_id].add_repo_id(repo_id);
+            const char *begin = nullptr;
+            const char *end = nullptr;
+            repo.getString(&begin, &end);
+            product.add_repo_id(std::string_view(begin, static_cast<std::size_t>(end - begin)));
         }
+        root.removeMember(product_id);
     }
 
     return true;
@@ -108,9 +113,9 @@ Json::Value ProductDb::to_json() const {
             if (product.is_installed) {
                 Json::Value repo_array(Json::arrayValue);
                 for (const auto &repo: product.repos | std::views::values) {
-                    repo_array.append(repo.repo_id);
+                    repo_array.append(Json::Value(repo.repo_id.data(), repo.repo_id.data() + repo.repo_id.size()));
                 }
-                root[product.product_id] = repo_array;
+                root[product.product_id.c_str()] = repo_array;
             }
         }
     }
@@ -126,67 +131,88 @@ bool ProductDb::write_product_db() const {
 
     auto root = to_json();
 
-    // Create the temporary file in the same directory as a target file to be
-    // able to atomically rename it to the target file at the end of this function.
-    // The temporary file is automatically deleted when the TempFile object goes out of scope
-    std::filesystem::path target_path(path);
-    std::filesystem::path temp_dir = target_path.parent_path();
-    // If the path contains only a filename, then the target file path is empty
-    // In this case, the temporary file will be created in the current working directory
-    if (temp_dir.empty()) {
-        temp_dir = std::filesystem::current_path();
-    }
-    // Try to create a temporary file. The following code can raise an exception
-    libdnf5::utils::fs::TempFile temp_file(temp_dir,"productid");
-    std::string temp_path = temp_file.get_path();
-
-    std::ofstream file(temp_path);
-    if (!file.is_open()) {
-        return false;
-    }
-
     auto stream_writer_builder = Json::StreamWriterBuilder();
     stream_writer_builder["commentStyle"] = "None";
     stream_writer_builder["indentation"] = "   ";
     stream_writer_builder["prettyPrinting"] = true;
-    std::unique_ptr<Json::StreamWriter> stream_writer(stream_writer_builder.newStreamWriter());
-    stream_writer->write(root, &file);
-
-    file.close();
 
-    // Atomically rename the temporary file to the target file (productid.json)
+    // The file is written to a temporary file and atomically renamed to the target file (productid.json).
     // This method can raise an exception, and such an exception has to be caught by calling code
-    std::filesystem::rename(temp_path, path);
+    fs->write_file_atomically(path, Json::writeString(stream_writer_builder, root), "productid");
 
     return true;
 }
 
 /// Try to add product_id in the products
-bool ProductDb::add_product_id(const std::string &product_id, const std::string &product_cert_path) {
-    return products.insert({product_id, ProductRecord(product_id, product_cert_path)}).second;
+bool ProductDb::add_product_id(const std::string_view product_id, const std::string_view product_cert_path) {
+    return products.try_emplace(
+        ProductMap::key_type(product_id, products.get_allocator()), product_id, product_cert_path, *fs).second;
 }
 
 /// Try to remove product with given product_id from the products (used)
-bool ProductDb::remove_product_id(const std::string& product_id) {
-    return products.erase(product_id) > 0;
+bool ProductDb::remove_product_id(const std::string_view product_id) {
+    const auto it = products.find(product_id);
+    if (it == products.end()) {
+        return false;
+    }
+    products.erase(it);
+    return true;
 }
 
 /// Check if the product_id exists in the repo_map (used)
-bool ProductDb::has_product_id(const std::string& product_id) const {
+bool ProductDb::has_product_id(const std::string_view product_id) const {
     return products.contains(product_id);
 }
 
+ProductRecord &ProductDb::get_product(const std::string_view product_id) {
+    const auto it = products.find(product_id);
+    if (it == products.end()) {
+        throw std::out_of_range("Product '" + std::string(product_id) + "' is not in productdb");
+    }
+    return it->second;
+}
+
 /// Try to add repo_id in the products
-bool ProductRecord::add_repo_id(const std::string &repo_id) {
-    return this->repos.insert({repo_id, RepoRecord(repo_id)}).second;
+bool ProductRecord::add_repo_id(const std::string_view repo_id) {
+    return this->repos.try_emplace(RepoMap::key_type(repo_id, repos.get_allocator()), repo_id).second;
 }
 
 /// Try to remove repo_id from the repo_map[product_id]
-bool ProductRecord::remove_repo_id(const std::string& repo_id) {
-    return this->repos.erase(repo_id) > 0;
+bool ProductRecord::remove_repo_id(const std::string_view repo_id) {
+    const auto it = this->repos.find(repo_id);
+    if (it == this->repos.end()) {
+        return false;
+    }
+    this->repos.erase(it);
+    return true;
 }
 
 /// Check if the repo_id exists in the repo_map[product_id]
-bool ProductRecord::has_repo_id(const std::string &repo_id) const {
+bool ProductRecord::has_repo_id(const std::string_view repo_id) const {
     return this->repos.contains(repo_id);
 }
+
+/// Return the directory containing the productdb file
+std::string ProductIdPaths::productdb_dir() const {
+    return std::filesystem::path(productdb_file).parent_path().string() + "/";
+}
+
+/// Return the copy of paths with the installroot prepended. Directories keep
+/// the trailing slash, because file names are appended to them directly.
+ProductIdPaths ProductIdPaths::with_installroot(const std::string &installroot) const {
+    const auto prefix = [&installroot](const std::string &path, const bool is_dir) {
+        std::filesystem::path result = std::filesystem::path(installroot.empty() ? "/" : installroot);
+        result /= std::filesystem::path(path).relative_path();
+        auto result_str = result.lexically_normal().string();
+        if (is_dir && !result_str.ends_with('/')) {
+            result_str += '/';
+        }
+        return result_str;
+    };
+    ProductIdPaths paths;
+    paths.productdb_file = prefix(productdb_file, false);
+    paths.product_cert_dir = prefix(product_cert_dir, true);
+    paths.default_product_cert_dir = prefix(default_product_cert_dir, true);
+    paths.cache_file = prefix(cache_file, false);
+    return paths;
+}
@@ -7,105 +7,182 @@
 
 #include <fstream>
 #include <string>
+#include <string_view>
 #include <map>
+#include <memory_resource>
 #include <json/json.h>
 #include <utility>
 #include <filesystem>
 
+#include "filesystem.hpp"
+
 #define PRODUCTDB_DIR "/var/lib/rhsm/"
 #define PRODUCT_CERT_DIR "/etc/pki/product/"
 #define DEFAULT_PRODUCT_CERT_DIR "/etc/pki/product-default/"
 #define DEFAULT_PRODUCTDB_FILE "/var/lib/rhsm/productid.json"
+#define DEFAULT_PRODUCTID_CACHE_FILE "/var/cache/rhsm/productid-cache.json"
+
+/// The initial size of the arena used for productdb records during one hook. The arena grows
+/// geometrically. A buffer sized for the whole productdb up front would exist together with
+/// the JSON document being parsed, and it would increase the peak memory usage.
+constexpr std::size_t PRODUCTDB_ARENA_INITIAL_SIZE = 64 * 1024;
+
+/// Files and directories used by the productid plugin. The defaults can be overridden
+/// in productid.conf. All paths have to be resolved relative to the installroot
+/// using with_installroot() before they are used.
+class ProductIdPaths {
+public:
+    /// The product "database" file. Its parent directory is created when it does not exist
+    std::string productdb_file = DEFAULT_PRODUCTDB_FILE;
+
+    /// The directory where downloaded product certificates are installed (with trailing slash)
+    std::string product_cert_dir = PRODUCT_CERT_DIR;
+
+    /// The directory with protected product certificates (with trailing slash)
+    std::string default_product_cert_dir = DEFAULT_PRODUCT_CERT_DIR;
+
+    /// The cache of decompressed productid metadata
+    std::string cache_file = DEFAULT_PRODUCTID_CACHE_FILE;
+
+    [[nodiscard]] std::string productdb_dir() const;
+    [[nodiscard]] ProductIdPaths with_installroot(const std::string &installroot) const;
+};
 
 /// The object representing record about the RPM repository. It contains
 /// little information. It can be extended in the future if needed.
+/// Records are allocator-aware, so that they can be allocated together with
+/// the containers holding them from the memory resource of the ProductDb.
 class RepoRecord {
 public:
-    explicit RepoRecord(const std::string &repo_id) {
-        this->repo_id = repo_id;
-    }
-    std::string repo_id;
+    using allocator_type = std::pmr::polymorphic_allocator<>;
+
+    explicit RepoRecord(std::string_view repo_id, const allocator_type &alloc = {}) : repo_id(repo_id, alloc) {}
+
+    RepoRecord(const RepoRecord &other, const allocator_type &alloc) : repo_id(other.repo_id, alloc) {}
+    RepoRecord(RepoRecord &&other, const allocator_type &alloc) : repo_id(std::move(other.repo_id), alloc) {}
+    RepoRecord(const RepoRecord &other) = default;
+    RepoRecord(RepoRecord &&other) = default;
+    RepoRecord &operator=(const RepoRecord &other) = default;
+    RepoRecord &operator=(RepoRecord &&other) = default;
+
+    std::pmr::string repo_id;
 };
 
 /// The object representing record about product certificate
 class ProductRecord {
 public:
+    using allocator_type = std::pmr::polymorphic_allocator<>;
+    using RepoMap = std::pmr::map<std::pmr::string, RepoRecord, std::less<>>;
 
-    explicit ProductRecord(std::string product_id, std::string product_cert_path) {
-        this->product_id = std::move(product_id);
-        this->repos = std::map<std::string, RepoRecord>();
+    explicit ProductRecord(std::string_view product_id, std::string_view product_cert_path,
+                           const FileSystem &fs = default_filesystem(), const allocator_type &alloc = {})
+        : ProductRecord(alloc) {
+        this->product_id = product_id;
         // Check if a given certificate file exists
-        if (std::filesystem::exists(product_cert_path)) {
-            this->product_cert_path = std::move(product_cert_path);
+        if (fs.exists(std::string(product_cert_path))) {
+            this->product_cert_path = product_cert_path;
             this->is_installed = true;
-        } else {
-            this->product_cert_path = "";
-            this->is_installed = false;
         }
     }
 
-    explicit ProductRecord(std::string product_id) {
-        this->product_id = std::move(product_id);
-        this->repos = std::map<std::string, RepoRecord>();
-        this->product_cert_path = "";
-        this->is_installed = false;
+    explicit ProductRecord(std::string_view product_id, const allocator_type &alloc = {}) :
+        ProductRecord(product_id, PRODUCT_CERT_DIR, DEFAULT_PRODUCT_CERT_DIR, default_filesystem(), alloc) {}
+
+    explicit ProductRecord(std::string_view product_id,
+                           const std::string &product_cert_dir,
+                           const std::string &default_product_cert_dir,
+                           const FileSystem &fs = default_filesystem(),
+                           const allocator_type &alloc = {})
+        : ProductRecord(alloc) {
+        this->product_id = product_id;
         // Check if the product cert with the given product ID exists in
         // directory /etc/pki/product or /etc/pki/product-default
-        const auto _product_cert_path = PRODUCT_CERT_DIR + this->product_id + ".pem";
-        const auto _default_product_cert_path = DEFAULT_PRODUCT_CERT_DIR + this->product_id + ".pem";
-        if (std::filesystem::exists(_product_cert_path)) {
+        const auto _product_cert_path = product_cert_dir + std::string(product_id) + ".pem";
+        const auto _default_product_cert_path = default_product_cert_dir + std::string(product_id) + ".pem";
+        if (fs.exists(_product_cert_path)) {
             this->product_cert_path = _product_cert_path;
             this->is_installed = true;
-        } else if (std::filesystem::exists(_default_product_cert_path)) {
+        } else if (fs.exists(_default_product_cert_path)) {
             this->product_cert_path = _default_product_cert_path;
             this->is_installed = true;
         }
     }
 
-    ProductRecord() {
-        this->product_id = "";
-        this->repos = std::map<std::string, RepoRecord>();
-        this->product_cert_path = "";
-        this->is_installed = false;
-    }
+    ProductRecord() : ProductRecord(allocator_type()) {}
+
+    explicit ProductRecord(const allocator_type &alloc)
+        : product_id(alloc), repos(alloc), product_cert_path(alloc), is_installed(false) {}
+
+    ProductRecord(const ProductRecord &other, const allocator_type &alloc)
+        : product_id(other.product_id, alloc),
+          repos(other.repos, alloc),
+          product_cert_path(other.product_cert_path, alloc),
+          is_installed(other.is_installed) {}
+
+    ProductRecord(ProductRecord &&other, const allocator_type &alloc)
+        : product_id(std::move(other.product_id), alloc),
+          repos(std::move(other.repos), alloc),
+          product_cert_path(std::move(other.product_cert_path), alloc),
+          is_installed(other.is_installed) {}
+
+    ProductRecord(const ProductRecord &other) = default;
+    ProductRecord(ProductRecord &&other) = default;
+    ProductRecord &operator=(const ProductRecord &other) = default;
+    ProductRecord &operator=(ProductRecord &&other) = default;
 
     /// The ID of product certificate
-    std::string product_id;
+    std::pmr::string product_id;
 
     //// The list of repositories associated with the product certificate
-    std::map<std::string, RepoRecord> repos;
+    RepoMap repos;
 
     /// Path to the product certificate installed in /etc/pki/product
     /// or /etc/pki/product-default
-    std::string product_cert_path;
+    std::pmr::string product_cert_path;
 
     /// Is the product cert already installed in /etc/pki/product-default
     /// or in /etc/pki/product?
     bool is_installed;
 
-    bool add_repo_id(const std::string &repo_id);
-    bool remove_repo_id(const std::string &repo_id);
-    [[nodiscard]] bool has_repo_id(const std::string &repo_id) const;
+    bool add_repo_id(std::string_view repo_id);
+    bool remove_repo_id(std::string_view repo_id);
+    [[nodiscard]] bool has_repo_id(std::string_view repo_id) const;
 };
 
 /// This class is used for managing "database" of product certificates
 /// and related repositories. The "database" is stored in a simple JSON
 /// document in /var/lib/rhsm/productid.json
+///
+/// All records are allocated from the given memory resource. The hooks pass
+/// a monotonic arena living as long as the hook, so the thousands of short-lived
+/// strings and map nodes are released at once. The memory resource has to
+/// outlive the ProductDb.
 class ProductDb {
 public:
+    using ProductMap = std::pmr::map<std::pmr::string, ProductRecord, std::less<>>;
+
     explicit ProductDb();
     explicit ProductDb(const std::string &path);
+    explicit ProductDb(const ProductIdPaths &paths, FileSystem &fs = default_filesystem(),
+                       std::pmr::memory_resource *memory_resource = std::pmr::get_default_resource());
     ~ProductDb();
     std::string path;
-    std::map<std::string, ProductRecord> products;
+    /// The filesystem where the productdb file and product certificates are stored
+    FileSystem *fs = &default_filesystem();
+    /// Directories searched for certificates of products read from the file
+    std::string product_cert_dir = PRODUCT_CERT_DIR;
+    std::string default_product_cert_dir = DEFAULT_PRODUCT_CERT_DIR;
+    ProductMap products;
 
     bool read_product_db();
     [[nodiscard]] bool write_product_db() const;
     [[nodiscard]] Json::Value to_json() const;
 
-    bool add_product_id(const std::string& product_id, const std::string& product_cert_path);
-    bool remove_product_id(const std::string& product_id);
-    [[nodiscard]] bool has_product_id(const std::string& product_id) const;
+    bool add_product_id(std::string_view product_id, std::string_view product_cert_path);
+    bool remove_product_id(std::string_view product_id);
+    [[nodiscard]] bool has_product_id(std::string_view product_id) const;
+    /// Return the product with the given product_id; throws std::out_of_range when it does not exist
+    [[nodiscard]] ProductRecord &get_product(std::string_view product_id);
 };
 
 #endif //RHSM_DNF5_PLUGINS_PRODUCTDB_H
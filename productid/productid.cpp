@@ -4,12 +4,15 @@
 #include <libdnf5/utils/fs/temp.hpp>
 #include <libdnf5/rpm/package_query.hpp>
 
-#include <filesystem>
 #include <iostream>
 #include <ranges>
 #include <chrono>
+#include <cstdint>
+#include <unistd.h>
 
+#include "plugin_metrics.hpp"
 #include "productdb.hpp"
+#include "productid_engine.hpp"
 #include "utils.hpp"
 
 /// This libdnf5 plugin is triggered during dnf transaction, and it tries to download "productid" metadata
@@ -42,7 +45,11 @@ public:
     /// Implement a custom constructor for the new plugin.
     /// This is not necessary when you only need the Base object for your implementation.
     /// Optional to override.
-    ProductIdPlugin(plugin::IPluginData & data, ConfigParser & config) : IPlugin(data), config(config) {}
+    ProductIdPlugin(plugin::IPluginData & data, ConfigParser & config) : IPlugin(data), config(config) {
+        if (config.has_option("main", "log_level") && !log_level_from_string(config.get_value("main", "log_level"))) {
+            logger.warning("Invalid value of log_level: \"{}\"", config.get_value("main", "log_level"));
+        }
+    }
 
     /// Fill in the API version of your plugin.
     /// This is used to check if the provided plugin API version is compatible with the library's plugin API version.
@@ -73,301 +80,236 @@ public:
         return nullptr;
     }
 
+    void post_base_setup() override {
+        post_base_setup_hook();
+    }
+
     void repos_configured() override {
         repos_configured_hook();
     }
 
+    void repos_loaded() override {
+        repos_loaded_hook();
+    }
+
     void post_transaction(const base::Transaction & transaction) override {
         post_transaction_hook(transaction);
     };
 
-    ConfigParser & config;
-
-private:
-    static bool is_number(const std::string &str) {
-        return !str.empty() && std::ranges::all_of(str, [](const unsigned char ch) {
-            return std::isdigit(ch) != 0;
-        });
+    void finish() noexcept override {
+        write_trace();
+        write_metrics();
     }
 
-    void process_all_installed_product_certificates(
-        ProductDb & product_db) const;
+    ConfigParser & config;
 
-    // Own logging
-    template <typename... Ss>
-    void debug_log(std::string_view format, Ss &&... args) const;
+private:
+    [[nodiscard]] std::string get_config_value(const std::string & key, const std::string & default_value) const;
 
-    template <typename... Ss>
-    void info_log(std::string_view format, Ss &&... args) const;
+    [[nodiscard]] ProductIdLogger::Level get_log_level() const;
 
-    template <typename... Ss>
-    void warning_log(std::string_view format, Ss &&... args) const;
+    // Hooks
+    void post_base_setup_hook();
 
-    template <typename... Ss>
-    void error_log(std::string_view format, Ss &&... args) const;
+    void repos_configured_hook() const;
 
-    void process_installed_product_certificates(
-        const std::string & dir_filepath,
-        ProductDb & product_db) const;
+    void repos_loaded_hook() const;
 
-    // Hooks
-    void repos_configured_hook() const;
+    void post_transaction_hook(const base::Transaction &) const;
 
-    void remove_inactive_repositories_from_product_db(ProductDb & product_db,
-        const std::set<std::string> & active_repos) const;
+    [[nodiscard]] std::map<std::string, std::string> get_transaction_repos(const base::Transaction &transaction) const;
 
-    void remove_inactive_product_certificates(ProductDb & product_db) const;
+    [[nodiscard]] std::set<std::string> get_active_repos() const;
 
-    bool install_product_certificate(ProductDb & product_db,
-        const std::string & cert_content,
-        std::string product_id) const;
+    [[nodiscard]] ProductIdEngine make_engine() const;
 
-    void post_transaction_hook(const base::Transaction &) const;
+    void write_trace() const noexcept;
 
-    [[nodiscard]] std::map<std::string, libdnf5::repo::Repo *> get_transaction_repos(const base::Transaction &transaction) const;
+    void write_metrics() noexcept;
 
-    [[nodiscard]] std::set<std::string> get_active_repos() const;
+    void export_stats(const ProductIdStats & stats) const;
 
-    [[nodiscard]] bool setup_filesystem() const ;
-};
+    // Own logging, written up to the level of get_log_level()
+    ProductIdLogger logger{*get_base().get_logger(), get_log_level()};
 
-template <typename... Ss>
-void ProductIdPlugin::debug_log(const std::string_view format, Ss &&... args) const {
-    Base & base = this->get_base();
-    base.get_logger()->debug("[productid plugin] " + std::string(format), std::forward<Ss>(args)...);
-}
+    /// Spans of the hooks and their phases; disabled unless trace_dir or RHSM_DNF5_PLUGINS_TRACE_DIR is set
+    Tracer tracer{Tracer::get_plugin_trace_path(PLUGIN_NAME, get_config_value("trace_dir", ""))};
 
-template <typename... Ss>
-void ProductIdPlugin::info_log(const std::string_view format, Ss &&... args) const {
-    Base & base = this->get_base();
-    base.get_logger()->info("[productid plugin] " + std::string(format), std::forward<Ss>(args)...);
-}
+    /// Metrics of this run for the node_exporter textfile collector; disabled unless metrics_file is set.
+    /// Collecting the metrics does not change the state of the plugin, so the const hooks may update them.
+    mutable PluginMetrics metrics{PLUGIN_NAME, get_config_value("metrics_file", "")};
 
-template <typename... Ss>
-void ProductIdPlugin::warning_log(const std::string_view format, Ss &&... args) const {
-    Base & base = this->get_base();
-    base.get_logger()->warning("[productid plugin] " + std::string(format), std::forward<Ss>(args)...);
-}
+    /// Paths of productdb and product certificates resolved relative to the installroot
+    ProductIdPaths paths;
 
-template <typename... Ss>
-void ProductIdPlugin::error_log(const std::string_view format, Ss &&... args) const {
-    Base & base = this->get_base();
-    base.get_logger()->error("[productid plugin] " + std::string(format), std::forward<Ss>(args)...);
-}
+    /// Metadata modified after this time (nanoseconds since the epoch) was downloaded by this dnf invocation.
+    /// The timestamps of files come from a coarse clock, so the creation time of the plugin is moved back
+    /// by a second.
+    const std::int64_t created_ns{
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch())
+            .count() -
+        1000000000};
+};
 
-/// Try to process product certificates from a given directory that have not been loaded to the product_db yet during
-/// reading of productid.json. These product certificates could be installed manually, or it is the first time
-/// the productid plugin has been run, and the productid.json was just empty, or it even did not exist.
-void ProductIdPlugin::process_installed_product_certificates(
-    const std::string &dir_filepath,
-    ProductDb & product_db) const {
-    debug_log("Processing certificates from directory {}", dir_filepath);
-    for (const auto &entry: std::filesystem::directory_iterator(dir_filepath)) {
-        auto filename = entry.path().filename();
-        if (filename.extension() != ".pem") {
-            debug_log("The file {} is not a product certificate, skipping", entry.path().string());
-            continue;
-        }
-        auto product_id = filename.stem().string();
-        // Skip certificates that don't have numeric product ID
-        if (!is_number(product_id)) {
-            warning_log(
-                "The product certificate {} does not have numeric product ID, skipping",
-                filename.string());
-            continue;
-        }
-        debug_log("The product certificate '{}' has product ID: {}", entry.path().string(), product_id);
-        if (product_db.has_product_id(product_id)) {
-            debug_log("The product certificate '{}' is already in the database, skipping", filename.string());
-        } else {
-            debug_log("Adding product certificate '{}' to the database", filename.string());
-            product_db.products[product_id] = ProductRecord(product_id, entry.path().string());
-        }
+/// This method tries to return all repositories from the current transaction together with paths
+/// of downloaded productid metadata
+std::map<std::string, std::string> ProductIdPlugin::get_transaction_repos(const base::Transaction &transaction) const {
+    const TraceSpan span(&tracer, "get_transaction_repos");
+    const auto transaction_pkgs = transaction.get_transaction_packages();
+    auto active_repos = collect_transaction_repos(
+        transaction_pkgs,
+        [](const base::TransactionPackage &transaction_pkg) {
+            // When the package is going to be removed or replaced, then related repository ID will
+            // contain "@System" and such a repository also cannot be considered as active, because
+            // the RPM will be removed from the system
+            return !libdnf5::transaction::transaction_item_action_is_outbound(transaction_pkg.get_action());
+        },
+        [](const base::TransactionPackage &transaction_pkg) {
+            return transaction_pkg.get_package().get_repo().get();
+        });
+    std::map<std::string, std::string> productid_paths;
+    for (const auto &[repo_id, repo] : active_repos) {
+        logger.debug("Transaction repository '{}' added to the set of active repositories", repo_id);
+        productid_paths.emplace(repo_id, repo->get_metadata_path(METADATA_TYPE_PRODUCTID));
     }
+    return productid_paths;
 }
 
-/// Tries to get the list of installed productid certificates in the following directories:
-/// * /etc/pki/product-default
-/// * /etc/pki/product
-void ProductIdPlugin::process_all_installed_product_certificates(
-    ProductDb & product_db) const {
-    namespace fs = std::filesystem;
-
-    // Try to get product certificates from /etc/pki/product-default and /etc/pki/product directories
-    for (const auto * const cert_dir_path : { DEFAULT_PRODUCT_CERT_DIR, PRODUCT_CERT_DIR }) {
-        if (fs::exists(cert_dir_path)) {
-            process_installed_product_certificates(
-                cert_dir_path,
-                product_db);
-        } else {
-            debug_log("Directory {} does not exist, skipping", cert_dir_path);
-        }
+/// Try to get the set of active repo IDs. It means the repositories that are currently
+/// enabled and have installed packages.
+std::set<std::string> ProductIdPlugin::get_active_repos() const {
+    const TraceSpan span(&tracer, "get_active_repos");
+    // First, try to get active repositories from installed packages
+    std::set<std::string> active_repos;
+    libdnf5::rpm::PackageQuery installed_packages(get_base());
+    installed_packages.filter_installed();
+    for (const auto &package : installed_packages) {
+        active_repos.insert(package.get_from_repo_id());
     }
+    return active_repos;
 }
 
-/// Try to remove inactive repositories from the product DB
-void ProductIdPlugin::remove_inactive_repositories_from_product_db(ProductDb & product_db,
-    const std::set<std::string> & active_repos) const {
-    // Try to remove inactive repositories from the product DB
-    for ( auto & [product_id, product] : product_db.products ) {
-        // We cannot remove inactive repositories directly, because it could invalidate iterator.
-        std::vector<std::string> to_erase;
-        for (const auto &repo_id: product.repos | std::views::keys) {
-            if (!active_repos.contains(repo_id)) {
-                to_erase.push_back(repo_id);
-            }
-        }
-        for (const auto &repo_id: to_erase) {
-            debug_log("Removing inactive repository '{}' (no installed RPMS) from product '{}' in productdb",
-                repo_id, product_id);
-            product.remove_repo_id(repo_id);
-        }
-    }
+/// Create the engine, which implements the business logic of this plugin on top of the real file system
+ProductIdEngine ProductIdPlugin::make_engine() const {
+    return {default_filesystem(), paths, *get_base().get_logger().get(), get_log_level(), &tracer};
 }
 
-/// Try to remove installed productid certificates when no related repository is active
-void ProductIdPlugin::remove_inactive_product_certificates(ProductDb & product_db) const {
-    std::map<std::string, std::string> to_erase;
-    for ( auto & [product_id, product] : product_db.products ) {
-        if (product.repos.empty()) {
-            auto product_cert_path = product.product_cert_path;
-            if (product_cert_path.starts_with(DEFAULT_PRODUCT_CERT_DIR)) {
-                debug_log("Skipping removal of default product certificate: '{}' (no assigned repositories)",
-                    product_cert_path);
-                continue;
-            }
-            to_erase[product_id] = product.product_cert_path;
-        }
+/// Write the spans recorded in this dnf run, when tracing is enabled
+void ProductIdPlugin::write_trace() const noexcept {
+    if (!tracer.is_enabled()) {
+        return;
     }
-    for (const auto &[product_id, product_cert_path]: to_erase) {
-        debug_log("Removing product '{}', because it has no repositories assigned", product_cert_path);
-        try {
-            std::filesystem::remove(product_cert_path);
-        } catch (const std::filesystem::filesystem_error &e) {
-            warning_log("Failed to remove product certificate from '{}': {}",
-                product_cert_path, e.what());
-            continue;
-        }
-        product_db.remove_product_id(product_id);
-        debug_log("Product '{}' removed from productdb", product_cert_path);
+    try {
+        tracer.write("dnf (productid plugin)");
+        logger.debug("Trace of {} span(s) written to {}", tracer.size(), tracer.get_path());
+    } catch (const std::exception &e) {
+        logger.warning("Failed to write trace: {}", e.what());
     }
 }
 
-/// Try to install product certificate to /etc/pki/product
-bool ProductIdPlugin::install_product_certificate(ProductDb & product_db,
-    const std::string & cert_content,
-    std::string product_id) const {
-    auto product_cert_filepath = PRODUCT_CERT_DIR + product_id + ".pem";
-    debug_log("Installing product certificate '{}' to '{}'",
-              product_id, product_cert_filepath);
+/// Merge the metrics of this dnf run into the metrics file, when the metrics are enabled
+void ProductIdPlugin::write_metrics() noexcept {
+    if (!metrics.is_enabled()) {
+        return;
+    }
     try {
-        auto file = libdnf5::utils::fs::File(product_cert_filepath, "w", false);
-        file.write(cert_content);
+        metrics.write();
+        logger.debug("Metrics written to {}", metrics.get_path());
     } catch (const std::exception &e) {
-        warning_log("Failed to install product certificate to '{}': {}",
-                    product_cert_filepath, e.what());
-        return false;
+        logger.warning("Failed to write metrics: {}", e.what());
     }
-    debug_log("Product certificate '{}' installed successfully", product_cert_filepath);
-
-    debug_log("Adding a new product '{}' to productdb", product_id);
-    product_db.add_product_id(product_id, product_cert_filepath);
-    return true;
 }
 
-/// This method tries to return all repositories from the current transaction
-std::map<std::string, libdnf5::repo::Repo *> ProductIdPlugin::get_transaction_repos(const base::Transaction &transaction) const {
-    // Then try to get another set of repositories from transaction package(s)
-    std::map<std::string, libdnf5::repo::Repo *> active_repos;
-    auto transaction_pkgs = transaction.get_transaction_packages();
-    for (const auto &transaction_pkg : transaction_pkgs) {
-        // When the package is going to be removed or replaced, then related repository ID will
-        // contain "@System" and such a repository also cannot be considered as active, because
-        // the RPM will be removed from the system
-        if (libdnf5::transaction::transaction_item_action_is_outbound(transaction_pkg.get_action())) {
-            continue;
-        }
-        auto pkg = transaction_pkg.get_package();
-        auto repo = pkg.get_repo();
-        auto repo_id = repo->get_id();
-        const auto [it, inserted] = active_repos.try_emplace(repo_id, repo.get());
-        if (inserted) {
-            debug_log("Transaction repository '{}' added to the set of active repositories", repo_id);
-        }
+/// Add the counts of one run of the engine to the metrics
+void ProductIdPlugin::export_stats(const ProductIdStats & stats) const {
+    if (!metrics.is_enabled()) {
+        return;
     }
-    return active_repos;
+    metrics.add_counter(
+        "rhsm_dnf5_productid_repositories_processed_total",
+        "Repositories whose productid metadata was processed",
+        static_cast<double>(stats.repositories));
+    metrics.add_counter(
+        "rhsm_dnf5_productid_cache_lookups_total",
+        "Lookups of product certificates in the productid cache",
+        static_cast<double>(stats.cache_hits),
+        {{"result", "hit"}});
+    metrics.add_counter(
+        "rhsm_dnf5_productid_cache_lookups_total",
+        "Lookups of product certificates in the productid cache",
+        static_cast<double>(stats.cache_misses),
+        {{"result", "miss"}});
 }
 
-/// Try to get the set of active repo IDs. It means the repositories that are currently
-/// enabled and have installed packages.
-std::set<std::string> ProductIdPlugin::get_active_repos() const {
-    // First, try to get active repositories from installed packages
-    std::set<std::string> active_repos;
-    libdnf5::rpm::PackageQuery installed_packages(get_base());
-    installed_packages.filter_installed();
-    for (const auto &package : installed_packages) {
-        active_repos.insert(package.get_from_repo_id());
+/// Return the value of the option from the [main] section of productid.conf or the default value
+std::string ProductIdPlugin::get_config_value(const std::string & key, const std::string & default_value) const {
+    if (config.has_option("main", key)) {
+        return config.get_value("main", key);
     }
-    return active_repos;
+    return default_value;
 }
 
-/// This plugin needs the existence of several directories. Try to create these directories.
-bool ProductIdPlugin::setup_filesystem() const {
-    // Try to create the directory where we store the productdb ("database" of product certificates).
-    // It is critical to have this directory, because productdb is written to this directory.
-    if (std::filesystem::exists(PRODUCTDB_DIR)) {
-        debug_log("Directory for productdb {} already exists", PRODUCTDB_DIR);
-    } else {
-        info_log("Directory {} does not exist, creating it", PRODUCTDB_DIR);
-        try {
-            std::filesystem::create_directories(PRODUCTDB_DIR);
-        } catch (const std::filesystem::filesystem_error &e) {
-            error_log(
-                "Failed to create directory {}: {}; Exiting", PRODUCTDB_DIR, e.what());
-            return false;
-        }
-        // Other users should not be able to read /var/lib/rhsm
-        try {
-            std::filesystem::permissions(
-                PRODUCTDB_DIR,
-                std::filesystem::perms::others_all,
-                std::filesystem::perm_options::remove);
-        } catch (const std::filesystem::filesystem_error &e) {
-            error_log("Failed to set permissions for directory {}: {}", PRODUCTDB_DIR, e.what());
-            return false;
-        }
-        info_log("Directory {} created successfully", PRODUCTDB_DIR);
+/// The level of the messages of the plugin and of the engine: the log_level option, or the level of the dnf
+/// "logfilelevel" when the option is not set or not valid
+ProductIdLogger::Level ProductIdPlugin::get_log_level() const {
+    if (const auto level = log_level_from_string(get_config_value("log_level", ""))) {
+        return *level;
     }
-    // Create directories for product certificates. It is critical to have this directory,
-    // because product certificates are installed to this directory.
-    // Note: It is not necessary to create a directory for default product certificates,
-    // because we never write anything to this directory
-    if (std::filesystem::exists(PRODUCT_CERT_DIR)) {
-        debug_log("Directory for product certificates {} already exists", PRODUCT_CERT_DIR);
-    } else {
-        info_log("Directory {} does not exist, creating it", PRODUCT_CERT_DIR);
-        try {
-            std::filesystem::create_directories(PRODUCT_CERT_DIR);
-        } catch (const std::filesystem::filesystem_error &e) {
-            error_log(
-                "Failed to create directory {}: {}; Exiting", PRODUCT_CERT_DIR, e.what());
-            return false;
-        }
-        info_log("Directory {} created successfully", PRODUCT_CERT_DIR);
-        // Other users should be able to read /etc/pki/product; no need to change permissions
-        // in this case
-    }
-    return true;
+    return log_level_of_logfilelevel(get_base().get_config().get_logfilelevel_option().get_value());
+}
+
+/// The installroot is known after the base setup. All paths used by this plugin are resolved relative
+/// to the installroot, so that dnf running with --installroot never touches files of the host.
+void ProductIdPlugin::post_base_setup_hook() {
+    const TraceSpan span(&tracer, "post_base_setup", "hook");
+    const HookTimer timer(metrics, "post_base_setup");
+    ProductIdPaths configured_paths;
+    configured_paths.productdb_file = get_config_value("productdb_file", DEFAULT_PRODUCTDB_FILE);
+    configured_paths.product_cert_dir = get_config_value("product_cert_dir", PRODUCT_CERT_DIR);
+    configured_paths.default_product_cert_dir = get_config_value("default_product_cert_dir", DEFAULT_PRODUCT_CERT_DIR);
+    configured_paths.cache_file = get_config_value("cache_file", DEFAULT_PRODUCTID_CACHE_FILE);
+
+    const auto & installroot = get_base().get_config().get_installroot_option().get_value();
+    paths = configured_paths.with_installroot(installroot);
+    logger.debug("Using productdb {} and product certificates from {} and {}",
+        paths.productdb_file, paths.product_cert_dir, paths.default_product_cert_dir);
 }
 
 /// This hook method is called before transaction processing starts. We order the dnf to try to
 /// download productid metadata.
 void ProductIdPlugin::repos_configured_hook() const {
     Base & base = get_base();
-    debug_log("Hook repos_configured started");
-    debug_log("Order dnf to download additional metadata type: productid");
+    const TraceSpan span(&tracer, "repos_configured", "hook");
+    const HookTimer timer(metrics, "repos_configured");
+    logger.debug("Hook repos_configured started");
+    logger.debug("Order dnf to download additional metadata type: productid");
     base.get_config().get_optional_metadata_types_option().set(METADATA_TYPE_PRODUCTID);
-    debug_log("Hook repos_configured finished successfully");
+    logger.debug("Hook repos_configured finished successfully");
+}
+
+/// This hook method is called when the metadata of repositories were loaded. When productid metadata
+/// was downloaded by this dnf invocation (e.g. "dnf makecache" from the systemd timer), it is decompressed
+/// and parsed here, and the results are stored in the productid cache. The post_transaction hook then only
+/// checks that the cached records are still fresh. Commands using the metadata from the cache only stat
+/// the productid metadata files.
+void ProductIdPlugin::repos_loaded_hook() const {
+    const TraceSpan span(&tracer, "repos_loaded", "hook");
+    const HookTimer timer(metrics, "repos_loaded");
+    logger.debug("Hook repos_loaded started");
+    if (getuid() != 0) {
+        logger.debug("Not root, productid cache not updated");
+        return;
+    }
+
+    std::map<std::string, std::string> productid_paths;
+    repo::RepoQuery repos(get_base());
+    repos.filter_enabled(true);
+    for (const auto &repo : repos) {
+        productid_paths.emplace(repo->get_id(), repo->get_metadata_path(METADATA_TYPE_PRODUCTID));
+    }
+
+    export_stats(make_engine().update_productid_cache(productid_paths, created_ns));
+    logger.debug("Hook repos_loaded finished successfully");
 }
 
 /// The management of productid certificates is triggered in this hook method after
@@ -386,12 +328,16 @@ void ProductIdPlugin::repos_configured_hook() const {
 void ProductIdPlugin::post_transaction_hook(const base::Transaction & transaction) const {
     Base & base = get_base();
 
-    debug_log("Hook post_transaction started");
+    TraceSpan span(&tracer, "post_transaction", "hook");
+    const HookTimer timer(metrics, "post_transaction");
+    logger.debug("Hook post_transaction started");
     const auto start_time = std::chrono::high_resolution_clock::now();
 
+    const auto engine = make_engine();
+
     // First, try to create all necessary directories
-    if (!setup_filesystem()) {
-        debug_log("Hook post_transaction terminated with error");
+    if (!engine.setup_filesystem()) {
+        logger.debug("Hook post_transaction terminated with error");
         return;
     }
 
@@ -399,137 +345,32 @@ void ProductIdPlugin::post_transaction_hook(const base::Transaction & transactio
     repo::RepoQuery repos(base);
     repos.filter_enabled(true);
 
-    debug_log("Number of enabled repositories: {}", repos.size());
-
-    auto product_db = ProductDb();
-
-    // First, try to read the product db file from /var/lib/rhsm/productid.json.
-    // If it is not possible to read it, because e.g., this file does not exist yet,
-    // then it should not be a problem. The new file will be created at the end
-    // of the transaction.
-    try {
-        if (const auto ret = product_db.read_product_db(); ret) {
-            debug_log("Successfully read existing productdb from {}", product_db.path);
-        }
-    } catch (const std::exception &e) {
-        warning_log("Failed to read productdb: {}", e.what());
-    }
-
-    // Print warning messages when product DB contains products without valid product certificates.
-    // This could happen when the product certificate was manually removed from /etc/pki/product or
-    // /etc/pki/product-default
-    for (const auto &[product_id, product] : product_db.products) {
-        if (!product.is_installed) {
-            warning_log("Product '{}' has record in product DB, but related product certificate does not exist",
-                product_id);
-        }
-    }
-
-    // Check if there are any new installed product certificates and load these
-    // product certs to the product_db too. This could happen when the product certificate was
-    // manually added to /etc/pki/product or /etc/pki/product-default.
-    process_all_installed_product_certificates(product_db);
+    logger.debug("Number of enabled repositories: {}", repos.size());
 
     // Get the dictionary of active repositories from transaction
-    auto transaction_repos = get_transaction_repos(transaction);
-    debug_log("Number of transaction repositories: {}", transaction_repos.size());
-
-    // Go through all active repositories and try to get paths of downloaded productid certificates.
-    // Note: when the transaction is e.g. "remove", then cached metadata is empty, but we will probably
-    //       not need cached metadata during removal of packages.
-    for (const auto &[repo_id, repo]: transaction_repos) {
-        std::string productid_path = repo->get_metadata_path(METADATA_TYPE_PRODUCTID);
-        if (productid_path.empty()) {
-            debug_log(
-                "Repository '{}' does not provide productid metadata; skipping",
-                repo_id);
-            continue;
-        }
-
-        debug_log(
-            "The productid certificates of '{}' repository downloaded to: {}",
-            repo_id,
-            productid_path
-            );
-
-        std::string cert_content;
-        // Try to decompress the downloaded certificate
-        try {
-            cert_content = decompress_productid_cert(productid_path);
-        } catch (const std::exception &e) {
-            warning_log("Failed to decompress productid certificate: {}; skipping", e.what());
-            continue;
-        }
-
-        if (cert_content.empty()) {
-            warning_log("Product certificate '{}' is empty; skipping", productid_path);
-            continue;
-        }
-
-        // Try to get product ID from certificate
-        std::string product_id;
-        try {
-            product_id = get_product_id_from_cert_content(cert_content);
-        } catch (const std::exception &e) {
-            warning_log("Failed to get product ID from certificate '{}': {}; skipping", productid_path, e.what());
-            continue;
-        }
-
-        debug_log("The downloaded product certificate '{}' has product ID: {}", productid_path, product_id);
-
-        // If it is a new product certificate, then try to install it
-        if (!product_db.has_product_id(product_id)) {
-            if (!install_product_certificate(product_db, cert_content, product_id)) continue;
-        } else {
-            debug_log("Product certificate '{}' is already installed in: '{}'",
-                product_id, product_db.products[product_id].product_cert_path);
-        }
-
-        // If the repository hasn't been added yet to the productdb, then assign it to the current product
-        if (!product_db.products[product_id].has_repo_id(repo_id)) {
-            debug_log("Assigning repository '{}' to product '{}' in productdb", repo_id, product_id);
-            product_db.products[product_id].add_repo_id(repo_id);
-        } else {
-            debug_log("Repository '{}' is already assigned to product '{}' in productdb", repo_id, product_id);
-        }
-    }
-
-    // Get the dictionary of active repositories
-    auto active_repos = get_active_repos();
-    /// Extend active repos with active transaction_repos
-    std::ranges::transform(transaction_repos,
-        std::inserter(active_repos, active_repos.end()),
-        [](const auto &pair) { return pair.first; }
-    );
-    debug_log("Number of active repositories: {}", active_repos.size());
-
-    // TODO: Try to protect disabled repositories that have some "active" RPMs. Removing such
-    //       disabled repositories could cause removing of related product certificate despite
-    //       the product is still used (RPMs from this product are still installed).
-
-    // Check if it is necessary to remove any repository from the "database" or eventually
-    // if it is necessary to remove any product certificate.
-    // Note: it is not possible to do the following optimization: Try to remove repository
-    // and product certificate only in cases when there was at least one "remove"
-    // transaction. Why? RPMs could be also removed using "rpm" command, which does not
-    // trigger any libdnf plugin. Thus, we have to check the validity of our "database"
-    // at the end of this hook.
-    remove_inactive_repositories_from_product_db(product_db, active_repos);
-    remove_inactive_product_certificates(product_db);
-
-    debug_log("Writing current productdb to {}", product_db.path);
-    try {
-        if (product_db.write_product_db()) {
-            debug_log("The productdb successfully writen to {}", product_db.path);
-        }
-    } catch (const std::exception &e) {
-        warning_log("Failed to write productdb: {}", e.what());
-    }
+    const auto transaction_repos = get_transaction_repos(transaction);
+    logger.debug("Number of transaction repositories: {}", transaction_repos.size());
+    span.arg("transaction_repos", std::to_string(transaction_repos.size()));
+
+    const auto stats = engine.process_transaction(transaction_repos, get_active_repos());
+    export_stats(stats);
+    metrics.set_gauge(
+        "rhsm_dnf5_productid_products",
+        "Products in the productdb after the last transaction",
+        static_cast<double>(stats.products));
+    metrics.add_counter(
+        "rhsm_dnf5_productid_certificates_installed_total",
+        "Product certificates installed after transactions",
+        static_cast<double>(stats.certificates_installed));
+    metrics.add_counter(
+        "rhsm_dnf5_productid_certificates_removed_total",
+        "Product certificates removed, because no repository of the product was active",
+        static_cast<double>(stats.certificates_removed));
 
     const auto end_time = std::chrono::high_resolution_clock::now();
     const auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
 
-    debug_log("Hook post_transaction finished successfully in {} ms", duration.count());
+    logger.debug("Hook post_transaction finished successfully in {} ms", duration.count());
 }
 
 }  // namespace
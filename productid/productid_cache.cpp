@@ -0,0 +1,137 @@
+#include "productid_cache.hpp"
+
+#include <stdexcept>
+
+/// We do not read the cache file in the constructor. It is necessary to read the file
+/// explicitly using read_cache() to be able to get an error when it is not possible to read it.
+ProductIdCache::ProductIdCache(const std::string &path, FileSystem &fs) {
+    this->path = path;
+    this->fs = &fs;
+}
+
+/// Try to read the JSON document containing the cache. The content of the file could look like this:
+///
+/// {
+///   "/var/cache/libdnf5/baseos-1b2f8b4a9e1c2d3f/repodata/beea...-productid.gz": {
+///     "size": 1830,
+///     "mtime_ns": 1733313542000000000,
+///     "product_id": "479",
+///     "cert_content": "-----BEGIN CERTIFICATE-----\n..."
+///   }
+/// }
+///
+/// Records with invalid format are ignored, because they can always be computed again.
+bool ProductIdCache::read_cache() {
+    if (path.empty()) {
+        throw std::runtime_error("Productid cache file path is empty");
+    }
+
+    const auto file_content = fs->read_file(path);
+    if (!file_content) {
+        throw std::runtime_error("Unable to open productid cache file: " + path);
+    }
+
+    Json::Value root;
+    Json::CharReaderBuilder reader_builder;
+    std::unique_ptr<Json::CharReader> reader(reader_builder.newCharReader());
+    Json::String errors;
+    if (!reader->parse(file_content->c_str(), file_content->c_str() + file_content->length(), &root, &errors)) {
+        throw std::runtime_error("Unable to parse productid cache file: '" + path + "': " + errors);
+    }
+    if (!root.isObject()) {
+        throw std::runtime_error("The productid cache file: '" + path + "' root value is not collection");
+    }
+
+    records.clear();
+    for (const auto &metadata_path: root.getMemberNames()) {
+        const Json::Value &record = root[metadata_path];
+        if (!record.isObject() ||
+            !record["size"].isInt64() || !record["mtime_ns"].isInt64() ||
+            !record["product_id"].isString() || !record["cert_content"].isString()) {
+            continue;
+        }
+        ProductIdCacheRecord cache_record;
+        cache_record.size = record["size"].asInt64();
+        cache_record.mtime_ns = record["mtime_ns"].asInt64();
+        cache_record.product_id = record["product_id"].asString();
+        cache_record.cert_content = record["cert_content"].asString();
+        records[metadata_path] = std::move(cache_record);
+    }
+    dirty = false;
+
+    return true;
+}
+
+/// Convert the cache to JSON format
+Json::Value ProductIdCache::to_json() const {
+    Json::Value root(Json::objectValue);
+    for (const auto &[metadata_path, record]: records) {
+        Json::Value value(Json::objectValue);
+        value["size"] = Json::Int64(record.size);
+        value["mtime_ns"] = Json::Int64(record.mtime_ns);
+        value["product_id"] = record.product_id;
+        value["cert_content"] = record.cert_content;
+        root[metadata_path] = value;
+    }
+    return root;
+}
+
+/// Try to write the cache to JSON file. The file is replaced atomically.
+bool ProductIdCache::write_cache() const {
+    if (path.empty()) {
+        return false;
+    }
+
+    auto stream_writer_builder = Json::StreamWriterBuilder();
+    stream_writer_builder["commentStyle"] = "None";
+    stream_writer_builder["indentation"] = "";
+
+    // This method can raise an exception, and such an exception has to be caught by calling code
+    fs->write_file_atomically(path, Json::writeString(stream_writer_builder, to_json()), "productid-cache");
+
+    return true;
+}
+
+/// Return the cached record of the given metadata file, when the file has not been changed
+/// since the record was stored. Otherwise, return nullptr.
+const ProductIdCacheRecord * ProductIdCache::lookup(const std::string &metadata_path) const {
+    const auto it = records.find(metadata_path);
+    if (it == records.end()) {
+        return nullptr;
+    }
+    const auto status = fs->stat(metadata_path);
+    if (!status || status->size != it->second.size || status->mtime_ns != it->second.mtime_ns) {
+        return nullptr;
+    }
+    return &it->second;
+}
+
+/// Try to store the result of processing the given metadata file to the cache
+bool ProductIdCache::store(const std::string &metadata_path,
+                           const std::string &product_id,
+                           const std::string &cert_content) {
+    const auto status = fs->stat(metadata_path);
+    if (!status) {
+        return false;
+    }
+    ProductIdCacheRecord record;
+    record.size = status->size;
+    record.mtime_ns = status->mtime_ns;
+    record.product_id = product_id;
+    record.cert_content = cert_content;
+    records[metadata_path] = std::move(record);
+    dirty = true;
+    return true;
+}
+
+/// Remove records of metadata files that do not exist anymore (e.g. the metadata was refreshed
+/// and the old file was removed). Return the number of removed records.
+std::size_t ProductIdCache::prune() {
+    const auto removed = std::erase_if(records, [this](const auto &item) {
+        return !fs->exists(item.first);
+    });
+    if (removed > 0) {
+        dirty = true;
+    }
+    return removed;
+}
@@ -0,0 +1,52 @@
+#ifndef RHSM_DNF5_PLUGINS_PRODUCTID_CACHE_HPP
+#define RHSM_DNF5_PLUGINS_PRODUCTID_CACHE_HPP
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <json/json.h>
+
+#include "filesystem.hpp"
+
+/// The result of processing one downloaded productid metadata file. The record is valid
+/// only while the size and the modification time of the metadata file are the same.
+class ProductIdCacheRecord {
+public:
+    std::int64_t size = 0;
+    std::int64_t mtime_ns = 0;
+
+    /// The product ID read from the certificate
+    std::string product_id;
+
+    /// The decompressed content of the product certificate
+    std::string cert_content;
+};
+
+/// This class is used for caching decompressed productid metadata and product IDs read from
+/// them. The cache is filled when repository metadata is downloaded (e.g. by "dnf makecache") and
+/// the post_transaction hook only checks that the cached records are still fresh. The cache
+/// is stored in a JSON document in /var/cache/rhsm/productid-cache.json
+class ProductIdCache {
+public:
+    explicit ProductIdCache(const std::string &path, FileSystem &fs = default_filesystem());
+    std::string path;
+
+    /// The filesystem where the cache file and productid metadata are stored
+    FileSystem *fs;
+
+    /// Records indexed by the path of the productid metadata file
+    std::map<std::string, ProductIdCacheRecord> records;
+
+    /// Has the cache been changed since it was read?
+    bool dirty = false;
+
+    bool read_cache();
+    [[nodiscard]] bool write_cache() const;
+    [[nodiscard]] Json::Value to_json() const;
+
+    [[nodiscard]] const ProductIdCacheRecord * lookup(const std::string &metadata_path) const;
+    bool store(const std::string &metadata_path, const std::string &product_id, const std::string &cert_content);
+    std::size_t prune();
+};
+
+#endif //RHSM_DNF5_PLUGINS_PRODUCTID_CACHE_HPP
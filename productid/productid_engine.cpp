@@ -0,0 +1,433 @@
+#include "productid_engine.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <memory_resource>
+#include <ranges>
+#include <utility>
+
+#include "utils.hpp"
+
+ProductIdEngine::ProductIdEngine(
+    FileSystem & fs, ProductIdPaths paths, libdnf5::Logger & logger, const libdnf5::Logger::Level log_level,
+    const Tracer * tracer)
+    : fs(fs), paths(std::move(paths)), logger(logger, log_level), tracer(tracer) {}
+
+bool ProductIdEngine::is_number(const std::string &str) {
+    return !str.empty() && std::ranges::all_of(str, [](const unsigned char ch) {
+        return std::isdigit(ch) != 0;
+    });
+}
+
+/// Try to process product certificates from a given directory that have not been loaded to the product_db yet during
+/// reading of productid.json. These product certificates could be installed manually, or it is the first time
+/// the productid plugin has been run, and the productid.json was just empty, or it even did not exist.
+void ProductIdEngine::process_installed_product_certificates(
+    const std::string &dir_filepath,
+    ProductDb & product_db) const {
+    TraceSpan span(tracer, "process_installed_product_certificates");
+    span.arg("dir", dir_filepath);
+    logger.debug("Processing certificates from directory {}", dir_filepath);
+    for (const auto &name: fs.list_directory(dir_filepath)) {
+        const auto entry_path = dir_filepath + name;
+        const std::filesystem::path filename(name);
+        if (filename.extension() != ".pem") {
+            logger.debug("The file {} is not a product certificate, skipping", entry_path);
+            continue;
+        }
+        auto product_id = filename.stem().string();
+        // Skip certificates that don't have numeric product ID
+        if (!is_number(product_id)) {
+            logger.warning(
+                "The product certificate {} does not have numeric product ID, skipping",
+                filename);
+            continue;
+        }
+        logger.debug("The product certificate '{}' has product ID: {}", entry_path, product_id);
+        if (product_db.has_product_id(product_id)) {
+            logger.debug("The product certificate '{}' is already in the database, skipping", filename);
+        } else {
+            logger.debug("Adding product certificate '{}' to the database", filename);
+            product_db.add_product_id(product_id, entry_path);
+        }
+    }
+}
+
+/// Tries to get the list of installed productid certificates in the following directories:
+/// * /etc/pki/product-default
+/// * /etc/pki/product
+void ProductIdEngine::process_all_installed_product_certificates(
+    ProductDb & product_db) const {
+    // Try to get product certificates from /etc/pki/product-default and /etc/pki/product directories
+    for (const auto & cert_dir_path : { paths.default_product_cert_dir, paths.product_cert_dir }) {
+        if (fs.exists(cert_dir_path)) {
+            process_installed_product_certificates(
+                cert_dir_path,
+                product_db);
+        } else {
+            logger.debug("Directory {} does not exist, skipping", cert_dir_path);
+        }
+    }
+}
+
+/// Try to remove inactive repositories from the product DB
+void ProductIdEngine::remove_inactive_repositories_from_product_db(ProductDb & product_db,
+    const RepoIdSet & active_repos) const {
+    const TraceSpan span(tracer, "remove_inactive_repositories");
+    // Try to remove inactive repositories from the product DB
+    for ( auto & [product_id, product] : product_db.products ) {
+        // We cannot remove inactive repositories directly, because it could invalidate iterator.
+        std::pmr::vector<std::string_view> to_erase(product_db.products.get_allocator());
+        for (const auto &repo_id: product.repos | std::views::keys) {
+            if (!active_repos.contains(repo_id)) {
+                to_erase.push_back(repo_id);
+            }
+        }
+        for (const auto &repo_id: to_erase) {
+            logger.debug("Removing inactive repository '{}' (no installed RPMS) from product '{}' in productdb",
+                repo_id, product_id);
+            product.remove_repo_id(repo_id);
+        }
+    }
+}
+
+/// Try to remove installed productid certificates when no related repository is active
+std::size_t ProductIdEngine::remove_inactive_product_certificates(ProductDb & product_db) const {
+    const TraceSpan span(tracer, "remove_inactive_product_certificates");
+    std::pmr::map<std::pmr::string, std::pmr::string> to_erase(product_db.products.get_allocator());
+    for ( auto & [product_id, product] : product_db.products ) {
+        if (product.repos.empty()) {
+            const auto &product_cert_path = product.product_cert_path;
+            if (product_cert_path.starts_with(paths.default_product_cert_dir)) {
+                logger.debug("Skipping removal of default product certificate: '{}' (no assigned repositories)",
+                    product_cert_path);
+                continue;
+            }
+            to_erase[product_id] = product.product_cert_path;
+        }
+    }
+    std::size_t removed = 0;
+    for (const auto &[product_id, product_cert_path]: to_erase) {
+        logger.debug("Removing product '{}', because it has no repositories assigned", product_cert_path);
+        try {
+            fs.remove(std::string(product_cert_path));
+        } catch (const std::exception &e) {
+            logger.warning("Failed to remove product certificate from '{}': {}",
+                product_cert_path, e.what());
+            continue;
+        }
+        product_db.remove_product_id(product_id);
+        logger.debug("Product '{}' removed from productdb", product_cert_path);
+        ++removed;
+    }
+    return removed;
+}
+
+/// Try to install product certificate to /etc/pki/product
+bool ProductIdEngine::install_product_certificate(ProductDb & product_db,
+    const std::string & cert_content,
+    const std::string & product_id) const {
+    const TraceSpan span(tracer, "install_product_certificate");
+    auto product_cert_filepath = paths.product_cert_dir + product_id + ".pem";
+    logger.debug("Installing product certificate '{}' to '{}'",
+              product_id, product_cert_filepath);
+    try {
+        fs.write_file(product_cert_filepath, cert_content);
+    } catch (const std::exception &e) {
+        logger.warning("Failed to install product certificate to '{}': {}",
+                    product_cert_filepath, e.what());
+        return false;
+    }
+    logger.debug("Product certificate '{}' installed successfully", product_cert_filepath);
+
+    logger.debug("Adding a new product '{}' to productdb", product_id);
+    product_db.add_product_id(product_id, product_cert_filepath);
+    return true;
+}
+
+/// This plugin needs the existence of several directories. Try to create these directories.
+bool ProductIdEngine::setup_filesystem() const {
+    const TraceSpan span(tracer, "setup_filesystem");
+    // Try to create the directory where we store the productdb ("database" of product certificates).
+    // It is critical to have this directory, because productdb is written to this directory.
+    const auto productdb_dir = paths.productdb_dir();
+    if (fs.exists(productdb_dir)) {
+        logger.debug("Directory for productdb {} already exists", productdb_dir);
+    } else {
+        logger.info("Directory {} does not exist, creating it", productdb_dir);
+        // Other users should not be able to read /var/lib/rhsm
+        try {
+            fs.create_directories(productdb_dir, true);
+        } catch (const std::exception &e) {
+            logger.error(
+                "Failed to create directory {}: {}; Exiting", productdb_dir, e.what());
+            return false;
+        }
+        logger.info("Directory {} created successfully", productdb_dir);
+    }
+    // Create directories for product certificates. It is critical to have this directory,
+    // because product certificates are installed to this directory.
+    // Note: It is not necessary to create a directory for default product certificates,
+    // because we never write anything to this directory
+    if (fs.exists(paths.product_cert_dir)) {
+        logger.debug("Directory for product certificates {} already exists", paths.product_cert_dir);
+    } else {
+        logger.info("Directory {} does not exist, creating it", paths.product_cert_dir);
+        try {
+            fs.create_directories(paths.product_cert_dir, false);
+        } catch (const std::exception &e) {
+            logger.error(
+                "Failed to create directory {}: {}; Exiting", paths.product_cert_dir, e.what());
+            return false;
+        }
+        logger.info("Directory {} created successfully", paths.product_cert_dir);
+        // Other users should be able to read /etc/pki/product; no need to change permissions
+        // in this case
+    }
+    return true;
+}
+
+/// Try to read the cache of productid metadata. A missing or broken cache is not a problem,
+/// because all records can be computed again.
+void ProductIdEngine::read_productid_cache(ProductIdCache & cache) const {
+    const TraceSpan span(tracer, "read_productid_cache");
+    try {
+        if (cache.read_cache()) {
+            logger.debug("Read {} record(s) from productid cache {}", cache.records.size(), cache.path);
+        }
+    } catch (const std::exception &e) {
+        logger.debug("Failed to read productid cache: {}", e.what());
+    }
+}
+
+/// Try to write the cache of productid metadata, when it was changed
+void ProductIdEngine::write_productid_cache(const ProductIdCache & cache) const {
+    if (!cache.dirty) {
+        return;
+    }
+    const TraceSpan span(tracer, "write_productid_cache");
+    try {
+        fs.create_directories(std::filesystem::path(cache.path).parent_path().string(), false);
+        if (cache.write_cache()) {
+            logger.debug("The productid cache successfully written to {}", cache.path);
+        }
+    } catch (const std::exception &e) {
+        logger.warning("Failed to write productid cache: {}", e.what());
+    }
+}
+
+/// Try to get the content of the downloaded productid certificate and the product ID from it. When
+/// the metadata file has not been changed since it was processed, then the result is taken from
+/// the cache, and it is not necessary to decompress the file and parse the certificate again.
+bool ProductIdEngine::get_product_certificate(ProductIdCache & cache,
+    ProductIdStats & stats,
+    const std::string & productid_path,
+    std::string & cert_content,
+    std::string & product_id) const {
+    if (const auto *record = cache.lookup(productid_path); record != nullptr) {
+        logger.debug("Using cached product certificate of '{}'", productid_path);
+        cert_content = record->cert_content;
+        product_id = record->product_id;
+        ++stats.cache_hits;
+        return true;
+    }
+    ++stats.cache_misses;
+
+    // Try to decompress the downloaded certificate
+    try {
+        const TraceSpan span(tracer, "decompress");
+        cert_content = fs.read_compressed_file(productid_path);
+    } catch (const std::exception &e) {
+        logger.warning("Failed to decompress productid certificate: {}; skipping", e.what());
+        return false;
+    }
+
+    if (cert_content.empty()) {
+        logger.warning("Product certificate '{}' is empty; skipping", productid_path);
+        return false;
+    }
+
+    // Try to get product ID from certificate
+    try {
+        const TraceSpan span(tracer, "parse_certificate");
+        product_id = get_product_id_from_cert_content(cert_content);
+    } catch (const std::exception &e) {
+        logger.warning("Failed to get product ID from certificate '{}': {}; skipping", productid_path, e.what());
+        return false;
+    }
+
+    cache.store(productid_path, product_id, cert_content);
+    return true;
+}
+
+/// Decompress and parse productid metadata, which is not cached yet, and remove outdated records
+/// from the cache
+ProductIdStats ProductIdEngine::update_productid_cache(
+    const std::map<std::string, std::string> & productid_paths, const std::int64_t refreshed_since_ns) const {
+    ProductIdStats stats;
+    std::map<std::string, std::string> refreshed_paths;
+    for (const auto &[repo_id, productid_path] : productid_paths) {
+        if (productid_path.empty()) {
+            continue;
+        }
+        if (refreshed_since_ns > 0) {
+            const auto status = fs.stat(productid_path);
+            if (!status || status->mtime_ns < refreshed_since_ns) {
+                continue;
+            }
+        }
+        refreshed_paths.emplace(repo_id, productid_path);
+    }
+    if (refreshed_since_ns > 0 && refreshed_paths.empty()) {
+        logger.debug("No productid metadata was refreshed, productid cache not updated");
+        return stats;
+    }
+
+    ProductIdCache cache(paths.cache_file, fs);
+    read_productid_cache(cache);
+
+    for (const auto &[repo_id, productid_path] : refreshed_paths) {
+        const TraceSpan span(tracer, repo_id, "repo");
+        ++stats.repositories;
+        std::string cert_content;
+        std::string product_id;
+        if (get_product_certificate(cache, stats, productid_path, cert_content, product_id)) {
+            logger.debug("Repository '{}' provides product certificate with product ID: {}", repo_id, product_id);
+        }
+    }
+
+    if (const auto removed = cache.prune(); removed > 0) {
+        logger.debug("Removed {} outdated record(s) from productid cache", removed);
+    }
+    write_productid_cache(cache);
+    return stats;
+}
+
+/// The management of product certificates and the productdb after the transaction. See the description
+/// of the post_transaction hook in the plugin for details.
+ProductIdStats ProductIdEngine::process_transaction(const std::map<std::string, std::string> & transaction_repos,
+                                                    const std::set<std::string> & installed_repos) const {
+    ProductIdStats stats;
+    // All records of the productdb and temporary containers are released at once, when the hook is finished
+    std::pmr::monotonic_buffer_resource arena(PRODUCTDB_ARENA_INITIAL_SIZE);
+    auto product_db = ProductDb(paths, fs, &arena);
+
+    // First, try to read the product db file from /var/lib/rhsm/productid.json.
+    // If it is not possible to read it, because e.g., this file does not exist yet,
+    // then it should not be a problem. The new file will be created at the end
+    // of the transaction.
+    try {
+        const TraceSpan span(tracer, "read_product_db");
+        if (const auto ret = product_db.read_product_db(); ret) {
+            logger.debug("Successfully read existing productdb from {}", product_db.path);
+        }
+    } catch (const std::exception &e) {
+        logger.warning("Failed to read productdb: {}", e.what());
+    }
+
+    // Print warning messages when product DB contains products without valid product certificates.
+    // This could happen when the product certificate was manually removed from /etc/pki/product or
+    // /etc/pki/product-default
+    for (const auto &[product_id, product] : product_db.products) {
+        if (!product.is_installed) {
+            logger.warning("Product '{}' has record in product DB, but related product certificate does not exist",
+                product_id);
+        }
+    }
+
+    // Check if there are any new installed product certificates and load these
+    // product certs to the product_db too. This could happen when the product certificate was
+    // manually added to /etc/pki/product or /etc/pki/product-default.
+    process_all_installed_product_certificates(product_db);
+
+    // Product certificates of transaction repositories were usually already decompressed
+    // and parsed, when the repositories were loaded
+    ProductIdCache productid_cache(paths.cache_file, fs);
+    read_productid_cache(productid_cache);
+
+    // Go through all active repositories and try to get paths of downloaded productid certificates.
+    // Note: when the transaction is e.g. "remove", then cached metadata is empty, but we will probably
+    //       not need cached metadata during removal of packages.
+    for (const auto &[repo_id, productid_path]: transaction_repos) {
+        if (productid_path.empty()) {
+            logger.debug(
+                "Repository '{}' does not provide productid metadata; skipping",
+                repo_id);
+            continue;
+        }
+
+        TraceSpan span(tracer, repo_id, "repo");
+        ++stats.repositories;
+        logger.debug(
+            "The productid certificates of '{}' repository downloaded to: {}",
+            repo_id,
+            productid_path
+            );
+
+        std::string cert_content;
+        std::string product_id;
+        if (!get_product_certificate(productid_cache, stats, productid_path, cert_content, product_id)) {
+            continue;
+        }
+
+        logger.debug("The downloaded product certificate '{}' has product ID: {}", productid_path, product_id);
+        span.arg("product_id", product_id);
+
+        // If it is a new product certificate, then try to install it
+        if (!product_db.has_product_id(product_id)) {
+            if (!install_product_certificate(product_db, cert_content, product_id)) continue;
+            ++stats.certificates_installed;
+        } else {
+            logger.debug("Product certificate '{}' is already installed in: '{}'",
+                product_id, product_db.get_product(product_id).product_cert_path);
+        }
+
+        // If the repository hasn't been added yet to the productdb, then assign it to the current product
+        if (auto &product = product_db.get_product(product_id); !product.has_repo_id(repo_id)) {
+            logger.debug("Assigning repository '{}' to product '{}' in productdb", repo_id, product_id);
+            product.add_repo_id(repo_id);
+        } else {
+            logger.debug("Repository '{}' is already assigned to product '{}' in productdb", repo_id, product_id);
+        }
+    }
+
+    // Get the dictionary of active repositories
+    RepoIdSet active_repos(&arena);
+    for (const auto &repo_id : installed_repos) {
+        active_repos.emplace(repo_id);
+    }
+    /// Extend active repos with active transaction_repos
+    for (const auto &repo_id : transaction_repos | std::views::keys) {
+        active_repos.emplace(repo_id);
+    }
+    logger.debug("Number of active repositories: {}", active_repos.size());
+
+    // TODO: Try to protect disabled repositories that have some "active" RPMs. Removing such
+    //       disabled repositories could cause removing of related product certificate despite
+    //       the product is still used (RPMs from this product are still installed).
+
+    // Check if it is necessary to remove any repository from the "database" or eventually
+    // if it is necessary to remove any product certificate.
+    // Note: it is not possible to do the following optimization: Try to remove repository
+    // and product certificate only in cases when there was at least one "remove"
+    // transaction. Why? RPMs could be also removed using "rpm" command, which does not
+    // trigger any libdnf plugin. Thus, we have to check the validity of our "database"
+    // at the end of this hook.
+    remove_inactive_repositories_from_product_db(product_db, active_repos);
+    stats.certificates_removed = remove_inactive_product_certificates(product_db);
+    stats.products = product_db.products.size();
+
+    write_productid_cache(productid_cache);
+
+    logger.debug("Writing current productdb to {}", product_db.path);
+    try {
+        const TraceSpan span(tracer, "write_product_db");
+        if (product_db.write_product_db()) {
+            logger.debug("The productdb successfully writen to {}", product_db.path);
+        }
+    } catch (const std::exception &e) {
+        logger.warning("Failed to write productdb: {}", e.what());
+    }
+    return stats;
+}
@@ -0,0 +1,97 @@
+#ifndef RHSM_DNF5_PLUGINS_PRODUCTID_ENGINE_HPP
+#define RHSM_DNF5_PLUGINS_PRODUCTID_ENGINE_HPP
+
+#include <cstdint>
+#include <map>
+#include <memory_resource>
+#include <set>
+#include <string>
+#include <string_view>
+#include <libdnf5/logger/logger.hpp>
+
+#include "filesystem.hpp"
+#include "plugin_logger.hpp"
+#include "plugin_trace.hpp"
+#include "productdb.hpp"
+#include "productid_cache.hpp"
+
+using ProductIdLogger = PluginLogger<"[productid plugin] ">;
+
+/// Counts of one run of the engine, exported as metrics by the plugin
+struct ProductIdStats {
+    /// Products in the productdb after the transaction
+    std::size_t products = 0;
+    /// Repositories with productid metadata that were processed
+    std::size_t repositories = 0;
+    std::size_t certificates_installed = 0;
+    std::size_t certificates_removed = 0;
+    /// Lookups of product certificates in the productid cache
+    std::size_t cache_hits = 0;
+    std::size_t cache_misses = 0;
+};
+
+/// The business logic of the productid plugin. It does not depend on the libdnf5 Base, and it
+/// accesses files only through the FileSystem interface. The plugin collects information about
+/// repositories and packages from libdnf5 and passes it to the engine. This allows unit tests,
+/// stress tests and benchmarks to drive the complete logic of the hooks with MemoryFileSystem.
+class ProductIdEngine {
+public:
+    /// Messages up to log_level are written to logger; the phases are recorded by tracer, if any
+    ProductIdEngine(FileSystem & fs, ProductIdPaths paths, libdnf5::Logger & logger,
+                    libdnf5::Logger::Level log_level = libdnf5::Logger::Level::DEBUG, const Tracer * tracer = nullptr);
+
+    /// Try to create directories where the productdb is stored and product certificates are installed
+    [[nodiscard]] bool setup_filesystem() const;
+
+    /// Decompress and parse productid metadata of repositories (repository ID -> path of the metadata)
+    /// that are not cached yet, and store the results in the productid cache. When refreshed_since_ns
+    /// is set, only metadata modified at or after this time (nanoseconds since the epoch) is processed,
+    /// and the cache is not touched at all when no metadata was refreshed.
+    ProductIdStats update_productid_cache(const std::map<std::string, std::string> & productid_paths,
+                                          std::int64_t refreshed_since_ns = 0) const;
+
+    /// The business logic of the post_transaction hook. The transaction_repos contains repositories
+    /// of inbound transaction packages (repository ID -> path of downloaded productid metadata, which
+    /// is empty when the repository does not provide productid metadata). The installed_repos
+    /// contains IDs of repositories of installed packages.
+    ProductIdStats process_transaction(const std::map<std::string, std::string> & transaction_repos,
+                                       const std::set<std::string> & installed_repos) const;
+
+private:
+    using RepoIdSet = std::pmr::set<std::pmr::string, std::less<>>;
+
+    static bool is_number(const std::string &str);
+
+    void process_installed_product_certificates(
+        const std::string & dir_filepath,
+        ProductDb & product_db) const;
+
+    void process_all_installed_product_certificates(ProductDb & product_db) const;
+
+    void remove_inactive_repositories_from_product_db(ProductDb & product_db,
+        const RepoIdSet & active_repos) const;
+
+    /// Return the number of removed product certificates
+    std::size_t remove_inactive_product_certificates(ProductDb & product_db) const;
+
+    bool install_product_certificate(ProductDb & product_db,
+        const std::string & cert_content,
+        const std::string & product_id) const;
+
+    void read_productid_cache(ProductIdCache & cache) const;
+
+    void write_productid_cache(const ProductIdCache & cache) const;
+
+    bool get_product_certificate(ProductIdCache & cache,
+        ProductIdStats & stats,
+        const std::string & productid_path,
+        std::string & cert_content,
+        std::string & product_id) const;
+
+    FileSystem & fs;
+    ProductIdPaths paths;
+    ProductIdLogger logger;
+    const Tracer * tracer;
+};
+
+#endif //RHSM_DNF5_PLUGINS_PRODUCTID_ENGINE_HPP
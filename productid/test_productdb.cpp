@@ -4,6 +4,8 @@
 
 #include <gtest/gtest.h>
 #include <fstream>
+#include <memory_resource>
+#include <ranges>
 #include "productdb.hpp"
 
 class ProductDbTest : public ::testing::Test {
@@ -411,6 +413,99 @@ namespace test_remove_repo_id {
     }
 }
 
+namespace test_paths {
+    TEST_F(ProductDbTest, DefaultPaths) {
+        const ProductIdPaths paths;
+        EXPECT_EQ(paths.productdb_file, DEFAULT_PRODUCTDB_FILE);
+        EXPECT_EQ(paths.productdb_dir(), PRODUCTDB_DIR);
+        EXPECT_EQ(paths.product_cert_dir, PRODUCT_CERT_DIR);
+        EXPECT_EQ(paths.default_product_cert_dir, DEFAULT_PRODUCT_CERT_DIR);
+    }
+
+    TEST_F(ProductDbTest, PathsWithRootInstallroot) {
+        const auto paths = ProductIdPaths().with_installroot("/");
+        EXPECT_EQ(paths.productdb_file, DEFAULT_PRODUCTDB_FILE);
+        EXPECT_EQ(paths.product_cert_dir, PRODUCT_CERT_DIR);
+        EXPECT_EQ(paths.default_product_cert_dir, DEFAULT_PRODUCT_CERT_DIR);
+    }
+
+    TEST_F(ProductDbTest, PathsWithInstallroot) {
+        const auto paths = ProductIdPaths().with_installroot("/mnt/sysimage/");
+        EXPECT_EQ(paths.productdb_file, "/mnt/sysimage/var/lib/rhsm/productid.json");
+        EXPECT_EQ(paths.productdb_dir(), "/mnt/sysimage/var/lib/rhsm/");
+        EXPECT_EQ(paths.product_cert_dir, "/mnt/sysimage/etc/pki/product/");
+        EXPECT_EQ(paths.default_product_cert_dir, "/mnt/sysimage/etc/pki/product-default/");
+    }
+
+    TEST_F(ProductDbTest, ConfiguredPathsWithInstallroot) {
+        ProductIdPaths configured;
+        configured.productdb_file = "/srv/productid/db.json";
+        configured.product_cert_dir = "/srv/product";
+        const auto paths = configured.with_installroot("/mnt/sysimage");
+        EXPECT_EQ(paths.productdb_file, "/mnt/sysimage/srv/productid/db.json");
+        EXPECT_EQ(paths.product_cert_dir, "/mnt/sysimage/srv/product/");
+        EXPECT_EQ(paths.default_product_cert_dir, "/mnt/sysimage/etc/pki/product-default/");
+    }
+
+    TEST_F(ProductDbTest, ConstructorWithPaths) {
+        ProductIdPaths paths;
+        paths.productdb_file = "foo_product.json";
+        paths.product_cert_dir = "./test_data/";
+        const ProductDb db(paths);
+        EXPECT_EQ(db.path, "foo_product.json");
+        EXPECT_EQ(db.product_cert_dir, "./test_data/");
+        EXPECT_EQ(db.default_product_cert_dir, DEFAULT_PRODUCT_CERT_DIR);
+        EXPECT_TRUE(db.products.empty());
+    }
+
+    TEST_F(ProductDbTest, ReadDbWithCustomCertDir) {
+        std::ofstream file(test_db.path);
+        file << R"({"38091": ["repo1"], "12345": ["repo2"]})";
+        file.close();
+        test_db.product_cert_dir = "./test_data/";
+        EXPECT_TRUE(test_db.read_product_db());
+        EXPECT_TRUE(test_db.products["38091"].is_installed);
+        EXPECT_EQ(test_db.products["38091"].product_cert_path, "./test_data/38091.pem");
+        EXPECT_FALSE(test_db.products["12345"].is_installed);
+    }
+}
+
+namespace test_memory_resource {
+    TEST_F(ProductDbTest, ReadDbIntoArena) {
+        std::ofstream file(test_db.path);
+        file << R"({"38091": ["rhel-9-for-x86_64-baseos-rpms", "rhel-9-for-x86_64-appstream-rpms"]})";
+        file.close();
+
+        std::pmr::monotonic_buffer_resource arena;
+        ProductIdPaths paths;
+        paths.productdb_file = test_db.path;
+        paths.product_cert_dir = "./test_data/";
+        ProductDb db(paths, default_filesystem(), &arena);
+        EXPECT_TRUE(db.read_product_db());
+
+        const auto &product = db.get_product("38091");
+        EXPECT_EQ(product.product_cert_path.get_allocator().resource(), &arena);
+        EXPECT_EQ(product.repos.get_allocator().resource(), &arena);
+        ASSERT_EQ(product.repos.size(), 2);
+        for (const auto &repo : product.repos | std::views::values) {
+            EXPECT_EQ(repo.repo_id.get_allocator().resource(), &arena);
+        }
+    }
+
+    TEST_F(ProductDbTest, AddProductIntoArena) {
+        std::pmr::monotonic_buffer_resource arena;
+        ProductDb db(ProductIdPaths(), default_filesystem(), &arena);
+        EXPECT_TRUE(db.add_product_id("38091", "./test_data/38091.pem"));
+        EXPECT_TRUE(db.get_product("38091").add_repo_id("rhel-9-for-x86_64-baseos-rpms"));
+        EXPECT_EQ(db.get_product("38091").product_cert_path.get_allocator().resource(), &arena);
+        EXPECT_EQ(db.get_product("38091").repos.begin()->second.repo_id.get_allocator().resource(), &arena);
+    }
+
+    TEST_F(ProductDbTest, GetMissingProduct) {
+        EXPECT_THROW(static_cast<void>(test_db.get_product("38091")), std::out_of_range);
+    }
+}
+
 int main(int argc, char **argv) {
     testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
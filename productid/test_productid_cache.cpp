@@ -0,0 +1,90 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+
+#include "productid_cache.hpp"
+
+namespace fs = std::filesystem;
+
+class ProductIdCacheTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        temp_dir = fs::temp_directory_path() / "productid_cache_test";
+        fs::create_directories(temp_dir);
+        metadata_path = (temp_dir / "beea-productid.gz").string();
+        std::ofstream(metadata_path) << "compressed metadata";
+        cache.path = (temp_dir / "productid-cache.json").string();
+    }
+
+    void TearDown() override {
+        fs::remove_all(temp_dir);
+    }
+
+    fs::path temp_dir;
+    std::string metadata_path;
+    ProductIdCache cache = ProductIdCache("");
+};
+
+TEST_F(ProductIdCacheTest, LookupEmptyCache) {
+    EXPECT_EQ(cache.lookup(metadata_path), nullptr);
+    EXPECT_FALSE(cache.dirty);
+}
+
+TEST_F(ProductIdCacheTest, StoreAndLookup) {
+    EXPECT_TRUE(cache.store(metadata_path, "38091", "certificate"));
+    EXPECT_TRUE(cache.dirty);
+    const auto *record = cache.lookup(metadata_path);
+    ASSERT_NE(record, nullptr);
+    EXPECT_EQ(record->product_id, "38091");
+    EXPECT_EQ(record->cert_content, "certificate");
+}
+
+TEST_F(ProductIdCacheTest, StoreNonexistentFile) {
+    EXPECT_FALSE(cache.store((temp_dir / "nonexistent").string(), "38091", "certificate"));
+    EXPECT_FALSE(cache.dirty);
+}
+
+TEST_F(ProductIdCacheTest, LookupChangedFile) {
+    EXPECT_TRUE(cache.store(metadata_path, "38091", "certificate"));
+    std::ofstream(metadata_path, std::ios::app) << " changed";
+    EXPECT_EQ(cache.lookup(metadata_path), nullptr);
+}
+
+TEST_F(ProductIdCacheTest, WriteAndRead) {
+    EXPECT_TRUE(cache.store(metadata_path, "38091", "-----BEGIN CERTIFICATE-----\n"));
+    EXPECT_TRUE(cache.write_cache());
+
+    ProductIdCache new_cache(cache.path);
+    EXPECT_TRUE(new_cache.read_cache());
+    EXPECT_FALSE(new_cache.dirty);
+    const auto *record = new_cache.lookup(metadata_path);
+    ASSERT_NE(record, nullptr);
+    EXPECT_EQ(record->product_id, "38091");
+    EXPECT_EQ(record->cert_content, "-----BEGIN CERTIFICATE-----\n");
+}
+
+TEST_F(ProductIdCacheTest, ReadNonexistentFile) {
+    EXPECT_THROW(cache.read_cache(), std::runtime_error);
+}
+
+TEST_F(ProductIdCacheTest, ReadInvalidRecordsAreIgnored) {
+    std::ofstream(cache.path) << R"({"/foo": {"size": "big"}, "/bar": [1, 2]})";
+    EXPECT_TRUE(cache.read_cache());
+    EXPECT_TRUE(cache.records.empty());
+}
+
+TEST_F(ProductIdCacheTest, PruneRemovedMetadata) {
+    EXPECT_TRUE(cache.store(metadata_path, "38091", "certificate"));
+    cache.dirty = false;
+    EXPECT_EQ(cache.prune(), 0);
+    EXPECT_FALSE(cache.dirty);
+    fs::remove(metadata_path);
+    EXPECT_EQ(cache.prune(), 1);
+    EXPECT_TRUE(cache.dirty);
+    EXPECT_TRUE(cache.records.empty());
+}
+
+int main(int argc, char **argv) {
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
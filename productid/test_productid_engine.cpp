@@ -0,0 +1,214 @@
+#include <gtest/gtest.h>
+#include <fstream>
+#include <sstream>
+#include <libdnf5/logger/null_logger.hpp>
+
+#include "productid_engine.hpp"
+
+namespace {
+
+std::string read_test_certificate() {
+    std::ifstream file("./test_data/38091.pem");
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    return buffer.str();
+}
+
+}
+
+class ProductIdEngineTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        cert_content = read_test_certificate();
+        ASSERT_FALSE(cert_content.empty());
+        // Metadata is stored already decompressed in the in-memory filesystem
+        fs.create_directories("/var/cache/libdnf5/rhel-baseos/repodata/", false);
+        fs.write_file(productid_path, cert_content);
+    }
+
+    [[nodiscard]] ProductDb read_productdb() {
+        ProductDb product_db(paths, fs);
+        product_db.read_product_db();
+        return product_db;
+    }
+
+    MemoryFileSystem fs;
+    ProductIdPaths paths;
+    libdnf5::NullLogger logger;
+    ProductIdEngine engine{fs, paths, logger};
+    std::string cert_content;
+    const std::string productid_path = "/var/cache/libdnf5/rhel-baseos/repodata/productid";
+};
+
+TEST_F(ProductIdEngineTest, SetupFilesystem) {
+    EXPECT_TRUE(engine.setup_filesystem());
+    EXPECT_TRUE(fs.exists(paths.productdb_dir()));
+    EXPECT_TRUE(fs.exists(paths.product_cert_dir));
+    EXPECT_FALSE(fs.exists(paths.default_product_cert_dir));
+}
+
+TEST_F(ProductIdEngineTest, InstallProductCertificate) {
+    ASSERT_TRUE(engine.setup_filesystem());
+    engine.process_transaction({{"rhel-baseos", productid_path}}, {"rhel-baseos"});
+
+    const auto installed_cert = fs.read_file(paths.product_cert_dir + "38091.pem");
+    ASSERT_TRUE(installed_cert.has_value());
+    EXPECT_EQ(*installed_cert, cert_content);
+
+    auto product_db = read_productdb();
+    ASSERT_TRUE(product_db.has_product_id("38091"));
+    EXPECT_TRUE(product_db.products["38091"].has_repo_id("rhel-baseos"));
+}
+
+TEST_F(ProductIdEngineTest, RepositoryWithoutProductId) {
+    ASSERT_TRUE(engine.setup_filesystem());
+    engine.process_transaction({{"epel", ""}}, {"epel"});
+
+    EXPECT_TRUE(fs.list_directory(paths.product_cert_dir).empty());
+    EXPECT_TRUE(read_productdb().products.empty());
+}
+
+TEST_F(ProductIdEngineTest, RemoveInactiveProductCertificate) {
+    ASSERT_TRUE(engine.setup_filesystem());
+    engine.process_transaction({{"rhel-baseos", productid_path}}, {"rhel-baseos"});
+    ASSERT_TRUE(fs.exists(paths.product_cert_dir + "38091.pem"));
+
+    // All packages from the repository were removed
+    engine.process_transaction({}, {"@System"});
+
+    EXPECT_FALSE(fs.exists(paths.product_cert_dir + "38091.pem"));
+    EXPECT_FALSE(read_productdb().has_product_id("38091"));
+}
+
+TEST_F(ProductIdEngineTest, KeepDefaultProductCertificate) {
+    ASSERT_TRUE(engine.setup_filesystem());
+    fs.create_directories(paths.default_product_cert_dir, false);
+    fs.write_file(paths.default_product_cert_dir + "908.pem", "certificate");
+
+    engine.process_transaction({}, {});
+
+    EXPECT_TRUE(fs.exists(paths.default_product_cert_dir + "908.pem"));
+    EXPECT_TRUE(read_productdb().has_product_id("908"));
+}
+
+TEST_F(ProductIdEngineTest, UpdateProductIdCache) {
+    engine.update_productid_cache({{"rhel-baseos", productid_path}, {"epel", ""}});
+
+    ProductIdCache cache(paths.cache_file, fs);
+    ASSERT_TRUE(cache.read_cache());
+    const auto *record = cache.lookup(productid_path);
+    ASSERT_NE(record, nullptr);
+    EXPECT_EQ(record->product_id, "38091");
+    EXPECT_EQ(record->cert_content, cert_content);
+}
+
+TEST_F(ProductIdEngineTest, UpdateProductIdCachePrunesRemovedMetadata) {
+    engine.update_productid_cache({{"rhel-baseos", productid_path}});
+    fs.remove(productid_path);
+    engine.update_productid_cache({});
+
+    ProductIdCache cache(paths.cache_file, fs);
+    ASSERT_TRUE(cache.read_cache());
+    EXPECT_TRUE(cache.records.empty());
+}
+
+TEST_F(ProductIdEngineTest, UpdateProductIdCacheOnlyRefreshedMetadata) {
+    // The metadata of rhel-baseos is older than the dnf invocation, the metadata of rhel-appstream was downloaded
+    const std::string appstream_path = "/var/cache/libdnf5/rhel-appstream/repodata/productid";
+    fs.create_directories("/var/cache/libdnf5/rhel-appstream/repodata/", false);
+    fs.write_file(appstream_path, cert_content);
+    const auto refreshed_since_ns = fs.stat(appstream_path)->mtime_ns;
+
+    const auto stats = engine.update_productid_cache(
+        {{"rhel-baseos", productid_path}, {"rhel-appstream", appstream_path}}, refreshed_since_ns);
+    EXPECT_EQ(stats.repositories, 1);
+
+    ProductIdCache cache(paths.cache_file, fs);
+    ASSERT_TRUE(cache.read_cache());
+    EXPECT_EQ(cache.lookup(productid_path), nullptr);
+    EXPECT_NE(cache.lookup(appstream_path), nullptr);
+}
+
+TEST_F(ProductIdEngineTest, UpdateProductIdCacheNothingRefreshed) {
+    const auto refreshed_since_ns = fs.stat(productid_path)->mtime_ns + 1;
+    const auto stats = engine.update_productid_cache({{"rhel-baseos", productid_path}}, refreshed_since_ns);
+    EXPECT_EQ(stats.repositories, 0);
+    EXPECT_FALSE(fs.exists(paths.cache_file));
+}
+
+TEST_F(ProductIdEngineTest, Stats) {
+    const auto cache_stats = engine.update_productid_cache({{"rhel-baseos", productid_path}, {"epel", ""}});
+    EXPECT_EQ(cache_stats.repositories, 1);
+    EXPECT_EQ(cache_stats.cache_hits, 0);
+    EXPECT_EQ(cache_stats.cache_misses, 1);
+
+    ASSERT_TRUE(engine.setup_filesystem());
+    const auto install_stats = engine.process_transaction({{"rhel-baseos", productid_path}}, {"rhel-baseos"});
+    EXPECT_EQ(install_stats.repositories, 1);
+    EXPECT_EQ(install_stats.cache_hits, 1);
+    EXPECT_EQ(install_stats.cache_misses, 0);
+    EXPECT_EQ(install_stats.certificates_installed, 1);
+    EXPECT_EQ(install_stats.certificates_removed, 0);
+    EXPECT_EQ(install_stats.products, 1);
+
+    const auto remove_stats = engine.process_transaction({}, {"@System"});
+    EXPECT_EQ(remove_stats.repositories, 0);
+    EXPECT_EQ(remove_stats.certificates_installed, 0);
+    EXPECT_EQ(remove_stats.certificates_removed, 1);
+    EXPECT_EQ(remove_stats.products, 0);
+}
+
+TEST_F(ProductIdEngineTest, TracePhasesAndRepositories) {
+    const Tracer tracer("/tmp/productid-trace-test.json");
+    const ProductIdEngine traced_engine{fs, paths, logger, libdnf5::Logger::Level::DEBUG, &tracer};
+    ASSERT_TRUE(traced_engine.setup_filesystem());
+    traced_engine.process_transaction({{"rhel-baseos", productid_path}, {"epel", ""}}, {"rhel-baseos"});
+
+    const auto trace = tracer.to_json("test");
+    for (const auto *span : {"\"setup_filesystem\"", "\"read_product_db\"", "\"parse_certificate\"",
+                             "\"install_product_certificate\"", "\"write_product_db\""}) {
+        EXPECT_NE(trace.find(span), std::string::npos) << span;
+    }
+    // Only the repository providing productid metadata has a span, with the product ID
+    EXPECT_NE(trace.find("\"name\":\"rhel-baseos\""), std::string::npos);
+    EXPECT_NE(trace.find("\"product_id\":\"38091\""), std::string::npos);
+    EXPECT_EQ(trace.find("\"name\":\"epel\""), std::string::npos);
+}
+
+/// Drive the complete post_transaction logic with a large number of installed products. Every
+/// product is assigned to its own repository, and packages of every second repository were removed.
+TEST_F(ProductIdEngineTest, StressManyProducts) {
+    constexpr int NUMBER_OF_PRODUCTS = 50000;
+    ASSERT_TRUE(engine.setup_filesystem());
+
+    std::set<std::string> installed_repos;
+    {
+        ProductDb product_db(paths, fs);
+        for (int i = 0; i < NUMBER_OF_PRODUCTS; ++i) {
+            const auto product_id = std::to_string(100000 + i);
+            const auto repo_id = "repo-" + product_id;
+            const auto cert_path = paths.product_cert_dir + product_id + ".pem";
+            fs.write_file(cert_path, cert_content);
+            product_db.add_product_id(product_id, cert_path);
+            product_db.get_product(product_id).add_repo_id(repo_id);
+            if (i % 2 == 0) {
+                installed_repos.insert(repo_id);
+            }
+        }
+        ASSERT_TRUE(product_db.write_product_db());
+    }
+
+    engine.process_transaction({{"rhel-baseos", productid_path}}, installed_repos);
+
+    const auto product_db = read_productdb();
+    EXPECT_EQ(product_db.products.size(), NUMBER_OF_PRODUCTS / 2 + 1);
+    EXPECT_EQ(fs.list_directory(paths.product_cert_dir).size(), NUMBER_OF_PRODUCTS / 2 + 1);
+    EXPECT_TRUE(product_db.has_product_id("100000"));
+    EXPECT_FALSE(product_db.has_product_id("100001"));
+    EXPECT_TRUE(product_db.has_product_id("38091"));
+}
+
+int main(int argc, char **argv) {
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -50,6 +50,49 @@ namespace test_get_product_id_from_cert_content {
     }
 }
 
+namespace test_collect_transaction_repos {
+    struct FakeRepo {
+        std::string id;
+        [[nodiscard]] std::string get_id() const { return id; }
+    };
+
+    struct FakeTransactionPackage {
+        bool outbound;
+        FakeRepo *repo;
+    };
+
+    auto collect(const std::vector<FakeTransactionPackage> &pkgs) {
+        return collect_transaction_repos(
+            pkgs,
+            [](const FakeTransactionPackage &pkg) { return !pkg.outbound; },
+            [](const FakeTransactionPackage &pkg) { return pkg.repo; });
+    }
+
+    TEST_F(UtilsTest, CollectTransactionReposEmpty) {
+        EXPECT_TRUE(collect({}).empty());
+    }
+
+    TEST_F(UtilsTest, CollectTransactionReposDeduplicates) {
+        FakeRepo baseos{"baseos"};
+        FakeRepo appstream{"appstream"};
+        const std::vector<FakeTransactionPackage> pkgs{
+            {false, &baseos}, {false, &appstream}, {false, &baseos}, {false, &baseos}, {false, &appstream}};
+        const auto repos = collect(pkgs);
+        ASSERT_EQ(repos.size(), 2);
+        EXPECT_EQ(repos.at("baseos"), &baseos);
+        EXPECT_EQ(repos.at("appstream"), &appstream);
+    }
+
+    TEST_F(UtilsTest, CollectTransactionReposSkipsOutbound) {
+        FakeRepo baseos{"baseos"};
+        FakeRepo system{"@System"};
+        const std::vector<FakeTransactionPackage> pkgs{{true, &system}, {false, &baseos}, {true, &system}};
+        const auto repos = collect(pkgs);
+        ASSERT_EQ(repos.size(), 1);
+        EXPECT_TRUE(repos.contains("baseos"));
+    }
+}
+
 int main(int argc, char **argv) {
     testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
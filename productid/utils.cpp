@@ -2,6 +2,7 @@
 // Created by jhnidek on 04.12.25.
 //
 
+#include <cstring>
 #include <format>
 #include <libdnf5/utils/fs/file.hpp>
 
@@ -9,6 +10,7 @@
 #include <openssl/x509.h>
 #include <openssl/err.h>
 
+#include "cert_cache.hpp"
 #include "utils.hpp"
 
 /// Try to decompress downloaded compressed productid certificate to some temporary file.
@@ -31,6 +33,18 @@ std::string decompress_productid_cert(const std::filesystem::path & compressed_c
 /// We care only about the remaining part of the OID 1.3.6.1.4.1.2312.9.1. In this
 /// case it is the number: 38091. This is the product ID we try to return.
 std::string get_product_id_from_cert_content(const std::string & cert_content) {
+    // The certificate is decoded once per dnf run; the facts are shared with the rhsm plugin, which
+    // reads the installed product certificates
+    if (const auto facts = CertCache::get().get_facts(cert_content); facts->redhat_extensions) {
+        auto product_id = facts->product_id();
+        if (product_id.empty()) {
+            throw std::runtime_error(std::format("Red Hat Product OID: {} not found or malformed",
+                std::string(REDHAT_PRODUCT_OID)));
+        }
+        return product_id;
+    }
+
+    // OpenSSL parses only certificates that cannot be decoded without it
     BIO *bio = BIO_new_mem_buf(cert_content.c_str(), static_cast<int>(cert_content.size()));
     if (bio == nullptr) {
         const std::string err_str(ERR_error_string(ERR_get_error(), nullptr));
@@ -7,6 +7,11 @@
 #ifndef RHSM_DNF5_PLUGINS_UTILS_HPP
 #define RHSM_DNF5_PLUGINS_UTILS_HPP
 #include <filesystem>
+#include <map>
+#include <string>
+#include <type_traits>
+#include <unordered_set>
+#include <vector>
 
 #define MAX_BUFF 256
 
@@ -17,4 +22,37 @@ std::string decompress_productid_cert(const std::filesystem::path & compressed_c
 
 std::string get_product_id_from_cert_content(const std::string & cert_content);
 
+/// Collect the distinct repositories of transaction items accepted by is_inbound. The items
+/// are deduplicated by repository identity (the pointer returned by get_repo) first, and the
+/// repository ID is read only once per distinct repository. A large transaction contains
+/// thousands of packages, but only a handful of repositories, so no string is copied and no
+/// map lookup is done per package.
+template <typename Items, typename IsInbound, typename GetRepo>
+auto collect_transaction_repos(const Items & items, IsInbound && is_inbound, GetRepo && get_repo) {
+    using RepoPtr = std::invoke_result_t<GetRepo &, const typename Items::value_type &>;
+    std::unordered_set<RepoPtr> seen;
+    std::vector<RepoPtr> unique_repos;
+    RepoPtr last_repo = nullptr;
+    for (const auto & item : items) {
+        if (!is_inbound(item)) {
+            continue;
+        }
+        RepoPtr repo = get_repo(item);
+        // Packages from the same repository are usually adjacent in the transaction
+        if (repo == last_repo || repo == nullptr) {
+            continue;
+        }
+        last_repo = repo;
+        if (seen.insert(repo).second) {
+            unique_repos.push_back(repo);
+        }
+    }
+
+    std::map<std::string, RepoPtr> repos;
+    for (RepoPtr repo : unique_repos) {
+        repos.try_emplace(repo->get_id(), repo);
+    }
+    return repos;
+}
+
 #endif //RHSM_DNF5_PLUGINS_UTILS_HPP
@@ -0,0 +1,106 @@
+#include <benchmark/benchmark.h>
+
+#include <filesystem>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/rand.h>
+#include <openssl/x509.h>
+#include <openssl/x509v3.h>
+
+#include "cert_cache.hpp"
+#include "rhsm_utils.hpp"
+
+/// Parsing of a generated directory with 500 entitlement certificates, similar to older non-SCA
+/// systems. Every certificate is a v3 certificate with a large content extension, like the
+/// entitlement data of v3 entitlement certificates. The cache is not used, so every iteration
+/// parses all certificates; the argument is the maximum number of parser threads.
+
+namespace {
+
+constexpr int ENTITLEMENT_CERTS = 500;
+constexpr int CONTENT_EXTENSION_SIZE = 32 * 1024;
+constexpr const char *ENTITLEMENT_DATA_OID = "1.3.6.1.4.1.2312.9.7";
+
+using EvpPkeyPtr = std::unique_ptr<EVP_PKEY, decltype(&EVP_PKEY_free)>;
+using X509Ptr = std::unique_ptr<X509, decltype(&X509_free)>;
+
+void write_certificate(const std::filesystem::path &path, EVP_PKEY *key, const long serial) {
+    auto cert = X509Ptr(X509_new(), X509_free);
+    X509_set_version(cert.get(), X509_VERSION_3);
+    ASN1_INTEGER_set(X509_get_serialNumber(cert.get()), serial);
+    X509_gmtime_adj(X509_getm_notBefore(cert.get()), 0);
+    X509_gmtime_adj(X509_getm_notAfter(cert.get()), (serial % 2 == 0 ? 1 : -1) * 365L * 24 * 3600);
+    X509_set_pubkey(cert.get(), key);
+    auto *name = X509_get_subject_name(cert.get());
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+                               reinterpret_cast<const unsigned char *>("entitlement"), -1, -1, 0);
+    X509_set_issuer_name(cert.get(), name);
+
+    std::vector<unsigned char> content(CONTENT_EXTENSION_SIZE);
+    RAND_bytes(content.data(), static_cast<int>(content.size()));
+    auto *data = ASN1_OCTET_STRING_new();
+    ASN1_OCTET_STRING_set(data, content.data(), static_cast<int>(content.size()));
+    auto *object = OBJ_txt2obj(ENTITLEMENT_DATA_OID, 1);
+    auto *extension = X509_EXTENSION_create_by_OBJ(nullptr, object, 0, data);
+    X509_add_ext(cert.get(), extension, -1);
+    X509_EXTENSION_free(extension);
+    ASN1_OBJECT_free(object);
+    ASN1_OCTET_STRING_free(data);
+
+    X509_sign(cert.get(), key, EVP_sha256());
+
+    const auto file = std::unique_ptr<FILE, decltype(&fclose)>(fopen(path.c_str(), "w"), fclose);
+    if (!file || PEM_write_X509(file.get(), cert.get()) != 1) {
+        throw std::runtime_error("Unable to write certificate " + path.string());
+    }
+}
+
+/// The directory with generated certificates shared by all benchmarks
+class EntitlementDirectory {
+public:
+    EntitlementDirectory() {
+        dir = std::filesystem::temp_directory_path() / "bench_entitlement_parsing";
+        std::filesystem::remove_all(dir);
+        std::filesystem::create_directories(dir);
+        auto key = EvpPkeyPtr(EVP_EC_gen("P-256"), EVP_PKEY_free);
+        for (int i = 0; i < ENTITLEMENT_CERTS; ++i) {
+            write_certificate(dir / (std::to_string(1000000 + i) + ".pem"), key.get(), i);
+        }
+        cert_paths = get_entitlement_cert_paths(dir);
+    }
+
+    ~EntitlementDirectory() {
+        std::filesystem::remove_all(dir);
+    }
+
+    std::filesystem::path dir;
+    std::vector<std::filesystem::path> cert_paths;
+};
+
+const EntitlementDirectory &entitlement_directory() {
+    static const EntitlementDirectory directory;
+    return directory;
+}
+
+void BM_ParseEntitlementCertificates(benchmark::State &state) {
+    const auto &cert_paths = entitlement_directory().cert_paths;
+    for (auto _ : state) {
+        // Every iteration decodes the certificates, like the first dnf command after they were installed
+        state.PauseTiming();
+        CertCache::get().clear();
+        state.ResumeTiming();
+        auto results = get_certs_not_after(cert_paths, static_cast<unsigned>(state.range(0)));
+        benchmark::DoNotOptimize(results);
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(cert_paths.size()));
+}
+BENCHMARK(BM_ParseEntitlementCertificates)->Arg(1)->Arg(2)->Arg(MAX_CERT_PARSER_THREADS)
+    ->Unit(benchmark::kMillisecond)->UseRealTime();
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,86 @@
+#include <benchmark/benchmark.h>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+
+#include "rhsm_status.hpp"
+
+/// The overlap of the status checks with the setup of Base. Every iteration simulates the work
+/// done by libdnf5 between the pre_base_setup and post_base_setup hooks (20 ms, either waiting
+/// for I/O or computing), and checks the status of a registered system with the given number of
+/// entitlement certificates that are not cached yet. The synchronous variant checks the status
+/// after the setup, like post_base_setup did before; the background variant starts the check
+/// before the setup and retrieves the result after it.
+/// Run it from the build directory of the plugin, where the test data are copied.
+
+namespace {
+
+constexpr auto BASE_SETUP_DURATION = std::chrono::milliseconds(20);
+
+void simulate_base_setup(const bool compute) {
+    if (!compute) {
+        std::this_thread::sleep_for(BASE_SETUP_DURATION);
+        return;
+    }
+    const auto end = std::chrono::steady_clock::now() + BASE_SETUP_DURATION;
+    while (std::chrono::steady_clock::now() < end) {
+    }
+}
+
+/// A registered system with the given number of entitlement certificates
+class RegisteredSystem {
+public:
+    explicit RegisteredSystem(const int64_t entitlements) {
+        root = std::filesystem::temp_directory_path() / "bench_rhsm_status";
+        std::filesystem::remove_all(root);
+        paths = RhsmPaths().with_installroot(root);
+        std::filesystem::create_directories(paths.consumer_cert_dir);
+        std::filesystem::copy_file("./test_data/valid.pem", paths.consumer_cert_dir / "cert.pem");
+        std::filesystem::create_directories(paths.entitlement_cert_dir);
+        for (int64_t i = 0; i < entitlements; ++i) {
+            std::filesystem::copy_file(
+                i % 2 == 0 ? "./test_data/valid.pem" : "./test_data/expired.pem",
+                paths.entitlement_cert_dir / (std::to_string(1000000 + i) + ".pem"));
+        }
+    }
+
+    ~RegisteredSystem() {
+        std::filesystem::remove_all(root);
+    }
+
+    std::filesystem::path root;
+    RhsmPaths paths;
+};
+
+void BM_StatusSynchronous(benchmark::State &state) {
+    const RegisteredSystem system(state.range(0));
+    for (auto _ : state) {
+        CertExpiryCache expiry_cache(system.paths.expiry_cache_file);
+        simulate_base_setup(state.range(1) != 0);
+        auto status = check_rhsm_status(system.paths, expiry_cache, static_cast<std::int64_t>(std::time(nullptr)));
+        benchmark::DoNotOptimize(status);
+    }
+}
+
+void BM_StatusBackground(benchmark::State &state) {
+    const RegisteredSystem system(state.range(0));
+    for (auto _ : state) {
+        CertExpiryCache expiry_cache(system.paths.expiry_cache_file);
+        auto pending = start_rhsm_status_check(system.paths, expiry_cache, 0);
+        simulate_base_setup(state.range(1) != 0);
+        auto status = pending.get();
+        benchmark::DoNotOptimize(status);
+    }
+}
+
+}  // namespace
+
+BENCHMARK(BM_StatusSynchronous)->ArgsProduct({{10, 500}, {0, 1}})->ArgNames({"certs", "compute"})
+    ->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_StatusBackground)->ArgsProduct({{10, 500}, {0, 1}})->ArgNames({"certs", "compute"})
+    ->Unit(benchmark::kMillisecond)->UseRealTime();
+
+BENCHMARK_MAIN();
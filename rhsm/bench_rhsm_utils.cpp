@@ -0,0 +1,113 @@
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "bench_fixtures.hpp"
+#include "cert_cache.hpp"
+#include "rhsm_utils.hpp"
+
+/// Microbenchmarks of the utilities of the rhsm plugin, each with 1 to 100k certificates. The
+/// entitlement directory contains the generated certificates (see bench_fixtures.hpp), every second
+/// one expired, each with its key. Unlike bench_entitlement_parsing, the certificates are small
+/// and checked one by one on the calling thread, like is_cert_expired() does in the plugin.
+///
+/// The results can be compared across commits with compare.py of Google Benchmark, see TESTING.md.
+
+namespace {
+
+using bench_fixtures::MAX_FIXTURE_SIZE;
+using bench_fixtures::MIN_FIXTURE_SIZE;
+
+/// The entitlement directory with count certificates and count keys
+struct EntitlementDirectory {
+    explicit EntitlementDirectory(const std::int64_t count) : count(count), dir("bench_rhsm_utils") {
+        static const std::string certificates[] = {
+            bench_fixtures::generate_certificate(1), bench_fixtures::generate_certificate(2, "", true)};
+        for (std::int64_t i = 0; i < count; ++i) {
+            const auto serial = std::to_string(1000000 + i);
+            bench_fixtures::write_file(dir.path / (serial + ".pem"), certificates[i % 2]);
+            bench_fixtures::write_file(dir.path / (serial + "-key.pem"), "key");
+        }
+        cert_paths = get_entitlement_cert_paths(dir.path);
+    }
+
+    std::int64_t count;
+    bench_fixtures::TemporaryDirectory dir;
+    std::vector<std::filesystem::path> cert_paths;
+};
+
+void set_items_processed(benchmark::State &state) {
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+void BM_IsCertExpired(benchmark::State &state) {
+    const auto &fixture = bench_fixtures::current_fixture<EntitlementDirectory>(state.range(0));
+    for (auto _ : state) {
+        // Every iteration reads the certificates, like the first dnf command after they were installed
+        state.PauseTiming();
+        CertCache::get().clear();
+        state.ResumeTiming();
+        for (const auto &cert_path : fixture.cert_paths) {
+            benchmark::DoNotOptimize(is_cert_expired(cert_path));
+        }
+    }
+    set_items_processed(state);
+}
+
+void BM_GetEntitlementCertPaths(benchmark::State &state) {
+    const auto &fixture = bench_fixtures::current_fixture<EntitlementDirectory>(state.range(0));
+    for (auto _ : state) {
+        auto cert_paths = get_entitlement_cert_paths(fixture.dir.path);
+        benchmark::DoNotOptimize(cert_paths);
+    }
+    set_items_processed(state);
+}
+
+void BM_HasEntitlementCertificates(benchmark::State &state) {
+    const auto &fixture = bench_fixtures::current_fixture<EntitlementDirectory>(state.range(0));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(has_entitlement_certificates(fixture.dir.path));
+    }
+    set_items_processed(state);
+}
+
+/// The directory of the consumer certificate is scanned the same way; a registered system has
+/// one certificate and one key
+void BM_HasConsumerCertificate(benchmark::State &state) {
+    const auto &fixture = bench_fixtures::current_fixture<EntitlementDirectory>(1);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(has_consumer_certificate(fixture.dir.path));
+    }
+}
+
+void BM_InContainer(benchmark::State &state) {
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(in_container());
+    }
+}
+
+void BM_GetReleasever(benchmark::State &state) {
+    const bench_fixtures::TemporaryDirectory dir("bench_rhsm_utils_releasever");
+    bench_fixtures::write_file(dir.path / "releasever", "10.0\n");
+    for (auto _ : state) {
+        auto releasever = get_releasever(dir.path / "releasever");
+        benchmark::DoNotOptimize(releasever);
+    }
+}
+
+BENCHMARK(BM_IsCertExpired)->RangeMultiplier(10)->Range(MIN_FIXTURE_SIZE, MAX_FIXTURE_SIZE)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_GetEntitlementCertPaths)->RangeMultiplier(10)->Range(MIN_FIXTURE_SIZE, MAX_FIXTURE_SIZE)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_HasEntitlementCertificates)->RangeMultiplier(10)->Range(MIN_FIXTURE_SIZE, MAX_FIXTURE_SIZE)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_HasConsumerCertificate)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_InContainer)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_GetReleasever)->Unit(benchmark::kMicrosecond);
+
+}  // namespace
+
+BENCHMARK_MAIN();
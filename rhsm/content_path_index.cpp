@@ -0,0 +1,103 @@
+#include "content_path_index.hpp"
+
+namespace {
+
+/// Split a path into its segments; empty segments ("//", a trailing "/") are skipped
+std::vector<std::string_view> split_segments(std::string_view path) {
+    std::vector<std::string_view> segments;
+    while (!path.empty()) {
+        const auto slash = path.find('/');
+        const auto segment = path.substr(0, slash);
+        if (!segment.empty()) {
+            segments.push_back(segment);
+        }
+        path = slash == std::string_view::npos ? std::string_view() : path.substr(slash + 1);
+    }
+    return segments;
+}
+
+}  // namespace
+
+std::optional<std::string> content_path_of_url(std::string_view url, std::string_view baseurl) {
+    while (baseurl.ends_with('/')) {
+        baseurl.remove_suffix(1);
+    }
+    if (baseurl.empty() || !url.starts_with(baseurl)) {
+        return std::nullopt;
+    }
+    auto path = url.substr(baseurl.size());
+    path = path.substr(0, path.find_first_of("?#"));
+    if (!path.empty() && !path.starts_with('/')) {
+        // "https://cdn.redhat.com.example.com/..."
+        return std::nullopt;
+    }
+    return std::string(path);
+}
+
+ContentPathIndex::ContentPathIndex(const std::vector<EntitlementCert> &certs, const std::string_view baseurl) {
+    for (const auto &cert : certs) {
+        for (const auto &content : cert.contents) {
+            add_content_path(content.path, baseurl);
+        }
+    }
+}
+
+ContentPathIndex::ContentPathIndex(const std::vector<std::string> &content_paths, const std::string_view baseurl) {
+    for (const auto &content_path : content_paths) {
+        add_content_path(content_path, baseurl);
+    }
+}
+
+void ContentPathIndex::add_content_path(const std::string_view path, const std::string_view baseurl) {
+    if (path.find("://") == std::string_view::npos) {
+        add(path);
+    } else if (const auto relative_path = content_path_of_url(path, baseurl)) {
+        add(*relative_path);
+    }
+}
+
+void ContentPathIndex::add(const std::string_view path) {
+    const auto segments = split_segments(path);
+    if (segments.empty()) {
+        // The whole content server is never entitled
+        return;
+    }
+    Node *node = &root;
+    for (const auto segment : segments) {
+        std::unique_ptr<Node> *child = &node->variable;
+        if (segment.find('$') == std::string_view::npos) {
+            auto item = node->children.find(segment);
+            if (item == node->children.end()) {
+                item = node->children.emplace(std::string(segment), nullptr).first;
+            }
+            child = &item->second;
+        }
+        if (!*child) {
+            *child = std::make_unique<Node>();
+        }
+        node = child->get();
+    }
+    if (!node->leaf) {
+        node->leaf = true;
+        ++paths;
+    }
+}
+
+bool ContentPathIndex::is_entitled(const std::string_view path) const {
+    return match(root, split_segments(path), 0);
+}
+
+bool ContentPathIndex::match(const Node &node, const std::vector<std::string_view> &segments, const std::size_t next) {
+    if (node.leaf) {
+        return true;
+    }
+    if (next == segments.size()) {
+        return false;
+    }
+    // Both a literal and a variable segment can match; the literal one is tried first
+    if (const auto child = node.children.find(segments[next]); child != node.children.end() &&
+                                                                match(*child->second, segments, next + 1)) {
+        return true;
+    }
+    return node.variable && match(*node.variable, segments, next + 1);
+}
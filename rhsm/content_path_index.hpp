@@ -0,0 +1,67 @@
+#ifndef RHSM_DNF5_PLUGINS_CONTENT_PATH_INDEX_HPP
+#define RHSM_DNF5_PLUGINS_CONTENT_PATH_INDEX_HPP
+
+#include "entitlement_content.hpp"
+
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// Return the path of url relative to the content base URL, e.g. "/content/dist/rhel9/9/x86_64/baseos/os"
+/// for "https://cdn.redhat.com/content/dist/rhel9/9/x86_64/baseos/os/", or std::nullopt when the URL is
+/// not on the content server. The query and the fragment of the URL are ignored.
+std::optional<std::string> content_path_of_url(std::string_view url, std::string_view baseurl);
+
+/// The content paths of entitlement certificates, indexed by their segments, so that the URL of
+/// a repository can be checked in time proportional to the number of its segments instead of the
+/// number of content sets (certificates of Simple Content Access contain thousands of them).
+///
+/// A segment containing a dnf variable (e.g. "$releasever" or "rhel-$basearch") matches any one
+/// segment, the way the content server authorizes the paths of a certificate. A URL is entitled when
+/// a whole content path is its prefix.
+class ContentPathIndex {
+public:
+    ContentPathIndex() = default;
+
+    /// Index the content paths of all content sets of the certificates. Content paths that are absolute
+    /// URLs are indexed only when they are on the content server at baseurl.
+    ContentPathIndex(const std::vector<EntitlementCert> & certs, std::string_view baseurl);
+
+    /// Index the content paths, e.g. stored by the entitlement content cache (see entitlement_cache.hpp)
+    ContentPathIndex(const std::vector<std::string> & content_paths, std::string_view baseurl);
+
+    /// Add a content path relative to the content base URL
+    void add(std::string_view path);
+
+    /// Is the path (relative to the content base URL) in any indexed content path?
+    [[nodiscard]] bool is_entitled(std::string_view path) const;
+
+    /// Number of indexed content paths, without duplicates
+    [[nodiscard]] std::size_t size() const { return paths; }
+
+private:
+    struct Node {
+        std::map<std::string, std::unique_ptr<Node>, std::less<>> children;
+
+        /// The child for segments with variables
+        std::unique_ptr<Node> variable;
+
+        /// A content path ends here
+        bool leaf = false;
+    };
+
+    /// Add a content path of a content set, which may be an absolute URL on the content server at baseurl
+    void add_content_path(std::string_view path, std::string_view baseurl);
+
+    static bool match(const Node & node, const std::vector<std::string_view> & segments, std::size_t next);
+
+    Node root;
+    std::size_t paths = 0;
+};
+
+#endif // RHSM_DNF5_PLUGINS_CONTENT_PATH_INDEX_HPP
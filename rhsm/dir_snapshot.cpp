@@ -0,0 +1,85 @@
+#include "dir_snapshot.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <string_view>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+/// Size of the getdents64() buffer; it fits a few hundred entries, so a typical directory
+/// is read by one call returning the entries and one call returning the end of the directory
+constexpr std::size_t DIRENT_BUFFER_SIZE = 32 * 1024;
+
+/// Closes the file descriptor when it goes out of scope
+class FileDescriptor {
+public:
+    explicit FileDescriptor(int fd) : fd(fd) {}
+    FileDescriptor(const FileDescriptor &) = delete;
+    FileDescriptor & operator=(const FileDescriptor &) = delete;
+    ~FileDescriptor() {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+    int fd;
+};
+
+}  // namespace
+
+DirectorySnapshot::DirectorySnapshot(std::filesystem::path dir) : dir(std::move(dir)) {
+    const FileDescriptor dir_fd(openat(AT_FDCWD, this->dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+    if (dir_fd.fd < 0) {
+        return;
+    }
+    directory_exists = true;
+
+    alignas(struct dirent64) char buffer[DIRENT_BUFFER_SIZE];
+    while (true) {
+        const auto size = getdents64(dir_fd.fd, buffer, sizeof(buffer));
+        if (size < 0 && errno == EINTR) {
+            continue;
+        }
+        if (size <= 0) {
+            // like directory_iterator with an error_code, a read error ends the listing
+            break;
+        }
+        for (std::size_t offset = 0; offset < static_cast<std::size_t>(size);) {
+            const auto *entry = reinterpret_cast<const struct dirent64 *>(buffer + offset);
+            offset += entry->d_reclen;
+
+            const std::string_view name(entry->d_name);
+            // the same rules as path::extension() and path::stem(): ".pem" is a hidden file without extension
+            if (name.size() <= 4 || !name.ends_with(".pem")) {
+                continue;
+            }
+            if (name.ends_with("-key.pem")) {
+                key_names.emplace_back(name);
+            } else {
+                cert_names.emplace_back(name);
+            }
+        }
+    }
+
+    std::ranges::sort(cert_names);
+    std::ranges::sort(key_names);
+}
+
+std::vector<std::filesystem::path> DirectorySnapshot::get_cert_paths() const {
+    std::vector<std::filesystem::path> cert_paths;
+    cert_paths.reserve(cert_names.size());
+    for (const auto &name : cert_names) {
+        cert_paths.push_back(dir / name);
+    }
+    return cert_paths;
+}
+
+RhsmSnapshot take_rhsm_snapshot(const RhsmPaths &paths) {
+    return RhsmSnapshot{
+        .in_container = in_container(paths.rhsm_host_config_dir, paths.entitlement_host_cert_dir),
+        .consumer_certs = DirectorySnapshot(paths.consumer_cert_dir),
+        .entitlement_certs = DirectorySnapshot(paths.entitlement_cert_dir),
+    };
+}
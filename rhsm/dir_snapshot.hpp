@@ -0,0 +1,63 @@
+#ifndef RHSM_DNF5_PLUGINS_DIR_SNAPSHOT_HPP
+#define RHSM_DNF5_PLUGINS_DIR_SNAPSHOT_HPP
+
+#include "rhsm_utils.hpp"
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+/// Names of the entries of one directory, read once and classified in a single pass. The directory
+/// is opened with openat() and listed with getdents64(), so a snapshot of an existing directory costs
+/// one open, one close and usually two getdents64 calls, without any stat() of the directory or its
+/// entries. A missing or unreadable directory, or a path that is not a directory, gives an empty
+/// snapshot.
+class DirectorySnapshot {
+public:
+    DirectorySnapshot() = default;
+
+    /// Read the directory
+    explicit DirectorySnapshot(std::filesystem::path dir);
+
+    /// The path of the directory
+    [[nodiscard]] const std::filesystem::path & path() const { return dir; }
+
+    /// Was the directory read?
+    [[nodiscard]] bool exists() const { return directory_exists; }
+
+    /// Does the directory contain any .pem file, including keys?
+    [[nodiscard]] bool has_pem_files() const { return !cert_names.empty() || !key_names.empty(); }
+
+    /// Sorted names of .pem files that are not keys (*-key.pem)
+    [[nodiscard]] const std::vector<std::string> & get_cert_names() const { return cert_names; }
+
+    /// Sorted paths of .pem files that are not keys (*-key.pem)
+    [[nodiscard]] std::vector<std::filesystem::path> get_cert_paths() const;
+
+private:
+    std::filesystem::path dir;
+    bool directory_exists = false;
+    std::vector<std::string> cert_names;
+    std::vector<std::string> key_names;
+};
+
+/// All directories checked by the rhsm plugin when dnf starts. Every directory is read once
+/// and all checks are served from the snapshot.
+struct RhsmSnapshot {
+    /// The RHSM host directories exist, see in_container()
+    bool in_container = false;
+    DirectorySnapshot consumer_certs;
+    DirectorySnapshot entitlement_certs;
+
+    /// Is the system registered (a consumer certificate exists)?
+    [[nodiscard]] bool has_consumer_certificate() const { return consumer_certs.has_pem_files(); }
+
+    /// Does any entitlement certificate exist?
+    [[nodiscard]] bool has_entitlement_certificates() const { return entitlement_certs.has_pem_files(); }
+};
+
+/// Take the snapshot of the directories in paths. The host directories are only checked for
+/// existence, the consumer and entitlement certificate directories are listed.
+RhsmSnapshot take_rhsm_snapshot(const RhsmPaths & paths);
+
+#endif // RHSM_DNF5_PLUGINS_DIR_SNAPSHOT_HPP
@@ -0,0 +1,196 @@
+#include "entitlement_cache.hpp"
+
+#include "rhsm_utils.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <sys/stat.h>
+#include <json/json.h>
+
+namespace {
+
+/// Version of the format of the cache; a different version is ignored
+constexpr int CONTENT_CACHE_VERSION = 1;
+
+Json::Value path_key_to_json(const PathKey &key) {
+    Json::Value value(Json::objectValue);
+    value["inode"] = Json::Int64(key.inode);
+    value["mtime_ns"] = Json::Int64(key.mtime_ns);
+    value["ctime_ns"] = Json::Int64(key.ctime_ns);
+    return value;
+}
+
+std::optional<PathKey> path_key_from_json(const Json::Value &value) {
+    if (!value.isObject() || !value["inode"].isInt64() || !value["mtime_ns"].isInt64() || !value["ctime_ns"].isInt64()) {
+        return std::nullopt;
+    }
+    return PathKey{
+        .inode = value["inode"].asInt64(),
+        .mtime_ns = value["mtime_ns"].asInt64(),
+        .ctime_ns = value["ctime_ns"].asInt64(),
+    };
+}
+
+Json::Value redhat_repo_key_to_json(const RedhatRepoKey &key) {
+    Json::Value value(Json::objectValue);
+    value["product_cert_dir"] = path_key_to_json(key.product_cert_dir);
+    value["product_default_cert_dir"] = path_key_to_json(key.product_default_cert_dir);
+    value["content_overrides_file"] = path_key_to_json(key.content_overrides_file);
+    value["redhat_repo_file"] = path_key_to_json(key.redhat_repo_file);
+    value["baseurl"] = key.baseurl;
+    value["ca_cert"] = key.ca_cert;
+    value["arch"] = key.arch;
+    return value;
+}
+
+std::optional<RedhatRepoKey> redhat_repo_key_from_json(const Json::Value &value) {
+    if (!value.isObject() || !value["baseurl"].isString() || !value["ca_cert"].isString() || !value["arch"].isString()) {
+        return std::nullopt;
+    }
+    const auto product_cert_dir = path_key_from_json(value["product_cert_dir"]);
+    const auto product_default_cert_dir = path_key_from_json(value["product_default_cert_dir"]);
+    const auto content_overrides_file = path_key_from_json(value["content_overrides_file"]);
+    const auto redhat_repo_file = path_key_from_json(value["redhat_repo_file"]);
+    if (!product_cert_dir || !product_default_cert_dir || !content_overrides_file || !redhat_repo_file) {
+        return std::nullopt;
+    }
+    return RedhatRepoKey{
+        .product_cert_dir = *product_cert_dir,
+        .product_default_cert_dir = *product_default_cert_dir,
+        .content_overrides_file = *content_overrides_file,
+        .redhat_repo_file = *redhat_repo_file,
+        .baseurl = value["baseurl"].asString(),
+        .ca_cert = value["ca_cert"].asString(),
+        .arch = value["arch"].asString(),
+    };
+}
+
+Json::Value strings_to_json(const std::vector<std::string> &strings) {
+    Json::Value value(Json::arrayValue);
+    for (const auto &string : strings) {
+        value.append(string);
+    }
+    return value;
+}
+
+std::optional<std::vector<std::string>> strings_from_json(const Json::Value &value) {
+    if (!value.isArray()) {
+        return std::nullopt;
+    }
+    std::vector<std::string> strings;
+    strings.reserve(value.size());
+    for (const auto &item : value) {
+        if (!item.isString()) {
+            return std::nullopt;
+        }
+        strings.push_back(item.asString());
+    }
+    return strings;
+}
+
+}  // namespace
+
+PathKey get_path_key(const std::filesystem::path &path) {
+    struct stat st{};
+    if (stat(path.c_str(), &st) != 0) {
+        return {};
+    }
+    return PathKey{
+        .inode = static_cast<std::int64_t>(st.st_ino),
+        .mtime_ns = static_cast<std::int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec,
+        .ctime_ns = static_cast<std::int64_t>(st.st_ctim.tv_sec) * 1000000000 + st.st_ctim.tv_nsec,
+    };
+}
+
+RedhatRepoKey get_redhat_repo_key(const RhsmPaths &paths, const RedhatRepoOptions &options) {
+    return RedhatRepoKey{
+        .product_cert_dir = get_path_key(paths.product_cert_dir),
+        .product_default_cert_dir = get_path_key(paths.product_default_cert_dir),
+        .content_overrides_file = get_path_key(paths.content_overrides_file),
+        .redhat_repo_file = get_path_key(paths.redhat_repo_file),
+        .baseurl = options.baseurl,
+        .ca_cert = options.ca_cert,
+        .arch = options.arch,
+    };
+}
+
+EntitlementContentRecord make_entitlement_content_record(
+    const PathKey &entitlement_cert_dir,
+    const std::vector<std::string> &expired_entitlements,
+    const std::vector<EntitlementCert> &certs,
+    const std::vector<std::string> &errors) {
+    EntitlementContentRecord record{
+        .entitlement_cert_dir = entitlement_cert_dir,
+        .expired_entitlements = expired_entitlements,
+        .certificates = certs.size(),
+        .content_paths = {},
+        .errors = errors,
+        .redhat_repo = std::nullopt,
+        .redhat_repos = 0,
+    };
+    for (const auto &cert : certs) {
+        for (const auto &content : cert.contents) {
+            record.content_paths.push_back(content.path);
+        }
+    }
+    std::sort(record.content_paths.begin(), record.content_paths.end());
+    record.content_paths.erase(
+        std::unique(record.content_paths.begin(), record.content_paths.end()), record.content_paths.end());
+    return record;
+}
+
+std::optional<EntitlementContentRecord> read_entitlement_content_cache(
+    const std::filesystem::path &path,
+    const PathKey &entitlement_cert_dir,
+    const std::vector<std::string> &expired_entitlements) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        return std::nullopt;
+    }
+    Json::Value root;
+    Json::CharReaderBuilder reader_builder;
+    Json::String errors;
+    if (!Json::parseFromStream(reader_builder, file, &root, &errors) || !root.isObject()) {
+        return std::nullopt;
+    }
+
+    // The record is used only when everything is valid, the certificates can always be read again
+    if (!root["version"].isInt() || root["version"].asInt() != CONTENT_CACHE_VERSION ||
+        path_key_to_json(entitlement_cert_dir) != root["entitlement_cert_dir"] ||
+        strings_to_json(expired_entitlements) != root["expired_entitlements"] || !root["certificates"].isUInt64() ||
+        !root["redhat_repos"].isUInt64()) {
+        return std::nullopt;
+    }
+    auto content_paths = strings_from_json(root["content_paths"]);
+    auto cert_errors = strings_from_json(root["errors"]);
+    const auto &redhat_repo_json = root["redhat_repo"];
+    const auto redhat_repo = redhat_repo_key_from_json(redhat_repo_json);
+    if (!content_paths || !cert_errors || (!redhat_repo_json.isNull() && !redhat_repo)) {
+        return std::nullopt;
+    }
+    return EntitlementContentRecord{
+        .entitlement_cert_dir = entitlement_cert_dir,
+        .expired_entitlements = expired_entitlements,
+        .certificates = static_cast<std::size_t>(root["certificates"].asUInt64()),
+        .content_paths = std::move(*content_paths),
+        .errors = std::move(*cert_errors),
+        .redhat_repo = redhat_repo,
+        .redhat_repos = static_cast<std::size_t>(root["redhat_repos"].asUInt64()),
+    };
+}
+
+void write_entitlement_content_cache(const std::filesystem::path &path, const EntitlementContentRecord &record) {
+    Json::Value root(Json::objectValue);
+    root["version"] = CONTENT_CACHE_VERSION;
+    root["entitlement_cert_dir"] = path_key_to_json(record.entitlement_cert_dir);
+    root["expired_entitlements"] = strings_to_json(record.expired_entitlements);
+    root["certificates"] = Json::UInt64(record.certificates);
+    root["content_paths"] = strings_to_json(record.content_paths);
+    root["errors"] = strings_to_json(record.errors);
+    root["redhat_repo"] = record.redhat_repo ? redhat_repo_key_to_json(*record.redhat_repo) : Json::Value();
+    root["redhat_repos"] = Json::UInt64(record.redhat_repos);
+
+    Json::StreamWriterBuilder writer_builder;
+    writer_builder["indentation"] = "";
+    write_file_atomically(path, Json::writeString(writer_builder, root));
+}
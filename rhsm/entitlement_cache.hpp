@@ -0,0 +1,97 @@
+#ifndef RHSM_DNF5_PLUGINS_ENTITLEMENT_CACHE_HPP
+#define RHSM_DNF5_PLUGINS_ENTITLEMENT_CACHE_HPP
+
+#include "entitlement_content.hpp"
+#include "redhat_repo.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+/// Identity of a file or a directory: the inode, the modification time and the status change time
+/// (in nanoseconds), all -1 when the path does not exist. Adding, removing or renaming an entry of
+/// a directory changes its key; the inode and the ctime detect a directory replaced by a rename or
+/// restored with its original modification time.
+struct PathKey {
+    std::int64_t inode = -1;
+    std::int64_t mtime_ns = -1;
+    std::int64_t ctime_ns = -1;
+
+    bool operator==(const PathKey &) const = default;
+};
+
+/// Get the key of the path; one stat() call
+PathKey get_path_key(const std::filesystem::path & path);
+
+/// The inputs of update_redhat_repo() other than the entitlement certificates, and the generated file.
+/// The product certificate directories change when products are installed or removed (rpm replaces the
+/// certificates by a rename), the overrides file when subscription-manager writes it.
+struct RedhatRepoKey {
+    PathKey product_cert_dir;
+    PathKey product_default_cert_dir;
+    PathKey content_overrides_file;
+    PathKey redhat_repo_file;
+    std::string baseurl;
+    std::string ca_cert;
+    std::string arch;
+
+    bool operator==(const RedhatRepoKey &) const = default;
+};
+
+/// Get the key of the paths and the options; one stat() call per path
+RedhatRepoKey get_redhat_repo_key(const RhsmPaths & paths, const RedhatRepoOptions & options);
+
+/// What the rhsm plugin uses from the valid entitlement certificates, stored in the entitlement content
+/// cache (see write_entitlement_content_cache()), so that the following dnf invocations do not read and
+/// decode the certificates again while the entitlement certificate directory is unchanged
+struct EntitlementContentRecord {
+    /// The key of the entitlement certificate directory, taken before the certificates were read
+    PathKey entitlement_cert_dir;
+
+    /// Sorted names (stems) of the expired certificates, which were skipped. A certificate that expires
+    /// changes the valid certificates without changing the directory.
+    std::vector<std::string> expired_entitlements;
+
+    /// Number of valid certificates read
+    std::size_t certificates = 0;
+
+    /// Content paths of all content sets of the valid certificates, sorted, without duplicates;
+    /// see ContentPathIndex
+    std::vector<std::string> content_paths;
+
+    /// Errors of the certificates that could not be read
+    std::vector<std::string> errors;
+
+    /// The key of redhat.repo generated from the certificates, taken after the file was written; std::nullopt
+    /// when the file was not generated or any product certificate or override could not be read
+    std::optional<RedhatRepoKey> redhat_repo;
+
+    /// Number of repositories generated in redhat.repo
+    std::size_t redhat_repos = 0;
+
+    bool operator==(const EntitlementContentRecord &) const = default;
+};
+
+/// Create the record of the certificates read by read_entitlement_certs() after the key of the directory
+/// was taken
+EntitlementContentRecord make_entitlement_content_record(
+    const PathKey & entitlement_cert_dir,
+    const std::vector<std::string> & expired_entitlements,
+    const std::vector<EntitlementCert> & certs,
+    const std::vector<std::string> & errors);
+
+/// Read the record written by write_entitlement_content_cache(). The record is returned only when
+/// the key of the entitlement certificate directory and the expired certificates are the same.
+/// Returns std::nullopt otherwise, including when the file does not exist or cannot be parsed.
+std::optional<EntitlementContentRecord> read_entitlement_content_cache(
+    const std::filesystem::path & path,
+    const PathKey & entitlement_cert_dir,
+    const std::vector<std::string> & expired_entitlements);
+
+/// Atomically write the record for the following dnf invocations. Throws std::runtime_error on failure.
+void write_entitlement_content_cache(const std::filesystem::path & path, const EntitlementContentRecord & record);
+
+#endif // RHSM_DNF5_PLUGINS_ENTITLEMENT_CACHE_HPP
@@ -0,0 +1,337 @@
+#include "entitlement_content.hpp"
+
+#include "cert_cache.hpp"
+#include "der_validity.hpp"
+#include "rhsm_utils.hpp"
+
+#include <algorithm>
+#include <format>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <json/json.h>
+#include <zlib.h>
+
+namespace {
+
+/// Content types of v1 certificates, the second to last arc of the content OIDs
+const std::map<std::string, std::string, std::less<>> V1_CONTENT_TYPES{
+    {"1", "yum"},
+    {"2", "file"},
+    {"3", "kickstart"},
+};
+
+/// Split a comma separated list of tags or architectures; empty items are skipped
+std::vector<std::string> split_list(const std::string_view list) {
+    std::vector<std::string> items;
+    std::size_t begin = 0;
+    while (begin <= list.size()) {
+        auto end = list.find(',', begin);
+        if (end == std::string_view::npos) {
+            end = list.size();
+        }
+        auto item = list.substr(begin, end - begin);
+        const auto first = item.find_first_not_of(" \t");
+        if (first != std::string_view::npos) {
+            item = item.substr(first, item.find_last_not_of(" \t") - first + 1);
+            items.emplace_back(item);
+        }
+        begin = end + 1;
+    }
+    return items;
+}
+
+/// Split the arcs of an OID, "21.1.2" -> {"21", "1", "2"}
+std::vector<std::string> split_arcs(std::string_view oid) {
+    std::vector<std::string> arcs;
+    while (!oid.empty()) {
+        const auto dot = oid.find('.');
+        arcs.emplace_back(oid.substr(0, dot));
+        oid = dot == std::string_view::npos ? std::string_view() : oid.substr(dot + 1);
+    }
+    return arcs;
+}
+
+/// The value of a Red Hat extension; the values are DER strings, but some old certificates store
+/// the plain string
+std::string extension_string(const CertExtension &extension) {
+    if (auto value = read_der_string(extension.value)) {
+        return std::move(*value);
+    }
+    return std::string(extension.value.begin(), extension.value.end());
+}
+
+std::vector<CertExtension> read_extensions(const std::string_view pem) {
+    auto extensions = read_pem_extensions(pem);
+    if (!extensions) {
+        throw std::runtime_error("invalid certificate");
+    }
+    return std::move(*extensions);
+}
+
+std::string json_string(const Json::Value &value) {
+    return value.isString() ? value.asString() : std::string();
+}
+
+std::vector<std::string> json_strings(const Json::Value &value) {
+    std::vector<std::string> strings;
+    if (value.isArray()) {
+        for (const auto &item : value) {
+            if (item.isString()) {
+                strings.push_back(item.asString());
+            }
+        }
+    } else if (value.isString()) {
+        strings = split_list(value.asString());
+    }
+    return strings;
+}
+
+EntitlementContent content_from_json(const Json::Value &json, const std::vector<std::string> &product_arches) {
+    EntitlementContent content;
+    content.id = json_string(json["id"]);
+    content.type = json_string(json["type"]);
+    content.label = json_string(json["label"]);
+    content.name = json_string(json["name"]);
+    content.vendor = json_string(json["vendor"]);
+    content.path = json_string(json["path"]);
+    content.gpg_url = json_string(json["gpg_url"]);
+    content.required_tags = json_strings(json["required_tags"]);
+    content.arches = json_strings(json["arches"]);
+    if (json["enabled"].isBool()) {
+        content.enabled = json["enabled"].asBool();
+    }
+    if (json["metadata_expire"].isInt64()) {
+        content.metadata_expire = json["metadata_expire"].asInt64();
+    }
+    // Content sets without architectures are available for the architectures of the product
+    if (content.arches.empty()) {
+        content.arches = product_arches;
+    }
+    return content;
+}
+
+}  // namespace
+
+std::string zlib_decompress(const std::span<const unsigned char> data, const std::size_t max_size) {
+    z_stream stream{};
+    if (inflateInit(&stream) != Z_OK) {
+        throw std::runtime_error("could not initialize zlib");
+    }
+    const std::unique_ptr<z_stream, int (*)(z_stream *)> guard(&stream, inflateEnd);
+
+    std::string output;
+    stream.next_in = const_cast<Bytef *>(data.data());
+    stream.avail_in = static_cast<uInt>(data.size());
+    int result = Z_OK;
+    while (result != Z_STREAM_END) {
+        if (output.size() == max_size) {
+            throw std::runtime_error(std::format("decompressed data larger than {} bytes", max_size));
+        }
+        const auto offset = output.size();
+        output.resize(std::min(max_size, std::max<std::size_t>(offset * 2, 64 * 1024)));
+        stream.next_out = reinterpret_cast<Bytef *>(output.data() + offset);
+        stream.avail_out = static_cast<uInt>(output.size() - offset);
+        result = inflate(&stream, Z_NO_FLUSH);
+        output.resize(output.size() - stream.avail_out);
+        if (result == Z_BUF_ERROR && stream.avail_in == 0) {
+            throw std::runtime_error("truncated compressed data");
+        }
+        if (result != Z_OK && result != Z_STREAM_END && result != Z_BUF_ERROR) {
+            throw std::runtime_error(std::format("invalid compressed data: {}", stream.msg ? stream.msg : "unknown error"));
+        }
+    }
+    return output;
+}
+
+std::vector<EntitlementContent> decode_entitlement_data(const std::span<const unsigned char> compressed) {
+    const auto data = zlib_decompress(compressed, MAX_ENTITLEMENT_DATA_SIZE);
+
+    Json::Value root;
+    Json::CharReaderBuilder reader_builder;
+    Json::String errors;
+    const std::unique_ptr<Json::CharReader> reader(reader_builder.newCharReader());
+    if (!reader->parse(data.data(), data.data() + data.size(), &root, &errors)) {
+        throw std::runtime_error("could not parse entitlement data: " + errors);
+    }
+    if (!root.isObject() || !(root["products"].isArray() || root["products"].isNull())) {
+        throw std::runtime_error("invalid format of entitlement data");
+    }
+
+    std::vector<EntitlementContent> contents;
+    for (const auto &product : root["products"]) {
+        if (!product.isObject() || !product["content"].isArray()) {
+            continue;
+        }
+        const auto product_arches = json_strings(product["architectures"]);
+        for (const auto &content : product["content"]) {
+            if (content.isObject()) {
+                contents.push_back(content_from_json(content, product_arches));
+            }
+        }
+    }
+    return contents;
+}
+
+std::optional<std::vector<EntitlementContent>> decode_entitlement_data(const std::string_view pem) {
+    if (const auto compressed = read_pem_entitlement_data(pem)) {
+        return decode_entitlement_data(*compressed);
+    }
+    return std::nullopt;
+}
+
+std::vector<EntitlementContent> decode_v1_entitlement_content(const std::vector<CertExtension> &extensions) {
+    // 1.3.6.1.4.1.2312.9.2.<content id>.<content type>.<field>
+    std::map<std::string, EntitlementContent> contents;
+    std::vector<std::string> order;
+    for (const auto &extension : extensions) {
+        if (!extension.oid.starts_with(REDHAT_CONTENT_OID_PREFIX)) {
+            continue;
+        }
+        const auto parts = split_arcs(std::string_view(extension.oid).substr(REDHAT_CONTENT_OID_PREFIX.size()));
+        if (parts.size() != 3) {
+            continue;
+        }
+        const auto type = V1_CONTENT_TYPES.find(parts[1]);
+        const auto key = parts[0] + "." + parts[1];
+        auto [item, inserted] = contents.try_emplace(key);
+        auto &content = item->second;
+        if (inserted) {
+            order.push_back(key);
+            content.id = parts[0];
+            content.type = type != V1_CONTENT_TYPES.end() ? type->second : parts[1];
+        }
+
+        auto value = extension_string(extension);
+        const auto &field = parts[2];
+        if (field == "1") {
+            content.name = std::move(value);
+        } else if (field == "2") {
+            content.label = std::move(value);
+        } else if (field == "5") {
+            content.vendor = std::move(value);
+        } else if (field == "6") {
+            content.path = std::move(value);
+        } else if (field == "7") {
+            content.gpg_url = std::move(value);
+        } else if (field == "8") {
+            content.enabled = value != "0";
+        } else if (field == "9") {
+            try {
+                content.metadata_expire = std::stoll(value);
+            } catch (const std::exception &) {
+            }
+        } else if (field == "10") {
+            content.required_tags = split_list(value);
+        }
+    }
+
+    std::vector<EntitlementContent> result;
+    result.reserve(order.size());
+    for (const auto &key : order) {
+        result.push_back(std::move(contents[key]));
+    }
+    return result;
+}
+
+std::vector<EntitlementContent> decode_v1_entitlement_content(const std::string_view pem) {
+    return decode_v1_entitlement_content(read_extensions(pem));
+}
+
+EntitlementCert read_entitlement_cert(const std::filesystem::path &cert_path) {
+    EntitlementCert cert{
+        .cert_path = cert_path,
+        .key_path = cert_path.parent_path() / (cert_path.stem().string() + "-key.pem"),
+        .contents = {},
+    };
+    try {
+        // Certificates whose expiry was checked in the same dnf run are not read and decoded again
+        const auto facts = CertCache::get().get_file_facts(cert_path);
+        if (!facts->entitlement_data_error.empty()) {
+            throw std::runtime_error(facts->entitlement_data_error);
+        }
+        if (facts->entitlement_data) {
+            cert.contents = decode_entitlement_data(*facts->entitlement_data);
+        } else if (facts->redhat_extensions) {
+            cert.contents = decode_v1_entitlement_content(*facts->redhat_extensions);
+        } else {
+            throw std::runtime_error("invalid certificate");
+        }
+    } catch (const std::runtime_error &e) {
+        throw std::runtime_error(std::format("Unable to read entitlement certificate {}: {}", cert_path.string(), e.what()));
+    }
+    return cert;
+}
+
+std::vector<EntitlementCert> read_entitlement_certs(
+    const std::filesystem::path &entitlement_cert_dir,
+    const std::vector<std::string> &expired_entitlements,
+    std::vector<std::string> &errors) {
+    return read_entitlement_certs(get_entitlement_cert_paths(entitlement_cert_dir), expired_entitlements, errors);
+}
+
+std::vector<EntitlementCert> read_entitlement_certs(
+    const std::vector<std::filesystem::path> &cert_paths,
+    const std::vector<std::string> &expired_entitlements,
+    std::vector<std::string> &errors) {
+    std::vector<EntitlementCert> certs;
+    for (const auto &cert_path : cert_paths) {
+        if (std::find(expired_entitlements.begin(), expired_entitlements.end(), cert_path.stem().string()) !=
+            expired_entitlements.end()) {
+            continue;
+        }
+        try {
+            certs.push_back(read_entitlement_cert(cert_path));
+        } catch (const std::runtime_error &e) {
+            errors.emplace_back(e.what());
+        }
+    }
+    return certs;
+}
+
+std::vector<std::string> read_product_tags(const std::filesystem::path &product_cert_path) {
+    // Product certificates installed by the productid plugin in the same dnf run are not decoded again
+    std::vector<std::string> tags;
+    try {
+        const auto facts = CertCache::get().get_file_facts(product_cert_path);
+        if (!facts->redhat_extensions) {
+            throw std::runtime_error("invalid certificate");
+        }
+        // 1.3.6.1.4.1.2312.9.1.<product id>.4
+        for (const auto &extension : *facts->redhat_extensions) {
+            if (!extension.oid.starts_with(REDHAT_PRODUCT_OID_PREFIX)) {
+                continue;
+            }
+            const auto parts = split_arcs(std::string_view(extension.oid).substr(REDHAT_PRODUCT_OID_PREFIX.size()));
+            if (parts.size() == 2 && parts[1] == "4") {
+                for (auto &tag : split_list(extension_string(extension))) {
+                    tags.push_back(std::move(tag));
+                }
+            }
+        }
+    } catch (const std::runtime_error &e) {
+        throw std::runtime_error(std::format("Unable to read product certificate {}: {}", product_cert_path.string(), e.what()));
+    }
+    return tags;
+}
+
+std::set<std::string> read_provided_tags(
+    const std::vector<std::filesystem::path> &product_cert_dirs, std::vector<std::string> &errors) {
+    std::set<std::string> tags;
+    for (const auto &dir : product_cert_dirs) {
+        std::error_code ec;
+        for (const auto &entry : std::filesystem::directory_iterator(dir, ec)) {
+            if (entry.path().extension() != ".pem") {
+                continue;
+            }
+            try {
+                for (auto &tag : read_product_tags(entry.path())) {
+                    tags.insert(std::move(tag));
+                }
+            } catch (const std::runtime_error &e) {
+                errors.emplace_back(e.what());
+            }
+        }
+    }
+    return tags;
+}
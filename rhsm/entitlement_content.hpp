@@ -0,0 +1,114 @@
+#ifndef RHSM_DNF5_PLUGINS_ENTITLEMENT_CONTENT_HPP
+#define RHSM_DNF5_PLUGINS_ENTITLEMENT_CONTENT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <set>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "der_validity.hpp"
+
+/// Prefix of the OIDs of the products in entitlement and product certificates:
+/// <prefix><product id>.<field>, e.g. field 4 are the tags provided by the product
+constexpr std::string_view REDHAT_PRODUCT_OID_PREFIX = "1.3.6.1.4.1.2312.9.1.";
+
+/// Prefix of the OIDs of the content sets in v1 entitlement certificates:
+/// <prefix><content id>.<content type>.<field>
+constexpr std::string_view REDHAT_CONTENT_OID_PREFIX = "1.3.6.1.4.1.2312.9.2.";
+
+/// Maximum size of the decompressed entitlement data of one v3 certificate. Certificates of
+/// Simple Content Access contain all content sets of the organization, which is a few MiB of JSON.
+constexpr std::size_t MAX_ENTITLEMENT_DATA_SIZE = 64 * 1024 * 1024;
+
+/// One content set (repository) of an entitlement
+struct EntitlementContent {
+    std::string id;
+
+    /// "yum", "file", "kickstart", ...; only "yum" content sets are repositories
+    std::string type;
+
+    /// The repository ID
+    std::string label;
+    std::string name;
+    std::string vendor;
+
+    /// The path relative to the content base URL; it may contain dnf variables like $releasever
+    std::string path;
+    std::string gpg_url;
+    bool enabled = true;
+    std::optional<std::int64_t> metadata_expire;
+
+    /// Tags that have to be provided by installed products, see read_provided_tags()
+    std::vector<std::string> required_tags;
+
+    /// Architectures of the content set; empty for all architectures
+    std::vector<std::string> arches;
+
+    bool operator==(const EntitlementContent &) const = default;
+};
+
+/// The content sets of one entitlement certificate and the certificate and key used to access them
+struct EntitlementCert {
+    std::filesystem::path cert_path;
+    std::filesystem::path key_path;
+    std::vector<EntitlementContent> contents;
+};
+
+/// Decompress zlib (RFC 1950) data. Throws std::runtime_error when the data is not valid,
+/// truncated, or larger than max_size when decompressed.
+std::string zlib_decompress(std::span<const unsigned char> data, std::size_t max_size);
+
+/// Decode the content sets of a v3 entitlement certificate, stored in the "ENTITLEMENT DATA"
+/// PEM block following the certificate as base64 encoded, zlib compressed JSON. Returns
+/// std::nullopt when there is no such block (e.g. in v1 certificates).
+/// Throws std::runtime_error when the block cannot be decoded.
+std::optional<std::vector<EntitlementContent>> decode_entitlement_data(std::string_view pem);
+
+/// Decode the content sets of the base64 decoded "ENTITLEMENT DATA" block (see CertFacts::entitlement_data).
+/// Throws std::runtime_error when the data cannot be decoded.
+std::vector<EntitlementContent> decode_entitlement_data(std::span<const unsigned char> compressed);
+
+/// Decode the content sets of a v1 entitlement certificate, stored in certificate extensions.
+/// Throws std::runtime_error when the certificate cannot be parsed.
+std::vector<EntitlementContent> decode_v1_entitlement_content(std::string_view pem);
+
+/// Decode the content sets of a v1 entitlement certificate from its extensions (see CertFacts::redhat_extensions)
+std::vector<EntitlementContent> decode_v1_entitlement_content(const std::vector<CertExtension> & extensions);
+
+/// Read the content sets of the entitlement certificate in cert_path, v3 or v1. The key is expected
+/// next to the certificate, "123.pem" -> "123-key.pem", like subscription-manager stores them.
+/// The content sets are in the order they are stored in the certificate.
+/// Throws std::runtime_error when the file cannot be read or the certificate cannot be decoded.
+EntitlementCert read_entitlement_cert(const std::filesystem::path & cert_path);
+
+/// Read the entitlement certificates in the directory (see get_entitlement_cert_paths()), sorted by their paths.
+/// Certificates whose names (stems) are in expired_entitlements are skipped, like subscription-manager
+/// uses only valid certificates. Certificates that cannot be read are skipped and their errors are
+/// appended to errors.
+std::vector<EntitlementCert> read_entitlement_certs(
+    const std::filesystem::path & entitlement_cert_dir,
+    const std::vector<std::string> & expired_entitlements,
+    std::vector<std::string> & errors);
+
+/// Like read_entitlement_certs() above, but read the certificates in cert_paths (e.g. the paths of a
+/// DirectorySnapshot taken by the status check) instead of listing the directory again
+std::vector<EntitlementCert> read_entitlement_certs(
+    const std::vector<std::filesystem::path> & cert_paths,
+    const std::vector<std::string> & expired_entitlements,
+    std::vector<std::string> & errors);
+
+/// Read the tags provided by the products in a product certificate, e.g. "rhel-9,rhel-9-x86_64".
+/// Throws std::runtime_error when the file cannot be read or the certificate cannot be parsed.
+std::vector<std::string> read_product_tags(const std::filesystem::path & product_cert_path);
+
+/// Read the tags provided by all product certificates (.pem files) in the directories. Certificates
+/// that cannot be parsed are skipped and their errors are appended to errors.
+std::set<std::string> read_provided_tags(
+    const std::vector<std::filesystem::path> & product_cert_dirs, std::vector<std::string> & errors);
+
+#endif // RHSM_DNF5_PLUGINS_ENTITLEMENT_CONTENT_HPP
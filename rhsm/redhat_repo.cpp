@@ -0,0 +1,345 @@
+#include "redhat_repo.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <format>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+#include <sys/utsname.h>
+#include <json/json.h>
+
+namespace {
+
+constexpr std::string_view REDHAT_REPO_HEADER =
+    "#\n"
+    "# Certificate-Based Repositories\n"
+    "# Managed by the rhsm dnf5 plugin\n"
+    "#\n"
+    "# *** This file is auto-generated.  Changes made here will be over-written. ***\n"
+    "# *** Use \"subscription-manager repo-override --help\" if you wish to make changes. ***\n"
+    "#\n"
+    "# If this file is empty and this system is subscribed consider\n"
+    "# a \"dnf repolist\" to refresh available repos\n"
+    "#\n";
+
+/// Defaults of the options of the [rhsm] section used by read_rhsm_config(), as in subscription-manager
+const std::map<std::string, std::string> RHSM_CONFIG_DEFAULTS{
+    {"baseurl", CONTENT_BASEURL},
+    {"ca_cert_dir", "/etc/rhsm/ca/"},
+    {"manage_repos", "1"},
+    {"repo_ca_cert", "%(ca_cert_dir)sredhat-uep.pem"},
+};
+
+/// Python configparser allows more than one level of references
+constexpr int MAX_INTERPOLATION_DEPTH = 10;
+
+std::string_view trim(std::string_view value) {
+    const auto begin = value.find_first_not_of(" \t\r");
+    if (begin == std::string_view::npos) {
+        return {};
+    }
+    return value.substr(begin, value.find_last_not_of(" \t\r") - begin + 1);
+}
+
+/// Replace "%(name)s" with the value of the option and "%%" with "%"
+std::string interpolate(const std::string &value, const std::map<std::string, std::string> &options, const int depth) {
+    if (depth > MAX_INTERPOLATION_DEPTH) {
+        throw std::runtime_error("too deep interpolation of value: " + value);
+    }
+    std::string result;
+    for (std::size_t pos = 0; pos < value.size();) {
+        const auto percent = value.find('%', pos);
+        result.append(value, pos, percent - pos);
+        if (percent == std::string::npos) {
+            break;
+        }
+        if (value.compare(percent, 2, "%%") == 0) {
+            result += '%';
+            pos = percent + 2;
+            continue;
+        }
+        const auto end = value.find(")s", percent);
+        if (value.compare(percent, 2, "%(") != 0 || end == std::string::npos) {
+            throw std::runtime_error("invalid interpolation syntax in value: " + value);
+        }
+        const auto name = value.substr(percent + 2, end - percent - 2);
+        const auto option = options.find(name);
+        if (option == options.end()) {
+            throw std::runtime_error("bad interpolation variable reference: " + name);
+        }
+        result += interpolate(option->second, options, depth + 1);
+        pos = end + 2;
+    }
+    return result;
+}
+
+/// Options that cannot be overridden; the same options are rejected by the entitlement server
+constexpr std::string_view PROTECTED_OPTIONS[]{"baseurl", "label", "name"};
+
+/// 32-bit x86 architectures, which can be used on x86_64 too
+bool is_x86(const std::string_view arch) {
+    return arch == "x86" || (arch.size() == 4 && arch[0] == 'i' && arch[1] >= '3' && arch[1] <= '6' && arch.substr(2) == "86");
+}
+
+/// Repository IDs are used as section names; they must not break the syntax of the file
+bool is_valid_label(const std::string_view label) {
+    return !label.empty() && std::none_of(label.begin(), label.end(), [](const char ch) {
+        return ch == '[' || ch == ']' || ch == '=' || static_cast<unsigned char>(ch) <= ' ';
+    });
+}
+
+/// Option names of overrides must not break the syntax of the file
+bool is_valid_option_name(const std::string_view name) {
+    return !name.empty() && std::none_of(name.begin(), name.end(), [](const char ch) {
+        return ch == '[' || ch == '=' || static_cast<unsigned char>(ch) <= ' ';
+    });
+}
+
+/// Values are written on one line
+std::string single_line(std::string value) {
+    std::replace_if(value.begin(), value.end(), [](const char ch) { return ch == '\n' || ch == '\r'; }, ' ');
+    return value;
+}
+
+/// Join the base URL and a content path; absolute URLs are used as they are
+std::string join_url(std::string_view baseurl, const std::string_view path) {
+    if (path.find("://") != std::string_view::npos) {
+        return std::string(path);
+    }
+    while (baseurl.ends_with('/')) {
+        baseurl.remove_suffix(1);
+    }
+    return std::string(baseurl) + (path.starts_with('/') ? "" : "/") + std::string(path);
+}
+
+bool is_content_available(const EntitlementContent &content, const RedhatRepoOptions &options) {
+    if (content.type != "yum" || !is_valid_label(content.label)) {
+        return false;
+    }
+    if (!options.arch.empty() && !is_arch_compatible(content.arches, options.arch)) {
+        return false;
+    }
+    return std::all_of(content.required_tags.begin(), content.required_tags.end(), [&options](const auto &tag) {
+        return options.provided_tags.contains(tag);
+    });
+}
+
+/// Select the repositories, indexed (and so sorted) by their IDs
+std::map<std::string, std::pair<const EntitlementCert *, const EntitlementContent *>> select_repos(
+    const std::vector<EntitlementCert> &certs, const RedhatRepoOptions &options) {
+    std::map<std::string, std::pair<const EntitlementCert *, const EntitlementContent *>> repos;
+    for (const auto &cert : certs) {
+        for (const auto &content : cert.contents) {
+            if (is_content_available(content, options)) {
+                repos.try_emplace(content.label, &cert, &content);
+            }
+        }
+    }
+    return repos;
+}
+
+}  // namespace
+
+ContentOverrides read_content_overrides(const std::filesystem::path &path) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        if (!std::filesystem::exists(path)) {
+            return {};
+        }
+        throw std::runtime_error("could not open file: " + path.string());
+    }
+
+    Json::Value root;
+    Json::CharReaderBuilder reader_builder;
+    Json::String errors;
+    if (!Json::parseFromStream(reader_builder, file, &root, &errors)) {
+        throw std::runtime_error(std::format("could not parse file {}: {}", path.string(), errors));
+    }
+    if (!root.isArray()) {
+        throw std::runtime_error("invalid format of file: " + path.string());
+    }
+
+    ContentOverrides overrides;
+    for (const auto &item : root) {
+        // Invalid overrides are ignored, like subscription-manager does
+        if (!item.isObject() || !item["contentLabel"].isString() || !item["name"].isString() ||
+            !item["value"].isString()) {
+            continue;
+        }
+        overrides[item["contentLabel"].asString()][item["name"].asString()] = item["value"].asString();
+    }
+    return overrides;
+}
+
+RhsmConfig read_rhsm_config(const std::filesystem::path &path) {
+    auto options = RHSM_CONFIG_DEFAULTS;
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        if (std::filesystem::exists(path)) {
+            throw std::runtime_error("could not open file: " + path.string());
+        }
+    }
+    bool in_rhsm_section = false;
+    for (std::string line; std::getline(file, line);) {
+        const auto content = trim(line);
+        if (content.empty() || content.starts_with('#') || content.starts_with(';')) {
+            continue;
+        }
+        if (content.starts_with('[')) {
+            in_rhsm_section = content == "[rhsm]";
+            continue;
+        }
+        const auto separator = content.find_first_of("=:");
+        if (!in_rhsm_section || separator == std::string_view::npos) {
+            continue;
+        }
+        // Option names are case-insensitive
+        auto name = std::string(trim(content.substr(0, separator)));
+        std::transform(name.begin(), name.end(), name.begin(), [](const unsigned char ch) { return std::tolower(ch); });
+        options[name] = trim(content.substr(separator + 1));
+    }
+    if (file.bad()) {
+        throw std::runtime_error("could not read file: " + path.string());
+    }
+
+    const auto value = [&](const std::string &name) {
+        auto result = interpolate(options.at(name), options, 0);
+        return result.empty() ? interpolate(RHSM_CONFIG_DEFAULTS.at(name), options, 0) : result;
+    };
+    RhsmConfig config;
+    auto manage_repos = value("manage_repos");
+    std::transform(manage_repos.begin(), manage_repos.end(), manage_repos.begin(), [](const unsigned char ch) {
+        return std::tolower(ch);
+    });
+    if (manage_repos == "yes" || manage_repos == "true" || manage_repos == "on") {
+        config.manage_repos = true;
+    } else if (manage_repos == "no" || manage_repos == "false" || manage_repos == "off") {
+        config.manage_repos = false;
+    } else {
+        try {
+            std::size_t end = 0;
+            config.manage_repos = std::stoi(manage_repos, &end) != 0;
+            if (end != manage_repos.size()) {
+                throw std::invalid_argument(manage_repos);
+            }
+        } catch (const std::exception &) {
+            throw std::runtime_error(std::format("invalid value of manage_repos in {}: \"{}\"", path.string(), manage_repos));
+        }
+    }
+    // subscription-manager uses https when the scheme is missing
+    config.baseurl = value("baseurl");
+    if (config.baseurl.find("://") == std::string::npos) {
+        config.baseurl = "https://" + config.baseurl;
+    }
+    config.repo_ca_cert = value("repo_ca_cert");
+    return config;
+}
+
+std::string get_system_arch() {
+    struct utsname name{};
+    if (uname(&name) != 0) {
+        return std::string();
+    }
+    return name.machine;
+}
+
+bool is_arch_compatible(const std::vector<std::string> &arches, const std::string_view arch) {
+    if (arches.empty()) {
+        return true;
+    }
+    return std::any_of(arches.begin(), arches.end(), [arch](const std::string &content_arch) {
+        return content_arch == arch || content_arch == "ALL" || content_arch == "noarch" ||
+               (is_x86(content_arch) && (arch == "x86_64" || is_x86(arch)));
+    });
+}
+
+std::string render_redhat_repo(const std::vector<EntitlementCert> &certs, const RedhatRepoOptions &options) {
+    std::string output(REDHAT_REPO_HEADER);
+    for (const auto &[label, source] : select_repos(certs, options)) {
+        const auto &[cert, content] = source;
+        const std::string enabled = content->enabled ? "1" : "0";
+        std::vector<std::pair<std::string, std::string>> repo_options{
+            {"name", single_line(content->name)},
+            {"baseurl", single_line(join_url(options.baseurl, content->path))},
+            {"enabled", enabled},
+            {"gpgcheck", content->gpg_url.empty() ? "0" : "1"},
+        };
+        if (!content->gpg_url.empty()) {
+            repo_options.emplace_back("gpgkey", single_line(join_url(options.baseurl, content->gpg_url)));
+        }
+        repo_options.insert(repo_options.end(), {
+            {"sslverify", "1"},
+            {"sslcacert", single_line(options.ca_cert)},
+            {"sslclientkey", single_line(cert->key_path.string())},
+            {"sslclientcert", single_line(cert->cert_path.string())},
+            {"sslverifystatus", "1"},
+        });
+        if (content->metadata_expire) {
+            repo_options.emplace_back("metadata_expire", std::to_string(*content->metadata_expire));
+        }
+        repo_options.emplace_back("enabled_metadata", enabled);
+
+        // Overridden options replace the generated values; other options are appended in the order of their names
+        const auto find_option = [&repo_options](const std::string &name) {
+            return std::find_if(repo_options.begin(), repo_options.end(), [&name](const auto &item) {
+                return item.first == name;
+            });
+        };
+        if (const auto overrides = options.overrides.find(label); overrides != options.overrides.end()) {
+            for (const auto &[name, value] : overrides->second) {
+                if (!is_valid_option_name(name) ||
+                    std::find(std::begin(PROTECTED_OPTIONS), std::end(PROTECTED_OPTIONS), name) !=
+                        std::end(PROTECTED_OPTIONS)) {
+                    continue;
+                }
+                if (const auto option = find_option(name); option != repo_options.end()) {
+                    option->second = single_line(value);
+                } else {
+                    repo_options.emplace_back(name, single_line(value));
+                }
+            }
+            // The metadata of a repository enabled by an override are used too, unless overridden separately
+            if (overrides->second.contains("enabled") && !overrides->second.contains("enabled_metadata")) {
+                find_option("enabled_metadata")->second = find_option("enabled")->second;
+            }
+        }
+
+        output += "\n[" + label + "]\n";
+        for (const auto &[name, value] : repo_options) {
+            output += name + " = " + value + "\n";
+        }
+    }
+    return output;
+}
+
+bool write_file_if_changed(const std::filesystem::path &path, const std::string &content) {
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (file.is_open()) {
+            std::ostringstream current;
+            current << file.rdbuf();
+            if (!file.bad() && current.view() == content) {
+                return false;
+            }
+        }
+    }
+    write_file_atomically(path, content);
+    return true;
+}
+
+RedhatRepoUpdate update_redhat_repo(
+    const RhsmPaths &paths, const std::vector<EntitlementCert> &certs, RedhatRepoOptions options) {
+    RedhatRepoUpdate result;
+    options.provided_tags = read_provided_tags({paths.product_cert_dir, paths.product_default_cert_dir}, result.errors);
+    try {
+        options.overrides = read_content_overrides(paths.content_overrides_file);
+    } catch (const std::runtime_error &e) {
+        result.errors.push_back(std::format("Unable to read content overrides: {}", e.what()));
+    }
+
+    result.repos = select_repos(certs, options).size();
+    result.written = write_file_if_changed(paths.redhat_repo_file, render_redhat_repo(certs, options));
+    return result;
+}
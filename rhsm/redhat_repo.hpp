@@ -0,0 +1,98 @@
+#ifndef RHSM_DNF5_PLUGINS_REDHAT_REPO_HPP
+#define RHSM_DNF5_PLUGINS_REDHAT_REPO_HPP
+
+#include "entitlement_content.hpp"
+#include "rhsm_utils.hpp"
+
+#include <cstddef>
+#include <filesystem>
+#include <map>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+constexpr const char * CONTENT_BASEURL = "https://cdn.redhat.com";
+constexpr const char * REPO_CA_CERT = "/etc/rhsm/ca/redhat-uep.pem";
+
+/// The repository settings in the [rhsm] section of the configuration of subscription-manager
+struct RhsmConfig {
+    /// Are repositories generated from the entitlement certificates (manage_repos)?
+    bool manage_repos = true;
+
+    /// The content server, e.g. a Satellite or a proxy CDN (baseurl)
+    std::string baseurl{CONTENT_BASEURL};
+
+    /// The CA certificate verifying the content server (repo_ca_cert)
+    std::string repo_ca_cert{REPO_CA_CERT};
+};
+
+/// Read the [rhsm] section of the configuration of subscription-manager (/etc/rhsm/rhsm.conf). Values
+/// may refer to other options of the section with "%(name)s" like in Python configparser, e.g.
+/// "repo_ca_cert = %(ca_cert_dir)sredhat-uep.pem". Missing options and a missing file give the defaults
+/// of subscription-manager. Throws std::runtime_error if the file cannot be read or manage_repos is
+/// not a boolean or a number.
+RhsmConfig read_rhsm_config(const std::filesystem::path & path);
+
+/// Repository options overridden by "subscription-manager repo-override": the option values indexed
+/// by the repository ID (content label) and the option name
+using ContentOverrides = std::map<std::string, std::map<std::string, std::string>>;
+
+/// Read the content overrides cached by subscription-manager, a JSON array of objects with
+/// "contentLabel", "name" and "value". Returns no overrides when the file does not exist.
+/// Throws std::runtime_error if the file cannot be read or parsed.
+ContentOverrides read_content_overrides(const std::filesystem::path & path);
+
+/// How repositories are generated from the content sets of entitlement certificates
+struct RedhatRepoOptions {
+    /// The base URL of the content paths
+    std::string baseurl{CONTENT_BASEURL};
+
+    /// The CA certificate verifying the content server
+    std::string ca_cert{REPO_CA_CERT};
+
+    /// The architecture of the system; content sets of other architectures are skipped.
+    /// Empty to keep content sets of all architectures.
+    std::string arch;
+
+    /// Tags provided by the installed products; content sets requiring any other tag are skipped
+    std::set<std::string> provided_tags;
+
+    ContentOverrides overrides;
+};
+
+/// Return the architecture of the running system (the machine of uname(2))
+std::string get_system_arch();
+
+/// Check if a content set for the given architectures can be used on a system of the architecture arch
+bool is_arch_compatible(const std::vector<std::string> & arches, std::string_view arch);
+
+/// Generate redhat.repo with one repository for each "yum" content set of the certificates that
+/// matches the architecture and the provided tags. Repositories are sorted by their ID; when
+/// several certificates provide the same content set, the first certificate is used. The output
+/// depends only on the arguments, so it does not change when nothing changed.
+std::string render_redhat_repo(const std::vector<EntitlementCert> & certs, const RedhatRepoOptions & options);
+
+/// Replace the file atomically, but only when its content differs. Returns true if the file was written.
+/// Throws std::runtime_error on failure.
+bool write_file_if_changed(const std::filesystem::path & path, const std::string & content);
+
+/// The result of update_redhat_repo()
+struct RedhatRepoUpdate {
+    /// Number of generated repositories
+    std::size_t repos = 0;
+
+    /// The file was written, because its content changed
+    bool written = false;
+
+    /// Errors of product certificates and of the overrides that were skipped
+    std::vector<std::string> errors;
+};
+
+/// Generate paths.redhat_repo_file from the entitlement certificates (see read_entitlement_certs()),
+/// the installed product certificates and the content overrides in paths.
+/// Throws std::runtime_error if the file cannot be written.
+RedhatRepoUpdate update_redhat_repo(
+    const RhsmPaths & paths, const std::vector<EntitlementCert> & certs, RedhatRepoOptions options);
+
+#endif // RHSM_DNF5_PLUGINS_REDHAT_REPO_HPP
@@ -1,14 +1,25 @@
 #include <libdnf5/base/base.hpp>
 #include <libdnf5/plugin/iplugin.hpp>
+#include <libdnf5/repo/repo_query.hpp>
 
+#include <algorithm>
 #include <cstring>
+#include <ctime>
 #include <format>
+#include <future>
 #include <iostream>
+#include <map>
+#include <optional>
 #include <unistd.h>
-#include <openssl/pem.h>
-#include <openssl/types.h>
-#include <openssl/x509.h>
 
+#include "content_path_index.hpp"
+#include "entitlement_cache.hpp"
+#include "plugin_logger.hpp"
+#include "plugin_metrics.hpp"
+#include "plugin_trace.hpp"
+#include "redhat_repo.hpp"
+#include "rhsm_status.hpp"
+#include "rhsm_status_client.hpp"
 #include "rhsm_utils.hpp"
 
 using namespace libdnf5;
@@ -25,6 +36,20 @@ namespace {
         "RHSM plugin for subscription status checks and warnings."
     };
 
+    using RhsmLogger = PluginLogger<"[rhsm plugin] ">;
+
+    /// The modification time of repomd.xml in the metadata cache of the repository; std::nullopt when
+    /// the metadata are not cached
+    std::optional<std::filesystem::file_time_type> get_repomd_mtime(const repo::Repo & repo) {
+        std::error_code ec;
+        const auto mtime = std::filesystem::last_write_time(
+            std::filesystem::path(repo.get_cachedir()) / "repodata" / "repomd.xml", ec);
+        if (ec) {
+            return std::nullopt;
+        }
+        return mtime;
+    }
+
 
     class RhsmPlugin final : public plugin::IPlugin {
     public:
@@ -32,6 +57,9 @@ namespace {
         /// This is not necessary when you only need the Base object for your implementation.
         /// Optional to override.
         RhsmPlugin(plugin::IPluginData &data, ConfigParser &config) : IPlugin(data), config(config) {
+            if (config.has_option("main", "log_level") && !log_level_from_string(config.get_value("main", "log_level"))) {
+                logger.warning("Invalid value of log_level: \"{}\"", config.get_value("main", "log_level"));
+            }
         }
 
         /// Fill in the API version of your plugin.
@@ -63,94 +91,656 @@ namespace {
             return nullptr;
         }
 
+        /// Start the status checks in the background, so that they overlap with the setup of Base
+        void pre_base_setup() override { start_status_check(); };
+
         void post_base_setup() override { print_warnings(); };
 
+        /// Called before the metadata of the repositories are loaded
+        void repos_configured() override {
+            skip_unentitled_repos();
+            record_repo_metadata();
+        };
+
+        void repos_loaded() override { update_expiry_cache(); };
+
+        void finish() noexcept override {
+            write_trace();
+            write_metrics();
+        };
+
         ConfigParser &config;
 
     private:
-        void print_warnings() const;
+        [[nodiscard]] RhsmLogger::Level get_log_level() const;
+
+        void resolve_paths();
+
+        void resolve_status_cache_ttl();
+
+        void resolve_status_service_socket();
+
+        void resolve_status_snapshot_file();
+
+        void resolve_repo_options();
+
+        bool get_boolean_option(const std::string & option, bool default_value);
+
+        void start_status_check();
+
+        RhsmStatus get_status();
+
+        void print_warnings();
+
+        void update_entitlement_content(const RhsmStatus & status);
+
+        std::vector<EntitlementCert> read_entitlements(
+            const RhsmStatus & status, const PathKey & cert_dir_key, std::vector<std::string> & errors);
+
+        void update_repos(
+            const std::vector<EntitlementCert> & certs, RedhatRepoKey repo_key, EntitlementContentRecord & record);
+
+        void index_content_paths(const EntitlementContentRecord & record);
+
+        void write_content_cache(const EntitlementContentRecord & record);
+
+        void skip_unentitled_repos();
+
+        void update_expiry_cache();
+
+        void record_repo_metadata();
+
+        bool repo_metadata_refreshed();
+
+        void write_expiry_cache();
+
+        void write_status_cache(const RhsmStatus & status);
+
+        void write_status_snapshot(const RhsmStatus & status);
 
         void warn_system_not_registered() const;
 
         void warn_no_entitlements() const;
 
-        std::vector<std::string> get_expired_entitlements(const std::filesystem::path & entitlement_cert_dir) const;
+        void warn_entitlements_expired(const std::vector<std::string> & expired) const;
+
+        void log_releasever(const RhsmStatus & status) const;
+
+        void write_trace() const noexcept;
+
+        void export_status(const RhsmStatus & status);
+
+        void write_metrics() noexcept;
+
+        /// Messages of the plugin, written up to the level of get_log_level()
+        RhsmLogger logger{*get_base().get_logger(), get_log_level()};
+
+        /// Spans of the hooks and their phases; disabled unless trace_dir or RHSM_DNF5_PLUGINS_TRACE_DIR is set
+        Tracer tracer{Tracer::get_plugin_trace_path(
+            PLUGIN_NAME, config.has_option("main", "trace_dir") ? config.get_value("main", "trace_dir") : "")};
+
+        /// Metrics of this run for the node_exporter textfile collector; disabled unless metrics_file is set
+        PluginMetrics metrics{
+            PLUGIN_NAME, config.has_option("main", "metrics_file") ? config.get_value("main", "metrics_file") : ""};
+
+        /// Paths of certificates and configuration resolved relative to the installroot
+        RhsmPaths paths;
+
+        /// notAfter dates of entitlement certificates cached across dnf invocations
+        CertExpiryCache expiry_cache{EXPIRY_CACHE_FILE};
+
+        /// Has expiry_cache been read? It is not used when the status is memoized.
+        bool expiry_cache_read = false;
+
+        /// Modification times of the cached repomd.xml of the enabled repositories before their metadata
+        /// are loaded, by repository ID; std::nullopt when the metadata are not cached
+        std::map<std::string, std::optional<std::filesystem::file_time_type>> repomd_mtimes;
+
+        /// How long (in seconds) the status can be reused by the following dnf invocations
+        std::int64_t status_cache_ttl = DEFAULT_STATUS_CACHE_TTL;
 
-        void warn_entitlements_expired() const;
+        /// Socket of the status service asked before the status is checked in-process; empty when
+        /// the service is not used
+        std::filesystem::path status_service_socket{STATUS_SERVICE_SOCKET};
 
-        void log_releasever() const;
+        /// The status snapshot for monitoring written by each dnf run; empty when it is not written
+        std::filesystem::path status_snapshot_file{STATUS_SNAPSHOT_FILE};
 
-        template<typename... Ss>
-        void debug_log(std::string_view format, Ss &&... args) const;
+        /// Is redhat.repo generated from the entitlement certificates?
+        bool manage_repos = true;
 
-        template<typename... Ss>
-        void info_log(std::string_view format, Ss &&... args) const;
+        /// The repository settings of subscription-manager
+        RhsmConfig rhsm_config;
 
-        template<typename... Ss>
-        void warning_log(std::string_view format, Ss &&... args) const;
+        /// The base URL of the content server of the repositories in redhat.repo: the one of the generated
+        /// repositories, or the one of subscription-manager when it manages the file
+        std::string content_server{CONTENT_BASEURL};
 
-        template<typename... Ss>
-        void error_log(std::string_view format, Ss &&... args) const;
+        /// How the repositories in redhat.repo are generated
+        RedhatRepoOptions repo_options;
+
+        /// Are enabled repositories on the content server checked against the entitlement certificates?
+        bool check_repo_entitlement = true;
+
+        /// Content paths of the valid entitlement certificates; empty when the repositories are not checked
+        std::optional<ContentPathIndex> content_index;
+
+        /// The status computed in the background; it uses expiry_cache until it is retrieved. It is
+        /// declared last, so that it is destroyed first: its destructor waits for the background thread,
+        /// even when dnf exits before post_base_setup.
+        std::future<RhsmStatus> pending_status;
     };
 
 
-    template<typename... Ss>
-    void RhsmPlugin::debug_log(const std::string_view format, Ss &&... args) const {
-        get_base().get_logger()->debug("[rhsm plugin] " + std::string(format), std::forward<Ss>(args)...);
+    // Read log_level from rhsm.conf. Without the option, or with an invalid value, the level follows the dnf
+    // "logfilelevel", so that the plugin does not format messages that dnf would not write.
+    RhsmLogger::Level RhsmPlugin::get_log_level() const {
+        if (config.has_option("main", "log_level")) {
+            if (const auto level = log_level_from_string(config.get_value("main", "log_level"))) {
+                return *level;
+            }
+        }
+        return log_level_of_logfilelevel(get_base().get_config().get_logfilelevel_option().get_value());
+    }
+
+    // Resolve paths from rhsm.conf (or defaults) relative to the installroot, so that dnf running
+    // with --installroot checks the subscription status of the installroot, not of the host.
+    void RhsmPlugin::resolve_paths() {
+        const auto config_value = [this](const std::string &key, const std::filesystem::path &default_value) {
+            if (config.has_option("main", key)) {
+                return std::filesystem::path(config.get_value("main", key));
+            }
+            return default_value;
+        };
+        const RhsmPaths defaults;
+        const RhsmPaths configured{
+            .consumer_cert_dir = config_value("consumer_cert_dir", defaults.consumer_cert_dir),
+            .entitlement_cert_dir = config_value("entitlement_cert_dir", defaults.entitlement_cert_dir),
+            .releasever_file = config_value("releasever_file", defaults.releasever_file),
+            .rhsm_host_config_dir = config_value("rhsm_host_config_dir", defaults.rhsm_host_config_dir),
+            .entitlement_host_cert_dir = config_value("entitlement_host_cert_dir", defaults.entitlement_host_cert_dir),
+            .expiry_cache_file = config_value("expiry_cache_file", defaults.expiry_cache_file),
+            .status_cache_file = config_value("status_cache_file", defaults.status_cache_file),
+            .redhat_repo_file = config_value("redhat_repo_file", defaults.redhat_repo_file),
+            .content_overrides_file = config_value("content_overrides_file", defaults.content_overrides_file),
+            .product_cert_dir = config_value("product_cert_dir", defaults.product_cert_dir),
+            .product_default_cert_dir = config_value("product_default_cert_dir", defaults.product_default_cert_dir),
+            .rhsm_config_file = config_value("rhsm_config_file", defaults.rhsm_config_file),
+            .content_cache_file = config_value("content_cache_file", defaults.content_cache_file),
+        };
+        paths = configured.with_installroot(get_base().get_config().get_installroot_option().get_value());
+        resolve_status_cache_ttl();
+        resolve_status_service_socket();
+        resolve_status_snapshot_file();
+        resolve_repo_options();
+    }
+
+    // Read status_cache_ttl from rhsm.conf; an invalid value disables the memoization of the status
+    void RhsmPlugin::resolve_status_cache_ttl() {
+        if (!config.has_option("main", "status_cache_ttl")) {
+            return;
+        }
+        const auto &value = config.get_value("main", "status_cache_ttl");
+        try {
+            std::size_t end = 0;
+            status_cache_ttl = std::stoll(value, &end);
+            if (end != value.size() || status_cache_ttl < 0) {
+                throw std::invalid_argument(value);
+            }
+        } catch (const std::exception &) {
+            logger.warning("Invalid value of status_cache_ttl: \"{}\"", value);
+            status_cache_ttl = 0;
+        }
+    }
+
+    // Read status_service_socket from rhsm.conf; an empty value disables the service. The service checks
+    // the host, so it is not used with an installroot.
+    void RhsmPlugin::resolve_status_service_socket() {
+        if (config.has_option("main", "status_service_socket")) {
+            status_service_socket = config.get_value("main", "status_service_socket");
+        }
+        if (std::filesystem::path(get_base().get_config().get_installroot_option().get_value()) != "/") {
+            status_service_socket.clear();
+        }
+    }
+
+    // Read status_snapshot_file from rhsm.conf; an empty value disables the snapshot. The snapshot describes
+    // the host, so it is not written with --installroot.
+    void RhsmPlugin::resolve_status_snapshot_file() {
+        if (config.has_option("main", "status_snapshot_file")) {
+            status_snapshot_file = config.get_value("main", "status_snapshot_file");
+        }
+        if (std::filesystem::path(get_base().get_config().get_installroot_option().get_value()) != "/") {
+            status_snapshot_file.clear();
+        }
+    }
+
+    // Read a boolean option from rhsm.conf. An invalid value is reported and read as false, so that
+    // nothing is changed by a misspelled option.
+    bool RhsmPlugin::get_boolean_option(const std::string & option, const bool default_value) {
+        if (!config.has_option("main", option)) {
+            return default_value;
+        }
+        const auto &value = config.get_value("main", option);
+        if (value == "1" || value == "yes" || value == "true" || value == "on") {
+            return true;
+        }
+        if (value != "0" && value != "no" && value != "false" && value != "off") {
+            logger.warning("Invalid value of {}: \"{}\"", option, value);
+        }
+        return false;
     }
 
-    template<typename... Ss>
-    void RhsmPlugin::info_log(const std::string_view format, Ss &&... args) const {
-        get_base().get_logger()->info("[rhsm plugin] " + std::string(format), std::forward<Ss>(args)...);
+    // Read manage_repos, check_repo_entitlement, content_baseurl and repo_ca_cert from rhsm.conf, and the
+    // repository settings of subscription-manager from its rhsm.conf. redhat.repo is generated only when both
+    // configurations allow it; an invalid value of manage_repos in either of them leaves redhat.repo untouched.
+    // The content server and its CA certificate are those of subscription-manager (e.g. a Satellite), unless
+    // content_baseurl and repo_ca_cert override them. Repositories are not generated with an installroot,
+    // because the certificates would be referenced by their paths in the installroot.
+    void RhsmPlugin::resolve_repo_options() {
+        manage_repos = get_boolean_option("manage_repos", true);
+        check_repo_entitlement = get_boolean_option("check_repo_entitlement", true);
+        if (std::filesystem::path(get_base().get_config().get_installroot_option().get_value()) != "/") {
+            manage_repos = false;
+        }
+        try {
+            rhsm_config = read_rhsm_config(paths.rhsm_config_file);
+        } catch (const std::exception &e) {
+            logger.warning("Unable to read the configuration of subscription-manager: {}", e.what());
+            rhsm_config.manage_repos = false;
+        }
+        if (!rhsm_config.manage_repos) {
+            manage_repos = false;
+        }
+        repo_options.baseurl = config.has_option("main", "content_baseurl") ? config.get_value("main", "content_baseurl")
+                                                                            : rhsm_config.baseurl;
+        repo_options.ca_cert = config.has_option("main", "repo_ca_cert") ? config.get_value("main", "repo_ca_cert")
+                                                                         : rhsm_config.repo_ca_cert;
+        repo_options.arch = get_system_arch();
+        content_server = manage_repos ? repo_options.baseurl : rhsm_config.baseurl;
     }
 
-    template<typename... Ss>
-    void RhsmPlugin::warning_log(const std::string_view format, Ss &&... args) const {
-        get_base().get_logger()->warning("[rhsm plugin] " + std::string(format), std::forward<Ss>(args)...);
+    // Start the checks of the subscription status on a background thread. The thread reads only files;
+    // all messages are printed on the main thread in post_base_setup, in the same order as before.
+    void RhsmPlugin::start_status_check() {
+        if (getuid() != 0) {
+            return;
+        }
+        const TraceSpan span(&tracer, "pre_base_setup", "hook");
+        const HookTimer timer(metrics, "pre_base_setup");
+        resolve_paths();
+        pending_status = start_rhsm_status_check(paths, expiry_cache, status_cache_ttl, status_service_socket);
     }
 
-    template<typename... Ss>
-    void RhsmPlugin::error_log(const std::string_view format, Ss &&... args) const {
-        get_base().get_logger()->error("[rhsm plugin] " + std::string(format), std::forward<Ss>(args)...);
+    // Wait for the status started in pre_base_setup, or check it now
+    RhsmStatus RhsmPlugin::get_status() {
+        const TraceSpan span(&tracer, "get_status");
+        if (pending_status.valid()) {
+            return pending_status.get();
+        }
+        resolve_paths();
+        return get_rhsm_status(
+            paths, expiry_cache, static_cast<std::int64_t>(std::time(nullptr)), status_cache_ttl, status_service_socket);
     }
 
-    // Print warning and info messages about subscription status.
-    void RhsmPlugin::print_warnings() const {
-        debug_log("Hook post_base_setup started");
+    // Use the valid entitlement certificates of a registered system for redhat.repo and the content path index.
+    // The content paths are taken from the entitlement content cache while the entitlement certificate directory
+    // and the expired certificates are unchanged and, when redhat.repo is generated, also the product
+    // certificates, the overrides, the options and redhat.repo itself, so an unchanged system does not read
+    // any certificate and does not generate redhat.repo again.
+    void RhsmPlugin::update_entitlement_content(const RhsmStatus & status) {
+        if ((!manage_repos && !check_repo_entitlement) || status.in_container || !status.registered) {
+            return;
+        }
+        // The keys are taken before the certificates are read, so that changes made meanwhile invalidate the record
+        const auto cert_dir_key = get_path_key(paths.entitlement_cert_dir);
+        std::optional<RedhatRepoKey> repo_key;
+        if (manage_repos) {
+            repo_key = get_redhat_repo_key(paths, repo_options);
+        }
+        auto record = read_entitlement_content_cache(paths.content_cache_file, cert_dir_key, status.expired_entitlements);
+        if (record && manage_repos && record->redhat_repo != repo_key) {
+            record.reset();
+        }
+        if (record) {
+            logger.debug("Content of {} entitlement certificates read from {}", record->certificates, paths.content_cache_file);
+            if (manage_repos) {
+                metrics.set_gauge(
+                    "rhsm_dnf5_rhsm_redhat_repo_repositories",
+                    "Repositories generated in redhat.repo",
+                    static_cast<double>(record->redhat_repos));
+                logger.debug("Repositories in {} are up to date", paths.redhat_repo_file);
+            }
+        } else {
+            std::vector<std::string> errors;
+            const auto certs = read_entitlements(status, cert_dir_key, errors);
+            record = make_entitlement_content_record(cert_dir_key, status.expired_entitlements, certs, errors);
+            if (repo_key) {
+                update_repos(certs, *repo_key, *record);
+            }
+            write_content_cache(*record);
+        }
+        for (const auto &error : record->errors) {
+            logger.debug("{}", error);
+        }
+        metrics.set_gauge(
+            "rhsm_dnf5_rhsm_entitlement_certificates",
+            "Valid entitlement certificates used by the last dnf run",
+            static_cast<double>(record->certificates));
+        index_content_paths(*record);
+    }
+
+    // Read the content sets of the valid entitlement certificates, once for both redhat.repo and the content
+    // path index. Broken certificates are already reported by the status checks. The certificates listed by
+    // the status check are used while the directory is unchanged; the status service does not tell the key.
+    std::vector<EntitlementCert> RhsmPlugin::read_entitlements(
+        const RhsmStatus & status, const PathKey & cert_dir_key, std::vector<std::string> & errors) {
+        TraceSpan span(&tracer, "read_entitlement_certs");
+        std::vector<EntitlementCert> certs;
+        if (!status.from_service && status.key.entitlement_cert_dir == cert_dir_key.mtime_ns) {
+            std::vector<std::filesystem::path> cert_paths;
+            cert_paths.reserve(status.entitlement_certs.size());
+            for (const auto &name : status.entitlement_certs) {
+                cert_paths.push_back(paths.entitlement_cert_dir / name);
+            }
+            certs = read_entitlement_certs(cert_paths, status.expired_entitlements, errors);
+        } else {
+            certs = read_entitlement_certs(paths.entitlement_cert_dir, status.expired_entitlements, errors);
+        }
+        span.arg("certificates", std::to_string(certs.size()));
+        return certs;
+    }
+
+    // Generate redhat.repo from the valid entitlement certificates. It is called in post_base_setup, before
+    // dnf reads the repository configuration, and the file is written only when the repositories or their
+    // options changed. The key of the inputs, taken before, and of the written file is stored in the record
+    // when everything was read.
+    void RhsmPlugin::update_repos(
+        const std::vector<EntitlementCert> & certs, RedhatRepoKey repo_key, EntitlementContentRecord & record) {
+        const TraceSpan span(&tracer, "update_redhat_repo");
+        try {
+            const auto result = update_redhat_repo(paths, certs, repo_options);
+            metrics.set_gauge(
+                "rhsm_dnf5_rhsm_redhat_repo_repositories",
+                "Repositories generated in redhat.repo",
+                static_cast<double>(result.repos));
+            for (const auto &error : result.errors) {
+                logger.debug("{}", error);
+            }
+            if (result.written) {
+                logger.info("Repositories in {} updated, {} repositories available", paths.redhat_repo_file, result.repos);
+            } else {
+                logger.debug("Repositories in {} are up to date", paths.redhat_repo_file);
+            }
+            if (result.errors.empty()) {
+                repo_key.redhat_repo_file = get_path_key(paths.redhat_repo_file);
+                record.redhat_repo = repo_key;
+                record.redhat_repos = result.repos;
+            }
+        } catch (const std::exception &e) {
+            logger.warning("Unable to update {}: {}", paths.redhat_repo_file, e.what());
+        }
+    }
+
+    // Index the content paths of the valid entitlement certificates for skip_unentitled_repos(). The
+    // repositories are not checked when any certificate could not be read, because the certificate could
+    // entitle them.
+    void RhsmPlugin::index_content_paths(const EntitlementContentRecord & record) {
+        if (!check_repo_entitlement) {
+            return;
+        }
+        if (!record.errors.empty()) {
+            logger.debug("Repositories are not checked against the entitlement certificates, some could not be read");
+            return;
+        }
+        const TraceSpan span(&tracer, "index_content_paths");
+        content_index.emplace(record.content_paths, content_server);
+        logger.debug(
+            "{} content paths of {} entitlement certificates indexed", content_index->size(), record.certificates);
+    }
+
+    // Store the content of the entitlement certificates read by this command for the following commands
+    void RhsmPlugin::write_content_cache(const EntitlementContentRecord & record) {
+        const TraceSpan span(&tracer, "write_content_cache");
+        try {
+            std::filesystem::create_directories(paths.content_cache_file.parent_path());
+            write_entitlement_content_cache(paths.content_cache_file, record);
+            logger.debug("Entitlement content cache written to {}", paths.content_cache_file);
+        } catch (const std::exception &e) {
+            logger.warning("Unable to write entitlement content cache: {}", e.what());
+        }
+    }
+
+    // Called when the repositories are configured, before their metadata are loaded. Repositories on the
+    // content server that are not entitled by any valid entitlement certificate are disabled, instead of
+    // failing to download their metadata with "403 Forbidden" after several retries. Repositories with
+    // a metalink or a mirrorlist only, or with any URL outside the content server, are not checked.
+    void RhsmPlugin::skip_unentitled_repos() {
+        if (!content_index) {
+            return;
+        }
+        const TraceSpan span(&tracer, "repos_configured", "hook");
+        const HookTimer timer(metrics, "repos_configured");
+        std::size_t skipped = 0;
+        const auto &vars = *get_base().get_vars();
+        repo::RepoQuery repos(get_base());
+        repos.filter_enabled(true);
+        for (const auto &repo : repos) {
+            const auto &baseurls = repo->get_config().get_baseurl_option().get_value();
+            if (baseurls.empty()) {
+                continue;
+            }
+            const TraceSpan repo_span(&tracer, repo->get_id(), "repo");
+            std::vector<std::string> content_paths;
+            for (const auto &baseurl : baseurls) {
+                auto content_path = content_path_of_url(vars.substitute(baseurl), content_server);
+                if (!content_path) {
+                    break;
+                }
+                content_paths.push_back(std::move(*content_path));
+            }
+            if (content_paths.size() != baseurls.size() ||
+                std::any_of(content_paths.begin(), content_paths.end(), [this](const auto &path) {
+                    return content_index->is_entitled(path);
+                })) {
+                continue;
+            }
+
+            repo->disable();
+            ++skipped;
+            logger.notify(
+                RhsmLogger::Level::WARNING,
+                "Repository '{}' ({}) is not entitled by any valid certificate in {} and will be skipped.\n"
+                "Run \"subscription-manager refresh\" if the subscriptions of this system have changed.",
+                repo->get_id(),
+                baseurls.front(),
+                paths.entitlement_cert_dir);
+        }
+        metrics.add_counter(
+            "rhsm_dnf5_rhsm_skipped_repositories_total",
+            "Enabled repositories skipped, because no valid entitlement certificate entitles them",
+            static_cast<double>(skipped));
+    }
 
+    // Called when repositories are loaded. When this dnf invocation downloaded repository metadata (e.g.
+    // "dnf makecache" run by the systemd timer), parse all entitlement certificates that are not cached
+    // yet, and write the cache, so that the following dnf invocations only check that the cached records
+    // are still fresh. Commands using the metadata from the cache leave it to the status check.
+    void RhsmPlugin::update_expiry_cache() {
         if (getuid() != 0) {
-            info_log("Not root, Subscription Management repositories not updated");
+            return;
+        }
+        const TraceSpan span(&tracer, "repos_loaded", "hook");
+        const HookTimer timer(metrics, "repos_loaded");
+        logger.debug("Hook repos_loaded started");
+        if (!repo_metadata_refreshed()) {
+            logger.debug("No repository metadata was refreshed, expiry cache not updated");
+            return;
+        }
+
+        if (!expiry_cache_read) {
+            // The status was memoized or provided by the status service, so the cache has not been read yet
+            expiry_cache = CertExpiryCache(paths.expiry_cache_file);
+            try {
+                expiry_cache.read_cache();
+            } catch (const std::exception &e) {
+                logger.debug("Unable to read expiry cache: {}", e.what());
+            }
+            expiry_cache_read = true;
+        }
+
+        const auto cert_paths = get_entitlement_cert_paths(paths.entitlement_cert_dir);
+        const auto results = expiry_cache.get_not_after(cert_paths);
+        for (std::size_t i = 0; i < results.size(); ++i) {
+            if (!results[i].not_after) {
+                logger.debug("Unable to cache expiry of {}: {}", cert_paths[i], results[i].error);
+            }
+        }
+        expiry_cache.prune();
+        write_expiry_cache();
+
+        logger.debug("Hook repos_loaded finished");
+    }
+
+    // Was the metadata of any enabled repository downloaded by this dnf invocation? Downloaded metadata replace
+    // the cached repomd.xml, so its modification time differs from the one recorded before the metadata were
+    // loaded.
+    bool RhsmPlugin::repo_metadata_refreshed() {
+        repo::RepoQuery repos(get_base());
+        repos.filter_enabled(true);
+        for (const auto &repo : repos) {
+            const auto recorded = repomd_mtimes.find(repo->get_id());
+            const auto mtime = get_repomd_mtime(*repo);
+            if (mtime && (recorded == repomd_mtimes.end() || recorded->second != mtime)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Record the modification times of the cached metadata of the enabled repositories before they are loaded,
+    // for repo_metadata_refreshed()
+    void RhsmPlugin::record_repo_metadata() {
+        if (getuid() != 0) {
+            return;
+        }
+        repo::RepoQuery repos(get_base());
+        repos.filter_enabled(true);
+        for (const auto &repo : repos) {
+            repomd_mtimes[repo->get_id()] = get_repomd_mtime(*repo);
+        }
+    }
+
+    // Write the expiry cache, when any record was added or removed
+    void RhsmPlugin::write_expiry_cache() {
+        if (!expiry_cache.dirty) {
+            return;
+        }
+        const TraceSpan span(&tracer, "write_expiry_cache");
+        try {
+            std::filesystem::create_directories(paths.expiry_cache_file.parent_path());
+            expiry_cache.write_cache();
+            expiry_cache.dirty = false;
+            logger.debug("Expiry cache written to {}", paths.expiry_cache_file);
+        } catch (const std::exception &e) {
+            logger.warning("Unable to write expiry cache: {}", e.what());
+        }
+    }
+
+    // Memoize the status checked by this command for the following dnf invocations
+    void RhsmPlugin::write_status_cache(const RhsmStatus & status) {
+        if (status.memoized || status.from_service || status_cache_ttl == 0) {
+            return;
+        }
+        const TraceSpan span(&tracer, "write_status_cache");
+        try {
+            std::filesystem::create_directories(paths.status_cache_file.parent_path());
+            write_memoized_rhsm_status(paths.status_cache_file, status);
+            logger.debug("Status written to {}", paths.status_cache_file);
+        } catch (const std::exception &e) {
+            logger.warning("Unable to write status cache: {}", e.what());
+        }
+    }
+
+    // Publish the status used by this command for monitoring agents, so they do not have to parse
+    // the certificates themselves. It is written by every command, including memoized statuses,
+    // so that written_at tells monitoring how fresh the snapshot is.
+    void RhsmPlugin::write_status_snapshot(const RhsmStatus & status) {
+        if (status_snapshot_file.empty()) {
+            return;
+        }
+        const TraceSpan span(&tracer, "write_status_snapshot");
+        try {
+            std::filesystem::create_directories(status_snapshot_file.parent_path());
+            write_rhsm_status_snapshot(status_snapshot_file, status, static_cast<std::int64_t>(std::time(nullptr)));
+            logger.debug("Status snapshot written to {}", status_snapshot_file);
+        } catch (const std::exception &e) {
+            logger.warning("Unable to write status snapshot: {}", e.what());
+        }
+    }
+
+    // Print warning and info messages about subscription status.
+    void RhsmPlugin::print_warnings() {
+        const TraceSpan span(&tracer, "post_base_setup", "hook");
+        const HookTimer timer(metrics, "post_base_setup");
+        logger.debug("Hook post_base_setup started");
 
-            // FIXME: replace with appropriate DNF API call when available
-            std::cout << "Not root, Subscription Management repositories not updated" << std::endl;
+        if (getuid() != 0) {
+            logger.notify(RhsmLogger::Level::INFO, "Not root, Subscription Management repositories not updated");
             return;
         }
 
-        if (!in_container()) {
-            const auto registered = has_consumer_certificate(CONSUMER_CERT_DIR);
+        const auto status = get_status();
+        export_status(status);
+        if (!status.status_service_error.empty()) {
+            logger.debug("Unable to get the status from {}: {}", status_service_socket, status.status_service_error);
+        }
+        if (status.from_service) {
+            logger.debug("Using the status checked at {} by the service at {}", status.checked_at, status_service_socket);
+        } else if (status.memoized) {
+            logger.debug("Using the status checked at {} from {}", status.checked_at, paths.status_cache_file);
+        } else {
+            expiry_cache_read = true;
+            if (status.expiry_cache_error.empty()) {
+                logger.debug("Expiry cache read from {}", paths.expiry_cache_file);
+            } else {
+                logger.debug("Unable to read expiry cache: {}", status.expiry_cache_error);
+            }
+        }
+
+        if (!status.in_container) {
+            const auto registered = status.registered;
             if (!registered) {
                 warn_system_not_registered();
             }
             if (registered) {
                 // Try to warn about missing entitlements only in situation, when system is registered
-                if (!has_entitlement_certificates(ENTITLEMENT_CERT_DIR)) {
+                if (!status.has_entitlements) {
                     warn_no_entitlements();
                 }
             }
         } else {
-            info_log("Running in container mode. Subscription management is handled by the host.");
+            logger.info("Running in container mode. Subscription management is handled by the host.");
             std::cout << "This system is running in container mode. Subscription management is handled by the host." << std::endl;
         }
 
-        warn_entitlements_expired();
-        log_releasever();
-
-        debug_log("Hook post_base_setup finished");
+        for (const auto &error : status.cert_errors) {
+            logger.warning("{}", error);
+        }
+        warn_entitlements_expired(status.expired_entitlements);
+        update_entitlement_content(status);
+        // Certificates parsed by this command (e.g. renewed since the last makecache) are not parsed again
+        write_expiry_cache();
+        write_status_cache(status);
+        write_status_snapshot(status);
+        log_releasever(status);
+
+        logger.debug("Hook post_base_setup finished");
     }
 
     // Log a warning message when the system is not registered (consumer certificate does not exist in /etc/pki/consumer)
     void RhsmPlugin::warn_system_not_registered() const {
-        warning_log("System is not registered. No consumer certificate found in {}.", CONSUMER_CERT_DIR);
+        logger.warning("System is not registered. No consumer certificate found in {}.", paths.consumer_cert_dir);
 
         // FIXME: replace with appropriate DNF API call when available
         std::cout << "This system is not registered with an entitlement server."
@@ -159,47 +749,12 @@ namespace {
 
     // Log a warning message when no entitlement certificate exists in /etc/pki/entitlement
     void RhsmPlugin::warn_no_entitlements() const {
-        warning_log("No SCA entitlement certificate(s) found in {}", ENTITLEMENT_CERT_DIR);
-        std::cout << std::format("No SCA entitlement certificate(s) found in {}",
-                                 ENTITLEMENT_CERT_DIR) << std::endl;
-    }
-
-    /// Scans the directory for .pem files (skipping key files), checks notAfter dates,
-    /// and returns expired certificate stems.
-    std::vector<std::string> RhsmPlugin::get_expired_entitlements(const std::filesystem::path & entitlement_cert_dir) const {
-        namespace fs = std::filesystem;
-
-        std::set<std::string> expired_names;
-
-        if (!fs::exists(entitlement_cert_dir) || !fs::is_directory(entitlement_cert_dir)) {
-            return {};
-        }
-
-        for (const auto &entry: fs::directory_iterator(entitlement_cert_dir)) {
-            if (entry.path().extension() != ".pem") {
-                continue;
-            }
-            auto stem = entry.path().stem().string();
-            if (stem.ends_with("-key")) {
-                continue;
-            }
-
-            try {
-                if (is_cert_expired(entry.path())) {
-                    expired_names.insert(stem);
-                }
-            } catch (std::runtime_error &e) {
-                warning_log(e.what());
-            }
-        }
-
-        return {expired_names.begin(), expired_names.end()};
+        logger.notify(
+            RhsmLogger::Level::WARNING, "No SCA entitlement certificate(s) found in {}", paths.entitlement_cert_dir);
     }
 
     // Log a warning message when SCA entitlement certificate(s) are expired
-    void RhsmPlugin::warn_entitlements_expired() const {
-        const auto expired = get_expired_entitlements(ENTITLEMENT_CERT_DIR);
-
+    void RhsmPlugin::warn_entitlements_expired(const std::vector<std::string> & expired) const {
         if (expired.empty()) {
             return;
         }
@@ -209,35 +764,97 @@ namespace {
             expired_list += "  - " + entitlement + "\n";
         }
 
-        error_log(
+        logger.notify(
+            RhsmLogger::Level::ERROR,
             "The following entitlement certificate(s) have expired:\n{}"
             "Renew your subscription to resume access to updates.",
             expired_list);
-
-        // FIXME: replace with appropriate DNF API call when available
-        std::cout << std::format(
-            "The following entitlement certificate(s) have expired:\n{}"
-            "Renew your subscription to resume access to updates.",
-            expired_list) << std::endl;
     }
 
     // Checks for the presence of /etc/dnf/var/releasever; if exists, then logs its value in an info message
-    void RhsmPlugin::log_releasever() const {
+    void RhsmPlugin::log_releasever(const RhsmStatus & status) const {
+        if (!status.releasever_error.empty()) {
+            logger.warning("Unable to determine release version: {}", status.releasever_error);
+            return;
+        }
+        if (!status.releasever.empty()) {
+            logger.notify(
+                RhsmLogger::Level::INFO,
+                "This system has release set to {} and it receives updates only for this release.",
+                status.releasever);
+        }
+    }
+
+    // Add the subscription status checked by this dnf run to the metrics
+    void RhsmPlugin::export_status(const RhsmStatus & status) {
+        if (!metrics.is_enabled()) {
+            return;
+        }
+        metrics.add_counter(
+            "rhsm_dnf5_rhsm_status_checks_total",
+            "Subscription status checks by the source of the status",
+            1,
+            {{"source", status.from_service ? "service" : status.memoized ? "memoized" : "checked"}});
+        metrics.set_gauge(
+            "rhsm_dnf5_rhsm_container",
+            "Is the system running in container mode",
+            status.in_container ? 1 : 0);
+        metrics.set_gauge(
+            "rhsm_dnf5_rhsm_registered",
+            "Is the system registered",
+            status.registered ? 1 : 0);
+        metrics.set_gauge(
+            "rhsm_dnf5_rhsm_expired_entitlements",
+            "Expired entitlement certificates",
+            static_cast<double>(status.expired_entitlements.size()));
+        metrics.set_gauge(
+            "rhsm_dnf5_rhsm_entitlement_certificate_errors",
+            "Entitlement certificates that cannot be parsed",
+            static_cast<double>(status.cert_errors.size()));
+        if (status.next_expiry) {
+            metrics.set_gauge(
+                "rhsm_dnf5_rhsm_next_entitlement_expiry_timestamp_seconds",
+                "The earliest notAfter date of entitlement certificates that are not expired yet",
+                static_cast<double>(*status.next_expiry));
+        }
+    }
+
+    // Merge the metrics of this dnf run into the metrics file, when the metrics are enabled
+    void RhsmPlugin::write_metrics() noexcept {
+        if (!metrics.is_enabled()) {
+            return;
+        }
         try {
-            // Release version check
-            auto releasever = get_releasever(RELEASEVER_FILE);
-            if (!releasever.empty()) {
-                info_log(
-                    "This system has release set to {} and it receives updates only for this release.",
-                    releasever);
-
-                // FIXME: replace with appropriate DNF API call when available
-                std::cout << std::format(
-                    "This system has release set to {} and it receives updates only for this release.",
-                    releasever) << std::endl;
+            // The background status check may still use the expiry cache, when dnf exits before post_base_setup
+            if (!pending_status.valid()) {
+                metrics.add_counter(
+                    "rhsm_dnf5_rhsm_expiry_cache_lookups_total",
+                    "Lookups of entitlement certificates in the expiry cache",
+                    static_cast<double>(expiry_cache.hits),
+                    {{"result", "hit"}});
+                metrics.add_counter(
+                    "rhsm_dnf5_rhsm_expiry_cache_lookups_total",
+                    "Lookups of entitlement certificates in the expiry cache",
+                    static_cast<double>(expiry_cache.misses),
+                    {{"result", "miss"}});
             }
+            metrics.write();
+            logger.debug("Metrics written to {}", metrics.get_path());
+        } catch (const std::exception &e) {
+            logger.warning("Unable to write metrics: {}", e.what());
+        }
+    }
+
+    // Write the spans recorded in this dnf run, when tracing is enabled
+    void RhsmPlugin::write_trace() const noexcept {
+        if (!tracer.is_enabled()) {
+            return;
+        }
+        try {
+            tracer.write("dnf (rhsm plugin)");
+            logger.debug("Trace of {} span(s) written to {}", tracer.size(), tracer.get_path());
         } catch (const std::exception &e) {
-            warning_log("Unable to determine release version: {}", e.what());
+            logger.warning("Unable to write trace: {}", e.what());
         }
     }
 } // namespace
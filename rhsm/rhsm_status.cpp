@@ -0,0 +1,325 @@
+#include "rhsm_status.hpp"
+
+#include "dir_snapshot.hpp"
+#include "rhsm_status_client.hpp"
+
+#include <ctime>
+#include <exception>
+#include <fstream>
+#include <set>
+#include <sys/stat.h>
+#include <json/json.h>
+
+namespace {
+
+/// Version of the format of the memoized status; a different version is ignored
+constexpr int STATUS_CACHE_VERSION = 3;
+
+/// Version of the format of the status snapshot; incremented when a field is removed or its meaning changes
+constexpr int STATUS_SNAPSHOT_VERSION = 1;
+
+std::int64_t get_mtime_ns(const std::filesystem::path &path) {
+    struct stat st{};
+    if (stat(path.c_str(), &st) != 0) {
+        return -1;
+    }
+    return static_cast<std::int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+}
+
+Json::Value key_to_json(const RhsmStatusKey &key) {
+    Json::Value value(Json::objectValue);
+    value["consumer_cert_dir"] = Json::Int64(key.consumer_cert_dir);
+    value["entitlement_cert_dir"] = Json::Int64(key.entitlement_cert_dir);
+    value["releasever_file"] = Json::Int64(key.releasever_file);
+    value["rhsm_host_config_dir"] = Json::Int64(key.rhsm_host_config_dir);
+    value["entitlement_host_cert_dir"] = Json::Int64(key.entitlement_host_cert_dir);
+    return value;
+}
+
+Json::Value strings_to_json(const std::vector<std::string> &strings) {
+    Json::Value value(Json::arrayValue);
+    for (const auto &string : strings) {
+        value.append(string);
+    }
+    return value;
+}
+
+std::optional<std::vector<std::string>> strings_from_json(const Json::Value &value) {
+    if (!value.isArray()) {
+        return std::nullopt;
+    }
+    std::vector<std::string> strings;
+    for (const auto &item : value) {
+        if (!item.isString()) {
+            return std::nullopt;
+        }
+        strings.push_back(item.asString());
+    }
+    return strings;
+}
+
+Json::Value expiry_to_json(const std::vector<EntitlementExpiry> &expiry) {
+    Json::Value value(Json::arrayValue);
+    for (const auto &cert : expiry) {
+        Json::Value item(Json::objectValue);
+        item["name"] = cert.name;
+        item["not_after"] = Json::Int64(cert.not_after);
+        value.append(std::move(item));
+    }
+    return value;
+}
+
+std::optional<std::vector<EntitlementExpiry>> expiry_from_json(const Json::Value &value) {
+    if (!value.isArray()) {
+        return std::nullopt;
+    }
+    std::vector<EntitlementExpiry> expiry;
+    for (const auto &item : value) {
+        if (!item.isObject() || !item["name"].isString() || !item["not_after"].isInt64()) {
+            return std::nullopt;
+        }
+        expiry.push_back({.name = item["name"].asString(), .not_after = item["not_after"].asInt64()});
+    }
+    return expiry;
+}
+
+RhsmStatus check_rhsm_status(
+    const RhsmPaths &paths, CertExpiryCache &expiry_cache, const std::int64_t now, const RhsmStatusKey &key) {
+    // The cache is optional; certificates missing in the cache are parsed
+    expiry_cache = CertExpiryCache(paths.expiry_cache_file);
+    std::string expiry_cache_error;
+    try {
+        expiry_cache.read_cache();
+    } catch (const std::exception &e) {
+        expiry_cache_error = e.what();
+    }
+
+    auto status = check_rhsm_status_with_cache(paths, expiry_cache, now);
+    status.key = key;
+    status.expiry_cache_error = std::move(expiry_cache_error);
+    return status;
+}
+
+}  // namespace
+
+RhsmStatus check_rhsm_status_with_cache(const RhsmPaths &paths, CertExpiryCache &expiry_cache, const std::int64_t now) {
+    RhsmStatus status;
+    status.checked_at = now;
+
+    // Every directory is read once, all checks below use the snapshot
+    const auto snapshot = take_rhsm_snapshot(paths);
+    status.in_container = snapshot.in_container;
+    status.registered = snapshot.has_consumer_certificate();
+    status.has_entitlements = snapshot.has_entitlement_certificates();
+    status.entitlement_certs = snapshot.entitlement_certs.get_cert_names();
+
+    // Certificates not changed since the last run are not parsed again, the others are parsed in parallel
+    std::set<std::string> expired_names;
+    const auto cert_paths = snapshot.entitlement_certs.get_cert_paths();
+    const auto results = expiry_cache.get_not_after(cert_paths);
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        if (!results[i].not_after) {
+            status.cert_errors.push_back(results[i].error);
+            continue;
+        }
+        status.entitlement_expiry.push_back({.name = cert_paths[i].stem().string(), .not_after = *results[i].not_after});
+        if (*results[i].not_after < now) {
+            expired_names.insert(cert_paths[i].stem().string());
+        } else if (!status.next_expiry || *results[i].not_after < *status.next_expiry) {
+            status.next_expiry = results[i].not_after;
+        }
+    }
+    status.expired_entitlements.assign(expired_names.begin(), expired_names.end());
+
+    try {
+        status.releasever = get_releasever(paths.releasever_file);
+    } catch (const std::exception &e) {
+        status.releasever_error = e.what();
+    }
+
+    return status;
+}
+
+Json::Value rhsm_status_to_json(const RhsmStatus &status) {
+    Json::Value root(Json::objectValue);
+    root["checked_at"] = Json::Int64(status.checked_at);
+    root["in_container"] = status.in_container;
+    root["registered"] = status.registered;
+    root["has_entitlements"] = status.has_entitlements;
+    root["entitlement_certs"] = strings_to_json(status.entitlement_certs);
+    root["expired_entitlements"] = strings_to_json(status.expired_entitlements);
+    root["cert_errors"] = strings_to_json(status.cert_errors);
+    root["entitlement_expiry"] = expiry_to_json(status.entitlement_expiry);
+    root["releasever"] = status.releasever;
+    root["releasever_error"] = status.releasever_error;
+    root["next_expiry"] = status.next_expiry ? Json::Value(Json::Int64(*status.next_expiry)) : Json::Value();
+    return root;
+}
+
+std::optional<RhsmStatus> rhsm_status_from_json(const Json::Value &root) {
+    if (!root.isObject()) {
+        return std::nullopt;
+    }
+    const auto entitlement_certs = strings_from_json(root["entitlement_certs"]);
+    const auto expired_entitlements = strings_from_json(root["expired_entitlements"]);
+    const auto cert_errors = strings_from_json(root["cert_errors"]);
+    const auto entitlement_expiry = expiry_from_json(root["entitlement_expiry"]);
+    const auto &next_expiry = root["next_expiry"];
+    if (!root["checked_at"].isInt64() || !root["in_container"].isBool() || !root["registered"].isBool() ||
+        !root["has_entitlements"].isBool() || !entitlement_certs || !expired_entitlements || !cert_errors || !entitlement_expiry ||
+        !root["releasever"].isString() || !root["releasever_error"].isString() ||
+        !(next_expiry.isNull() || next_expiry.isInt64())) {
+        return std::nullopt;
+    }
+
+    RhsmStatus status;
+    status.checked_at = root["checked_at"].asInt64();
+    status.in_container = root["in_container"].asBool();
+    status.registered = root["registered"].asBool();
+    status.has_entitlements = root["has_entitlements"].asBool();
+    status.entitlement_certs = *entitlement_certs;
+    status.expired_entitlements = *expired_entitlements;
+    status.cert_errors = *cert_errors;
+    status.entitlement_expiry = *entitlement_expiry;
+    status.releasever = root["releasever"].asString();
+    status.releasever_error = root["releasever_error"].asString();
+    if (!next_expiry.isNull()) {
+        status.next_expiry = next_expiry.asInt64();
+    }
+    return status;
+}
+
+Json::Value rhsm_status_snapshot_to_json(const RhsmStatus &status, const std::int64_t now) {
+    Json::Value root(Json::objectValue);
+    root["version"] = STATUS_SNAPSHOT_VERSION;
+    root["written_at"] = Json::Int64(now);
+    root["checked_at"] = Json::Int64(status.checked_at);
+    root["source"] = status.from_service ? "service" : status.memoized ? "memoized" : "checked";
+    root["in_container"] = status.in_container;
+    root["registered"] = status.registered;
+    root["has_sca_entitlements"] = status.has_entitlements;
+
+    Json::Value entitlements(Json::arrayValue);
+    for (const auto &cert : status.entitlement_expiry) {
+        Json::Value item(Json::objectValue);
+        item["name"] = cert.name;
+        item["not_after"] = Json::Int64(cert.not_after);
+        item["expired"] = cert.not_after < now;
+        entitlements.append(std::move(item));
+    }
+    root["entitlements"] = std::move(entitlements);
+    root["next_expiry"] = status.next_expiry ? Json::Value(Json::Int64(*status.next_expiry)) : Json::Value();
+    root["cert_errors"] = strings_to_json(status.cert_errors);
+    root["releasever"] = status.releasever;
+    root["releasever_error"] = status.releasever_error;
+    return root;
+}
+
+void write_rhsm_status_snapshot(const std::filesystem::path &path, const RhsmStatus &status, const std::int64_t now) {
+    Json::StreamWriterBuilder writer_builder;
+    writer_builder["indentation"] = "  ";
+    write_file_atomically(path, Json::writeString(writer_builder, rhsm_status_snapshot_to_json(status, now)) + "\n");
+}
+
+RhsmStatusKey get_rhsm_status_key(const RhsmPaths &paths) {
+    return RhsmStatusKey{
+        .consumer_cert_dir = get_mtime_ns(paths.consumer_cert_dir),
+        .entitlement_cert_dir = get_mtime_ns(paths.entitlement_cert_dir),
+        .releasever_file = get_mtime_ns(paths.releasever_file),
+        .rhsm_host_config_dir = get_mtime_ns(paths.rhsm_host_config_dir),
+        .entitlement_host_cert_dir = get_mtime_ns(paths.entitlement_host_cert_dir),
+    };
+}
+
+RhsmStatus check_rhsm_status(const RhsmPaths &paths, CertExpiryCache &expiry_cache, const std::int64_t now) {
+    return check_rhsm_status(paths, expiry_cache, now, get_rhsm_status_key(paths));
+}
+
+std::optional<RhsmStatus> read_memoized_rhsm_status(
+    const std::filesystem::path &path, const RhsmStatusKey &key, const std::int64_t now, const std::int64_t ttl) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        return std::nullopt;
+    }
+    Json::Value root;
+    Json::CharReaderBuilder reader_builder;
+    Json::String errors;
+    if (!Json::parseFromStream(reader_builder, file, &root, &errors) || !root.isObject()) {
+        return std::nullopt;
+    }
+
+    // The memoized status is used only when everything is valid, it can always be checked again
+    if (!root["version"].isInt() || root["version"].asInt() != STATUS_CACHE_VERSION ||
+        !root["checked_at"].isInt64() || key_to_json(key) != root["key"]) {
+        return std::nullopt;
+    }
+    const auto checked_at = root["checked_at"].asInt64();
+    if (checked_at > now || now - checked_at >= ttl) {
+        return std::nullopt;
+    }
+    const auto &next_expiry = root["next_expiry"];
+    if (!next_expiry.isNull() && (!next_expiry.isInt64() || next_expiry.asInt64() < now)) {
+        return std::nullopt;
+    }
+
+    auto status = rhsm_status_from_json(root);
+    if (!status) {
+        return std::nullopt;
+    }
+    status->key = key;
+    status->memoized = true;
+    return status;
+}
+
+void write_memoized_rhsm_status(const std::filesystem::path &path, const RhsmStatus &status) {
+    auto root = rhsm_status_to_json(status);
+    root["version"] = STATUS_CACHE_VERSION;
+    root["key"] = key_to_json(status.key);
+
+    Json::StreamWriterBuilder writer_builder;
+    writer_builder["indentation"] = "";
+    write_file_atomically(path, Json::writeString(writer_builder, root));
+}
+
+RhsmStatus get_rhsm_status(
+    const RhsmPaths &paths, CertExpiryCache &expiry_cache, const std::int64_t now, const std::int64_t ttl) {
+    // The key is taken before the checks, so that changes made during the checks invalidate the status
+    const auto key = get_rhsm_status_key(paths);
+    if (ttl > 0) {
+        if (auto status = read_memoized_rhsm_status(paths.status_cache_file, key, now, ttl)) {
+            return std::move(*status);
+        }
+    }
+    return check_rhsm_status(paths, expiry_cache, now, key);
+}
+
+RhsmStatus get_rhsm_status(
+    const RhsmPaths &paths,
+    CertExpiryCache &expiry_cache,
+    const std::int64_t now,
+    const std::int64_t ttl,
+    const std::filesystem::path &service_socket) {
+    std::string service_error;
+    if (!service_socket.empty()) {
+        try {
+            if (auto status = query_rhsm_status_service(service_socket, paths)) {
+                return std::move(*status);
+            }
+        } catch (const std::exception &e) {
+            service_error = e.what();
+        }
+    }
+    auto status = get_rhsm_status(paths, expiry_cache, now, ttl);
+    status.status_service_error = std::move(service_error);
+    return status;
+}
+
+std::future<RhsmStatus> start_rhsm_status_check(
+    RhsmPaths paths, CertExpiryCache &expiry_cache, const std::int64_t ttl, std::filesystem::path service_socket) {
+    return std::async(
+        std::launch::async,
+        [paths = std::move(paths), &expiry_cache, ttl, service_socket = std::move(service_socket)]() {
+            return get_rhsm_status(
+                paths, expiry_cache, static_cast<std::int64_t>(std::time(nullptr)), ttl, service_socket);
+        });
+}
@@ -0,0 +1,163 @@
+#ifndef RHSM_DNF5_PLUGINS_RHSM_STATUS_HPP
+#define RHSM_DNF5_PLUGINS_RHSM_STATUS_HPP
+
+#include "rhsm_utils.hpp"
+
+#include <cstdint>
+#include <future>
+#include <optional>
+#include <string>
+#include <vector>
+#include <json/json.h>
+
+/// Default number of seconds a memoized status can be reused, see get_rhsm_status()
+constexpr std::int64_t DEFAULT_STATUS_CACHE_TTL = 60;
+
+/// Default path of the status snapshot published for monitoring, see write_rhsm_status_snapshot()
+constexpr const char * STATUS_SNAPSHOT_FILE = "/run/rhsm/dnf5-status.json";
+
+/// Modification times (in nanoseconds, -1 when the path does not exist) of the paths checked by
+/// check_rhsm_status(). Adding or removing a certificate, or changing the release version, changes
+/// the key and invalidates the memoized status.
+struct RhsmStatusKey {
+    std::int64_t consumer_cert_dir = -1;
+    std::int64_t entitlement_cert_dir = -1;
+    std::int64_t releasever_file = -1;
+    std::int64_t rhsm_host_config_dir = -1;
+    std::int64_t entitlement_host_cert_dir = -1;
+
+    bool operator==(const RhsmStatusKey &) const = default;
+};
+
+/// Get the key of the paths; one stat() call per path
+RhsmStatusKey get_rhsm_status_key(const RhsmPaths & paths);
+
+/// The notAfter date of one entitlement certificate
+struct EntitlementExpiry {
+    /// The name (stem) of the certificate
+    std::string name;
+
+    /// Seconds since the epoch
+    std::int64_t not_after = 0;
+
+    bool operator==(const EntitlementExpiry &) const = default;
+};
+
+/// The subscription status of the system checked when dnf starts. It contains only data;
+/// the plugin turns it into log records and messages on the main thread, so the status can
+/// be computed on a background thread.
+struct RhsmStatus {
+    /// The RHSM host directories exist, see in_container()
+    bool in_container = false;
+
+    /// A consumer certificate exists
+    bool registered = false;
+
+    /// Any entitlement certificate exists
+    bool has_entitlements = false;
+
+    /// Sorted file names of the entitlement certificates in the snapshot of the directory, so that
+    /// the certificates are read without listing the directory again while its key is the same
+    std::vector<std::string> entitlement_certs;
+
+    /// Sorted names (stems) of expired entitlement certificates
+    std::vector<std::string> expired_entitlements;
+
+    /// Errors of entitlement certificates that cannot be parsed
+    std::vector<std::string> cert_errors;
+
+    /// The notAfter dates of all entitlement certificates that can be parsed, sorted by name
+    std::vector<EntitlementExpiry> entitlement_expiry;
+
+    /// The release version the system is pinned to, empty if it is not set
+    std::string releasever;
+
+    /// Why the release version cannot be determined, empty on success
+    std::string releasever_error;
+
+    /// Why the expiry cache cannot be read, empty on success
+    std::string expiry_cache_error;
+
+    /// The earliest notAfter date of entitlement certificates that are not expired yet
+    std::optional<std::int64_t> next_expiry;
+
+    /// When the status was checked (seconds since the epoch) and the key of the paths taken
+    /// before the checks
+    std::int64_t checked_at = 0;
+    RhsmStatusKey key;
+
+    /// The status was reused from a previous dnf invocation
+    bool memoized = false;
+
+    /// The status was provided by the status service (see query_rhsm_status_service())
+    bool from_service = false;
+
+    /// Why the status service failed and the status was checked by the caller, empty when the
+    /// service was not used, not running, or succeeded
+    std::string status_service_error;
+
+    bool operator==(const RhsmStatus &) const = default;
+};
+
+/// Convert the status to JSON, used by the memoized status and by the status service.
+/// The key, the errors of the caches and of the service, and the flags telling where the status
+/// comes from are not included.
+Json::Value rhsm_status_to_json(const RhsmStatus & status);
+
+/// Convert JSON created by rhsm_status_to_json() to the status. Returns std::nullopt when the JSON
+/// is not valid.
+std::optional<RhsmStatus> rhsm_status_from_json(const Json::Value & json);
+
+/// Convert the status to the snapshot published for monitoring (see write_rhsm_status_snapshot()). Unlike
+/// rhsm_status_to_json(), the snapshot tells where the status comes from, and which entitlement certificates
+/// are expired at now (seconds since the epoch), when the snapshot is written.
+Json::Value rhsm_status_snapshot_to_json(const RhsmStatus & status, std::int64_t now);
+
+/// Atomically write the snapshot of the status, so that monitoring agents can read the registration, the
+/// entitlement certificates and their expiry, and the release version from one file instead of parsing
+/// the certificates again. Throws std::runtime_error on failure.
+void write_rhsm_status_snapshot(const std::filesystem::path & path, const RhsmStatus & status, std::int64_t now);
+
+/// Check the subscription status: read the expiry cache, take a snapshot of the certificate
+/// directories (see take_rhsm_snapshot()), check the expiry of entitlement certificates against
+/// now (seconds since the epoch) and read the release version. Certificates missing in the cache
+/// are parsed and stored in expiry_cache, which is not written.
+RhsmStatus check_rhsm_status(const RhsmPaths & paths, CertExpiryCache & expiry_cache, std::int64_t now);
+
+/// Like check_rhsm_status(), but use the records already in expiry_cache instead of reading the cache
+/// file. Used by the status service, which keeps the parsed certificates in memory. The key is not set.
+RhsmStatus check_rhsm_status_with_cache(const RhsmPaths & paths, CertExpiryCache & expiry_cache, std::int64_t now);
+
+/// Read the status memoized by write_memoized_rhsm_status(). The status is returned only when
+/// it was checked less than ttl seconds before now, the key of the paths is the same, and no
+/// entitlement certificate expired since then. Returns std::nullopt otherwise, including when
+/// the file does not exist or cannot be parsed.
+std::optional<RhsmStatus> read_memoized_rhsm_status(
+    const std::filesystem::path & path, const RhsmStatusKey & key, std::int64_t now, std::int64_t ttl);
+
+/// Atomically write the status for the following dnf invocations. Throws std::runtime_error on failure.
+void write_memoized_rhsm_status(const std::filesystem::path & path, const RhsmStatus & status);
+
+/// Return the memoized status when it is valid (see read_memoized_rhsm_status()), or check the status
+/// using check_rhsm_status(). A ttl of 0 disables the memoization. The expiry cache is not used
+/// when the memoized status is returned.
+RhsmStatus get_rhsm_status(const RhsmPaths & paths, CertExpiryCache & expiry_cache, std::int64_t now, std::int64_t ttl);
+
+/// Ask the status service listening on service_socket (see query_rhsm_status_service()) and fall back
+/// to the checks above when the service is not running or fails; the failure is stored in
+/// status_service_error. An empty service_socket disables the service.
+RhsmStatus get_rhsm_status(
+    const RhsmPaths & paths,
+    CertExpiryCache & expiry_cache,
+    std::int64_t now,
+    std::int64_t ttl,
+    const std::filesystem::path & service_socket);
+
+/// Start get_rhsm_status() with the current time on a background thread. The caller must not use
+/// expiry_cache until the result is retrieved. Like every future returned by std::async(), the
+/// returned future waits for the thread when it is destroyed, so the thread never outlives
+/// the caller, even when the result is never retrieved.
+std::future<RhsmStatus> start_rhsm_status_check(
+    RhsmPaths paths, CertExpiryCache & expiry_cache, std::int64_t ttl, std::filesystem::path service_socket = {});
+
+#endif // RHSM_DNF5_PLUGINS_RHSM_STATUS_HPP
@@ -0,0 +1,36 @@
+#include "rhsm_status_client.hpp"
+
+#include "varlink.hpp"
+
+#include <stdexcept>
+
+Json::Value rhsm_paths_to_json(const RhsmPaths &paths) {
+    // The cache files are not included; the service keeps its state in memory
+    Json::Value value(Json::objectValue);
+    value["consumer_cert_dir"] = paths.consumer_cert_dir.string();
+    value["entitlement_cert_dir"] = paths.entitlement_cert_dir.string();
+    value["releasever_file"] = paths.releasever_file.string();
+    value["rhsm_host_config_dir"] = paths.rhsm_host_config_dir.string();
+    value["entitlement_host_cert_dir"] = paths.entitlement_host_cert_dir.string();
+    return value;
+}
+
+std::optional<RhsmStatus> query_rhsm_status_service(
+    const std::filesystem::path &socket_path, const RhsmPaths &paths, const std::chrono::milliseconds timeout) {
+    const auto deadline = VarlinkConnection::Clock::now() + timeout;
+    auto connection = VarlinkConnection::connect(socket_path);
+    if (!connection) {
+        return std::nullopt;
+    }
+
+    const auto reply = connection->call(STATUS_SERVICE_GET_STATUS, Json::Value(Json::objectValue), deadline);
+    if (reply["paths"] != rhsm_paths_to_json(paths)) {
+        throw std::runtime_error("The status service checks different paths");
+    }
+    auto status = rhsm_status_from_json(reply["status"]);
+    if (!status) {
+        throw std::runtime_error("Invalid status returned by the status service");
+    }
+    status->from_service = true;
+    return status;
+}
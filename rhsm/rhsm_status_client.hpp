@@ -0,0 +1,34 @@
+#ifndef RHSM_DNF5_PLUGINS_RHSM_STATUS_CLIENT_HPP
+#define RHSM_DNF5_PLUGINS_RHSM_STATUS_CLIENT_HPP
+
+#include "rhsm_status.hpp"
+
+#include <chrono>
+#include <filesystem>
+#include <optional>
+#include <json/json.h>
+
+/// Default socket of the status service, see rhsm_status_service.hpp
+constexpr const char * STATUS_SERVICE_SOCKET = "/run/rhsm/status.varlink";
+
+/// Varlink interface of the status service and its only method
+constexpr const char * STATUS_SERVICE_INTERFACE = "com.redhat.rhsm.Status";
+constexpr const char * STATUS_SERVICE_GET_STATUS = "com.redhat.rhsm.Status.GetStatus";
+
+/// How long the plugin waits for the reply of the service before it checks the status itself
+constexpr std::chrono::milliseconds STATUS_SERVICE_TIMEOUT{250};
+
+/// Convert the checked paths to JSON; the service returns them with the status, so that the client
+/// can tell whether the service checks the same paths as the client would
+Json::Value rhsm_paths_to_json(const RhsmPaths & paths);
+
+/// Ask the status service listening on socket_path for the status of the paths. Returns std::nullopt
+/// when the service is not running (the socket does not exist or nobody listens on it). Throws
+/// std::runtime_error when the service fails, does not reply within the timeout, or checks
+/// different paths.
+std::optional<RhsmStatus> query_rhsm_status_service(
+    const std::filesystem::path & socket_path,
+    const RhsmPaths & paths,
+    std::chrono::milliseconds timeout = STATUS_SERVICE_TIMEOUT);
+
+#endif // RHSM_DNF5_PLUGINS_RHSM_STATUS_CLIENT_HPP
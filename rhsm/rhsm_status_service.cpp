@@ -0,0 +1,270 @@
+#include "rhsm_status_service.hpp"
+
+#include "cert_cache.hpp"
+#include "rhsm_status_client.hpp"
+#include "varlink.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <exception>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+/// Description of the interface returned by org.varlink.service.GetInterfaceDescription
+constexpr const char *STATUS_INTERFACE_DESCRIPTION = R"(# Subscription status of the system checked by the rhsm dnf5 plugin
+interface com.redhat.rhsm.Status
+
+# Paths checked by the service
+type Paths (
+  consumer_cert_dir: string,
+  entitlement_cert_dir: string,
+  releasever_file: string,
+  rhsm_host_config_dir: string,
+  entitlement_host_cert_dir: string
+)
+
+type Status (
+  checked_at: int,
+  in_container: bool,
+  registered: bool,
+  has_entitlements: bool,
+  entitlement_certs: []string,
+  expired_entitlements: []string,
+  cert_errors: []string,
+  releasever: string,
+  releasever_error: string,
+  next_expiry: ?int
+)
+
+method GetStatus() -> (status: Status, paths: Paths)
+
+error CheckFailed (reason: string)
+)";
+
+/// Events in the certificate directories: a certificate is added, removed, replaced or written
+constexpr std::uint32_t CONTENT_EVENTS =
+    IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_CLOSE_WRITE | IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF;
+
+/// Events in the parent directories: a checked directory or file is created, removed or written
+constexpr std::uint32_t ENTRY_EVENTS = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_CLOSE_WRITE;
+
+/// The directory without a trailing separator, "/etc/pki/consumer/" -> "/etc/pki/consumer"
+std::filesystem::path without_trailing_separator(const std::filesystem::path &path) {
+    return path.has_filename() ? path : path.parent_path();
+}
+
+/// The path itself or its nearest ancestor that exists
+std::filesystem::path nearest_existing(std::filesystem::path path) {
+    std::error_code ec;
+    while (!std::filesystem::exists(path, ec) && path.has_relative_path()) {
+        path = path.parent_path();
+    }
+    return path;
+}
+
+}  // namespace
+
+RhsmStatusService::RhsmStatusService(RhsmPaths paths, const std::filesystem::path &socket_path)
+    : paths(std::move(paths)),
+      listen_fd(varlink_listen(socket_path)),
+      expiry_cache(this->paths.expiry_cache_file) {
+    init();
+}
+
+RhsmStatusService::RhsmStatusService(RhsmPaths paths, const int listen_fd)
+    : paths(std::move(paths)),
+      listen_fd(listen_fd),
+      expiry_cache(this->paths.expiry_cache_file) {
+    init();
+}
+
+RhsmStatusService::~RhsmStatusService() {
+    for (const int fd : {listen_fd, inotify_fd, stop_fd}) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+}
+
+void RhsmStatusService::init() {
+    inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (inotify_fd < 0 || stop_fd < 0) {
+        const std::runtime_error error(std::string("Unable to watch rhsm paths: ") + std::strerror(errno));
+        // The destructor is not called when the constructor throws
+        for (const int fd : {listen_fd, inotify_fd, stop_fd}) {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+        throw error;
+    }
+
+    // The cache written by the plugin spares parsing the certificates on the first query
+    try {
+        expiry_cache.read_cache();
+    } catch (const std::exception &) {
+        expiry_cache.records.clear();
+    }
+}
+
+// Watch the certificate directories and the parents of all checked paths. When a parent does not exist,
+// its nearest existing ancestor is watched, so that a directory created later (e.g. by registration)
+// is noticed. Adding an existing watch only updates it, so the watches are added again before each
+// check and follow the created directories.
+void RhsmStatusService::add_watches() {
+    std::map<std::filesystem::path, std::uint32_t> watches;
+    for (const auto &dir : {paths.consumer_cert_dir, paths.entitlement_cert_dir}) {
+        const auto path = without_trailing_separator(dir);
+        watches[path] |= CONTENT_EVENTS;
+        watches[nearest_existing(path.parent_path())] |= ENTRY_EVENTS;
+    }
+    for (const auto &path : {paths.releasever_file, paths.rhsm_host_config_dir, paths.entitlement_host_cert_dir}) {
+        watches[nearest_existing(without_trailing_separator(path).parent_path())] |= ENTRY_EVENTS | IN_ATTRIB;
+    }
+    for (const auto &[path, mask] : watches) {
+        // A path that does not exist (yet) is skipped
+        inotify_add_watch(inotify_fd, path.c_str(), mask);
+    }
+}
+
+// Any event invalidates the status; the status is checked again on the next query, not for each event
+void RhsmStatusService::read_events() {
+    alignas(struct inotify_event) char buffer[4096];
+    while (true) {
+        const auto size = read(inotify_fd, buffer, sizeof(buffer));
+        if (size > 0) {
+            dirty = true;
+        } else if (size < 0 && errno == EINTR) {
+            continue;
+        } else {
+            // EAGAIN: all events were read
+            return;
+        }
+    }
+}
+
+const RhsmStatus &RhsmStatusService::get_status(const std::int64_t now) {
+    if (status && status->next_expiry && *status->next_expiry < now) {
+        dirty = true;
+    }
+    if (dirty || !status) {
+        // Clear the flag and watch first, so that a change made during the check is not missed
+        dirty = false;
+        add_watches();
+        status = check_rhsm_status_with_cache(paths, expiry_cache, now);
+        expiry_cache.prune();
+        // The notAfter dates are kept by the expiry cache; the decoded certificates are not kept in memory
+        // by the long-running service
+        CertCache::get().clear();
+        ++check_count;
+    }
+    return *status;
+}
+
+Json::Value RhsmStatusService::handle_call(const Json::Value &call) {
+    const auto &method = call["method"];
+    if (!method.isString()) {
+        Json::Value parameters(Json::objectValue);
+        parameters["parameter"] = "method";
+        return varlink_error(VARLINK_ERROR_INVALID_PARAMETER, parameters);
+    }
+
+    Json::Value reply;
+    if (method.asString() == STATUS_SERVICE_GET_STATUS) {
+        Json::Value parameters(Json::objectValue);
+        try {
+            // Changes made just before the call are already queued
+            read_events();
+            parameters["status"] = rhsm_status_to_json(get_status(static_cast<std::int64_t>(std::time(nullptr))));
+            parameters["paths"] = rhsm_paths_to_json(paths);
+            reply = varlink_reply(parameters);
+        } catch (const std::exception &e) {
+            parameters["reason"] = e.what();
+            reply = varlink_error(std::string(STATUS_SERVICE_INTERFACE) + ".CheckFailed", parameters);
+        }
+    } else if (method.asString() == "org.varlink.service.GetInfo") {
+        Json::Value parameters(Json::objectValue);
+        parameters["vendor"] = "Red Hat";
+        parameters["product"] = "rhsm-status-service";
+        parameters["version"] = "1";
+        parameters["url"] = "https://github.com/candlepin/rhsm-dnf5-plugins";
+        parameters["interfaces"].append("org.varlink.service");
+        parameters["interfaces"].append(STATUS_SERVICE_INTERFACE);
+        reply = varlink_reply(parameters);
+    } else if (
+        method.asString() == "org.varlink.service.GetInterfaceDescription" &&
+        call["parameters"]["interface"] == STATUS_SERVICE_INTERFACE) {
+        Json::Value parameters(Json::objectValue);
+        parameters["description"] = STATUS_INTERFACE_DESCRIPTION;
+        reply = varlink_reply(parameters);
+    } else {
+        Json::Value parameters(Json::objectValue);
+        parameters["method"] = method.asString();
+        reply = varlink_error(VARLINK_ERROR_METHOD_NOT_FOUND, parameters);
+    }
+
+    // No reply is expected
+    if (call["oneway"].isBool() && call["oneway"].asBool()) {
+        return Json::Value();
+    }
+    return reply;
+}
+
+void RhsmStatusService::serve_client(const int fd) {
+    VarlinkConnection connection(fd);
+    const auto deadline = VarlinkConnection::Clock::now() + CLIENT_TIMEOUT;
+    try {
+        while (const auto call = connection.receive(deadline)) {
+            const auto reply = handle_call(*call);
+            if (!reply.isNull()) {
+                connection.send(reply, deadline);
+            }
+        }
+    } catch (const std::exception &e) {
+        std::cerr << "rhsm-status-service: " << e.what() << std::endl;
+    }
+}
+
+void RhsmStatusService::run() {
+    while (true) {
+        pollfd fds[]{
+            {.fd = stop_fd, .events = POLLIN, .revents = 0},
+            {.fd = inotify_fd, .events = POLLIN, .revents = 0},
+            {.fd = listen_fd, .events = POLLIN, .revents = 0},
+        };
+        if (poll(fds, std::size(fds), -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error(std::string("Unable to poll: ") + std::strerror(errno));
+        }
+        if (fds[0].revents != 0) {
+            return;
+        }
+        if (fds[1].revents != 0) {
+            read_events();
+        }
+        if (fds[2].revents != 0) {
+            const int fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd >= 0) {
+                serve_client(fd);
+            }
+        }
+    }
+}
+
+void RhsmStatusService::stop() noexcept {
+    const std::uint64_t value = 1;
+    // The event stays signaled, so run() returns also when it is called after stop()
+    [[maybe_unused]] const auto written = write(stop_fd, &value, sizeof(value));
+}
@@ -0,0 +1,72 @@
+#ifndef RHSM_DNF5_PLUGINS_RHSM_STATUS_SERVICE_HPP
+#define RHSM_DNF5_PLUGINS_RHSM_STATUS_SERVICE_HPP
+
+#include "rhsm_status.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <json/json.h>
+
+/// Long-running local service answering the status query of the rhsm plugin over Varlink (see
+/// rhsm_status_client.hpp). It watches the checked paths with inotify and keeps the status and the
+/// notAfter dates of entitlement certificates in memory, so a query is answered without reading
+/// any certificate; the status is checked again only after a watched path changed or
+/// an entitlement certificate expired.
+class RhsmStatusService {
+public:
+    /// Listen on socket_path; a stale socket file is replaced.
+    /// Throws std::runtime_error when the socket or the inotify instance cannot be created.
+    RhsmStatusService(RhsmPaths paths, const std::filesystem::path & socket_path);
+
+    /// Take ownership of a listening socket, e.g. one passed by systemd socket activation.
+    /// Throws std::runtime_error when the inotify instance cannot be created.
+    RhsmStatusService(RhsmPaths paths, int listen_fd);
+
+    RhsmStatusService(const RhsmStatusService &) = delete;
+    RhsmStatusService & operator=(const RhsmStatusService &) = delete;
+    ~RhsmStatusService();
+
+    /// Serve clients until stop() is called. Clients are served one at a time; each has
+    /// CLIENT_TIMEOUT to send its call and receive the reply.
+    void run();
+
+    /// Make run() return. Can be called from another thread or from a signal handler.
+    void stop() noexcept;
+
+    /// Handle one Varlink call and return the reply
+    Json::Value handle_call(const Json::Value & call);
+
+    /// Return the status at now (seconds since the epoch), checking it again when needed
+    const RhsmStatus & get_status(std::int64_t now);
+
+    /// Number of times the status was checked, for tests and debugging
+    [[nodiscard]] std::size_t get_check_count() const noexcept { return check_count; }
+
+    /// How long a client can take to send its call and receive the reply
+    static constexpr std::chrono::milliseconds CLIENT_TIMEOUT{1000};
+
+private:
+    void init();
+    void add_watches();
+    void read_events();
+    void serve_client(int fd);
+
+    RhsmPaths paths;
+    int listen_fd = -1;
+    int inotify_fd = -1;
+    int stop_fd = -1;
+
+    /// notAfter dates of entitlement certificates; records are checked against the certificate
+    /// files, so a certificate replaced in place is parsed again
+    CertExpiryCache expiry_cache;
+
+    /// The last checked status; it is checked again when dirty is set
+    std::optional<RhsmStatus> status;
+    bool dirty = true;
+    std::size_t check_count = 0;
+};
+
+#endif // RHSM_DNF5_PLUGINS_RHSM_STATUS_SERVICE_HPP
@@ -0,0 +1,89 @@
+#include "rhsm_status_client.hpp"
+#include "rhsm_status_service.hpp"
+
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+/// The first file descriptor passed by systemd socket activation (SD_LISTEN_FDS_START)
+constexpr int LISTEN_FDS_START = 3;
+
+RhsmStatusService *running_service = nullptr;
+
+void handle_signal(int) {
+    if (running_service) {
+        running_service->stop();
+    }
+}
+
+/// Return the listening socket passed by systemd (see sd_listen_fds(3)), or -1 when the service
+/// was not socket activated
+int get_activation_socket() {
+    const char *listen_pid = std::getenv("LISTEN_PID");
+    const char *listen_fds = std::getenv("LISTEN_FDS");
+    if (!listen_pid || !listen_fds || std::to_string(getpid()) != listen_pid || std::string_view(listen_fds) != "1") {
+        return -1;
+    }
+    unsetenv("LISTEN_PID");
+    unsetenv("LISTEN_FDS");
+    unsetenv("LISTEN_FDNAMES");
+    fcntl(LISTEN_FDS_START, F_SETFD, FD_CLOEXEC);
+    fcntl(LISTEN_FDS_START, F_SETFL, fcntl(LISTEN_FDS_START, F_GETFL) | O_NONBLOCK);
+    return LISTEN_FDS_START;
+}
+
+void print_usage(const char *program) {
+    std::cerr << "Usage: " << program << " [--socket PATH] [--root DIR]\n"
+              << "\n"
+              << "Answer the subscription status queries of the rhsm dnf5 plugin over Varlink.\n"
+              << "\n"
+              << "  --socket PATH  listen on PATH (default " << STATUS_SERVICE_SOCKET
+              << "), unless the socket is passed by systemd\n"
+              << "  --root DIR     check the paths relative to DIR (default /)\n";
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    std::filesystem::path socket_path{STATUS_SERVICE_SOCKET};
+    std::filesystem::path root{"/"};
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg(argv[i]);
+        if ((arg == "--socket" || arg == "--root") && i + 1 < argc) {
+            (arg == "--socket" ? socket_path : root) = argv[++i];
+        } else {
+            print_usage(argv[0]);
+            return arg == "--help" ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    try {
+        const auto paths = RhsmPaths().with_installroot(root);
+        const int activation_socket = get_activation_socket();
+        RhsmStatusService service = activation_socket >= 0 ? RhsmStatusService(paths, activation_socket)
+                                                           : RhsmStatusService(paths, socket_path);
+        running_service = &service;
+        struct sigaction action{};
+        action.sa_handler = handle_signal;
+        sigaction(SIGTERM, &action, nullptr);
+        sigaction(SIGINT, &action, nullptr);
+
+        service.run();
+        running_service = nullptr;
+        if (activation_socket < 0) {
+            std::filesystem::remove(socket_path);
+        }
+    } catch (const std::exception &e) {
+        std::cerr << "rhsm-status-service: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -1,17 +1,101 @@
 #include "rhsm_utils.hpp"
 
+#include "cert_cache.hpp"
+#include "der_validity.hpp"
+#include "dir_snapshot.hpp"
+
 #include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <ctime>
 #include <format>
 #include <fstream>
 #include <iostream>
 #include <set>
 #include <stdexcept>
+#include <thread>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <json/json.h>
 #include <openssl/err.h>
 
 #include <openssl/pem.h>
 #include <openssl/x509.h>
 
-bool in_container() {
+namespace {
+
+using X509Ptr = std::unique_ptr<X509, decltype(&X509_free)>;
+
+X509Ptr read_pem_certificate(const std::filesystem::path &cert_path) {
+    const auto fp = std::unique_ptr<FILE, void(*)(FILE *)>(
+        fopen(cert_path.c_str(), "r"),
+        [](FILE *f) { if (f) fclose(f); }
+    );
+
+    if (fp == nullptr) {
+        const std::string error_msg = std::error_code(errno, std::generic_category()).message();
+        throw std::runtime_error(std::format("Unable to open file {}: {}", cert_path.string(), error_msg));
+    }
+
+    auto cert = X509Ptr(PEM_read_X509(fp.get(), nullptr, nullptr, nullptr), X509_free);
+
+    if (cert == nullptr) {
+        unsigned long ssl_err = ERR_get_error();
+        const char *reason = ERR_reason_error_string(ssl_err);
+        throw std::runtime_error(std::format("Unable to read certificate {}: {}", cert_path.string(), reason));
+    }
+
+    return cert;
+}
+
+/// Read the validity of the certificate without OpenSSL. The certificate is decoded by the certificate
+/// cache, so the generation of redhat.repo does not read it again in the same dnf run.
+/// Returns std::nullopt when the certificate has to be parsed by OpenSSL.
+/// Throws std::runtime_error if the file cannot be read.
+std::optional<CertValidity> read_cert_file_validity(const std::filesystem::path &cert_path) {
+    return CertCache::get().get_file_facts(cert_path)->validity;
+}
+
+/// Try to get the identity of the file used to validate cached records. Returns false if the file does not exist.
+bool stat_file(const std::filesystem::path &path, CertExpiryRecord &record) {
+    struct stat st{};
+    if (stat(path.c_str(), &st) != 0) {
+        return false;
+    }
+    record.inode = st.st_ino;
+    record.size = st.st_size;
+    record.mtime_ns = static_cast<std::int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    record.ctime_ns = static_cast<std::int64_t>(st.st_ctim.tv_sec) * 1000000000 + st.st_ctim.tv_nsec;
+    return true;
+}
+
+}  // namespace
+
+RhsmPaths RhsmPaths::with_installroot(const std::filesystem::path &installroot) const {
+    const auto prefix = [&installroot](const std::filesystem::path &path) {
+        const std::filesystem::path root = installroot.empty() ? std::filesystem::path("/") : installroot;
+        return (root / path.relative_path()).lexically_normal();
+    };
+    return RhsmPaths{
+        .consumer_cert_dir = prefix(consumer_cert_dir),
+        .entitlement_cert_dir = prefix(entitlement_cert_dir),
+        .releasever_file = prefix(releasever_file),
+        .rhsm_host_config_dir = prefix(rhsm_host_config_dir),
+        .entitlement_host_cert_dir = prefix(entitlement_host_cert_dir),
+        .expiry_cache_file = prefix(expiry_cache_file),
+        .status_cache_file = prefix(status_cache_file),
+        .redhat_repo_file = prefix(redhat_repo_file),
+        .content_overrides_file = prefix(content_overrides_file),
+        .product_cert_dir = prefix(product_cert_dir),
+        .product_default_cert_dir = prefix(product_default_cert_dir),
+        .rhsm_config_file = prefix(rhsm_config_file),
+        .content_cache_file = prefix(content_cache_file),
+    };
+}
+
+bool in_container(const std::filesystem::path &rhsm_host_config_dir,
+                  const std::filesystem::path &entitlement_host_cert_dir) {
     namespace fs = std::filesystem;
 
     //  If the path exists, we are in a container.
@@ -35,58 +119,24 @@ bool in_container() {
     //    /etc/rhsm-host/            exists
     //    /etc/pki/entitlement-host/ exists and is not empty
 
-    return fs::is_directory(RHSM_HOST_CONFIG_DIR) && fs::is_directory(ENTITLEMENT_HOST_CERT_DIR);
+    return fs::is_directory(rhsm_host_config_dir) && fs::is_directory(entitlement_host_cert_dir);
 }
 
 bool has_consumer_certificate(const std::filesystem::path &consumer_cert_dir) {
-    namespace fs = std::filesystem;
-
-    if (!fs::exists(consumer_cert_dir) || !fs::is_directory(consumer_cert_dir)) {
-        return false;
-    }
-    return std::ranges::any_of(
-        fs::directory_iterator(consumer_cert_dir),
-        fs::directory_iterator(),
-        [](const auto &entry) {
-            return entry.path().extension() == ".pem";
-        });
+    return DirectorySnapshot(consumer_cert_dir).has_pem_files();
 }
 
 bool has_entitlement_certificates(const std::filesystem::path &entitlement_cert_dir) {
-    namespace fs = std::filesystem;
-
-    if (!fs::exists(entitlement_cert_dir) || !fs::is_directory(entitlement_cert_dir)) {
-        return false;
-    }
-    return std::ranges::any_of(
-        fs::directory_iterator(entitlement_cert_dir),
-        fs::directory_iterator(),
-        [](const auto &entry) {
-            return entry.path().extension() == ".pem";
-        });
+    return DirectorySnapshot(entitlement_cert_dir).has_pem_files();
 }
 
 bool is_cert_expired(const std::filesystem::path &cert_path) {
-    const auto fp = std::unique_ptr<FILE, void(*)(FILE *)>(
-        fopen(cert_path.c_str(), "r"),
-        [](FILE *f) { if (f) fclose(f); }
-    );
-
-    if (fp == nullptr) {
-        const std::string error_msg = std::error_code(errno, std::generic_category()).message();
-        throw std::runtime_error(std::format("Unable to open file {}: {}", cert_path.string(), error_msg));
+    if (const auto validity = read_cert_file_validity(cert_path)) {
+        // Like X509_cmp_current_time(), the certificate is expired at its notAfter time
+        return validity->not_after <= std::time(nullptr);
     }
 
-    const auto cert = std::unique_ptr<X509, decltype(&X509_free)>(
-        PEM_read_X509(fp.get(), nullptr, nullptr, nullptr),
-        X509_free
-    );
-
-    if (cert == nullptr) {
-        unsigned long ssl_err = ERR_get_error();
-        const char *reason = ERR_reason_error_string(ssl_err);
-        throw std::runtime_error(std::format("Unable to read certificate {}: {}", cert_path.string(), reason));
-    }
+    const auto cert = read_pem_certificate(cert_path);
 
     const ASN1_TIME *not_after = X509_get0_notAfter(cert.get());
     int cmp = X509_cmp_current_time(not_after);
@@ -100,6 +150,228 @@ bool is_cert_expired(const std::filesystem::path &cert_path) {
     return cmp == -1;
 }
 
+std::int64_t get_cert_not_after(const std::filesystem::path &cert_path) {
+    if (const auto validity = read_cert_file_validity(cert_path)) {
+        return validity->not_after;
+    }
+
+    const auto cert = read_pem_certificate(cert_path);
+
+    struct tm not_after_tm{};
+    if (ASN1_TIME_to_tm(X509_get0_notAfter(cert.get()), &not_after_tm) != 1) {
+        throw std::runtime_error("Unable to convert ASN1_TIME in certificate: " + cert_path.string());
+    }
+    return timegm(&not_after_tm);
+}
+
+std::vector<std::filesystem::path> get_entitlement_cert_paths(const std::filesystem::path &entitlement_cert_dir) {
+    return DirectorySnapshot(entitlement_cert_dir).get_cert_paths();
+}
+
+std::vector<CertNotAfter> get_certs_not_after(
+    const std::vector<std::filesystem::path> &cert_paths, const unsigned max_threads) {
+    std::vector<CertNotAfter> results(cert_paths.size());
+    std::atomic<std::size_t> next_index{0};
+
+    // Every worker takes the next certificate until all of them are parsed. Each result
+    // is written by exactly one worker, so no other synchronization is needed.
+    const auto worker = [&cert_paths, &results, &next_index]() {
+        for (auto i = next_index++; i < cert_paths.size(); i = next_index++) {
+            try {
+                results[i].not_after = get_cert_not_after(cert_paths[i]);
+            } catch (const std::exception &e) {
+                results[i].error = e.what();
+            }
+        }
+    };
+
+    const auto hardware_threads = std::max(1U, std::thread::hardware_concurrency());
+    const auto useful_threads = (cert_paths.size() + MIN_CERTS_PER_PARSER_THREAD - 1) / MIN_CERTS_PER_PARSER_THREAD;
+    const auto threads = std::min<std::size_t>({max_threads, hardware_threads, useful_threads});
+
+    {
+        std::vector<std::jthread> pool;
+        for (std::size_t i = 1; i < threads; ++i) {
+            pool.emplace_back(worker);
+        }
+        // The calling thread works too
+        worker();
+    }
+    return results;
+}
+
+void CertExpiryCache::read_cache() {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        throw std::runtime_error("could not open file: " + path.string());
+    }
+
+    Json::Value root;
+    Json::CharReaderBuilder reader_builder;
+    Json::String errors;
+    if (!Json::parseFromStream(reader_builder, file, &root, &errors)) {
+        throw std::runtime_error(std::format("could not parse file {}: {}", path.string(), errors));
+    }
+    if (!root.isObject()) {
+        throw std::runtime_error("invalid format of file: " + path.string());
+    }
+
+    records.clear();
+    for (const auto &cert_path: root.getMemberNames()) {
+        const Json::Value &record = root[cert_path];
+        // Invalid records are ignored, because they can always be computed again
+        if (!record.isObject() || !record["inode"].isUInt64() || !record["size"].isInt64() ||
+            !record["mtime_ns"].isInt64() || !record["ctime_ns"].isInt64() || !record["not_after"].isInt64()) {
+            continue;
+        }
+        records[cert_path] = CertExpiryRecord{
+            .inode = record["inode"].asUInt64(),
+            .size = record["size"].asInt64(),
+            .mtime_ns = record["mtime_ns"].asInt64(),
+            .ctime_ns = record["ctime_ns"].asInt64(),
+            .not_after = record["not_after"].asInt64(),
+        };
+    }
+    dirty = false;
+}
+
+void CertExpiryCache::write_cache() const {
+    Json::Value root(Json::objectValue);
+    for (const auto &[cert_path, record]: records) {
+        Json::Value value(Json::objectValue);
+        value["inode"] = Json::UInt64(record.inode);
+        value["size"] = Json::Int64(record.size);
+        value["mtime_ns"] = Json::Int64(record.mtime_ns);
+        value["ctime_ns"] = Json::Int64(record.ctime_ns);
+        value["not_after"] = Json::Int64(record.not_after);
+        root[cert_path] = value;
+    }
+    Json::StreamWriterBuilder writer_builder;
+    writer_builder["indentation"] = "";
+    write_file_atomically(path, Json::writeString(writer_builder, root));
+}
+
+std::optional<std::int64_t> CertExpiryCache::lookup(const std::filesystem::path &cert_path) const {
+    const auto it = records.find(cert_path.string());
+    if (it == records.end()) {
+        return std::nullopt;
+    }
+    CertExpiryRecord current;
+    if (!stat_file(cert_path, current)) {
+        return std::nullopt;
+    }
+    const auto &cached = it->second;
+    if (current.inode != cached.inode || current.size != cached.size ||
+        current.mtime_ns != cached.mtime_ns || current.ctime_ns != cached.ctime_ns) {
+        return std::nullopt;
+    }
+    return cached.not_after;
+}
+
+bool CertExpiryCache::store(const std::filesystem::path &cert_path, const std::int64_t not_after) {
+    CertExpiryRecord record{.not_after = not_after};
+    if (!stat_file(cert_path, record)) {
+        return false;
+    }
+    records[cert_path.string()] = record;
+    dirty = true;
+    return true;
+}
+
+std::int64_t CertExpiryCache::get_not_after(const std::filesystem::path &cert_path) {
+    if (const auto not_after = lookup(cert_path)) {
+        ++hits;
+        return *not_after;
+    }
+    ++misses;
+    const auto not_after = get_cert_not_after(cert_path);
+    store(cert_path, not_after);
+    return not_after;
+}
+
+std::vector<CertNotAfter> CertExpiryCache::get_not_after(
+    const std::vector<std::filesystem::path> &cert_paths, const unsigned max_threads) {
+    std::vector<CertNotAfter> results(cert_paths.size());
+    std::vector<std::filesystem::path> uncached_paths;
+    std::vector<std::size_t> uncached_indexes;
+    for (std::size_t i = 0; i < cert_paths.size(); ++i) {
+        if (const auto not_after = lookup(cert_paths[i])) {
+            results[i].not_after = not_after;
+        } else {
+            uncached_paths.push_back(cert_paths[i]);
+            uncached_indexes.push_back(i);
+        }
+    }
+    hits += cert_paths.size() - uncached_paths.size();
+    misses += uncached_paths.size();
+
+    auto parsed = get_certs_not_after(uncached_paths, max_threads);
+    for (std::size_t i = 0; i < parsed.size(); ++i) {
+        if (parsed[i].not_after) {
+            store(uncached_paths[i], *parsed[i].not_after);
+        }
+        results[uncached_indexes[i]] = std::move(parsed[i]);
+    }
+    return results;
+}
+
+std::size_t CertExpiryCache::prune() {
+    const auto removed = std::erase_if(records, [](const auto &item) {
+        return !std::filesystem::exists(item.first);
+    });
+    if (removed > 0) {
+        dirty = true;
+    }
+    return removed;
+}
+
+void write_file_atomically(const std::filesystem::path &path, const std::string &content) {
+    auto temp_path = path.string() + ".XXXXXX";
+    int fd = mkstemp(temp_path.data());
+    if (fd < 0) {
+        throw std::runtime_error(std::format("could not create temporary file for {}: {}",
+                                             path.string(), std::generic_category().message(errno)));
+    }
+    // The temporary file is removed on every error, so that a partial file is never left behind or installed
+    const auto fail = [&fd, &temp_path](const std::string &message) {
+        const auto error_msg = std::generic_category().message(errno);
+        if (fd >= 0) {
+            close(fd);
+        }
+        unlink(temp_path.c_str());
+        throw std::runtime_error(std::format("{}: {}", message, error_msg));
+    };
+
+    std::string_view remaining = content;
+    while (!remaining.empty()) {
+        const auto written = write(fd, remaining.data(), remaining.size());
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written < 0) {
+            fail("could not write file " + temp_path);
+        }
+        remaining.remove_prefix(static_cast<std::size_t>(written));
+    }
+    // mkstemp() creates the file with 0600 permissions; the files are world-readable like other RHSM files
+    if (fchmod(fd, 0644) != 0) {
+        fail("could not change mode of file " + temp_path);
+    }
+    // The content must be on the disk before the rename is, otherwise a crash can leave an empty file
+    if (fsync(fd) != 0) {
+        fail("could not sync file " + temp_path);
+    }
+    const auto closed = close(fd);
+    fd = -1;
+    if (closed != 0) {
+        fail("could not close file " + temp_path);
+    }
+
+    if (rename(temp_path.c_str(), path.c_str()) != 0) {
+        fail(std::format("could not rename {} to {}", temp_path, path.string()));
+    }
+}
+
 std::string get_releasever(const std::filesystem::path &releasever_file) {
     namespace fs = std::filesystem;
 
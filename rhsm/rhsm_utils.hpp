@@ -1,7 +1,9 @@
 #ifndef RHSM_DNF5_PLUGINS_RHSM_UTILS_HPP
 #define RHSM_DNF5_PLUGINS_RHSM_UTILS_HPP
 
+#include <cstdint>
 #include <filesystem>
+#include <map>
 #include <optional>
 #include <string>
 #include <vector>
@@ -9,14 +11,46 @@
 constexpr const char * CONSUMER_CERT_DIR = "/etc/pki/consumer/";
 constexpr const char * ENTITLEMENT_CERT_DIR = "/etc/pki/entitlement/";
 constexpr const char * RELEASEVER_FILE = "/etc/dnf/vars/releasever";
+constexpr const char * EXPIRY_CACHE_FILE = "/var/cache/rhsm/entitlement-expiry.json";
+constexpr const char * STATUS_CACHE_FILE = "/var/cache/rhsm/status.json";
+constexpr const char * CONTENT_CACHE_FILE = "/var/cache/rhsm/entitlement-content.json";
+
+constexpr const char * REDHAT_REPO_FILE = "/etc/yum.repos.d/redhat.repo";
+constexpr const char * CONTENT_OVERRIDES_FILE = "/var/lib/rhsm/cache/content_overrides.json";
+constexpr const char * PRODUCT_CERT_DIR = "/etc/pki/product/";
+constexpr const char * PRODUCT_DEFAULT_CERT_DIR = "/etc/pki/product-default/";
+constexpr const char * RHSM_CONFIG_FILE = "/etc/rhsm/rhsm.conf";
 
 constexpr const char * RHSM_HOST_CONFIG_DIR = "/etc/rhsm-host";
 constexpr const char * ENTITLEMENT_HOST_CERT_DIR = "/etc/pki/entitlement-host";
 
+/// Files and directories checked by the rhsm plugin. The defaults can be overridden
+/// in rhsm.conf and all of them are resolved relative to the installroot using
+/// with_installroot() before they are used.
+struct RhsmPaths {
+    std::filesystem::path consumer_cert_dir{CONSUMER_CERT_DIR};
+    std::filesystem::path entitlement_cert_dir{ENTITLEMENT_CERT_DIR};
+    std::filesystem::path releasever_file{RELEASEVER_FILE};
+    std::filesystem::path rhsm_host_config_dir{RHSM_HOST_CONFIG_DIR};
+    std::filesystem::path entitlement_host_cert_dir{ENTITLEMENT_HOST_CERT_DIR};
+    std::filesystem::path expiry_cache_file{EXPIRY_CACHE_FILE};
+    std::filesystem::path status_cache_file{STATUS_CACHE_FILE};
+    std::filesystem::path redhat_repo_file{REDHAT_REPO_FILE};
+    std::filesystem::path content_overrides_file{CONTENT_OVERRIDES_FILE};
+    std::filesystem::path product_cert_dir{PRODUCT_CERT_DIR};
+    std::filesystem::path product_default_cert_dir{PRODUCT_DEFAULT_CERT_DIR};
+    std::filesystem::path rhsm_config_file{RHSM_CONFIG_FILE};
+    std::filesystem::path content_cache_file{CONTENT_CACHE_FILE};
+
+    [[nodiscard]] RhsmPaths with_installroot(const std::filesystem::path & installroot) const;
+};
+
 /// Check if the current process is running inside a container.
 /// Detects UBI containers by checking for the presence of RHSM host directories
-/// (RHSM_HOST_CONFIG_DIR and ENTITLEMENT_HOST_CERT_DIR)
-bool in_container();
+/// (RHSM_HOST_CONFIG_DIR and ENTITLEMENT_HOST_CERT_DIR by default)
+bool in_container(
+    const std::filesystem::path & rhsm_host_config_dir = RHSM_HOST_CONFIG_DIR,
+    const std::filesystem::path & entitlement_host_cert_dir = ENTITLEMENT_HOST_CERT_DIR);
 
 /// Check if a consumer certificate (.pem) exists in the given directory.
 /// The presence of a consumer certificate indicates the system is registered.
@@ -25,10 +59,104 @@ bool has_consumer_certificate(const std::filesystem::path & consumer_cert_dir);
 /// Check if any entitlement certificate (.pem) exists in the given directory.
 bool has_entitlement_certificates(const std::filesystem::path & entitlement_cert_dir);
 
+/// Returns sorted paths of entitlement certificates (.pem files except keys) in the given directory.
+/// Returns an empty list if the directory does not exist or cannot be read.
+std::vector<std::filesystem::path> get_entitlement_cert_paths(const std::filesystem::path & entitlement_cert_dir);
+
 /// Reads the certificate in cert_path and returns true if the notAfter date is before the current date (expired).
+/// The certificate is decoded by the certificate cache (see cert_cache.hpp), once per dnf run; OpenSSL
+/// parses the certificate when the cache cannot decode it.
 /// Throws std::runtime_error if the file cannot be opened or the certificate cannot be parsed.
 bool is_cert_expired(const std::filesystem::path & cert_path);
 
+/// Reads the certificate in cert_path and returns its notAfter date as seconds since the epoch.
+/// Like is_cert_expired(), it falls back to OpenSSL when the fast path fails.
+/// Throws std::runtime_error if the file cannot be opened or the certificate cannot be parsed.
+std::int64_t get_cert_not_after(const std::filesystem::path & cert_path);
+
+/// Maximum number of threads used for parsing entitlement certificates
+constexpr unsigned MAX_CERT_PARSER_THREADS = 4;
+
+/// Minimum number of certificates parsed by one thread; fewer certificates are parsed on the calling thread
+constexpr std::size_t MIN_CERTS_PER_PARSER_THREAD = 16;
+
+/// The notAfter date of one certificate, or the error message when the certificate cannot be parsed
+struct CertNotAfter {
+    std::optional<std::int64_t> not_after;
+    std::string error;
+};
+
+/// Reads the certificates and returns their notAfter dates in the order of cert_paths. Large sets
+/// of certificates (e.g. hundreds of v3 entitlement certificates on non-SCA systems) are parsed by
+/// a small pool of at most max_threads threads.
+std::vector<CertNotAfter> get_certs_not_after(
+    const std::vector<std::filesystem::path> & cert_paths,
+    unsigned max_threads = MAX_CERT_PARSER_THREADS);
+
+/// The notAfter date of one certificate. The record is valid only while the inode, the size,
+/// the modification time and the status change time of the certificate file are the same.
+/// The inode and the ctime detect certificates replaced by a rename or restored with
+/// the original modification time.
+struct CertExpiryRecord {
+    std::uint64_t inode = 0;
+    std::int64_t size = 0;
+    std::int64_t mtime_ns = 0;
+    std::int64_t ctime_ns = 0;
+    std::int64_t not_after = 0;
+};
+
+/// Persistent cache of notAfter dates of entitlement certificates. It allows checking expiration
+/// of certificates without parsing them on every dnf command. The cache is read when the plugin
+/// checks the certificates, and it is written when repository metadata is downloaded (e.g. by
+/// "dnf makecache").
+class CertExpiryCache {
+public:
+    explicit CertExpiryCache(std::filesystem::path path) : path(std::move(path)) {}
+
+    std::filesystem::path path;
+
+    /// Records indexed by the path of the certificate
+    std::map<std::string, CertExpiryRecord> records;
+
+    /// Has the cache been changed since it was read?
+    bool dirty = false;
+
+    /// Certificates whose notAfter date get_not_after() took from the cache, and that it parsed instead
+    std::size_t hits = 0;
+    std::size_t misses = 0;
+
+    /// Read the cache file. Throws std::runtime_error if the file cannot be read or parsed.
+    void read_cache();
+
+    /// Atomically replace the cache file. Throws std::runtime_error on failure.
+    void write_cache() const;
+
+    /// Return the cached notAfter date of the certificate, when the certificate has not been
+    /// changed since the record was stored.
+    [[nodiscard]] std::optional<std::int64_t> lookup(const std::filesystem::path & cert_path) const;
+
+    /// Store the notAfter date of the certificate. Returns false if the certificate does not exist.
+    bool store(const std::filesystem::path & cert_path, std::int64_t not_after);
+
+    /// Return the notAfter date of the certificate from the cache, or parse the certificate
+    /// and store its notAfter date in the cache.
+    /// Throws std::runtime_error if the certificate cannot be parsed.
+    std::int64_t get_not_after(const std::filesystem::path & cert_path);
+
+    /// Return the notAfter dates of the certificates in the order of cert_paths. Certificates that are
+    /// not cached are parsed in parallel using get_certs_not_after() and stored in the cache.
+    std::vector<CertNotAfter> get_not_after(
+        const std::vector<std::filesystem::path> & cert_paths,
+        unsigned max_threads = MAX_CERT_PARSER_THREADS);
+
+    /// Remove records of certificates that do not exist anymore. Returns the number of removed records.
+    std::size_t prune();
+};
+
+/// Atomically replace the content of the file using a temporary file in the same directory.
+/// Throws std::runtime_error on failure.
+void write_file_atomically(const std::filesystem::path & path, const std::string & content);
+
 /// Read the release version from the given file path.
 /// Returns the trimmed first line of the file, or an empty string if the file
 /// is empty or contains only whitespace.
@@ -0,0 +1,146 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "dir_snapshot.hpp"
+#include "syscall_counter.hpp"
+
+namespace fs = std::filesystem;
+
+
+class DirSnapshotTest : public ::testing::Test {
+protected:
+    fs::path temp_dir;
+    RhsmPaths paths;
+
+    void SetUp() override {
+        temp_dir = fs::temp_directory_path() / "rhsm_dir_snapshot_test";
+        fs::remove_all(temp_dir);
+        fs::create_directories(temp_dir);
+        paths = RhsmPaths().with_installroot(temp_dir);
+    }
+
+    void TearDown() override {
+        fs::remove_all(temp_dir);
+    }
+
+    /// A registered system with certificates and keys in the consumer and entitlement directories
+    void create_registered_system(const int entitlements) const {
+        fs::create_directories(paths.consumer_cert_dir);
+        std::ofstream(paths.consumer_cert_dir / "cert.pem") << "cert";
+        std::ofstream(paths.consumer_cert_dir / "key.pem") << "key";
+        fs::create_directories(paths.entitlement_cert_dir);
+        for (int i = 0; i < entitlements; ++i) {
+            std::ofstream(paths.entitlement_cert_dir / (std::to_string(i) + ".pem")) << "cert";
+            std::ofstream(paths.entitlement_cert_dir / (std::to_string(i) + "-key.pem")) << "key";
+        }
+    }
+};
+
+
+// --- DirectorySnapshot tests ---
+
+TEST_F(DirSnapshotTest, ClassifiesEntries) {
+    std::ofstream(temp_dir / "2.pem") << "cert";
+    std::ofstream(temp_dir / "1.pem") << "cert";
+    std::ofstream(temp_dir / "1-key.pem") << "key";
+    std::ofstream(temp_dir / ".pem") << "hidden";
+    std::ofstream(temp_dir / "README") << "text";
+    const DirectorySnapshot snapshot(temp_dir);
+    EXPECT_TRUE(snapshot.exists());
+    EXPECT_TRUE(snapshot.has_pem_files());
+    EXPECT_EQ(snapshot.get_cert_names(), (std::vector<std::string>{"1.pem", "2.pem"}));
+    EXPECT_EQ(snapshot.get_cert_paths(), (std::vector<fs::path>{temp_dir / "1.pem", temp_dir / "2.pem"}));
+}
+
+TEST_F(DirSnapshotTest, OnlyKeys_HasPemFiles) {
+    std::ofstream(temp_dir / "1-key.pem") << "key";
+    const DirectorySnapshot snapshot(temp_dir);
+    EXPECT_TRUE(snapshot.has_pem_files());
+    EXPECT_TRUE(snapshot.get_cert_names().empty());
+}
+
+TEST_F(DirSnapshotTest, EmptyDir) {
+    const DirectorySnapshot snapshot(temp_dir);
+    EXPECT_TRUE(snapshot.exists());
+    EXPECT_FALSE(snapshot.has_pem_files());
+}
+
+TEST_F(DirSnapshotTest, NonexistentDir) {
+    const DirectorySnapshot snapshot(temp_dir / "nonexistent");
+    EXPECT_FALSE(snapshot.exists());
+    EXPECT_FALSE(snapshot.has_pem_files());
+    EXPECT_TRUE(snapshot.get_cert_paths().empty());
+}
+
+TEST_F(DirSnapshotTest, RegularFile_IsNotDirectory) {
+    std::ofstream(temp_dir / "file.pem") << "cert";
+    EXPECT_FALSE(DirectorySnapshot(temp_dir / "file.pem").exists());
+}
+
+TEST_F(DirSnapshotTest, ManyEntries) {
+    // More entries than fit into one getdents64 buffer
+    for (int i = 0; i < 2000; ++i) {
+        std::ofstream(temp_dir / (std::to_string(10000 + i) + "-entitlement-certificate.pem")) << "cert";
+    }
+    const DirectorySnapshot snapshot(temp_dir);
+    ASSERT_EQ(snapshot.get_cert_names().size(), 2000);
+    EXPECT_EQ(snapshot.get_cert_names().front(), "10000-entitlement-certificate.pem");
+    EXPECT_EQ(snapshot.get_cert_names().back(), "11999-entitlement-certificate.pem");
+}
+
+// --- RhsmSnapshot tests ---
+
+TEST_F(DirSnapshotTest, RhsmSnapshot_RegisteredSystem) {
+    create_registered_system(3);
+    const auto snapshot = take_rhsm_snapshot(paths);
+    EXPECT_FALSE(snapshot.in_container);
+    EXPECT_TRUE(snapshot.has_consumer_certificate());
+    EXPECT_TRUE(snapshot.has_entitlement_certificates());
+    EXPECT_EQ(snapshot.entitlement_certs.get_cert_names().size(), 3);
+}
+
+TEST_F(DirSnapshotTest, RhsmSnapshot_UnregisteredSystem) {
+    const auto snapshot = take_rhsm_snapshot(paths);
+    EXPECT_FALSE(snapshot.in_container);
+    EXPECT_FALSE(snapshot.has_consumer_certificate());
+    EXPECT_FALSE(snapshot.has_entitlement_certificates());
+}
+
+TEST_F(DirSnapshotTest, RhsmSnapshot_Container) {
+    fs::create_directories(paths.rhsm_host_config_dir);
+    fs::create_directories(paths.entitlement_host_cert_dir);
+    EXPECT_TRUE(take_rhsm_snapshot(paths).in_container);
+}
+
+TEST_F(DirSnapshotTest, RhsmSnapshot_SyscallCount) {
+    create_registered_system(50);
+    const auto counts = syscall_counter::count_syscalls([this]() {
+        const auto snapshot = take_rhsm_snapshot(paths);
+        if (snapshot.entitlement_certs.get_cert_names().size() != 50) {
+            throw std::runtime_error("unexpected snapshot");
+        }
+    });
+    if (!counts) {
+        GTEST_SKIP() << "ptrace is not available";
+    }
+    for (const auto &[nr, count] : *counts) {
+        std::cout << "syscall " << nr << ": " << count << std::endl;
+    }
+
+    // Each listed directory: openat, getdents64 (entries), getdents64 (end of directory), close
+    EXPECT_EQ(syscall_counter::count_of(*counts, SYS_openat), 2);
+    EXPECT_EQ(syscall_counter::count_of(*counts, SYS_getdents64), 4);
+    EXPECT_EQ(syscall_counter::count_of(*counts, SYS_close), 2);
+    // The missing host configuration directory is checked by one stat(), memory allocation may add a few calls
+    EXPECT_LE(syscall_counter::total(*counts), 12);
+}
+
+
+int main(int argc, char ** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
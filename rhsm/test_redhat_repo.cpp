@@ -0,0 +1,544 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <sys/stat.h>
+
+#include "base64.hpp"
+#include "cert_cache.hpp"
+#include "content_path_index.hpp"
+#include "entitlement_cache.hpp"
+#include "entitlement_content.hpp"
+#include "redhat_repo.hpp"
+
+namespace fs = std::filesystem;
+
+
+class RedhatRepoTest : public ::testing::Test {
+protected:
+    fs::path temp_dir;
+    static fs::path test_data_dir;
+
+    void SetUp() override {
+        temp_dir = fs::temp_directory_path() / "redhat_repo_test";
+        fs::remove_all(temp_dir);
+        fs::create_directories(temp_dir);
+    }
+
+    void TearDown() override {
+        fs::remove_all(temp_dir);
+    }
+
+    static void SetUpTestSuite() {
+        test_data_dir = fs::path("test_data");
+        if (!fs::exists(test_data_dir)) {
+            test_data_dir = fs::path(TEST_DATA_DIR);
+        }
+    }
+
+    static std::string read_file(const fs::path &path) {
+        std::ifstream file(path, std::ios::binary);
+        std::ostringstream content;
+        content << file.rdbuf();
+        return content.str();
+    }
+
+    /// The certificate with the given entitlement data block
+    static std::string with_entitlement_data(const std::string &body) {
+        const auto pem = read_file(test_data_dir / "valid.pem");
+        return pem + "-----BEGIN ENTITLEMENT DATA-----\n" + body + "\n-----END ENTITLEMENT DATA-----\n";
+    }
+
+    /// The test certificates as they are installed by subscription-manager
+    static std::vector<EntitlementCert> installed_certs() {
+        auto v3 = read_entitlement_cert(test_data_dir / "entitlement-v3.pem");
+        v3.cert_path = "/etc/pki/entitlement/1000.pem";
+        v3.key_path = "/etc/pki/entitlement/1000-key.pem";
+        auto v1 = read_entitlement_cert(test_data_dir / "entitlement-v1.pem");
+        v1.cert_path = "/etc/pki/entitlement/2000.pem";
+        v1.key_path = "/etc/pki/entitlement/2000-key.pem";
+        return {v3, v1};
+    }
+
+    static RedhatRepoOptions x86_64_options() {
+        RedhatRepoOptions options;
+        options.arch = "x86_64";
+        options.provided_tags = {"rhel-9", "rhel-9-x86_64"};
+        return options;
+    }
+
+    static std::vector<std::string> labels(const std::string &repo_file) {
+        std::vector<std::string> labels;
+        std::istringstream lines(repo_file);
+        for (std::string line; std::getline(lines, line);) {
+            if (line.starts_with("[")) {
+                labels.push_back(line.substr(1, line.size() - 2));
+            }
+        }
+        return labels;
+    }
+};
+
+fs::path RedhatRepoTest::test_data_dir;
+
+
+// --- Entitlement content tests ---
+
+TEST_F(RedhatRepoTest, DecodeEntitlementData_V3) {
+    const auto contents = decode_entitlement_data(read_file(test_data_dir / "entitlement-v3.pem"));
+    ASSERT_TRUE(contents.has_value());
+    ASSERT_EQ(contents->size(), 6);
+
+    const auto &baseos = (*contents)[0];
+    EXPECT_EQ(baseos.id, "9001");
+    EXPECT_EQ(baseos.type, "yum");
+    EXPECT_EQ(baseos.label, "rhel-9-for-x86_64-baseos-rpms");
+    EXPECT_EQ(baseos.name, "Red Hat Enterprise Linux 9 for x86_64 - BaseOS (RPMs)");
+    EXPECT_EQ(baseos.vendor, "Red Hat");
+    EXPECT_EQ(baseos.path, "/content/dist/rhel9/$releasever/x86_64/baseos/os");
+    EXPECT_EQ(baseos.gpg_url, "file:///etc/pki/rpm-gpg/RPM-GPG-KEY-redhat-release");
+    EXPECT_TRUE(baseos.enabled);
+    EXPECT_EQ(baseos.metadata_expire, 86400);
+    EXPECT_EQ(baseos.required_tags, (std::vector<std::string>{"rhel-9-x86_64"}));
+    EXPECT_EQ(baseos.arches, (std::vector<std::string>{"x86_64"}));
+
+    // Content sets without architectures inherit the architectures of their product
+    const auto &source = (*contents)[1];
+    EXPECT_FALSE(source.enabled);
+    EXPECT_EQ(source.arches, (std::vector<std::string>{"x86_64"}));
+    EXPECT_EQ((*contents)[3].type, "file");
+    EXPECT_EQ((*contents)[4].arches, (std::vector<std::string>{"aarch64"}));
+    EXPECT_FALSE((*contents)[5].metadata_expire.has_value());
+}
+
+TEST_F(RedhatRepoTest, DecodeEntitlementData_NoBlock) {
+    EXPECT_FALSE(decode_entitlement_data(read_file(test_data_dir / "valid.pem")).has_value());
+}
+
+TEST_F(RedhatRepoTest, DecodeEntitlementData_Invalid) {
+    // Not base64, not zlib, and zlib compressed data cut in the middle
+    EXPECT_THROW(decode_entitlement_data(with_entitlement_data("not base64!")), std::runtime_error);
+    EXPECT_THROW(decode_entitlement_data(with_entitlement_data("bm90IHpsaWI=")), std::runtime_error);
+    const auto pem = read_file(test_data_dir / "entitlement-v3.pem");
+    const auto begin = pem.find("-----BEGIN ENTITLEMENT DATA-----\n") + 33;
+    EXPECT_THROW(decode_entitlement_data(with_entitlement_data(pem.substr(begin, 64))), std::runtime_error);
+    EXPECT_THROW(decode_entitlement_data(pem.substr(0, begin + 64)), std::runtime_error);
+}
+
+TEST_F(RedhatRepoTest, ZlibDecompress_MaxSize) {
+    const auto pem = read_file(test_data_dir / "entitlement-v3.pem");
+    const auto begin = pem.find("-----BEGIN ENTITLEMENT DATA-----\n") + 33;
+    const auto compressed = base64_decode(pem.substr(begin, pem.find("-----END", begin) - begin));
+    ASSERT_TRUE(compressed.has_value());
+    const auto data = zlib_decompress(*compressed, MAX_ENTITLEMENT_DATA_SIZE);
+    EXPECT_TRUE(data.starts_with("{\"consumer\""));
+    EXPECT_NO_THROW(zlib_decompress(*compressed, data.size()));
+    EXPECT_THROW(zlib_decompress(*compressed, data.size() - 1), std::runtime_error);
+}
+
+TEST_F(RedhatRepoTest, DecodeV1EntitlementContent) {
+    const auto contents = decode_v1_entitlement_content(read_file(test_data_dir / "entitlement-v1.pem"));
+    ASSERT_EQ(contents.size(), 3);
+
+    const auto &server = contents[0];
+    EXPECT_EQ(server.id, "5001");
+    EXPECT_EQ(server.type, "yum");
+    EXPECT_EQ(server.label, "legacy-server-rpms");
+    EXPECT_EQ(server.name, "Legacy Server (RPMs)");
+    EXPECT_EQ(server.vendor, "Red Hat");
+    EXPECT_EQ(server.path, "/content/dist/legacy/$releasever/$basearch/os");
+    EXPECT_EQ(server.gpg_url, "file:///etc/pki/rpm-gpg/RPM-GPG-KEY-redhat-release");
+    EXPECT_TRUE(server.enabled);
+    EXPECT_EQ(server.metadata_expire, 3600);
+    EXPECT_EQ(server.required_tags, (std::vector<std::string>{"rhel-9-x86_64"}));
+    EXPECT_TRUE(server.arches.empty());
+
+    EXPECT_FALSE(contents[1].enabled);
+    EXPECT_EQ(contents[2].type, "file");
+}
+
+TEST_F(RedhatRepoTest, ReadEntitlementCert) {
+    const auto cert = read_entitlement_cert(test_data_dir / "entitlement-v3.pem");
+    EXPECT_EQ(cert.cert_path, test_data_dir / "entitlement-v3.pem");
+    EXPECT_EQ(cert.key_path, test_data_dir / "entitlement-v3-key.pem");
+    EXPECT_EQ(cert.contents.size(), 6);
+
+    EXPECT_THROW(read_entitlement_cert(temp_dir / "nonexistent.pem"), std::runtime_error);
+    std::ofstream(temp_dir / "broken.pem") << "-----BEGIN CERTIFICATE-----\nAAAA\n-----END CERTIFICATE-----\n";
+    EXPECT_THROW(read_entitlement_cert(temp_dir / "broken.pem"), std::runtime_error);
+}
+
+TEST_F(RedhatRepoTest, ReadEntitlementCert_DecodedOnce) {
+    // The expiry check and the content sets share the certificate decoded by the cache
+    CertCache::get().clear();
+    for (const auto *name : {"entitlement-v3.pem", "entitlement-v1.pem"}) {
+        static_cast<void>(get_cert_not_after(test_data_dir / name));
+        EXPECT_FALSE(read_entitlement_cert(test_data_dir / name).contents.empty());
+    }
+    EXPECT_EQ(CertCache::get().get_misses(), 2);
+}
+
+TEST_F(RedhatRepoTest, ReadProvidedTags) {
+    EXPECT_EQ(read_product_tags(test_data_dir / "product-479.pem"), (std::vector<std::string>{"rhel-9", "rhel-9-x86_64"}));
+    // Certificates without product tags
+    EXPECT_TRUE(read_product_tags(test_data_dir / "valid.pem").empty());
+
+    fs::copy_file(test_data_dir / "product-479.pem", temp_dir / "479.pem");
+    std::ofstream(temp_dir / "broken.pem") << "not a certificate";
+    std::vector<std::string> errors;
+    const auto tags = read_provided_tags({temp_dir, temp_dir / "nonexistent"}, errors);
+    EXPECT_EQ(tags, (std::set<std::string>{"rhel-9", "rhel-9-x86_64"}));
+    ASSERT_EQ(errors.size(), 1);
+    EXPECT_NE(errors[0].find("broken.pem"), std::string::npos);
+
+    // Errors of reading the file name the certificate
+    std::string error;
+    try {
+        static_cast<void>(read_product_tags(temp_dir / "missing.pem"));
+    } catch (const std::runtime_error &e) {
+        error = e.what();
+    }
+    EXPECT_TRUE(error.starts_with("Unable to read product certificate " + (temp_dir / "missing.pem").string()));
+}
+
+// --- redhat.repo tests ---
+
+TEST_F(RedhatRepoTest, IsArchCompatible) {
+    EXPECT_TRUE(is_arch_compatible({}, "x86_64"));
+    EXPECT_TRUE(is_arch_compatible({"x86_64"}, "x86_64"));
+    EXPECT_TRUE(is_arch_compatible({"aarch64", "x86_64"}, "x86_64"));
+    EXPECT_TRUE(is_arch_compatible({"ALL"}, "s390x"));
+    EXPECT_TRUE(is_arch_compatible({"noarch"}, "ppc64le"));
+    EXPECT_TRUE(is_arch_compatible({"i686"}, "x86_64"));
+    EXPECT_TRUE(is_arch_compatible({"x86"}, "i686"));
+    EXPECT_FALSE(is_arch_compatible({"x86_64"}, "i686"));
+    EXPECT_FALSE(is_arch_compatible({"aarch64"}, "x86_64"));
+}
+
+TEST_F(RedhatRepoTest, Render_MatchesExpected) {
+    auto options = x86_64_options();
+    options.overrides["rhel-9-for-x86_64-appstream-source-rpms"] = {{"enabled", "1"}, {"module_hotfixes", "1"}};
+    EXPECT_EQ(render_redhat_repo(installed_certs(), options), read_file(test_data_dir / "redhat.repo"));
+}
+
+TEST_F(RedhatRepoTest, Render_FiltersContent) {
+    auto options = x86_64_options();
+    EXPECT_EQ(
+        labels(render_redhat_repo(installed_certs(), options)),
+        (std::vector<std::string>{
+            "legacy-server-debug-rpms",
+            "legacy-server-rpms",
+            "rhel-9-for-x86_64-appstream-source-rpms",
+            "rhel-9-for-x86_64-baseos-rpms",
+            "test-extras-rpms"}));
+
+    options.arch = "aarch64";
+    options.provided_tags.clear();
+    EXPECT_EQ(
+        labels(render_redhat_repo(installed_certs(), options)),
+        (std::vector<std::string>{"legacy-server-debug-rpms", "rhel-9-for-aarch64-baseos-rpms", "test-extras-rpms"}));
+}
+
+TEST_F(RedhatRepoTest, Render_FirstCertificateWins) {
+    auto certs = installed_certs();
+    certs.push_back(certs[0]);
+    certs.back().cert_path = "/etc/pki/entitlement/3000.pem";
+    certs.back().contents[0].name = "Other";
+    const auto repo_file = render_redhat_repo(certs, x86_64_options());
+    EXPECT_EQ(repo_file, render_redhat_repo(installed_certs(), x86_64_options()));
+}
+
+TEST_F(RedhatRepoTest, Render_Overrides) {
+    auto options = x86_64_options();
+    options.overrides["rhel-9-for-x86_64-baseos-rpms"] = {
+        {"enabled", "0"}, {"name", "Renamed"}, {"baseurl", "https://example.com"}, {"bad name", "1"}};
+    const auto repo_file = render_redhat_repo(installed_certs(), options);
+    const auto section = repo_file.substr(repo_file.find("[rhel-9-for-x86_64-baseos-rpms]"));
+    EXPECT_NE(section.find("\nenabled = 0\n"), std::string::npos);
+    EXPECT_NE(section.find("\nname = Red Hat Enterprise Linux 9 for x86_64 - BaseOS (RPMs)\n"), std::string::npos);
+    EXPECT_NE(section.find("\nbaseurl = https://cdn.redhat.com/content/dist/rhel9/"), std::string::npos);
+    EXPECT_EQ(section.find("bad name"), std::string::npos);
+}
+
+TEST_F(RedhatRepoTest, Render_SingleLineValues) {
+    auto certs = installed_certs();
+    certs[0].contents[0].name = "Injected\n[other]\nenabled = 1";
+    const auto repo_file = render_redhat_repo(certs, x86_64_options());
+    EXPECT_NE(repo_file.find("\nname = Injected [other] enabled = 1\n"), std::string::npos);
+    EXPECT_EQ(repo_file.find("\n[other]"), std::string::npos);
+}
+
+TEST_F(RedhatRepoTest, ReadContentOverrides) {
+    EXPECT_TRUE(read_content_overrides(temp_dir / "nonexistent.json").empty());
+
+    std::ofstream(temp_dir / "overrides.json")
+        << R"([{"contentLabel": "repo-a", "name": "enabled", "value": "1", "created": "2024-01-01T00:00:00+0000"},)"
+        << R"( {"contentLabel": "repo-a", "name": "gpgcheck", "value": "0"},)"
+        << R"( {"contentLabel": "repo-b", "name": "enabled"}])";
+    EXPECT_EQ(
+        read_content_overrides(temp_dir / "overrides.json"),
+        (ContentOverrides{{"repo-a", {{"enabled", "1"}, {"gpgcheck", "0"}}}}));
+
+    std::ofstream(temp_dir / "invalid.json") << R"({"contentLabel": "repo-a"})";
+    EXPECT_THROW(read_content_overrides(temp_dir / "invalid.json"), std::runtime_error);
+}
+
+TEST_F(RedhatRepoTest, ReadRhsmConfig_Defaults) {
+    const auto config = read_rhsm_config(temp_dir / "nonexistent.conf");
+    EXPECT_TRUE(config.manage_repos);
+    EXPECT_EQ(config.baseurl, CONTENT_BASEURL);
+    EXPECT_EQ(config.repo_ca_cert, REPO_CA_CERT);
+}
+
+TEST_F(RedhatRepoTest, ReadRhsmConfig_Satellite) {
+    // As configured by the katello-ca-consumer package of a Satellite
+    std::ofstream(temp_dir / "rhsm.conf") << "[server]\n"
+                                             "hostname = satellite.example.com\n"
+                                             "baseurl = https://wrong.example.com\n"
+                                             "\n"
+                                             "[rhsm]\n"
+                                             "# Content base URL:\n"
+                                             "baseurl = https://satellite.example.com/pulp/content\n"
+                                             "ca_cert_dir = /etc/rhsm/ca/\n"
+                                             "Repo_CA_Cert = %(ca_cert_dir)skatello-server-ca.pem\n"
+                                             "manage_repos = 1\n";
+    const auto config = read_rhsm_config(temp_dir / "rhsm.conf");
+    EXPECT_TRUE(config.manage_repos);
+    EXPECT_EQ(config.baseurl, "https://satellite.example.com/pulp/content");
+    EXPECT_EQ(config.repo_ca_cert, "/etc/rhsm/ca/katello-server-ca.pem");
+}
+
+TEST_F(RedhatRepoTest, ReadRhsmConfig_ManageRepos) {
+    for (const auto *value : {"0", "no", "False"}) {
+        std::ofstream(temp_dir / "rhsm.conf") << "[rhsm]\nmanage_repos = " << value << "\nbaseurl = cdn.example.com\n";
+        const auto config = read_rhsm_config(temp_dir / "rhsm.conf");
+        EXPECT_FALSE(config.manage_repos) << value;
+        EXPECT_EQ(config.baseurl, "https://cdn.example.com");
+    }
+
+    std::ofstream(temp_dir / "rhsm.conf") << "[rhsm]\nmanage_repos = maybe\n";
+    EXPECT_THROW(read_rhsm_config(temp_dir / "rhsm.conf"), std::runtime_error);
+
+    std::ofstream(temp_dir / "rhsm.conf") << "[rhsm]\nrepo_ca_cert = %(unknown)s/ca.pem\n";
+    EXPECT_THROW(read_rhsm_config(temp_dir / "rhsm.conf"), std::runtime_error);
+}
+
+TEST_F(RedhatRepoTest, WriteFileIfChanged) {
+    const auto path = temp_dir / "redhat.repo";
+    EXPECT_TRUE(write_file_if_changed(path, "first\n"));
+    struct stat before{};
+    ASSERT_EQ(stat(path.c_str(), &before), 0);
+
+    EXPECT_FALSE(write_file_if_changed(path, "first\n"));
+    struct stat after{};
+    ASSERT_EQ(stat(path.c_str(), &after), 0);
+    EXPECT_EQ(before.st_ino, after.st_ino);
+
+    EXPECT_TRUE(write_file_if_changed(path, "second\n"));
+    EXPECT_EQ(read_file(path), "second\n");
+}
+
+TEST_F(RedhatRepoTest, UpdateRedhatRepo) {
+    const auto paths = RhsmPaths().with_installroot(temp_dir);
+    fs::create_directories(paths.entitlement_cert_dir);
+    fs::create_directories(paths.product_cert_dir);
+    fs::create_directories(paths.redhat_repo_file.parent_path());
+    fs::copy_file(test_data_dir / "entitlement-v3.pem", paths.entitlement_cert_dir / "1000.pem");
+    fs::copy_file(test_data_dir / "entitlement-v1.pem", paths.entitlement_cert_dir / "2000.pem");
+    std::ofstream(paths.entitlement_cert_dir / "3000.pem") << "not a certificate";
+    fs::copy_file(test_data_dir / "product-479.pem", paths.product_cert_dir / "479.pem");
+
+    std::vector<std::string> errors;
+    const auto certs = read_entitlement_certs(paths.entitlement_cert_dir, {"2000"}, errors);
+    ASSERT_EQ(certs.size(), 1);
+    ASSERT_EQ(errors.size(), 1);
+    EXPECT_NE(errors[0].find("3000.pem"), std::string::npos);
+
+    RedhatRepoOptions options;
+    options.arch = "x86_64";
+    const auto first = update_redhat_repo(paths, certs, options);
+    EXPECT_TRUE(first.written);
+    EXPECT_EQ(first.repos, 3);
+    EXPECT_TRUE(first.errors.empty());
+    const auto repo_file = read_file(paths.redhat_repo_file);
+    EXPECT_NE(repo_file.find("sslclientcert = " + (paths.entitlement_cert_dir / "1000.pem").string() + "\n"), std::string::npos);
+    EXPECT_NE(repo_file.find("sslclientkey = " + (paths.entitlement_cert_dir / "1000-key.pem").string() + "\n"), std::string::npos);
+
+    const auto second = update_redhat_repo(paths, certs, options);
+    EXPECT_FALSE(second.written);
+    EXPECT_EQ(read_file(paths.redhat_repo_file), repo_file);
+
+    const auto renewed = update_redhat_repo(paths, read_entitlement_certs(paths.entitlement_cert_dir, {}, errors), options);
+    EXPECT_TRUE(renewed.written);
+    EXPECT_EQ(renewed.repos, 5);
+}
+
+
+// --- Content path index tests ---
+
+TEST_F(RedhatRepoTest, ContentPathOfUrl) {
+    const std::string baseurl = "https://cdn.redhat.com/";
+    EXPECT_EQ(content_path_of_url("https://cdn.redhat.com/content/dist/rhel9/9/x86_64/baseos/os/", baseurl),
+              "/content/dist/rhel9/9/x86_64/baseos/os/");
+    EXPECT_EQ(content_path_of_url("https://cdn.redhat.com/content/extras?arch=x86_64#top", "https://cdn.redhat.com"),
+              "/content/extras");
+    EXPECT_EQ(content_path_of_url("https://cdn.redhat.com", baseurl), "");
+    EXPECT_FALSE(content_path_of_url("https://cdn.redhat.com.example.com/content/dist", baseurl).has_value());
+    EXPECT_FALSE(content_path_of_url("https://mirror.example.com/content/dist", baseurl).has_value());
+    EXPECT_FALSE(content_path_of_url("https://cdn.redhat.com/content", "").has_value());
+}
+
+TEST_F(RedhatRepoTest, ContentPathOfUrl_Satellite) {
+    // The content of a Satellite is published under a path with the organization and the lifecycle environment
+    const std::string baseurl = "https://satellite.example.com/pulp/content";
+    EXPECT_EQ(
+        content_path_of_url(
+            "https://satellite.example.com/pulp/content/ACME/Library/content/dist/rhel9/9/x86_64/baseos/os", baseurl),
+        "/ACME/Library/content/dist/rhel9/9/x86_64/baseos/os");
+    EXPECT_FALSE(content_path_of_url("https://satellite.example.com/pulp/contents/ACME", baseurl).has_value());
+    EXPECT_FALSE(content_path_of_url("https://cdn.redhat.com/content/dist/rhel9", baseurl).has_value());
+
+    ContentPathIndex index;
+    index.add("/ACME/Library/content/dist/rhel9/$releasever/x86_64/baseos/os");
+    EXPECT_TRUE(index.is_entitled(*content_path_of_url(
+        "https://satellite.example.com/pulp/content/ACME/Library/content/dist/rhel9/9/x86_64/baseos/os/", baseurl)));
+}
+
+TEST_F(RedhatRepoTest, ContentPathIndex_Certificates) {
+    const auto certs = installed_certs();
+    const ContentPathIndex index(certs, CONTENT_BASEURL);
+    // 6 content sets in the v3 certificate and 3 in the v1 certificate
+    EXPECT_EQ(index.size(), 9);
+
+    // Variables match the substituted values and the variables themselves
+    EXPECT_TRUE(index.is_entitled("/content/dist/rhel9/9.4/x86_64/baseos/os"));
+    EXPECT_TRUE(index.is_entitled("/content/dist/rhel9/$releasever/x86_64/baseos/os/"));
+    EXPECT_TRUE(index.is_entitled("//content/dist/rhel9/9/x86_64/baseos/os/repodata/repomd.xml"));
+    EXPECT_TRUE(index.is_entitled("/content/dist/legacy/7Server/x86_64/debug"));
+    EXPECT_TRUE(index.is_entitled("/content/extras/aarch64/os"));
+
+    EXPECT_FALSE(index.is_entitled("/content/dist/rhel9/9/x86_64/baseos"));
+    EXPECT_FALSE(index.is_entitled("/content/dist/rhel9/9/x86_64/appstream/os"));
+    EXPECT_FALSE(index.is_entitled("/content/dist/rhel10/10/x86_64/baseos/os"));
+    EXPECT_FALSE(index.is_entitled("/content/extras/x86_64"));
+    EXPECT_FALSE(index.is_entitled(""));
+}
+
+TEST_F(RedhatRepoTest, ContentPathIndex_LiteralAndVariableSegments) {
+    ContentPathIndex index;
+    index.add("/content/dist/rhel9/9/x86_64/baseos/os");
+    index.add("/content/dist/rhel9/$releasever/$basearch/appstream/os");
+    index.add("content/dist/rhel9/$releasever/$basearch/appstream/os/");
+    index.add("/");
+    EXPECT_EQ(index.size(), 2);
+
+    // The literal segment "9" does not hide the variable one
+    EXPECT_TRUE(index.is_entitled("/content/dist/rhel9/9/x86_64/appstream/os"));
+    EXPECT_TRUE(index.is_entitled("/content/dist/rhel9/9/x86_64/baseos/os"));
+    EXPECT_FALSE(index.is_entitled("/content/dist/rhel9/9.4/x86_64/baseos/os"));
+    EXPECT_FALSE(index.is_entitled("/content/dist/rhel9/9/x86_64/appstream"));
+    EXPECT_FALSE(ContentPathIndex().is_entitled("/content/dist/rhel9/9/x86_64/baseos/os"));
+}
+
+TEST_F(RedhatRepoTest, ContentPathIndex_ContentPaths) {
+    const auto record = make_entitlement_content_record({}, {}, installed_certs(), {});
+    const ContentPathIndex index(record.content_paths, CONTENT_BASEURL);
+    EXPECT_EQ(index.size(), ContentPathIndex(installed_certs(), CONTENT_BASEURL).size());
+    EXPECT_TRUE(index.is_entitled("/content/dist/rhel9/9.4/x86_64/baseos/os"));
+    EXPECT_FALSE(index.is_entitled("/content/dist/rhel9/9/x86_64/appstream/os"));
+}
+
+TEST_F(RedhatRepoTest, EntitlementContentCache_UnchangedDirectoryNotDecoded) {
+    const auto cert_dir = temp_dir / "entitlement";
+    const auto cache_file = temp_dir / "cache" / "entitlement-content.json";
+    fs::create_directories(cert_dir);
+    fs::create_directories(cache_file.parent_path());
+    fs::copy_file(test_data_dir / "entitlement-v3.pem", cert_dir / "1000.pem");
+    fs::copy_file(test_data_dir / "entitlement-v1.pem", cert_dir / "2000.pem");
+    fs::copy_file(test_data_dir / "valid.pem", cert_dir / "3000.pem");
+
+    // The first command reads the certificates; the expired one is skipped
+    const std::vector<std::string> expired{"3000"};
+    const auto key = get_path_key(cert_dir);
+    std::vector<std::string> errors;
+    const auto certs = read_entitlement_certs(cert_dir, expired, errors);
+    ASSERT_EQ(certs.size(), 2);
+    const auto record = make_entitlement_content_record(key, expired, certs, errors);
+    EXPECT_EQ(record.certificates, 2);
+    EXPECT_TRUE(std::is_sorted(record.content_paths.begin(), record.content_paths.end()));
+    write_entitlement_content_cache(cache_file, record);
+
+    // The following commands take the content paths from the cache without decoding any certificate
+    CertCache::get().clear();
+    const auto cached = read_entitlement_content_cache(cache_file, get_path_key(cert_dir), expired);
+    ASSERT_TRUE(cached.has_value());
+    EXPECT_EQ(*cached, record);
+    EXPECT_EQ(CertCache::get().get_misses(), 0);
+    EXPECT_EQ(ContentPathIndex(cached->content_paths, CONTENT_BASEURL).size(), ContentPathIndex(certs, CONTENT_BASEURL).size());
+
+    // Another expired certificate, or a certificate added to the directory, invalidates the record
+    EXPECT_FALSE(read_entitlement_content_cache(cache_file, get_path_key(cert_dir), {"1000", "3000"}).has_value());
+    fs::copy_file(test_data_dir / "valid.pem", cert_dir / "4000.pem");
+    EXPECT_FALSE(read_entitlement_content_cache(cache_file, get_path_key(cert_dir), expired).has_value());
+}
+
+TEST_F(RedhatRepoTest, EntitlementContentCache_RedhatRepoKey) {
+    const auto paths = RhsmPaths().with_installroot(temp_dir);
+    const auto cache_file = temp_dir / "entitlement-content.json";
+    fs::create_directories(paths.entitlement_cert_dir);
+    fs::create_directories(paths.product_cert_dir);
+    fs::create_directories(paths.redhat_repo_file.parent_path());
+    fs::copy_file(test_data_dir / "entitlement-v3.pem", paths.entitlement_cert_dir / "1000.pem");
+    fs::copy_file(test_data_dir / "product-479.pem", paths.product_cert_dir / "479.pem");
+    RedhatRepoOptions options;
+    options.arch = "x86_64";
+
+    // The certificates listed by the status check are read without listing the directory again
+    std::vector<std::string> errors;
+    const auto certs = read_entitlement_certs(get_entitlement_cert_paths(paths.entitlement_cert_dir), {}, errors);
+    ASSERT_EQ(certs.size(), 1);
+    EXPECT_TRUE(errors.empty());
+
+    auto repo_key = get_redhat_repo_key(paths, options);
+    const auto update = update_redhat_repo(paths, certs, options);
+    repo_key.redhat_repo_file = get_path_key(paths.redhat_repo_file);
+    auto record = make_entitlement_content_record(get_path_key(paths.entitlement_cert_dir), {}, certs, errors);
+    record.redhat_repo = repo_key;
+    record.redhat_repos = update.repos;
+    write_entitlement_content_cache(cache_file, record);
+
+    // Nothing changed, redhat.repo is not generated again
+    const auto cached = read_entitlement_content_cache(cache_file, get_path_key(paths.entitlement_cert_dir), {});
+    ASSERT_TRUE(cached.has_value());
+    EXPECT_EQ(*cached, record);
+    EXPECT_EQ(cached->redhat_repo, get_redhat_repo_key(paths, options));
+
+    // Overrides, other options or a removed redhat.repo change the key
+    options.baseurl = "https://satellite.example.com/pulp/content";
+    EXPECT_NE(cached->redhat_repo, get_redhat_repo_key(paths, options));
+    options.baseurl = CONTENT_BASEURL;
+    fs::create_directories(paths.content_overrides_file.parent_path());
+    std::ofstream(paths.content_overrides_file) << "[]";
+    EXPECT_NE(cached->redhat_repo, get_redhat_repo_key(paths, options));
+    fs::remove(paths.content_overrides_file);
+    EXPECT_EQ(cached->redhat_repo, get_redhat_repo_key(paths, options));
+    fs::remove(paths.redhat_repo_file);
+    EXPECT_NE(cached->redhat_repo, get_redhat_repo_key(paths, options));
+}
+
+TEST_F(RedhatRepoTest, EntitlementContentCache_Invalid) {
+    const auto cache_file = temp_dir / "entitlement-content.json";
+    const auto key = get_path_key(temp_dir);
+    EXPECT_FALSE(read_entitlement_content_cache(cache_file, key, {}).has_value());
+    std::ofstream(cache_file) << "{\"version\": 1, \"content_paths\": \"broken\"}";
+    EXPECT_FALSE(read_entitlement_content_cache(cache_file, key, {}).has_value());
+    EXPECT_EQ(get_path_key(temp_dir / "nonexistent"), PathKey{});
+}
+
+
+int main(int argc, char ** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,314 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+
+#include "rhsm_status.hpp"
+#include "syscall_counter.hpp"
+
+namespace fs = std::filesystem;
+
+
+class RhsmStatusTest : public ::testing::Test {
+protected:
+    fs::path temp_dir;
+    static fs::path test_data_dir;
+    RhsmPaths paths;
+    CertExpiryCache expiry_cache{""};
+
+    void SetUp() override {
+        temp_dir = fs::temp_directory_path() / "rhsm_status_test";
+        fs::remove_all(temp_dir);
+        fs::create_directories(temp_dir);
+        paths = RhsmPaths().with_installroot(temp_dir);
+    }
+
+    void TearDown() override {
+        fs::remove_all(temp_dir);
+    }
+
+    static void SetUpTestSuite() {
+        test_data_dir = fs::path("test_data");
+        if (!fs::exists(test_data_dir)) {
+            test_data_dir = fs::path(TEST_DATA_DIR);
+        }
+    }
+
+    void register_system() const {
+        fs::create_directories(paths.consumer_cert_dir);
+        fs::copy_file(test_data_dir / "valid.pem", paths.consumer_cert_dir / "cert.pem");
+        fs::create_directories(paths.entitlement_cert_dir);
+    }
+
+    void add_entitlement(const std::string &name, const std::string &test_cert) const {
+        fs::copy_file(test_data_dir / test_cert, paths.entitlement_cert_dir / (name + ".pem"));
+    }
+
+    [[nodiscard]] std::int64_t now() const {
+        return static_cast<std::int64_t>(std::time(nullptr));
+    }
+};
+
+fs::path RhsmStatusTest::test_data_dir;
+
+
+TEST_F(RhsmStatusTest, UnregisteredSystem) {
+    const auto status = check_rhsm_status(paths, expiry_cache, now());
+    EXPECT_FALSE(status.in_container);
+    EXPECT_FALSE(status.registered);
+    EXPECT_FALSE(status.has_entitlements);
+    EXPECT_TRUE(status.expired_entitlements.empty());
+    EXPECT_FALSE(status.releasever_error.empty());
+    EXPECT_FALSE(status.expiry_cache_error.empty());
+}
+
+TEST_F(RhsmStatusTest, RegisteredWithoutEntitlements) {
+    register_system();
+    const auto status = check_rhsm_status(paths, expiry_cache, now());
+    EXPECT_TRUE(status.registered);
+    EXPECT_FALSE(status.has_entitlements);
+}
+
+TEST_F(RhsmStatusTest, ExpiredAndBrokenEntitlements) {
+    register_system();
+    add_entitlement("3", "expired.pem");
+    add_entitlement("1", "expired.pem");
+    add_entitlement("2", "valid.pem");
+    std::ofstream(paths.entitlement_cert_dir / "4.pem") << "broken";
+    const auto status = check_rhsm_status(paths, expiry_cache, now());
+    EXPECT_TRUE(status.has_entitlements);
+    EXPECT_EQ(status.entitlement_certs, (std::vector<std::string>{"1.pem", "2.pem", "3.pem", "4.pem"}));
+    EXPECT_EQ(status.expired_entitlements, (std::vector<std::string>{"1", "3"}));
+    EXPECT_EQ(status.cert_errors.size(), 1);
+    ASSERT_EQ(status.entitlement_expiry.size(), 3);
+    EXPECT_EQ(status.entitlement_expiry[0].name, "1");
+    EXPECT_EQ(status.entitlement_expiry[1].name, "2");
+    EXPECT_EQ(status.entitlement_expiry[2].name, "3");
+    EXPECT_LT(status.entitlement_expiry[0].not_after, now());
+    EXPECT_EQ(status.entitlement_expiry[1].not_after, status.next_expiry);
+    // Parsed certificates are stored in the cache for the plugin to write it
+    EXPECT_TRUE(expiry_cache.dirty);
+    EXPECT_EQ(expiry_cache.records.size(), 3);
+}
+
+TEST_F(RhsmStatusTest, Releasever) {
+    fs::create_directories(paths.releasever_file.parent_path());
+    std::ofstream(paths.releasever_file) << "9.4\n";
+    const auto status = check_rhsm_status(paths, expiry_cache, now());
+    EXPECT_EQ(status.releasever, "9.4");
+    EXPECT_TRUE(status.releasever_error.empty());
+}
+
+TEST_F(RhsmStatusTest, Container) {
+    fs::create_directories(paths.rhsm_host_config_dir);
+    fs::create_directories(paths.entitlement_host_cert_dir);
+    EXPECT_TRUE(check_rhsm_status(paths, expiry_cache, now()).in_container);
+}
+
+TEST_F(RhsmStatusTest, Background_SameAsSynchronous) {
+    register_system();
+    add_entitlement("1", "expired.pem");
+    add_entitlement("2", "valid.pem");
+    const auto expected = check_rhsm_status(paths, expiry_cache, now());
+
+    CertExpiryCache background_cache{""};
+    auto pending = start_rhsm_status_check(paths, background_cache, 0);
+    EXPECT_EQ(pending.get(), expected);
+    EXPECT_EQ(background_cache.records.size(), 2);
+}
+
+TEST_F(RhsmStatusTest, Background_NotRetrieved) {
+    // The future waits for the thread, which still uses the cache, when it is destroyed
+    register_system();
+    for (int i = 0; i < 100; ++i) {
+        add_entitlement(std::to_string(i), i % 2 == 0 ? "expired.pem" : "valid.pem");
+    }
+    {
+        auto pending = start_rhsm_status_check(paths, expiry_cache, 0);
+    }
+    EXPECT_EQ(expiry_cache.records.size(), 100);
+}
+
+// --- memoization tests ---
+
+TEST_F(RhsmStatusTest, Memoized_ReusedWhenUnchanged) {
+    register_system();
+    add_entitlement("1", "expired.pem");
+    add_entitlement("2", "valid.pem");
+    fs::create_directories(paths.status_cache_file.parent_path());
+    const auto status = get_rhsm_status(paths, expiry_cache, now(), DEFAULT_STATUS_CACHE_TTL);
+    EXPECT_FALSE(status.memoized);
+    write_memoized_rhsm_status(paths.status_cache_file, status);
+
+    CertExpiryCache unused_cache{""};
+    auto memoized = get_rhsm_status(paths, unused_cache, now(), DEFAULT_STATUS_CACHE_TTL);
+    EXPECT_TRUE(memoized.memoized);
+    EXPECT_TRUE(unused_cache.records.empty());
+    memoized.memoized = false;
+    memoized.expiry_cache_error = status.expiry_cache_error;
+    EXPECT_EQ(memoized, status);
+}
+
+TEST_F(RhsmStatusTest, Memoized_InvalidatedByNewCertificate) {
+    register_system();
+    fs::create_directories(paths.status_cache_file.parent_path());
+    write_memoized_rhsm_status(paths.status_cache_file, get_rhsm_status(paths, expiry_cache, now(), 60));
+    add_entitlement("1", "valid.pem");
+    const auto status = get_rhsm_status(paths, expiry_cache, now(), 60);
+    EXPECT_FALSE(status.memoized);
+    EXPECT_TRUE(status.has_entitlements);
+}
+
+TEST_F(RhsmStatusTest, Memoized_InvalidatedByReleasever) {
+    fs::create_directories(paths.status_cache_file.parent_path());
+    write_memoized_rhsm_status(paths.status_cache_file, get_rhsm_status(paths, expiry_cache, now(), 60));
+    fs::create_directories(paths.releasever_file.parent_path());
+    std::ofstream(paths.releasever_file) << "9.4\n";
+    EXPECT_EQ(get_rhsm_status(paths, expiry_cache, now(), 60).releasever, "9.4");
+}
+
+TEST_F(RhsmStatusTest, Memoized_ExpiresAfterTtl) {
+    fs::create_directories(paths.status_cache_file.parent_path());
+    const auto status = get_rhsm_status(paths, expiry_cache, now(), 60);
+    write_memoized_rhsm_status(paths.status_cache_file, status);
+    const auto key = get_rhsm_status_key(paths);
+    EXPECT_TRUE(read_memoized_rhsm_status(paths.status_cache_file, key, status.checked_at + 59, 60).has_value());
+    EXPECT_FALSE(read_memoized_rhsm_status(paths.status_cache_file, key, status.checked_at + 60, 60).has_value());
+    // A clock moved backwards
+    EXPECT_FALSE(read_memoized_rhsm_status(paths.status_cache_file, key, status.checked_at - 1, 60).has_value());
+}
+
+TEST_F(RhsmStatusTest, Memoized_InvalidatedWhenCertificateExpires) {
+    register_system();
+    add_entitlement("1", "valid.pem");
+    fs::create_directories(paths.status_cache_file.parent_path());
+    const auto status = get_rhsm_status(paths, expiry_cache, now(), 60);
+    ASSERT_TRUE(status.next_expiry.has_value());
+    write_memoized_rhsm_status(paths.status_cache_file, status);
+    const auto key = get_rhsm_status_key(paths);
+    constexpr std::int64_t long_ttl = 100LL * 365 * 24 * 3600;
+    EXPECT_TRUE(read_memoized_rhsm_status(paths.status_cache_file, key, *status.next_expiry, long_ttl).has_value());
+    EXPECT_FALSE(read_memoized_rhsm_status(paths.status_cache_file, key, *status.next_expiry + 1, long_ttl).has_value());
+}
+
+TEST_F(RhsmStatusTest, Memoized_DisabledByZeroTtl) {
+    fs::create_directories(paths.status_cache_file.parent_path());
+    write_memoized_rhsm_status(paths.status_cache_file, get_rhsm_status(paths, expiry_cache, now(), 60));
+    EXPECT_FALSE(get_rhsm_status(paths, expiry_cache, now(), 0).memoized);
+}
+
+TEST_F(RhsmStatusTest, Memoized_CorruptFileIgnored) {
+    fs::create_directories(paths.status_cache_file.parent_path());
+    std::ofstream(paths.status_cache_file) << "{\"version\": 1, \"checked_at\": \"yesterday\"}";
+    EXPECT_FALSE(get_rhsm_status(paths, expiry_cache, now(), 60).memoized);
+    std::ofstream(paths.status_cache_file) << "not json";
+    EXPECT_FALSE(get_rhsm_status(paths, expiry_cache, now(), 60).memoized);
+}
+
+TEST_F(RhsmStatusTest, Memoized_SyscallCount) {
+    register_system();
+    for (int i = 0; i < 50; ++i) {
+        add_entitlement(std::to_string(i), "valid.pem");
+    }
+    fs::create_directories(paths.status_cache_file.parent_path());
+    write_memoized_rhsm_status(paths.status_cache_file, get_rhsm_status(paths, expiry_cache, now(), 60));
+
+    const auto counts = syscall_counter::count_syscalls([this]() {
+        if (!get_rhsm_status(paths, expiry_cache, now(), 60).memoized) {
+            throw std::runtime_error("status not memoized");
+        }
+    });
+    if (!counts) {
+        GTEST_SKIP() << "ptrace is not available";
+    }
+    // Five stat() calls for the key, and opening, reading (twice) and closing the memoized status
+    EXPECT_LE(syscall_counter::total(*counts), 10);
+}
+
+
+// --- status snapshot tests ---
+
+TEST_F(RhsmStatusTest, Snapshot_Content) {
+    register_system();
+    add_entitlement("1", "expired.pem");
+    add_entitlement("2", "valid.pem");
+    std::ofstream(paths.entitlement_cert_dir / "3.pem") << "broken";
+    fs::create_directories(paths.releasever_file.parent_path());
+    std::ofstream(paths.releasever_file) << "9.4\n";
+    const auto status = check_rhsm_status(paths, expiry_cache, now());
+
+    const auto snapshot = rhsm_status_snapshot_to_json(status, status.checked_at + 1);
+    EXPECT_EQ(snapshot["version"], 1);
+    EXPECT_EQ(snapshot["written_at"].asInt64(), status.checked_at + 1);
+    EXPECT_EQ(snapshot["checked_at"].asInt64(), status.checked_at);
+    EXPECT_EQ(snapshot["source"], "checked");
+    EXPECT_FALSE(snapshot["in_container"].asBool());
+    EXPECT_TRUE(snapshot["registered"].asBool());
+    EXPECT_TRUE(snapshot["has_sca_entitlements"].asBool());
+    ASSERT_EQ(snapshot["entitlements"].size(), 2);
+    EXPECT_EQ(snapshot["entitlements"][0]["name"], "1");
+    EXPECT_TRUE(snapshot["entitlements"][0]["expired"].asBool());
+    EXPECT_EQ(snapshot["entitlements"][1]["name"], "2");
+    EXPECT_FALSE(snapshot["entitlements"][1]["expired"].asBool());
+    EXPECT_EQ(snapshot["entitlements"][1]["not_after"].asInt64(), *status.next_expiry);
+    EXPECT_EQ(snapshot["next_expiry"].asInt64(), *status.next_expiry);
+    EXPECT_EQ(snapshot["cert_errors"].size(), 1);
+    EXPECT_EQ(snapshot["releasever"], "9.4");
+    EXPECT_EQ(snapshot["releasever_error"], "");
+}
+
+TEST_F(RhsmStatusTest, Snapshot_ExpiredRelativeToWrite) {
+    // A memoized status is published again by the following commands
+    register_system();
+    add_entitlement("1", "valid.pem");
+    auto status = check_rhsm_status(paths, expiry_cache, now());
+    status.memoized = true;
+    const auto snapshot = rhsm_status_snapshot_to_json(status, *status.next_expiry + 1);
+    EXPECT_EQ(snapshot["source"], "memoized");
+    EXPECT_TRUE(snapshot["entitlements"][0]["expired"].asBool());
+    status.memoized = false;
+    status.from_service = true;
+    EXPECT_EQ(rhsm_status_snapshot_to_json(status, now())["source"], "service");
+}
+
+TEST_F(RhsmStatusTest, Snapshot_Unregistered) {
+    const auto snapshot = rhsm_status_snapshot_to_json(check_rhsm_status(paths, expiry_cache, now()), now());
+    EXPECT_FALSE(snapshot["registered"].asBool());
+    EXPECT_FALSE(snapshot["has_sca_entitlements"].asBool());
+    EXPECT_TRUE(snapshot["entitlements"].isArray());
+    EXPECT_EQ(snapshot["entitlements"].size(), 0);
+    EXPECT_TRUE(snapshot["next_expiry"].isNull());
+    EXPECT_NE(snapshot["releasever_error"], "");
+}
+
+TEST_F(RhsmStatusTest, Snapshot_WrittenWorldReadable) {
+    register_system();
+    add_entitlement("1", "valid.pem");
+    const auto status = check_rhsm_status(paths, expiry_cache, now());
+    const auto snapshot_dir = temp_dir / "run";
+    fs::create_directories(snapshot_dir);
+    const auto snapshot_file = snapshot_dir / "dnf5-status.json";
+    write_rhsm_status_snapshot(snapshot_file, status, now());
+    write_rhsm_status_snapshot(snapshot_file, status, now());
+
+    std::ifstream file(snapshot_file);
+    Json::Value root;
+    Json::CharReaderBuilder reader_builder;
+    Json::String errors;
+    ASSERT_TRUE(Json::parseFromStream(reader_builder, file, &root, &errors)) << errors;
+    EXPECT_EQ(root["entitlements"][0]["name"], "1");
+    EXPECT_EQ(fs::status(snapshot_file).permissions() & fs::perms::others_read, fs::perms::others_read);
+    // No temporary files are left behind
+    EXPECT_EQ(std::distance(fs::directory_iterator(snapshot_dir), fs::directory_iterator()), 1);
+}
+
+TEST_F(RhsmStatusTest, Snapshot_WriteFailure) {
+    const auto status = check_rhsm_status(paths, expiry_cache, now());
+    EXPECT_THROW(write_rhsm_status_snapshot(temp_dir / "nonexistent" / "status.json", status, now()), std::runtime_error);
+}
+
+
+int main(int argc, char ** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
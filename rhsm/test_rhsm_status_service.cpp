@@ -0,0 +1,293 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <thread>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "rhsm_status_client.hpp"
+#include "rhsm_status_service.hpp"
+#include "varlink.hpp"
+
+namespace fs = std::filesystem;
+using namespace std::chrono_literals;
+
+
+/// Stand-in for the status service: accepts one connection, reads one call and lets the handler
+/// answer it, e.g. with an error or not at all
+class StandInService {
+public:
+    StandInService(const fs::path &socket_path, std::function<void(VarlinkConnection &, const Json::Value &)> handler)
+        : listen_fd(varlink_listen(socket_path)), thread([this, handler = std::move(handler)]() {
+              pollfd poll_fd{.fd = listen_fd, .events = POLLIN, .revents = 0};
+              if (poll(&poll_fd, 1, 5000) <= 0) {
+                  return;
+              }
+              VarlinkConnection connection(accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC));
+              const auto deadline = VarlinkConnection::Clock::now() + 5s;
+              try {
+                  if (const auto call = connection.receive(deadline)) {
+                      handler(connection, *call);
+                      // Keep the connection open until the client closes it
+                      connection.receive(deadline);
+                  }
+              } catch (const std::exception &) {
+              }
+          }) {}
+
+    ~StandInService() {
+        thread.join();
+        close(listen_fd);
+    }
+
+private:
+    int listen_fd;
+    std::thread thread;
+};
+
+
+class RhsmStatusServiceTest : public ::testing::Test {
+protected:
+    fs::path temp_dir;
+    fs::path socket_path;
+    static fs::path test_data_dir;
+    RhsmPaths paths;
+    CertExpiryCache expiry_cache{""};
+
+    void SetUp() override {
+        temp_dir = fs::temp_directory_path() / "rhsm_status_service_test";
+        fs::remove_all(temp_dir);
+        fs::create_directories(temp_dir);
+        socket_path = temp_dir / "status.varlink";
+        paths = RhsmPaths().with_installroot(temp_dir);
+    }
+
+    void TearDown() override {
+        fs::remove_all(temp_dir);
+    }
+
+    static void SetUpTestSuite() {
+        test_data_dir = fs::path("test_data");
+        if (!fs::exists(test_data_dir)) {
+            test_data_dir = fs::path(TEST_DATA_DIR);
+        }
+    }
+
+    void register_system() const {
+        fs::create_directories(paths.consumer_cert_dir);
+        fs::copy_file(test_data_dir / "valid.pem", paths.consumer_cert_dir / "cert.pem");
+        fs::create_directories(paths.entitlement_cert_dir);
+    }
+
+    void add_entitlement(const std::string &name, const std::string &test_cert) const {
+        fs::copy_file(test_data_dir / test_cert, paths.entitlement_cert_dir / (name + ".pem"));
+    }
+
+    [[nodiscard]] std::int64_t now() const {
+        return static_cast<std::int64_t>(std::time(nullptr));
+    }
+
+    /// The status returned by the service, when it is checked by the client itself
+    [[nodiscard]] RhsmStatus expected_status(const RhsmStatus &service_status) {
+        auto status = check_rhsm_status_with_cache(paths, expiry_cache, service_status.checked_at);
+        status.from_service = true;
+        return status;
+    }
+};
+
+fs::path RhsmStatusServiceTest::test_data_dir;
+
+
+/// Runs the service on a background thread for the duration of a test
+class RunningService {
+public:
+    RunningService(const RhsmPaths &paths, const fs::path &socket_path)
+        : service(paths, socket_path), thread([this]() { service.run(); }) {}
+
+    ~RunningService() {
+        service.stop();
+        thread.join();
+    }
+
+private:
+    RhsmStatusService service;
+    std::thread thread;
+};
+
+
+// --- Status service tests ---
+
+TEST_F(RhsmStatusServiceTest, Query_ReturnsStatus) {
+    register_system();
+    add_entitlement("1", "expired.pem");
+    add_entitlement("2", "valid.pem");
+    const RunningService service(paths, socket_path);
+
+    const auto status = query_rhsm_status_service(socket_path, paths);
+    ASSERT_TRUE(status.has_value());
+    EXPECT_TRUE(status->from_service);
+    EXPECT_TRUE(status->registered);
+    EXPECT_EQ(status->expired_entitlements, (std::vector<std::string>{"1"}));
+    EXPECT_EQ(*status, expected_status(*status));
+}
+
+TEST_F(RhsmStatusServiceTest, Query_NoticesChanges) {
+    const RunningService service(paths, socket_path);
+    const auto unregistered = query_rhsm_status_service(socket_path, paths);
+    ASSERT_TRUE(unregistered.has_value());
+    EXPECT_FALSE(unregistered->registered);
+
+    // The certificate directories did not exist when the service started
+    register_system();
+    add_entitlement("1", "expired.pem");
+    fs::create_directories(paths.releasever_file.parent_path());
+    std::ofstream(paths.releasever_file) << "9.4\n";
+    const auto registered = query_rhsm_status_service(socket_path, paths);
+    ASSERT_TRUE(registered.has_value());
+    EXPECT_TRUE(registered->registered);
+    EXPECT_EQ(registered->expired_entitlements, (std::vector<std::string>{"1"}));
+    EXPECT_EQ(registered->releasever, "9.4");
+
+    fs::remove(paths.entitlement_cert_dir / "1.pem");
+    const auto removed = query_rhsm_status_service(socket_path, paths);
+    ASSERT_TRUE(removed.has_value());
+    EXPECT_FALSE(removed->has_entitlements);
+    EXPECT_TRUE(removed->expired_entitlements.empty());
+}
+
+TEST_F(RhsmStatusServiceTest, GetStatus_CheckedOnlyAfterChange) {
+    register_system();
+    add_entitlement("1", "valid.pem");
+    RhsmStatusService service(paths, socket_path);
+    Json::Value call(Json::objectValue);
+    call["method"] = STATUS_SERVICE_GET_STATUS;
+
+    const auto first = service.handle_call(call);
+    const auto second = service.handle_call(call);
+    EXPECT_EQ(service.get_check_count(), 1);
+    EXPECT_EQ(first, second);
+
+    add_entitlement("2", "expired.pem");
+    const auto changed = service.handle_call(call);
+    EXPECT_EQ(service.get_check_count(), 2);
+    EXPECT_EQ(changed["parameters"]["status"]["expired_entitlements"][0], "2");
+}
+
+TEST_F(RhsmStatusServiceTest, GetStatus_CheckedAgainWhenCertificateExpires) {
+    register_system();
+    add_entitlement("1", "valid.pem");
+    RhsmStatusService service(paths, socket_path);
+    const auto status = service.get_status(now());
+    ASSERT_TRUE(status.next_expiry.has_value());
+    EXPECT_TRUE(status.expired_entitlements.empty());
+
+    const auto expired = service.get_status(*status.next_expiry + 1);
+    EXPECT_EQ(service.get_check_count(), 2);
+    EXPECT_EQ(expired.expired_entitlements, (std::vector<std::string>{"1"}));
+}
+
+TEST_F(RhsmStatusServiceTest, HandleCall_UnknownMethod) {
+    RhsmStatusService service(paths, socket_path);
+    Json::Value call(Json::objectValue);
+    call["method"] = "com.redhat.rhsm.Status.Unknown";
+    const auto reply = service.handle_call(call);
+    EXPECT_EQ(reply["error"], VARLINK_ERROR_METHOD_NOT_FOUND);
+    EXPECT_EQ(reply["parameters"]["method"], "com.redhat.rhsm.Status.Unknown");
+    EXPECT_EQ(service.get_check_count(), 0);
+}
+
+TEST_F(RhsmStatusServiceTest, HandleCall_GetInfo) {
+    RhsmStatusService service(paths, socket_path);
+    Json::Value call(Json::objectValue);
+    call["method"] = "org.varlink.service.GetInfo";
+    const auto reply = service.handle_call(call);
+    EXPECT_EQ(reply["parameters"]["interfaces"][1], STATUS_SERVICE_INTERFACE);
+
+    call["method"] = "org.varlink.service.GetInterfaceDescription";
+    call["parameters"]["interface"] = STATUS_SERVICE_INTERFACE;
+    const auto description = service.handle_call(call)["parameters"]["description"].asString();
+    EXPECT_NE(description.find("method GetStatus() -> (status: Status, paths: Paths)"), std::string::npos);
+}
+
+// --- Client tests ---
+
+TEST_F(RhsmStatusServiceTest, Query_NoSocket) {
+    EXPECT_FALSE(query_rhsm_status_service(socket_path, paths).has_value());
+}
+
+TEST_F(RhsmStatusServiceTest, Query_StaleSocket) {
+    close(varlink_listen(socket_path));
+    ASSERT_TRUE(fs::is_socket(socket_path));
+    EXPECT_FALSE(query_rhsm_status_service(socket_path, paths).has_value());
+}
+
+TEST_F(RhsmStatusServiceTest, Query_DifferentPaths) {
+    const RunningService service(RhsmPaths().with_installroot(temp_dir / "other"), socket_path);
+    EXPECT_THROW(query_rhsm_status_service(socket_path, paths), std::runtime_error);
+}
+
+TEST_F(RhsmStatusServiceTest, Query_ErrorReply) {
+    const StandInService service(socket_path, [](VarlinkConnection &connection, const Json::Value &call) {
+        EXPECT_EQ(call["method"], STATUS_SERVICE_GET_STATUS);
+        connection.send(varlink_error(VARLINK_ERROR_METHOD_NOT_FOUND), VarlinkConnection::Clock::now() + 1s);
+    });
+    EXPECT_THROW(query_rhsm_status_service(socket_path, paths), std::runtime_error);
+}
+
+TEST_F(RhsmStatusServiceTest, Query_InvalidStatus) {
+    const StandInService service(socket_path, [this](VarlinkConnection &connection, const Json::Value &) {
+        Json::Value parameters(Json::objectValue);
+        parameters["paths"] = rhsm_paths_to_json(paths);
+        parameters["status"]["registered"] = "yes";
+        connection.send(varlink_reply(parameters), VarlinkConnection::Clock::now() + 1s);
+    });
+    EXPECT_THROW(query_rhsm_status_service(socket_path, paths), std::runtime_error);
+}
+
+TEST_F(RhsmStatusServiceTest, Query_Timeout) {
+    const StandInService service(socket_path, [](VarlinkConnection &, const Json::Value &) {});
+    const auto start = std::chrono::steady_clock::now();
+    EXPECT_THROW(query_rhsm_status_service(socket_path, paths, 50ms), std::runtime_error);
+    EXPECT_LT(std::chrono::steady_clock::now() - start, 1s);
+}
+
+// --- Fallback to the in-process checks ---
+
+TEST_F(RhsmStatusServiceTest, GetRhsmStatus_FallbackWithoutService) {
+    register_system();
+    add_entitlement("1", "expired.pem");
+    const auto status = get_rhsm_status(paths, expiry_cache, now(), 0, socket_path);
+    EXPECT_FALSE(status.from_service);
+    EXPECT_TRUE(status.status_service_error.empty());
+    EXPECT_EQ(status.expired_entitlements, (std::vector<std::string>{"1"}));
+}
+
+TEST_F(RhsmStatusServiceTest, GetRhsmStatus_FallbackWhenServiceFails) {
+    register_system();
+    add_entitlement("1", "expired.pem");
+    const StandInService service(socket_path, [](VarlinkConnection &connection, const Json::Value &) {
+        connection.send(varlink_error("com.redhat.rhsm.Status.CheckFailed"), VarlinkConnection::Clock::now() + 1s);
+    });
+    const auto status = get_rhsm_status(paths, expiry_cache, now(), 0, socket_path);
+    EXPECT_FALSE(status.from_service);
+    EXPECT_NE(status.status_service_error.find("CheckFailed"), std::string::npos);
+    EXPECT_EQ(status.expired_entitlements, (std::vector<std::string>{"1"}));
+}
+
+TEST_F(RhsmStatusServiceTest, GetRhsmStatus_FromService) {
+    register_system();
+    const RunningService service(paths, socket_path);
+    const auto status = start_rhsm_status_check(paths, expiry_cache, 0, socket_path).get();
+    EXPECT_TRUE(status.from_service);
+    EXPECT_TRUE(status.registered);
+    EXPECT_FALSE(fs::exists(paths.status_cache_file));
+}
+
+
+int main(int argc, char ** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -2,6 +2,8 @@
 
 #include <filesystem>
 #include <fstream>
+#include <iterator>
+#include <sstream>
 
 #include "rhsm_utils.hpp"
 
@@ -110,6 +112,205 @@ TEST_F(CertExpiryTest, InvalidPemContent_Throws) {
 }
 
 
+TEST_F(CertExpiryTest, GetCertNotAfter_ExpiredCert) {
+    EXPECT_EQ(get_cert_not_after(test_data_dir / "expired.pem"), 1577836800);
+}
+
+TEST_F(CertExpiryTest, GetCertNotAfter_GeneralizedTime) {
+    EXPECT_EQ(get_cert_not_after(test_data_dir / "generalized-time.pem"), 2845281600);
+    EXPECT_FALSE(is_cert_expired(test_data_dir / "generalized-time.pem"));
+}
+
+TEST_F(CertExpiryTest, GetCertNotAfter_KeyBeforeCert_FallsBackToOpenSsl) {
+    // The fast path reads only the first PEM block; OpenSSL skips the key
+    std::ofstream(temp_dir / "combined.pem")
+        << std::ifstream(test_data_dir / "expired-key.pem").rdbuf()
+        << std::ifstream(test_data_dir / "expired.pem").rdbuf();
+    EXPECT_EQ(get_cert_not_after(temp_dir / "combined.pem"), 1577836800);
+    EXPECT_TRUE(is_cert_expired(temp_dir / "combined.pem"));
+}
+
+TEST_F(CertExpiryTest, GetCertNotAfter_InvalidPemContent_Throws) {
+    std::ofstream(temp_dir / "corrupt.pem") << "this is not a valid certificate";
+    EXPECT_THROW(get_cert_not_after(temp_dir / "corrupt.pem"), std::runtime_error);
+}
+
+
+// --- CertExpiryCache tests ---
+
+TEST_F(CertExpiryTest, ExpiryCache_ParsesAndStoresCert) {
+    fs::copy_file(test_data_dir / "expired.pem", temp_dir / "1234.pem");
+    CertExpiryCache cache(temp_dir / "cache.json");
+    EXPECT_FALSE(cache.lookup(temp_dir / "1234.pem").has_value());
+    EXPECT_EQ(cache.get_not_after(temp_dir / "1234.pem"), 1577836800);
+    EXPECT_TRUE(cache.dirty);
+    EXPECT_EQ(cache.lookup(temp_dir / "1234.pem"), 1577836800);
+}
+
+TEST_F(CertExpiryTest, ExpiryCache_UsesCachedRecord) {
+    // The cached record is used without parsing the certificate, as long as the file is not changed
+    std::ofstream(temp_dir / "1234.pem") << "not parsed";
+    CertExpiryCache cache(temp_dir / "cache.json");
+    EXPECT_TRUE(cache.store(temp_dir / "1234.pem", 42));
+    EXPECT_EQ(cache.get_not_after(temp_dir / "1234.pem"), 42);
+    EXPECT_EQ(cache.hits, 1);
+    EXPECT_EQ(cache.misses, 0);
+}
+
+TEST_F(CertExpiryTest, ExpiryCache_ChangedCertIsParsedAgain) {
+    std::ofstream(temp_dir / "1234.pem") << "old";
+    CertExpiryCache cache(temp_dir / "cache.json");
+    EXPECT_TRUE(cache.store(temp_dir / "1234.pem", 42));
+    fs::copy_file(test_data_dir / "expired.pem", temp_dir / "1234.pem", fs::copy_options::overwrite_existing);
+    EXPECT_FALSE(cache.lookup(temp_dir / "1234.pem").has_value());
+    EXPECT_EQ(cache.get_not_after(temp_dir / "1234.pem"), 1577836800);
+}
+
+TEST_F(CertExpiryTest, ExpiryCache_WriteAndRead) {
+    fs::copy_file(test_data_dir / "valid.pem", temp_dir / "1234.pem");
+    CertExpiryCache cache(temp_dir / "cache.json");
+    const auto not_after = cache.get_not_after(temp_dir / "1234.pem");
+    cache.write_cache();
+
+    CertExpiryCache new_cache(temp_dir / "cache.json");
+    new_cache.read_cache();
+    EXPECT_FALSE(new_cache.dirty);
+    EXPECT_EQ(new_cache.lookup(temp_dir / "1234.pem"), not_after);
+}
+
+TEST_F(CertExpiryTest, ExpiryCache_ReadNonexistentFile_Throws) {
+    CertExpiryCache cache(temp_dir / "cache.json");
+    EXPECT_THROW(cache.read_cache(), std::runtime_error);
+}
+
+TEST_F(CertExpiryTest, ExpiryCache_Prune) {
+    std::ofstream(temp_dir / "1234.pem") << "cert";
+    CertExpiryCache cache(temp_dir / "cache.json");
+    EXPECT_TRUE(cache.store(temp_dir / "1234.pem", 42));
+    EXPECT_EQ(cache.prune(), 0);
+    fs::remove(temp_dir / "1234.pem");
+    EXPECT_EQ(cache.prune(), 1);
+    EXPECT_TRUE(cache.records.empty());
+}
+
+TEST_F(CertExpiryTest, ExpiryCache_ReplacedCertIsParsedAgain) {
+    // A certificate replaced by rename keeps the size and the modification time, but not the inode
+    std::ofstream(temp_dir / "1234.pem") << "cert";
+    CertExpiryCache cache(temp_dir / "cache.json");
+    EXPECT_TRUE(cache.store(temp_dir / "1234.pem", 42));
+    const auto mtime = fs::last_write_time(temp_dir / "1234.pem");
+    std::ofstream(temp_dir / "1234.pem.new") << "cert";
+    fs::last_write_time(temp_dir / "1234.pem.new", mtime);
+    fs::rename(temp_dir / "1234.pem.new", temp_dir / "1234.pem");
+    EXPECT_FALSE(cache.lookup(temp_dir / "1234.pem").has_value());
+}
+
+TEST_F(CertExpiryTest, ExpiryCache_StatusChangeInvalidatesRecord) {
+    // The ctime changes e.g. when a certificate is restored from a backup with the original mtime
+    std::ofstream(temp_dir / "1234.pem") << "cert";
+    CertExpiryCache cache(temp_dir / "cache.json");
+    EXPECT_TRUE(cache.store(temp_dir / "1234.pem", 42));
+    auto record = cache.records.at((temp_dir / "1234.pem").string());
+    record.ctime_ns -= 1;
+    cache.records[(temp_dir / "1234.pem").string()] = record;
+    EXPECT_FALSE(cache.lookup(temp_dir / "1234.pem").has_value());
+}
+
+TEST_F(CertExpiryTest, ExpiryCache_RecordWithoutInodeIsIgnored) {
+    // Records written by older versions do not contain the inode and the ctime
+    std::ofstream(temp_dir / "cache.json") << R"({"/etc/pki/entitlement/1.pem": {"size": 1, "mtime_ns": 2, "not_after": 3}})";
+    CertExpiryCache cache(temp_dir / "cache.json");
+    cache.read_cache();
+    EXPECT_TRUE(cache.records.empty());
+}
+
+
+// --- parallel parsing of entitlement certificates ---
+
+TEST_F(CertExpiryTest, GetEntitlementCertPaths_SkipsKeysAndSorts) {
+    std::ofstream(temp_dir / "2.pem") << "cert";
+    std::ofstream(temp_dir / "1.pem") << "cert";
+    std::ofstream(temp_dir / "1-key.pem") << "key";
+    std::ofstream(temp_dir / "README") << "text";
+    const auto cert_paths = get_entitlement_cert_paths(temp_dir);
+    ASSERT_EQ(cert_paths.size(), 2);
+    EXPECT_EQ(cert_paths[0], temp_dir / "1.pem");
+    EXPECT_EQ(cert_paths[1], temp_dir / "2.pem");
+}
+
+TEST_F(CertExpiryTest, GetEntitlementCertPaths_NonexistentDir) {
+    EXPECT_TRUE(get_entitlement_cert_paths(temp_dir / "nonexistent").empty());
+}
+
+TEST_F(CertExpiryTest, GetCertsNotAfter_KeepsOrderWithThreads) {
+    // Enough certificates to use all threads; every seventh certificate is broken
+    std::vector<fs::path> cert_paths;
+    for (int i = 0; i < 100; ++i) {
+        const auto cert_path = temp_dir / (std::to_string(i) + ".pem");
+        if (i % 7 == 0) {
+            std::ofstream(cert_path) << "broken";
+        } else {
+            fs::copy_file(test_data_dir / (i % 2 == 0 ? "expired.pem" : "valid.pem"), cert_path);
+        }
+        cert_paths.push_back(cert_path);
+    }
+    const auto expected_valid_not_after = get_cert_not_after(test_data_dir / "valid.pem");
+
+    const auto results = get_certs_not_after(cert_paths, 4);
+    ASSERT_EQ(results.size(), cert_paths.size());
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        if (i % 7 == 0) {
+            EXPECT_FALSE(results[i].not_after.has_value());
+            EXPECT_FALSE(results[i].error.empty());
+        } else {
+            ASSERT_TRUE(results[i].not_after.has_value());
+            EXPECT_EQ(*results[i].not_after, i % 2 == 0 ? 1577836800 : expected_valid_not_after);
+        }
+    }
+}
+
+TEST_F(CertExpiryTest, ExpiryCache_GetNotAfterOfManyCerts) {
+    fs::copy_file(test_data_dir / "expired.pem", temp_dir / "1.pem");
+    std::ofstream(temp_dir / "2.pem") << "not parsed";
+    std::ofstream(temp_dir / "3.pem") << "broken";
+    CertExpiryCache cache(temp_dir / "cache.json");
+    EXPECT_TRUE(cache.store(temp_dir / "2.pem", 42));
+
+    const auto results = cache.get_not_after({temp_dir / "1.pem", temp_dir / "2.pem", temp_dir / "3.pem"});
+    ASSERT_EQ(results.size(), 3);
+    EXPECT_EQ(results[0].not_after, 1577836800);
+    EXPECT_EQ(results[1].not_after, 42);
+    EXPECT_FALSE(results[2].not_after.has_value());
+    EXPECT_EQ(cache.hits, 1);
+    EXPECT_EQ(cache.misses, 2);
+    // Only successfully parsed certificates are cached
+    EXPECT_EQ(cache.lookup(temp_dir / "1.pem"), 1577836800);
+    EXPECT_FALSE(cache.lookup(temp_dir / "3.pem").has_value());
+}
+
+// --- write_file_atomically tests ---
+
+TEST_F(RhsmUtilsTest, WriteFileAtomically_ReplacesContent) {
+    const auto path = temp_dir / "status.json";
+    std::ofstream(path) << "old";
+    write_file_atomically(path, "new");
+    std::ifstream file(path);
+    std::stringstream content;
+    content << file.rdbuf();
+    EXPECT_EQ(content.str(), "new");
+    EXPECT_EQ(fs::status(path).permissions(), fs::perms(0644));
+    EXPECT_EQ(std::distance(fs::directory_iterator(temp_dir), fs::directory_iterator()), 1);
+}
+
+TEST_F(RhsmUtilsTest, WriteFileAtomically_FailureRemovesTemporaryFile) {
+    // A directory cannot be replaced by a file
+    const auto path = temp_dir / "redhat.repo";
+    fs::create_directories(path / "subdir");
+    EXPECT_THROW(write_file_atomically(path, "content"), std::runtime_error);
+    EXPECT_TRUE(fs::is_directory(path));
+    EXPECT_EQ(std::distance(fs::directory_iterator(temp_dir), fs::directory_iterator()), 1);
+}
+
 // --- get_releasever tests ---
 
 TEST_F(RhsmUtilsTest, GetReleasever_NonexistentFile) {
@@ -146,6 +347,50 @@ TEST(ContainerDetectionTest, DoesNotCrash) {
     [[maybe_unused]] bool result = in_container();
 }
 
+TEST_F(RhsmUtilsTest, InContainer_HostDirectoriesExist) {
+    fs::create_directories(temp_dir / "rhsm-host");
+    fs::create_directories(temp_dir / "entitlement-host");
+    EXPECT_TRUE(in_container(temp_dir / "rhsm-host", temp_dir / "entitlement-host"));
+}
+
+TEST_F(RhsmUtilsTest, InContainer_HostDirectoryMissing) {
+    fs::create_directories(temp_dir / "rhsm-host");
+    EXPECT_FALSE(in_container(temp_dir / "rhsm-host", temp_dir / "entitlement-host"));
+}
+
+
+// --- RhsmPaths ---
+
+TEST(RhsmPathsTest, RootInstallroot) {
+    const auto paths = RhsmPaths().with_installroot("/");
+    EXPECT_EQ(paths.consumer_cert_dir, fs::path(CONSUMER_CERT_DIR));
+    EXPECT_EQ(paths.entitlement_cert_dir, fs::path(ENTITLEMENT_CERT_DIR));
+    EXPECT_EQ(paths.releasever_file, fs::path(RELEASEVER_FILE));
+    EXPECT_EQ(paths.rhsm_host_config_dir, fs::path(RHSM_HOST_CONFIG_DIR));
+    EXPECT_EQ(paths.entitlement_host_cert_dir, fs::path(ENTITLEMENT_HOST_CERT_DIR));
+}
+
+TEST(RhsmPathsTest, CustomInstallroot) {
+    const auto paths = RhsmPaths().with_installroot("/mnt/sysimage");
+    EXPECT_EQ(paths.consumer_cert_dir, fs::path("/mnt/sysimage/etc/pki/consumer/"));
+    EXPECT_EQ(paths.entitlement_cert_dir, fs::path("/mnt/sysimage/etc/pki/entitlement/"));
+    EXPECT_EQ(paths.releasever_file, fs::path("/mnt/sysimage/etc/dnf/vars/releasever"));
+    EXPECT_EQ(paths.rhsm_host_config_dir, fs::path("/mnt/sysimage/etc/rhsm-host"));
+    EXPECT_EQ(paths.entitlement_host_cert_dir, fs::path("/mnt/sysimage/etc/pki/entitlement-host"));
+    EXPECT_EQ(paths.expiry_cache_file, fs::path("/mnt/sysimage/var/cache/rhsm/entitlement-expiry.json"));
+    EXPECT_EQ(paths.status_cache_file, fs::path("/mnt/sysimage/var/cache/rhsm/status.json"));
+    EXPECT_EQ(paths.rhsm_config_file, fs::path("/mnt/sysimage/etc/rhsm/rhsm.conf"));
+    EXPECT_EQ(paths.content_cache_file, fs::path("/mnt/sysimage/var/cache/rhsm/entitlement-content.json"));
+}
+
+TEST(RhsmPathsTest, ConfiguredPathWithInstallroot) {
+    RhsmPaths configured;
+    configured.entitlement_cert_dir = "/srv/entitlement";
+    const auto paths = configured.with_installroot("/mnt/sysimage/");
+    EXPECT_EQ(paths.entitlement_cert_dir, fs::path("/mnt/sysimage/srv/entitlement"));
+    EXPECT_EQ(paths.consumer_cert_dir, fs::path("/mnt/sysimage/etc/pki/consumer/"));
+}
+
 
 int main(int argc, char ** argv) {
     ::testing::InitGoogleTest(&argc, argv);
@@ -0,0 +1,190 @@
+#include "varlink.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+std::runtime_error system_error(const std::string &what) {
+    return std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+sockaddr_un make_address(const std::filesystem::path &socket_path) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    const auto &path = socket_path.native();
+    if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error("Invalid socket path: " + path);
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return address;
+}
+
+std::string to_string(const Json::Value &message) {
+    Json::StreamWriterBuilder writer_builder;
+    writer_builder["indentation"] = "";
+    return Json::writeString(writer_builder, message);
+}
+
+}  // namespace
+
+VarlinkConnection::VarlinkConnection(VarlinkConnection &&other) noexcept
+    : fd(std::exchange(other.fd, -1)), buffer(std::move(other.buffer)) {}
+
+VarlinkConnection::~VarlinkConnection() {
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+std::optional<VarlinkConnection> VarlinkConnection::connect(const std::filesystem::path &socket_path) {
+    const auto address = make_address(socket_path);
+    VarlinkConnection connection(socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0));
+    if (connection.fd < 0) {
+        throw system_error("Unable to create socket");
+    }
+    // Connecting to a unix socket does not block: it is either accepted into the backlog or refused
+    if (::connect(connection.fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0) {
+        if (errno == ENOENT || errno == ECONNREFUSED) {
+            return std::nullopt;
+        }
+        throw system_error("Unable to connect to " + socket_path.string());
+    }
+    return connection;
+}
+
+void VarlinkConnection::wait(const short events, const Clock::time_point deadline) const {
+    while (true) {
+        const auto remaining =
+            std::chrono::ceil<std::chrono::milliseconds>(deadline - Clock::now()).count();
+        if (remaining <= 0) {
+            throw std::runtime_error("Varlink connection timed out");
+        }
+        pollfd poll_fd{.fd = fd, .events = events, .revents = 0};
+        const auto ready = poll(&poll_fd, 1, static_cast<int>(std::min<decltype(remaining)>(remaining, 60000)));
+        if (ready > 0) {
+            return;
+        }
+        if (ready < 0 && errno != EINTR) {
+            throw system_error("Unable to poll Varlink connection");
+        }
+    }
+}
+
+void VarlinkConnection::send(const Json::Value &message, const Clock::time_point deadline) {
+    // The terminating NUL byte is part of the message
+    const auto data = to_string(message);
+    const std::string_view message_data(data.c_str(), data.size() + 1);
+    std::size_t sent = 0;
+    while (sent < message_data.size()) {
+        const auto size = ::send(fd, message_data.data() + sent, message_data.size() - sent, MSG_NOSIGNAL);
+        if (size >= 0) {
+            sent += static_cast<std::size_t>(size);
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            wait(POLLOUT, deadline);
+        } else if (errno != EINTR) {
+            throw system_error("Unable to send Varlink message");
+        }
+    }
+}
+
+std::optional<Json::Value> VarlinkConnection::receive(const Clock::time_point deadline) {
+    std::size_t end;
+    while ((end = buffer.find('\0')) == std::string::npos) {
+        if (buffer.size() > MAX_VARLINK_MESSAGE_SIZE) {
+            throw std::runtime_error("Varlink message is too large");
+        }
+        char chunk[4096];
+        const auto size = recv(fd, chunk, sizeof(chunk), 0);
+        if (size > 0) {
+            buffer.append(chunk, static_cast<std::size_t>(size));
+        } else if (size == 0) {
+            if (buffer.empty()) {
+                return std::nullopt;
+            }
+            throw std::runtime_error("Varlink connection closed in the middle of a message");
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            wait(POLLIN, deadline);
+        } else if (errno != EINTR) {
+            throw system_error("Unable to receive Varlink message");
+        }
+    }
+
+    Json::Value message;
+    Json::CharReaderBuilder reader_builder;
+    const std::unique_ptr<Json::CharReader> reader(reader_builder.newCharReader());
+    Json::String errors;
+    const auto parsed = reader->parse(buffer.data(), buffer.data() + end, &message, &errors);
+    buffer.erase(0, end + 1);
+    if (!parsed || !message.isObject()) {
+        throw std::runtime_error("Invalid Varlink message: " + errors);
+    }
+    return message;
+}
+
+Json::Value VarlinkConnection::call(
+    const std::string &method, const Json::Value &parameters, const Clock::time_point deadline) {
+    Json::Value request(Json::objectValue);
+    request["method"] = method;
+    request["parameters"] = parameters;
+    send(request, deadline);
+
+    const auto reply = receive(deadline);
+    if (!reply) {
+        throw std::runtime_error("Varlink connection closed before the reply to " + method);
+    }
+    if ((*reply)["error"].isString()) {
+        throw std::runtime_error("Varlink call " + method + " failed: " + (*reply)["error"].asString());
+    }
+    const auto &reply_parameters = (*reply)["parameters"];
+    if (!reply_parameters.isNull() && !reply_parameters.isObject()) {
+        throw std::runtime_error("Invalid reply to " + method);
+    }
+    return reply_parameters.isNull() ? Json::Value(Json::objectValue) : reply_parameters;
+}
+
+int varlink_listen(const std::filesystem::path &socket_path) {
+    const auto address = make_address(socket_path);
+    const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (fd < 0) {
+        throw system_error("Unable to create socket");
+    }
+
+    // A socket left behind by a previous instance of the service is replaced
+    std::error_code ec;
+    if (std::filesystem::is_socket(std::filesystem::symlink_status(socket_path, ec))) {
+        unlink(socket_path.c_str());
+    }
+    const auto old_mask = umask(0077);
+    const auto bound = bind(fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address));
+    umask(old_mask);
+    if (bound != 0 || listen(fd, SOMAXCONN) != 0) {
+        const auto error = system_error("Unable to listen on " + socket_path.string());
+        close(fd);
+        throw error;
+    }
+    return fd;
+}
+
+Json::Value varlink_reply(const Json::Value &parameters) {
+    Json::Value reply(Json::objectValue);
+    reply["parameters"] = parameters;
+    return reply;
+}
+
+Json::Value varlink_error(const std::string &error, const Json::Value &parameters) {
+    Json::Value reply(Json::objectValue);
+    reply["error"] = error;
+    reply["parameters"] = parameters;
+    return reply;
+}
@@ -0,0 +1,71 @@
+#ifndef RHSM_DNF5_PLUGINS_VARLINK_HPP
+#define RHSM_DNF5_PLUGINS_VARLINK_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <json/json.h>
+
+/// Minimal implementation of the Varlink protocol (https://varlink.org) used by the rhsm status
+/// service and its client: JSON objects terminated by a NUL byte over a unix stream socket. Only
+/// plain method calls with one reply are supported; "more", "oneway" and "upgrade" are not.
+
+/// Messages larger than this are rejected; the status has a few kilobytes
+constexpr std::size_t MAX_VARLINK_MESSAGE_SIZE = 1024 * 1024;
+
+/// Errors defined by the org.varlink.service interface
+constexpr const char * VARLINK_ERROR_METHOD_NOT_FOUND = "org.varlink.service.MethodNotFound";
+constexpr const char * VARLINK_ERROR_INVALID_PARAMETER = "org.varlink.service.InvalidParameter";
+
+/// A connected unix stream socket exchanging Varlink messages. Every operation has a deadline,
+/// so that neither side can block the other one.
+class VarlinkConnection {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /// Take ownership of a connected socket
+    explicit VarlinkConnection(int fd) : fd(fd) {}
+    VarlinkConnection(VarlinkConnection && other) noexcept;
+    VarlinkConnection(const VarlinkConnection &) = delete;
+    VarlinkConnection & operator=(const VarlinkConnection &) = delete;
+    VarlinkConnection & operator=(VarlinkConnection &&) = delete;
+    ~VarlinkConnection();
+
+    /// Connect to the socket. Returns std::nullopt when nobody listens on the socket: it does not
+    /// exist (ENOENT) or it is stale (ECONNREFUSED). Throws std::runtime_error on other failures.
+    static std::optional<VarlinkConnection> connect(const std::filesystem::path & socket_path);
+
+    /// Send the message. Throws std::runtime_error on failure or when the deadline passes.
+    void send(const Json::Value & message, Clock::time_point deadline);
+
+    /// Receive the next message. Returns std::nullopt when the peer closed the connection between
+    /// messages. Throws std::runtime_error on failure, on an invalid message or when the deadline passes.
+    std::optional<Json::Value> receive(Clock::time_point deadline);
+
+    /// Call the method and return the parameters of the reply. Throws std::runtime_error on failure,
+    /// including an error reply.
+    Json::Value call(const std::string & method, const Json::Value & parameters, Clock::time_point deadline);
+
+private:
+    /// Wait until the socket is ready for the events (POLLIN or POLLOUT)
+    void wait(short events, Clock::time_point deadline) const;
+
+    int fd;
+
+    /// Received data following the last returned message
+    std::string buffer;
+};
+
+/// Create a listening unix stream socket, replacing a stale socket file. The socket can be accessed
+/// only by the owner (mode 0600). Returns the file descriptor. Throws std::runtime_error on failure.
+int varlink_listen(const std::filesystem::path & socket_path);
+
+/// Create a reply message with the parameters
+Json::Value varlink_reply(const Json::Value & parameters);
+
+/// Create an error reply message
+Json::Value varlink_error(const std::string & error, const Json::Value & parameters = Json::objectValue);
+
+#endif // RHSM_DNF5_PLUGINS_VARLINK_HPP